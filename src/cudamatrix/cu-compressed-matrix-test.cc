@@ -158,6 +158,44 @@ void CuCompressedMatrixTestSymmetric() {
 }
 
 
+// bfloat16 keeps the sign, zero and the dynamic range, with a relative
+// error of at most 2^-8; this one also runs without a GPU.
+void CuCompressedMatrixTestBf16() {
+  int32 num_rows = RandInt(80, 100),
+      num_cols = RandInt(80, 100);
+  CuMatrix<BaseFloat> M(num_rows, num_cols);
+  M.SetRandn();
+  // a wide dynamic range, and some exact zeros,
+  Matrix<BaseFloat> M_host(M);
+  for (int32 r = 0; r < num_rows; r++) {
+    M_host.Row(r).Scale(pow(10.0, RandInt(-20, 20)));
+    M_host(r, RandInt(0, num_cols - 1)) = 0.0;
+  }
+  M.CopyFromMat(M_host);
+
+  CuCompressedMatrixBase *cm = NewCuCompressedMatrix(kCompressedMatrixBf16,
+                                                     0.0);
+  CuMatrix<BaseFloat> M2(num_rows, num_cols, kUndefined);
+  cm->CopyFromMat(M);
+  cm->CopyToMat(&M2);
+  KALDI_ASSERT(cm->NumRows() == num_rows && cm->NumCols() == num_cols);
+
+  Matrix<BaseFloat> M2_host(M2);
+  for (int32 r = 0; r < num_rows; r++) {
+    for (int32 c = 0; c < num_cols; c++) {
+      BaseFloat a = M_host(r, c), b = M2_host(r, c);
+      KALDI_ASSERT(fabs(a - b) <= fabs(a) / 256.0);
+      KALDI_ASSERT((a == 0.0) == (b == 0.0) && (a < 0.0) == (b < 0.0));
+    }
+  }
+  // rounding to nearest even, (1 + 2^-8 is half-way between bf16 values),
+  KALDI_ASSERT(CuBf16Matrix::Bf16ToFloat(CuBf16Matrix::FloatToBf16(
+      1.0 + 1.0 / 256)) == 1.0);
+  KALDI_ASSERT(CuBf16Matrix::Bf16ToFloat(CuBf16Matrix::FloatToBf16(
+      1.0 + 3.0 / 256)) == 1.0 + 4.0 / 256);
+  delete cm;
+}
+
 
 } // namespace kaldi
 
@@ -175,5 +213,8 @@ int main() {
   }
 
 #endif
+  for (int32 i = 1; i < 10; i++) {
+    CuCompressedMatrixTestBf16();
+  }
   return 0;
 }
@@ -116,6 +116,62 @@ void CuCompressedMatrix<I>::CopyToMat(CuMatrixBase<BaseFloat> *mat) const {
 }
 
 
+void CuBf16Matrix::CopyFromMat(const CuMatrixBase<BaseFloat> &mat) {
+  num_rows_ = mat.NumRows();
+  num_cols_ = mat.NumCols();
+  data_.resize(static_cast<size_t>(num_rows_) * num_cols_);
+  if (data_.empty()) return;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Matrix<BaseFloat> host(mat);
+    for (MatrixIndexT r = 0; r < num_rows_; r++) {
+      const BaseFloat *src = host.RowData(r);
+      uint16 *dst = &(data_[static_cast<size_t>(r) * num_cols_]);
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        dst[c] = FloatToBf16(src[c]);
+    }
+    return;
+  }
+#endif
+  for (MatrixIndexT r = 0; r < num_rows_; r++) {
+    const BaseFloat *src = mat.Mat().RowData(r);
+    uint16 *dst = &(data_[static_cast<size_t>(r) * num_cols_]);
+    for (MatrixIndexT c = 0; c < num_cols_; c++)
+      dst[c] = FloatToBf16(src[c]);
+  }
+}
+
+void CuBf16Matrix::CopyToMat(CuMatrixBase<BaseFloat> *mat) const {
+  KALDI_ASSERT(mat->NumRows() == num_rows_ && mat->NumCols() == num_cols_);
+  if (data_.empty()) return;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Matrix<BaseFloat> host(num_rows_, num_cols_, kUndefined);
+    for (MatrixIndexT r = 0; r < num_rows_; r++) {
+      const uint16 *src = &(data_[static_cast<size_t>(r) * num_cols_]);
+      BaseFloat *dst = host.RowData(r);
+      for (MatrixIndexT c = 0; c < num_cols_; c++)
+        dst[c] = Bf16ToFloat(src[c]);
+    }
+    mat->CopyFromMat(host);
+    return;
+  }
+#endif
+  for (MatrixIndexT r = 0; r < num_rows_; r++) {
+    const uint16 *src = &(data_[static_cast<size_t>(r) * num_cols_]);
+    BaseFloat *dst = mat->Mat().RowData(r);
+    for (MatrixIndexT c = 0; c < num_cols_; c++)
+      dst[c] = Bf16ToFloat(src[c]);
+  }
+}
+
+void CuBf16Matrix::Clear() {
+  std::vector<uint16>().swap(data_);
+  num_rows_ = 0;
+  num_cols_ = 0;
+}
+
+
 CuCompressedMatrixBase *NewCuCompressedMatrix(CuCompressedMatrixType t,
                                               BaseFloat range,
                                               bool truncat) {
@@ -131,6 +187,8 @@ CuCompressedMatrixBase *NewCuCompressedMatrix(CuCompressedMatrixType t,
   } else if (t == kCompressedMatrixInt16) {
     KALDI_ASSERT(range > 0);
     return new CuCompressedMatrix<int16>(range);
+  } else if (t == kCompressedMatrixBf16) {
+    return new CuBf16Matrix();
   } else {
     KALDI_ERR << "Unknown compressed-matrix type";
     return NULL;
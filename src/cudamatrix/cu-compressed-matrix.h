@@ -22,6 +22,9 @@
 #ifndef KALDI_CUDAMATRIX_CU_COMPRESSED_MATRIX_H_
 #define KALDI_CUDAMATRIX_CU_COMPRESSED_MATRIX_H_
 
+#include <cstring>
+#include <vector>
+
 #include "cudamatrix/cu-matrix.h"
 
 namespace kaldi {
@@ -134,6 +137,60 @@ class CuCompressedMatrix: public CuCompressedMatrixBase {
 
 
 
+/**
+   Class CuBf16Matrix stores a CuMatrix<BaseFloat> in the 'bfloat16' format
+   (the upper 16 bits of an IEEE float, i.e. 8 exponent bits and 7 mantissa
+   bits, rounded to nearest even).  It halves the memory, with a relative
+   error of at most 2^-8 and the dynamic range of float, so unlike
+   CuCompressedMatrix there is no 'range' to choose, and the sign and zero
+   are exact.
+
+   Unlike CuCompressedMatrix, it works without a GPU: it is meant for the
+   activation storage in CPU training, where the activations kept for the
+   backward pass are stored in bfloat16 (less memory and memory bandwidth),
+   while the computation and the model stay in BaseFloat.  With a GPU it works, but
+   the data goes through the host memory, so it is slow there.
+ */
+class CuBf16Matrix: public CuCompressedMatrixBase {
+ public:
+  CuBf16Matrix(): num_rows_(0), num_cols_(0) { }
+
+  virtual void CopyFromMat(const CuMatrixBase<BaseFloat> &mat);
+
+  virtual void CopyToMat(CuMatrixBase<BaseFloat> *mat) const;
+
+  virtual MatrixIndexT NumRows() const { return num_rows_; }
+
+  virtual MatrixIndexT NumCols() const { return num_cols_; }
+
+  /// Frees the data.
+  void Clear();
+
+  /// Rounds to the nearest bfloat16 (ties to even, NaN stays NaN).
+  static inline uint16 FloatToBf16(float f) {
+    uint32 u;
+    memcpy(&u, &f, sizeof(u));
+    if ((u & 0x7fffffff) > 0x7f800000)  // NaN, keep it quiet,
+      return static_cast<uint16>((u >> 16) | 0x40);
+    u += 0x7fff + ((u >> 16) & 1);
+    return static_cast<uint16>(u >> 16);
+  }
+
+  static inline float Bf16ToFloat(uint16 b) {
+    uint32 u = static_cast<uint32>(b) << 16;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+  }
+
+ private:
+  std::vector<uint16> data_;
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+};
+
+
+
 // This enum value is used to encode the type you want to instantiate
 // a CuCompressedMatrix with.  It's used in class NnetComputation
 // (cast to int32) as one of the arguments of kCompressMatrix.
@@ -141,16 +198,18 @@ enum  CuCompressedMatrixType {
   kCompressedMatrixInt8 = 1,
   kCompressedMatrixUint8 = 2,
   kCompressedMatrixInt16 = 3,
-  kCompressedMatrixUint16 = 4
+  kCompressedMatrixUint16 = 4,
+  kCompressedMatrixBf16 = 5  // CuBf16Matrix, also without a GPU.
 };
 
 /**
    This function allocates a new CuCompressedMatrix with type determined
    by t, and with the 'range' and 'truncate' parameters provided to the
-   constructor of class CuCompressedMatrix.
+   constructor of class CuCompressedMatrix.  For kCompressedMatrixBf16 it
+   allocates a CuBf16Matrix (the 'range' and 'truncate' are not used).
 
-   It will crash at runtime if called when CUDA is not compiled in, or not
-   enabled.
+   Except for kCompressedMatrixBf16, it will crash at runtime if called when
+   CUDA is not compiled in, or not enabled.
  */
 CuCompressedMatrixBase *NewCuCompressedMatrix(CuCompressedMatrixType t,
                                               BaseFloat range,
@@ -487,6 +487,26 @@ void cudaD_find_row_max_id(dim3 Gr, dim3 Bl, const double *mat, double *vec_val,
                            int32_cuda *vec_id, MatrixDim d);
 void cudaF_find_row_max_id(dim3 Gr, dim3 Bl, const float *mat, float *vec_val,
                            int32_cuda *vec_id, MatrixDim d);
+void cudaD_fsmn_filter_grad(dim3 Gr, dim3 Bl, double *filter, MatrixDim d,
+                            const double *out_diff, int out_diff_stride,
+                            const double *in, int in_stride, const double *flags,
+                            int num_rows, int first_tap, int step,
+                            double alpha);
+void cudaF_fsmn_filter_grad(dim3 Gr, dim3 Bl, float *filter, MatrixDim d,
+                            const float *out_diff, int out_diff_stride,
+                            const float *in, int in_stride, const float *flags,
+                            int num_rows, int first_tap, int step,
+                            float alpha);
+void cudaD_fsmn_memory(dim3 Gr, dim3 Bl, double *out, MatrixDim d,
+                       const double *in, int in_stride, const double *l_filter,
+                       int l_filter_stride, const double *r_filter,
+                       int r_filter_stride, const double *flags, int l_order,
+                       int r_order, int l_step, int r_step);
+void cudaF_fsmn_memory(dim3 Gr, dim3 Bl, float *out, MatrixDim d,
+                       const float *in, int in_stride, const float *l_filter,
+                       int l_filter_stride, const float *r_filter,
+                       int r_filter_stride, const float *flags, int l_order,
+                       int r_order, int l_step, int r_step);
 void cudaD_group_max(dim3 Gr, dim3 Bl, double *y, const double *x, MatrixDim d,
                      int src_stride, int group_size);
 void cudaF_group_max(dim3 Gr, dim3 Bl, float *y, const float *x, MatrixDim d,
@@ -2330,6 +2330,65 @@ static void _add_row_ranges(Real *data, MatrixDim dim, const Real *src_data,
     data[dst_index] += src_data[row_index * src_dim.stride + col];
 }
 
+// Computes the memory of an FSMN layer: for each row,
+// out(row) = in(row) + sum_{i=0}^{l_order-1} l_filter(i) .* in(row - i*l_step)
+//                    + sum_{j=1}^{r_order} r_filter(j-1) .* in(row + j*r_step),
+// omitting rows outside the matrix and rows whose flag differs from that of
+// 'row' (a different sentence).  'flags' may be NULL.  With negated steps this
+// is the backprop of the same operation.
+template<typename Real>
+__global__
+static void _fsmn_memory(Real *out, MatrixDim d, const Real *in, int in_stride,
+                         const Real *l_filter, int l_filter_stride,
+                         const Real *r_filter, int r_filter_stride,
+                         const Real *flags, int l_order, int r_order,
+                         int l_step, int r_step) {
+  int col = blockIdx.x * blockDim.x + threadIdx.x;
+  int row = blockIdx.y * blockDim.y + threadIdx.y;
+  if (row >= d.rows || col >= d.cols)
+    return;
+  Real sum = in[row * in_stride + col];
+  for (int i = 0; i < l_order; i++) {
+    int src_row = row - i * l_step;
+    if (src_row >= 0 && src_row < d.rows &&
+        (flags == NULL || flags[src_row] == flags[row]))
+      sum += l_filter[i * l_filter_stride + col] * in[src_row * in_stride + col];
+  }
+  for (int j = 1; j <= r_order; j++) {
+    int src_row = row + j * r_step;
+    if (src_row >= 0 && src_row < d.rows &&
+        (flags == NULL || flags[src_row] == flags[row]))
+      sum += r_filter[(j - 1) * r_filter_stride + col] *
+          in[src_row * in_stride + col];
+  }
+  out[row * d.stride + col] = sum;
+}
+
+// Does filter(k) += alpha * sum_t out_diff(t) .* in(t + (k + first_tap) * step)
+// for each row k of 'filter' (of dimension d), omitting terms where the row
+// of 'in' is outside [0, num_rows) or in a different sentence from t.  This
+// is the update of the filters of _fsmn_memory.
+template<typename Real>
+__global__
+static void _fsmn_filter_grad(Real *filter, MatrixDim d, const Real *out_diff,
+                              int out_diff_stride, const Real *in,
+                              int in_stride, const Real *flags, int num_rows,
+                              int first_tap, int step, Real alpha) {
+  int col = blockIdx.x * blockDim.x + threadIdx.x;
+  int k = blockIdx.y * blockDim.y + threadIdx.y;
+  if (k >= d.rows || col >= d.cols)
+    return;
+  int shift = (k + first_tap) * step;
+  int t_begin = max(0, -shift), t_end = min(num_rows, num_rows - shift);
+  Real sum = 0.0;
+  for (int t = t_begin; t < t_end; t++) {
+    if (flags == NULL || flags[t + shift] == flags[t])
+      sum += out_diff[t * out_diff_stride + col] *
+          in[(t + shift) * in_stride + col];
+  }
+  filter[k * d.stride + col] += alpha * sum;
+}
+
 template<typename Real>
 __global__
 static void _soft_hinge(Real*y, const Real*x, MatrixDim d, int src_stride) {
@@ -4369,6 +4428,26 @@ void cudaF_add_row_ranges(dim3 Gr, dim3 Bl, float *data, MatrixDim dim,
   _add_row_ranges<<<Gr,Bl>>>(data, dim, src_data, src_dim, indexes);
 }
 
+void cudaF_fsmn_memory(dim3 Gr, dim3 Bl, float *out, MatrixDim d,
+                       const float *in, int in_stride, const float *l_filter,
+                       int l_filter_stride, const float *r_filter,
+                       int r_filter_stride, const float *flags, int l_order,
+                       int r_order, int l_step, int r_step) {
+  _fsmn_memory<<<Gr,Bl>>>(out, d, in, in_stride, l_filter, l_filter_stride,
+                          r_filter, r_filter_stride, flags, l_order, r_order,
+                          l_step, r_step);
+}
+
+void cudaF_fsmn_filter_grad(dim3 Gr, dim3 Bl, float *filter, MatrixDim d,
+                            const float *out_diff, int out_diff_stride,
+                            const float *in, int in_stride, const float *flags,
+                            int num_rows, int first_tap, int step,
+                            float alpha) {
+  _fsmn_filter_grad<<<Gr,Bl>>>(filter, d, out_diff, out_diff_stride, in,
+                               in_stride, flags, num_rows, first_tap, step,
+                               alpha);
+}
+
 void cudaF_matrix_lookup(dim3 Gr, dim3 Bl, const float *data, MatrixDim dim,
                          const Int32Pair *indices, int indices_size,
                          float *output) {
@@ -5062,6 +5141,26 @@ void cudaD_add_row_ranges(dim3 Gr, dim3 Bl, double *data, MatrixDim dim,
   _add_row_ranges<<<Gr,Bl>>>(data, dim, src_data, src_dim, indexes);
 }
 
+void cudaD_fsmn_memory(dim3 Gr, dim3 Bl, double *out, MatrixDim d,
+                       const double *in, int in_stride, const double *l_filter,
+                       int l_filter_stride, const double *r_filter,
+                       int r_filter_stride, const double *flags, int l_order,
+                       int r_order, int l_step, int r_step) {
+  _fsmn_memory<<<Gr,Bl>>>(out, d, in, in_stride, l_filter, l_filter_stride,
+                          r_filter, r_filter_stride, flags, l_order, r_order,
+                          l_step, r_step);
+}
+
+void cudaD_fsmn_filter_grad(dim3 Gr, dim3 Bl, double *filter, MatrixDim d,
+                            const double *out_diff, int out_diff_stride,
+                            const double *in, int in_stride, const double *flags,
+                            int num_rows, int first_tap, int step,
+                            double alpha) {
+  _fsmn_filter_grad<<<Gr,Bl>>>(filter, d, out_diff, out_diff_stride, in,
+                               in_stride, flags, num_rows, first_tap, step,
+                               alpha);
+}
+
 void cudaD_matrix_lookup(dim3 Gr, dim3 Bl, const double *data, MatrixDim dim,
                          const Int32Pair *indices, int indices_size,
                          double *output) {
@@ -916,6 +916,44 @@ inline void cuda_find_row_max_id(dim3 Gr, dim3 Bl, const float *mat,
                                  MatrixDim d) {
   cudaF_find_row_max_id(Gr, Bl, mat, vec_val, vec_id, d);
 }
+inline void cuda_fsmn_filter_grad(dim3 Gr, dim3 Bl, double *filter,
+                                  MatrixDim d, const double *out_diff,
+                                  int out_diff_stride, const double *in,
+                                  int in_stride, const double *flags,
+                                  int num_rows, int first_tap, int step,
+                                  double alpha) {
+  cudaD_fsmn_filter_grad(Gr, Bl, filter, d, out_diff, out_diff_stride, in,
+                          in_stride, flags, num_rows, first_tap, step, alpha);
+}
+inline void cuda_fsmn_filter_grad(dim3 Gr, dim3 Bl, float *filter,
+                                  MatrixDim d, const float *out_diff,
+                                  int out_diff_stride, const float *in,
+                                  int in_stride, const float *flags,
+                                  int num_rows, int first_tap, int step,
+                                  float alpha) {
+  cudaF_fsmn_filter_grad(Gr, Bl, filter, d, out_diff, out_diff_stride, in,
+                          in_stride, flags, num_rows, first_tap, step, alpha);
+}
+inline void cuda_fsmn_memory(dim3 Gr, dim3 Bl, double *out, MatrixDim d,
+                             const double *in, int in_stride,
+                             const double *l_filter, int l_filter_stride,
+                             const double *r_filter, int r_filter_stride,
+                             const double *flags, int l_order, int r_order,
+                             int l_step, int r_step) {
+  cudaD_fsmn_memory(Gr, Bl, out, d, in, in_stride, l_filter, l_filter_stride,
+                     r_filter, r_filter_stride, flags, l_order, r_order,
+                     l_step, r_step);
+}
+inline void cuda_fsmn_memory(dim3 Gr, dim3 Bl, float *out, MatrixDim d,
+                             const float *in, int in_stride,
+                             const float *l_filter, int l_filter_stride,
+                             const float *r_filter, int r_filter_stride,
+                             const float *flags, int l_order, int r_order,
+                             int l_step, int r_step) {
+  cudaF_fsmn_memory(Gr, Bl, out, d, in, in_stride, l_filter, l_filter_stride,
+                     r_filter, r_filter_stride, flags, l_order, r_order,
+                     l_step, r_step);
+}
 inline void cuda_group_max(dim3 Gr, dim3 Bl, double *y, const double *x,
                            MatrixDim d, int src_stride, int group_size) {
   cudaD_group_max(Gr, Bl, y, x, d, src_stride, group_size);
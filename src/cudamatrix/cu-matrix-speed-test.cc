@@ -980,6 +980,42 @@ template<typename Real> void TestCuMatrixAddRowRanges(int32 dim) {
             << dim << ", speed was " << gflops << " gigaflops.";
 }
 
+template<typename Real> void TestCuMatrixFsmnMemory(int32 dim) {
+  BaseFloat time_in_secs = 0.025;
+  // A typical FSMN memory block: 10 frames of history and 10 of look-ahead
+  // with stride 2, on 'dim' frames of 'dim' dimensions, in 4 sentences.
+  int32 l_order = 10, r_order = 10, l_stride = 2, r_stride = 2;
+  CuMatrix<Real> in(dim, dim), out(dim, dim), out_diff(dim, dim),
+      in_diff(dim, dim), l_filter(l_order, dim), r_filter(r_order, dim);
+  in.SetRandn();
+  out_diff.SetRandn();
+  l_filter.SetRandn();
+  r_filter.SetRandn();
+  Vector<Real> flags(dim);
+  for (int32 t = 0; t < dim; t++)
+    flags(t) = (4 * t) / dim;
+  CuVector<Real> cu_flags(flags);
+
+  Timer tim;
+  int32 iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++) {
+    out.GenMemory(in, l_filter, r_filter, cu_flags,
+                  l_order, r_order, l_stride, r_stride);
+    in_diff.MemoryErrBack(out_diff, l_filter, r_filter, cu_flags,
+                          l_order, r_order, l_stride, r_stride);
+    l_filter.GetLfilterErr(out_diff, in, cu_flags, l_order, l_stride, 1.0e-05);
+    r_filter.GetRfilterErr(out_diff, in, cu_flags, r_order, r_stride, 1.0e-05);
+  }
+
+  BaseFloat fdim = dim;
+  // Each of the 4 operations does 2 flops per tap and matrix element.
+  BaseFloat gflops = (4 * 2 * (l_order + r_order) * fdim * fdim * iter) /
+      (tim.Elapsed() * 1.0e+09);
+  KALDI_LOG << "For CuMatrix::GenMemory (forward and backward)"
+            << NameOf<Real>() << ", for dim = " << dim << ", speed was "
+            << gflops << " gigaflops.";
+}
+
 template<typename Real> void TestCuSparseMatrixTraceMatSmat(int32 dim) {
   for (int32 n = 0; n < 2; n++) {
     MatrixTransposeType trans = (n == 0 ? kNoTrans : kTrans);
@@ -1099,6 +1135,8 @@ template<typename Real> void CudaMatrixSpeedTest() {
     TestCuMatrixAddToRows<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixAddRowRanges<Real>(sizes[s]);
+  for (int32 s = 0; s < ns; s++)
+    TestCuMatrixFsmnMemory<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
     TestCuMatrixTransposeCross<Real>(sizes[s]);
   for (int32 s = 0; s < ns; s++)
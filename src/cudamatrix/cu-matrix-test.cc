@@ -714,6 +714,79 @@ static void UnitTestCuMatrixSumColumnRanges() {
 }
 
 
+template<typename Real>
+static void UnitTestCuMatrixFsmnMemory() {
+  for (int32 p = 0; p < 8; p++) {
+    bool uni = (p % 4 == 3);
+    MatrixIndexT num_rows = 10 + Rand() % 50,
+        num_cols = 10 + Rand() % 600;
+    int32 l_order = 1 + Rand() % 5, r_order = (uni ? 0 : Rand() % 5),
+        l_stride = 1 + Rand() % 3, r_stride = 1 + Rand() % 3;
+    Real lr = 0.1;
+    Matrix<Real> in(num_rows, num_cols), out_diff(num_rows, num_cols),
+        l_filter(l_order, num_cols), r_filter(r_order, r_order ? num_cols : 0);
+    in.SetRandn();
+    out_diff.SetRandn();
+    l_filter.SetRandn();
+    r_filter.SetRandn();
+    // Three sentences, or (if the flags are empty) one.
+    Vector<Real> flags;
+    if (p % 2 == 0) {
+      flags.Resize(num_rows);
+      for (MatrixIndexT t = 0; t < num_rows; t++)
+        flags(t) = (3 * t) / num_rows;
+    }
+
+    // Simple computation:
+    Matrix<Real> out(in), in_diff(out_diff),
+        l_filter_new(l_filter), r_filter_new(r_filter);
+    for (MatrixIndexT t = 0; t < num_rows; t++) {
+      for (int32 k = 0; k < l_order + r_order; k++) {
+        bool left = (k < l_order);
+        int32 s = (left ? t - k * l_stride : t + (k - l_order + 1) * r_stride);
+        if (s < 0 || s >= num_rows || (flags.Dim() != 0 && flags(s) != flags(t)))
+          continue;
+        SubVector<Real> filter_row(left ? l_filter.Row(k) :
+                                   r_filter.Row(k - l_order));
+        SubVector<Real> filter_new_row(left ? l_filter_new.Row(k) :
+                                       r_filter_new.Row(k - l_order));
+        for (MatrixIndexT c = 0; c < num_cols; c++) {
+          out(t, c) += filter_row(c) * in(s, c);
+          in_diff(s, c) += filter_row(c) * out_diff(t, c);
+          filter_new_row(c) -= lr * out_diff(t, c) * in(s, c);
+        }
+      }
+    }
+
+    CuMatrix<Real> cu_in(in), cu_out_diff(out_diff), cu_l_filter(l_filter),
+        cu_r_filter(r_filter), cu_out(num_rows, num_cols, kUndefined),
+        cu_in_diff(num_rows, num_cols, kUndefined);
+    CuVector<Real> cu_flags(flags);
+    if (uni) {
+      cu_out.GenUniMemory(cu_in, cu_l_filter, cu_flags, l_order, l_stride);
+      cu_in_diff.UniMemoryErrBack(cu_out_diff, cu_l_filter, cu_flags,
+                                  l_order, l_stride);
+    } else {
+      cu_out.GenMemory(cu_in, cu_l_filter, cu_r_filter, cu_flags,
+                       l_order, r_order, l_stride, r_stride);
+      cu_in_diff.MemoryErrBack(cu_out_diff, cu_l_filter, cu_r_filter, cu_flags,
+                               l_order, r_order, l_stride, r_stride);
+    }
+    cu_l_filter.GetLfilterErr(cu_out_diff, cu_in, cu_flags, l_order, l_stride,
+                              lr);
+    cu_r_filter.GetRfilterErr(cu_out_diff, cu_in, cu_flags, r_order, r_stride,
+                              lr);
+
+    Matrix<Real> out2(cu_out), in_diff2(cu_in_diff),
+        l_filter2(cu_l_filter), r_filter2(cu_r_filter);
+    KALDI_ASSERT(ApproxEqual(out, out2));
+    KALDI_ASSERT(ApproxEqual(in_diff, in_diff2));
+    KALDI_ASSERT(ApproxEqual(l_filter_new, l_filter2));
+    KALDI_ASSERT(ApproxEqual(r_filter_new, r_filter2));
+  }
+}
+
+
 template<typename Real>
 static void UnitTestCuMatrixAddRowRanges() {
   for (int32 p = 0; p < 10; p++) {
@@ -3001,6 +3074,7 @@ template<typename Real> void CudaMatrixUnitTest() {
   UnitTestCuMatrixMulRows<Real>();
   UnitTestCuMatrixAddToRows<Real>();
   UnitTestCuMatrixAddRowRanges<Real>();
+  UnitTestCuMatrixFsmnMemory<Real>();
   UnitTestCuMatrixAddTpMat<Real>();
   UnitTestCuMatrixTranspose<Real>();
   UnitTestCuMatrixCopyUpperToLower<Real>();
@@ -2954,6 +2954,204 @@ void CuMatrixBase<Real>::AddRowRanges(const CuMatrixBase<Real> &src,
 }
 
 
+// The FSMN memory-block functions all reduce to the following two operations,
+// which correspond to the kernels _fsmn_memory and _fsmn_filter_grad in
+// cu-kernels.cu (see there for the meaning of the arguments).  The CPU code
+// works on blocks of kFsmnBlockCols columns so that the filters and the rows
+// of input within reach of the filters stay in cache, and its innermost loops
+// are over consecutive columns, so they are vectorized.
+static const int32 kFsmnBlockCols = 256;
+
+template<typename Real>
+static void FsmnMemory(const CuMatrixBase<Real> &in,
+                       const CuMatrixBase<Real> &l_filter,
+                       const CuMatrixBase<Real> &r_filter,
+                       const CuVectorBase<Real> &flags,
+                       int32 l_order, int32 r_order,
+                       int32 l_step, int32 r_step,
+                       CuMatrixBase<Real> *out) {
+  KALDI_ASSERT(SameDim(*out, in) && out->Data() != in.Data());
+  KALDI_ASSERT(l_order >= 0 && r_order >= 0 &&
+               l_filter.NumRows() == l_order && r_filter.NumRows() == r_order);
+  KALDI_ASSERT((l_order == 0 || l_filter.NumCols() == in.NumCols()) &&
+               (r_order == 0 || r_filter.NumCols() == in.NumCols()));
+  KALDI_ASSERT(flags.Dim() == 0 || flags.Dim() == in.NumRows());
+  if (in.NumRows() == 0) return;
+  const Real *flags_data = (flags.Dim() == 0 ? NULL : flags.Data());
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuTimer tim;
+    dim3 dimGrid, dimBlock;
+    GetBlockSizesForSimpleMatrixOperation(in.NumRows(), in.NumCols(),
+                                          &dimGrid, &dimBlock);
+    cuda_fsmn_memory(dimGrid, dimBlock, out->Data(), out->Dim(),
+                     in.Data(), in.Stride(), l_filter.Data(), l_filter.Stride(),
+                     r_filter.Data(), r_filter.Stride(), flags_data,
+                     l_order, r_order, l_step, r_step);
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
+  } else
+#endif
+  {
+    int32 num_rows = in.NumRows(), num_cols = in.NumCols(),
+        out_stride = out->Stride(), in_stride = in.Stride(),
+        num_taps = l_order + r_order;
+    Real *out_data = out->Data();
+    const Real *in_data = in.Data();
+    for (int32 col0 = 0; col0 < num_cols; col0 += kFsmnBlockCols) {
+      int32 block_cols = std::min(kFsmnBlockCols, num_cols - col0);
+      for (int32 row = 0; row < num_rows; row++) {
+        Real *__restrict__ out_row = out_data + row * out_stride + col0;
+        const Real *__restrict__ in_row = in_data + row * in_stride + col0;
+        for (int32 col = 0; col < block_cols; col++)
+          out_row[col] = in_row[col];
+        for (int32 k = 0; k < num_taps; k++) {
+          int32 src_row;
+          const Real *filter_row;
+          if (k < l_order) {
+            src_row = row - k * l_step;
+            filter_row = l_filter.RowData(k) + col0;
+          } else {
+            src_row = row + (k - l_order + 1) * r_step;
+            filter_row = r_filter.RowData(k - l_order) + col0;
+          }
+          if (src_row < 0 || src_row >= num_rows ||
+              (flags_data != NULL && flags_data[src_row] != flags_data[row]))
+            continue;
+          const Real *__restrict__ src = in_data + src_row * in_stride + col0,
+              *__restrict__ filter_data = filter_row;
+          for (int32 col = 0; col < block_cols; col++)
+            out_row[col] += filter_data[col] * src[col];
+        }
+      }
+    }
+  }
+}
+
+template<typename Real>
+static void FsmnFilterGrad(const CuMatrixBase<Real> &out_diff,
+                           const CuMatrixBase<Real> &in,
+                           const CuVectorBase<Real> &flags,
+                           int32 first_tap, int32 step, Real alpha,
+                           CuMatrixBase<Real> *filter) {
+  if (filter->NumRows() == 0) return;
+  KALDI_ASSERT(SameDim(out_diff, in) && filter->NumCols() == in.NumCols());
+  KALDI_ASSERT(flags.Dim() == 0 || flags.Dim() == in.NumRows());
+  if (in.NumRows() == 0) return;
+  const Real *flags_data = (flags.Dim() == 0 ? NULL : flags.Data());
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuTimer tim;
+    dim3 dimGrid, dimBlock;
+    GetBlockSizesForSimpleMatrixOperation(filter->NumRows(), filter->NumCols(),
+                                          &dimGrid, &dimBlock);
+    cuda_fsmn_filter_grad(dimGrid, dimBlock, filter->Data(), filter->Dim(),
+                          out_diff.Data(), out_diff.Stride(),
+                          in.Data(), in.Stride(), flags_data, in.NumRows(),
+                          first_tap, step, alpha);
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
+  } else
+#endif
+  {
+    int32 num_rows = in.NumRows(), num_cols = in.NumCols(),
+        num_taps = filter->NumRows(), out_diff_stride = out_diff.Stride(),
+        in_stride = in.Stride();
+    const Real *out_diff_data = out_diff.Data(), *in_data = in.Data();
+    // The gradient for a block of columns; row k is at k * kFsmnBlockCols.
+    std::vector<Real> grad(num_taps * kFsmnBlockCols);
+    for (int32 col0 = 0; col0 < num_cols; col0 += kFsmnBlockCols) {
+      int32 block_cols = std::min(kFsmnBlockCols, num_cols - col0);
+      std::fill(grad.begin(), grad.end(), Real(0.0));
+      for (int32 row = 0; row < num_rows; row++) {
+        const Real *__restrict__ out_diff_row =
+            out_diff_data + row * out_diff_stride + col0;
+        for (int32 k = 0; k < num_taps; k++) {
+          int32 src_row = row + (k + first_tap) * step;
+          if (src_row < 0 || src_row >= num_rows ||
+              (flags_data != NULL && flags_data[src_row] != flags_data[row]))
+            continue;
+          const Real *__restrict__ src = in_data + src_row * in_stride + col0;
+          Real *__restrict__ grad_row = &(grad[k * kFsmnBlockCols]);
+          for (int32 col = 0; col < block_cols; col++)
+            grad_row[col] += out_diff_row[col] * src[col];
+        }
+      }
+      for (int32 k = 0; k < num_taps; k++) {
+        Real *filter_row = filter->RowData(k) + col0;
+        const Real *grad_row = &(grad[k * kFsmnBlockCols]);
+        for (int32 col = 0; col < block_cols; col++)
+          filter_row[col] += alpha * grad_row[col];
+      }
+    }
+  }
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::GenMemory(const CuMatrixBase<Real> &in,
+                                   const CuMatrixBase<Real> &l_filter,
+                                   const CuMatrixBase<Real> &r_filter,
+                                   const CuVectorBase<Real> &flags,
+                                   int32 l_order, int32 r_order,
+                                   int32 l_stride, int32 r_stride) {
+  FsmnMemory(in, l_filter, r_filter, flags, l_order, r_order,
+             l_stride, r_stride, this);
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::GenUniMemory(const CuMatrixBase<Real> &in,
+                                      const CuMatrixBase<Real> &l_filter,
+                                      const CuVectorBase<Real> &flags,
+                                      int32 l_order, int32 l_stride) {
+  CuMatrix<Real> no_filter;
+  FsmnMemory(in, l_filter, no_filter, flags, l_order, 0, l_stride, 0, this);
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::MemoryErrBack(const CuMatrixBase<Real> &out_diff,
+                                       const CuMatrixBase<Real> &l_filter,
+                                       const CuMatrixBase<Real> &r_filter,
+                                       const CuVectorBase<Real> &flags,
+                                       int32 l_order, int32 r_order,
+                                       int32 l_stride, int32 r_stride) {
+  // The backprop is the same filter run the other way in time.
+  FsmnMemory(out_diff, l_filter, r_filter, flags, l_order, r_order,
+             -l_stride, -r_stride, this);
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::UniMemoryErrBack(const CuMatrixBase<Real> &out_diff,
+                                          const CuMatrixBase<Real> &l_filter,
+                                          const CuVectorBase<Real> &flags,
+                                          int32 l_order, int32 l_stride) {
+  CuMatrix<Real> no_filter;
+  FsmnMemory(out_diff, l_filter, no_filter, flags, l_order, 0,
+             -l_stride, 0, this);
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::GetLfilterErr(const CuMatrixBase<Real> &out_diff,
+                                       const CuMatrixBase<Real> &in,
+                                       const CuVectorBase<Real> &flags,
+                                       int32 l_order, int32 l_stride,
+                                       Real lr) {
+  KALDI_ASSERT(NumRows() == l_order);
+  // Tap i of the left filter reads in(t - i * l_stride).
+  FsmnFilterGrad(out_diff, in, flags, 0, -l_stride, -lr, this);
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::GetRfilterErr(const CuMatrixBase<Real> &out_diff,
+                                       const CuMatrixBase<Real> &in,
+                                       const CuVectorBase<Real> &flags,
+                                       int32 r_order, int32 r_stride,
+                                       Real lr) {
+  KALDI_ASSERT(NumRows() == r_order);
+  // Row j - 1 of the right filter reads in(t + j * r_stride).
+  FsmnFilterGrad(out_diff, in, flags, 1, r_stride, -lr, this);
+}
+
+
 template<typename Real>
 void CuMatrixBase<Real>::CopyLowerToUpper() {
   KALDI_ASSERT(num_cols_ == num_rows_);
@@ -190,6 +190,61 @@ class CuMatrixBase {
                     const CuArrayBase<Int32Pair> &indexes);
 
 
+  /// The following functions implement the memory block of FSMN (feedforward
+  /// sequential memory network) components, which filters each column of its
+  /// input along the time (row) axis.  'flags' has one element per row and
+  /// identifies the sentence the row belongs to: rows with different flags
+  /// never see each other.  If 'flags' is empty, all rows are one sentence.
+
+  /// Sets *this to the memory of 'in': for each row t,
+  ///  this(t) = in(t) + \sum_{i=0}^{l_order-1} l_filter(i) .* in(t - i*l_stride)
+  ///                  + \sum_{j=1}^{r_order} r_filter(j-1) .* in(t + j*r_stride),
+  /// where terms whose row is outside the matrix or in a different sentence
+  /// are omitted.  l_filter is l_order by NumCols(), and r_filter is r_order
+  /// by NumCols().  *this must not be the same matrix as 'in'.
+  void GenMemory(const CuMatrixBase<Real> &in,
+                 const CuMatrixBase<Real> &l_filter,
+                 const CuMatrixBase<Real> &r_filter,
+                 const CuVectorBase<Real> &flags,
+                 int32 l_order, int32 r_order,
+                 int32 l_stride, int32 r_stride);
+
+  /// As GenMemory(), with no look-ahead (r_order == 0).
+  void GenUniMemory(const CuMatrixBase<Real> &in,
+                    const CuMatrixBase<Real> &l_filter,
+                    const CuVectorBase<Real> &flags,
+                    int32 l_order, int32 l_stride);
+
+  /// Backpropagates through GenMemory(): sets *this to the derivative w.r.t.
+  /// its input, given the derivative 'out_diff' w.r.t. its output.
+  void MemoryErrBack(const CuMatrixBase<Real> &out_diff,
+                     const CuMatrixBase<Real> &l_filter,
+                     const CuMatrixBase<Real> &r_filter,
+                     const CuVectorBase<Real> &flags,
+                     int32 l_order, int32 r_order,
+                     int32 l_stride, int32 r_stride);
+
+  /// Backpropagates through GenUniMemory().
+  void UniMemoryErrBack(const CuMatrixBase<Real> &out_diff,
+                        const CuMatrixBase<Real> &l_filter,
+                        const CuVectorBase<Real> &flags,
+                        int32 l_order, int32 l_stride);
+
+  /// *this is the l_filter given to GenMemory() or GenUniMemory(), which was
+  /// applied to 'in'; does a gradient-descent step on it with learning rate
+  /// 'lr', given the derivative 'out_diff' w.r.t. the output.
+  void GetLfilterErr(const CuMatrixBase<Real> &out_diff,
+                     const CuMatrixBase<Real> &in,
+                     const CuVectorBase<Real> &flags,
+                     int32 l_order, int32 l_stride, Real lr);
+
+  /// As GetLfilterErr(), for the r_filter of GenMemory().
+  void GetRfilterErr(const CuMatrixBase<Real> &out_diff,
+                     const CuMatrixBase<Real> &in,
+                     const CuVectorBase<Real> &flags,
+                     int32 r_order, int32 r_stride, Real lr);
+
+
   friend Real TraceMatMat<Real>(const CuMatrixBase<Real> &A,
                                 const CuMatrixBase<Real> &B,
                                 MatrixTransposeType trans);
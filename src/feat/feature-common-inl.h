@@ -69,16 +69,23 @@ void OfflineFeatureTpl<F>::Compute(
     return;
   }
   output->Resize(rows_out, cols_out);
-  Vector<BaseFloat> window;  // windowed waveform.
+  // Extract and window the frames a block at a time; each row of 'windows'
+  // is then transformed in place by the computer.
+  Matrix<BaseFloat> windows;
+  Vector<BaseFloat> raw_log_energies;
   bool use_raw_log_energy = computer_.NeedRawLogEnergy();
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index.
-    BaseFloat raw_log_energy = 0.0;
-    ExtractWindow(0, wave, r, computer_.GetFrameOptions(),
-                  feature_window_function_, &window,
-                  (use_raw_log_energy ? &raw_log_energy : NULL));
-
-    SubVector<BaseFloat> output_row(*output, r);
-    computer_.Compute(raw_log_energy, vtln_warp, &window, &output_row);
+  for (int32 begin = 0; begin < rows_out; begin += kBlockSize) {
+    int32 size = (rows_out - begin < kBlockSize ? rows_out - begin :
+                  kBlockSize);
+    ExtractWindows(0, wave, begin, size, computer_.GetFrameOptions(),
+                   feature_window_function_, &windows,
+                   (use_raw_log_energy ? &raw_log_energies : NULL));
+    for (int32 r = 0; r < size; r++) {
+      BaseFloat raw_log_energy = (use_raw_log_energy ?
+                                  raw_log_energies(r) : 0.0);
+      SubVector<BaseFloat> window(windows, r), output_row(*output, begin + r);
+      computer_.Compute(raw_log_energy, vtln_warp, &window, &output_row);
+    }
   }
 }
 
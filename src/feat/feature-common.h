@@ -163,6 +163,10 @@ class OfflineFeatureTpl {
   // Disallow assignment.
   OfflineFeatureTpl<F> &operator =(const OfflineFeatureTpl<F> &other);
 
+  // The number of frames that Compute() extracts and processes together; a
+  // block of 64 frames of 512 samples (128KB) stays in L2 cache.
+  static const int32 kBlockSize = 64;
+
   F computer_;
   FeatureWindowFunction feature_window_function_;
 };
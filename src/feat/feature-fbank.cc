@@ -73,9 +73,6 @@ void FbankComputer::Compute(BaseFloat signal_log_energy,
                             BaseFloat vtln_warp,
                             VectorBase<BaseFloat> *signal_frame,
                             VectorBase<BaseFloat> *feature) {
-
-  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
-
   KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
                feature->Dim() == this->Dim());
 
@@ -90,10 +87,21 @@ void FbankComputer::Compute(BaseFloat signal_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two.
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void FbankComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                   BaseFloat vtln_warp,
+                                   VectorBase<BaseFloat> *fft,
+                                   VectorBase<BaseFloat> *feature) {
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+
+  KALDI_ASSERT(fft->Dim() == opts_.frame_opts.PaddedWindowSize() &&
+               feature->Dim() == this->Dim());
+
   // Convert the FFT into a power spectrum.
-  ComputePowerSpectrum(signal_frame);
-  SubVector<BaseFloat> power_spectrum(*signal_frame, 0,
-                                      signal_frame->Dim() / 2 + 1);
+  ComputePowerSpectrum(fft);
+  SubVector<BaseFloat> power_spectrum(*fft, 0, fft->Dim() / 2 + 1);
 
   // Use magnitude instead of power if requested.
   if (!opts_.use_power)
@@ -92,6 +92,40 @@ void UnitTestOnlineCmvn() {
   }
 }
 
+void UnitTestExtractWindows() {
+  for (int32 i = 0; i < 10; i++) {
+    FrameExtractionOptions opts;
+    opts.dither = 0.0;
+    opts.snip_edges = (i % 2 == 0);
+    opts.remove_dc_offset = (i % 3 != 0);
+    opts.preemph_coeff = (i % 4 == 0 ? 0.0 : 0.97);
+    opts.round_to_power_of_two = (i % 5 != 0);
+    FeatureWindowFunction window_function(opts);
+    Vector<BaseFloat> wave(1000 + Rand() % 5000);
+    wave.SetRandn();
+    wave.Scale(1000.0);
+    int32 num_frames = NumFrames(wave.Dim(), opts);
+    if (num_frames == 0) continue;
+    int32 first_frame = Rand() % num_frames,
+        block_size = 1 + Rand() % (num_frames - first_frame);
+    Matrix<BaseFloat> windows;
+    Vector<BaseFloat> log_energies;
+    ExtractWindows(0, wave, first_frame, block_size, opts, window_function,
+                   &windows, &log_energies);
+    KALDI_ASSERT(windows.NumRows() == block_size &&
+                 windows.NumCols() == opts.PaddedWindowSize());
+    Vector<BaseFloat> window;
+    for (int32 i = 0; i < block_size; i++) {
+      BaseFloat log_energy;
+      ExtractWindow(0, wave, first_frame + i, opts, window_function, &window,
+                    &log_energy);
+      SubVector<BaseFloat> row(windows, i);
+      AssertEqual(window, row, 1.0e-03);
+      AssertEqual(log_energy, log_energies(i), 1.0e-03);
+    }
+  }
+}
+
 
 }
 
@@ -101,6 +135,7 @@ int main() {
   using namespace kaldi;
   try {
     UnitTestOnlineCmvn();
+    UnitTestExtractWindows();
     std::cout << "Tests succeeded.\n";
     return 0;
   } catch (const std::exception &e) {
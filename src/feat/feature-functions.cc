@@ -380,5 +380,76 @@ void SlidingWindowCmn(const SlidingWindowCmnOptions &opts,
 }
 
 
+bool PasteFeats(const std::vector<Matrix<BaseFloat> > &in,
+                const std::string &utt,
+                int32 tolerance,
+                Matrix<BaseFloat> *out) {
+  // Check the lengths
+  int32 min_len = in[0].NumRows(),
+      max_len = in[0].NumRows(),
+      tot_dim = in[0].NumCols();
+  for (int32 i = 1; i < in.size(); i++) {
+    int32 len = in[i].NumRows(), dim = in[i].NumCols();
+    tot_dim += dim;
+    if (len < min_len) min_len = len;
+    if (len > max_len) max_len = len;
+  }
+  if (max_len - min_len > tolerance || min_len == 0) {
+    KALDI_WARN << "Length mismatch " << max_len << " vs. " << min_len
+               << (utt.empty() ? "" : " for utt ") << utt
+               << " exceeds tolerance " << tolerance;
+    out->Resize(0, 0);
+    return false;
+  }
+  if (max_len - min_len > 0) {
+    KALDI_VLOG(2) << "Length mismatch " << max_len << " vs. " << min_len
+                  << (utt.empty() ? "" : " for utt ") << utt
+                  << " within tolerance " << tolerance;
+  }
+  out->Resize(min_len, tot_dim);
+  int32 dim_offset = 0;
+  for (int32 i = 0; i < in.size(); i++) {
+    int32 this_dim = in[i].NumCols();
+    out->Range(0, min_len, dim_offset, this_dim).CopyFromMat(
+        in[i].Range(0, min_len, 0, this_dim));
+    dim_offset += this_dim;
+  }
+  return true;
+}
+
+
+void PasteSortedFeatTables(const std::vector<std::string> &rspecifiers,
+                           int32 tolerance,
+                           BaseFloatMatrixWriter *writer,
+                           int32 *num_done,
+                           int32 *num_err) {
+  SequentialBaseFloatMatrixJoinReader input(rspecifiers);
+  for (; !input.Done(); input.Next()) {
+    std::string utt = input.Key();
+    KALDI_VLOG(2) << "Merging features for utterance " << utt;
+    std::vector<Matrix<BaseFloat> > feats(input.NumInputs());
+    int32 i;
+    for (i = 0; i < input.NumInputs(); i++) {
+      if (input.HasKey(i)) {
+        feats[i].Swap(&input.Value(i));
+      } else {
+        KALDI_WARN << "Missing utt " << utt << " from input "
+                   << rspecifiers[i];
+        (*num_err)++;
+        break;
+      }
+    }
+    if (i != input.NumInputs())
+      continue;
+    Matrix<BaseFloat> output;
+    if (!PasteFeats(feats, utt, tolerance, &output)) {
+      (*num_err)++;
+      continue;  // it will have printed a warning.
+    }
+    writer->Write(utt, output);
+    (*num_done)++;
+  }
+}
+
 
 }  // namespace kaldi
@@ -196,6 +196,28 @@ void SlidingWindowCmn(const SlidingWindowCmnOptions &opts,
                       MatrixBase<BaseFloat> *output);
 
 
+/// Appends the features in 'in' frame by frame, i.e. pastes them column-wise
+/// into 'out' (think of the unix command 'paste').  If the numbers of frames
+/// differ by at most 'tolerance', the output is trimmed to the shortest input;
+/// otherwise it prints a warning (mentioning 'utt' if nonempty), resizes 'out'
+/// to empty and returns false.
+bool PasteFeats(const std::vector<Matrix<BaseFloat> > &in,
+                const std::string &utt,
+                int32 tolerance,
+                Matrix<BaseFloat> *out);
+
+/// Pastes the utterances of the tables in 'rspecifiers' (see PasteFeats())
+/// and writes them to 'writer'.  All the tables must be sorted on key; they
+/// are read together in one sequential pass by a
+/// SequentialBaseFloatMatrixJoinReader.  Utterances missing from any of the
+/// inputs or failing the length check are counted in 'num_err'.
+void PasteSortedFeatTables(const std::vector<std::string> &rspecifiers,
+                           int32 tolerance,
+                           BaseFloatMatrixWriter *writer,
+                           int32 *num_done,
+                           int32 *num_err);
+
+
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
 
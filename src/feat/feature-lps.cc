@@ -62,10 +62,19 @@ void LpsComputer::Compute(BaseFloat signal_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void LpsComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                 BaseFloat vtln_warp,
+                                 VectorBase<BaseFloat> *fft,
+                                 VectorBase<BaseFloat> *feature) {
+  KALDI_ASSERT(fft->Dim() == opts_.frame_opts.PaddedWindowSize() &&
+               feature->Dim() == this->Dim());
+
   // Convert the FFT into a power spectrum.
-  ComputePowerSpectrum(signal_frame);
-  SubVector<BaseFloat> power_spectrum(*signal_frame,
-                                      0, signal_frame->Dim() / 2 + 1);
+  ComputePowerSpectrum(fft);
+  SubVector<BaseFloat> power_spectrum(*fft, 0, fft->Dim() / 2 + 1);
 
   power_spectrum.ApplyFloor(std::numeric_limits<BaseFloat>::epsilon());
   power_spectrum.ApplyLog();
@@ -82,4 +91,60 @@ void LpsComputer::Compute(BaseFloat signal_log_energy,
 
 }
 
+LpsPhsComputer::LpsPhsComputer(const LpsOptions &opts)
+    : opts_(opts), srfft_(NULL) {
+  int32 padded_window_size = opts.frame_opts.PaddedWindowSize();
+  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two
+    srfft_ = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+}
+
+LpsPhsComputer::LpsPhsComputer(const LpsPhsComputer &other):
+    opts_(other.opts_), srfft_(NULL) {
+  if (other.srfft_ != NULL)
+    srfft_ = new SplitRadixRealFft<BaseFloat>(*other.srfft_);
+}
+
+LpsPhsComputer::~LpsPhsComputer() {
+  delete srfft_;
+}
+
+void LpsPhsComputer::Compute(BaseFloat signal_log_energy,
+                             BaseFloat vtln_warp,
+                             VectorBase<BaseFloat> *signal_frame,
+                             VectorBase<BaseFloat> *feature) {
+  KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
+               feature->Dim() == this->Dim());
+
+  if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
+    srfft_->Compute(signal_frame->Data(), true);
+  else  // An alternative algorithm that works for non-powers-of-two
+    RealFft(signal_frame, true);
+
+  ComputeFromFft(signal_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void LpsPhsComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                    BaseFloat vtln_warp,
+                                    VectorBase<BaseFloat> *fft,
+                                    VectorBase<BaseFloat> *feature) {
+  int32 spectrum_dim = SpectrumDim();
+  KALDI_ASSERT(fft->Dim() == opts_.frame_opts.PaddedWindowSize() &&
+               feature->Dim() == this->Dim());
+
+  // The phase, as in PhsComputer; ComputePhaseSpectrum() works in place, so
+  // we give it a copy of the FFT.
+  fft_copy_.Resize(fft->Dim(), kUndefined);
+  fft_copy_.CopyFromVec(*fft);
+  ComputePhaseSpectrum(&fft_copy_);
+  feature->Range(spectrum_dim, spectrum_dim).CopyFromVec(
+      fft_copy_.Range(0, spectrum_dim));
+
+  // The log-power spectrum, as in LpsComputer.
+  ComputePowerSpectrum(fft);
+  SubVector<BaseFloat> power_spectrum(*fft, 0, spectrum_dim);
+  power_spectrum.ApplyFloor(std::numeric_limits<BaseFloat>::epsilon());
+  power_spectrum.ApplyLog();
+  feature->Range(0, spectrum_dim).CopyFromVec(power_spectrum);
+}
+
 }  // namespace kaldi
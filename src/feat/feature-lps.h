@@ -91,6 +91,14 @@ class LpsComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+
+  /// Does the part of Compute() that follows the FFT, as for
+  /// FbankComputer::ComputeFromFft(); 'signal_log_energy' is ignored.
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *fft,
+                      VectorBase<BaseFloat> *feature);
+
   ~LpsComputer();
 
  private:
@@ -105,6 +113,62 @@ class LpsComputer {
 typedef OfflineFeatureTpl<LpsComputer> Lps;
 
 
+/// Class for computing log-power spectra and phases from a single FFT per
+/// frame.  The feature is the output of LpsComputer (dimension
+/// padded-window-size / 2 + 1) followed by the output of PhsComputer for the
+/// same frame (same dimension), so speech-enhancement setups that need both
+/// (e.g. for resynthesis with OverlapAddSynthesizer) don't compute the FFT
+/// twice.
+class LpsPhsComputer {
+ public:
+  typedef LpsOptions Options;
+  explicit LpsPhsComputer(const LpsOptions &opts);
+  LpsPhsComputer(const LpsPhsComputer &other);
+
+  const FrameExtractionOptions& GetFrameOptions() const {
+    return opts_.frame_opts;
+  }
+
+  /// The dimension of the log-power spectrum; the phase has the same
+  /// dimension and starts at this offset in the feature.
+  int32 SpectrumDim() const {
+    return opts_.frame_opts.PaddedWindowSize() / 2 + 1;
+  }
+
+  int32 Dim() const { return 2 * SpectrumDim(); }
+
+  bool NeedRawLogEnergy() { return opts_.raw_energy; }
+
+  /// Computes the log-power spectrum and phase of one frame; the interface is
+  /// the same as LpsComputer::Compute().
+  void Compute(BaseFloat signal_log_energy,
+               BaseFloat vtln_warp,
+               VectorBase<BaseFloat> *signal_frame,
+               VectorBase<BaseFloat> *feature);
+
+
+  /// Does the part of Compute() that follows the FFT, as for
+  /// FbankComputer::ComputeFromFft(); 'signal_log_energy' is ignored.
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *fft,
+                      VectorBase<BaseFloat> *feature);
+
+  ~LpsPhsComputer();
+
+ private:
+  LpsOptions opts_;
+  SplitRadixRealFft<BaseFloat> *srfft_;
+  // A copy of the FFT of the current frame, from which the phase is computed.
+  Vector<BaseFloat> fft_copy_;
+
+  // Disallow assignment.
+  LpsPhsComputer &operator=(const LpsPhsComputer &other);
+};
+
+typedef OfflineFeatureTpl<LpsPhsComputer> LpsPhs;
+
+
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
 
@@ -32,8 +32,6 @@ void MfccComputer::Compute(BaseFloat signal_log_energy,
   KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
                feature->Dim() == this->Dim());
 
-  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
-
   if (opts_.use_energy && !opts_.raw_energy)
     signal_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
                                      std::numeric_limits<float>::min()));
@@ -43,10 +41,21 @@ void MfccComputer::Compute(BaseFloat signal_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two.
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void MfccComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                  BaseFloat vtln_warp,
+                                  VectorBase<BaseFloat> *fft,
+                                  VectorBase<BaseFloat> *feature) {
+  KALDI_ASSERT(fft->Dim() == opts_.frame_opts.PaddedWindowSize() &&
+               feature->Dim() == this->Dim());
+
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+
   // Convert the FFT into a power spectrum.
-  ComputePowerSpectrum(signal_frame);
-  SubVector<BaseFloat> power_spectrum(*signal_frame, 0,
-                                      signal_frame->Dim() / 2 + 1);
+  ComputePowerSpectrum(fft);
+  SubVector<BaseFloat> power_spectrum(*fft, 0, fft->Dim() / 2 + 1);
 
   mel_banks.Compute(power_spectrum, &mel_energies_);
 
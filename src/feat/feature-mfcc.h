@@ -124,6 +124,27 @@ class MfccComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+
+  /**
+     Does the part of Compute() that follows the FFT; Compute() is the same
+     as computing the FFT of the windowed frame and calling this.  It is used
+     when several feature types share the framing and FFT (see
+     MultiFeatureComputer).
+
+     @param [in] signal_log_energy  The raw log-energy of the frame if
+         opts.raw_energy is true, otherwise the log-energy of the windowed
+         frame, floored at numeric_limits<float>::min() before the log.
+         Ignored if opts.use_energy is false.
+     @param [in] vtln_warp  As for Compute().
+     @param [in] fft  The FFT of the windowed frame, in the format produced
+         by RealFft(); used as a workspace.
+     @param [out] feature  Pointer to a vector of size this->Dim().
+  */
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *fft,
+                      VectorBase<BaseFloat> *feature);
+
   ~MfccComputer();
  private:
   // disallow assignment.
@@ -0,0 +1,87 @@
+// feat/feature-multi-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/feature-multi.h"
+
+namespace kaldi {
+
+// Checks that MultiFeatureComputer gives the same features as computing each
+// feature type separately.
+void UnitTestMultiFeatureComputer() {
+  for (int32 i = 0; i < 8; i++) {
+    Vector<BaseFloat> wave(8000 + Rand() % 8000);
+    wave.SetRandn();
+    wave.Scale(1000.0);
+
+    FrameExtractionOptions frame_opts;
+    frame_opts.dither = 0.0;
+    frame_opts.snip_edges = (i % 2 == 0);
+
+    FbankOptions fbank_opts;
+    fbank_opts.frame_opts = frame_opts;
+    fbank_opts.use_energy = (i % 4 < 2);
+    fbank_opts.raw_energy = (i % 3 == 0);
+    MfccOptions mfcc_opts;
+    mfcc_opts.frame_opts = frame_opts;
+    mfcc_opts.raw_energy = (i % 3 != 0);
+    LpsOptions lps_opts;
+    lps_opts.frame_opts = frame_opts;
+    PhsOptions phs_opts;
+    phs_opts.frame_opts = frame_opts;
+    if (i >= 4) {
+      // Use different framing for the phase, so there are two groups.
+      phs_opts.frame_opts.frame_length_ms = 32.0;
+      phs_opts.frame_opts.window_type = "hamming";
+    }
+
+    MultiFeatureComputer computer;
+    KALDI_ASSERT(computer.AddComputer<FbankComputer>(fbank_opts) == 0 &&
+                 computer.AddComputer<MfccComputer>(mfcc_opts) == 1 &&
+                 computer.AddComputer<LpsComputer>(lps_opts) == 2 &&
+                 computer.AddComputer<PhsComputer>(phs_opts) == 3);
+    KALDI_ASSERT(computer.NumFrameGroups() == (i >= 4 ? 2 : 1));
+    std::vector<Matrix<BaseFloat> > feats;
+    computer.ComputeFeatures(wave, frame_opts.samp_freq, &feats);
+    KALDI_ASSERT(feats.size() == 4);
+
+    Matrix<BaseFloat> ref;
+    Fbank fbank(fbank_opts);
+    fbank.Compute(wave, 1.0, &ref);
+    AssertEqual(ref, feats[0], 1.0e-03);
+    Mfcc mfcc(mfcc_opts);
+    mfcc.Compute(wave, 1.0, &ref);
+    AssertEqual(ref, feats[1], 1.0e-03);
+    Lps lps(lps_opts);
+    lps.Compute(wave, 1.0, &ref);
+    AssertEqual(ref, feats[2], 1.0e-03);
+    Phs phs(phs_opts);
+    phs.Compute(wave, 1.0, &ref);
+    AssertEqual(ref, feats[3], 1.0e-03);
+    for (int32 j = 0; j < 4; j++)
+      KALDI_ASSERT(feats[j].NumCols() == computer.Dim(j));
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestMultiFeatureComputer();
+  KALDI_LOG << "Tests succeeded.";
+}
@@ -0,0 +1,162 @@
+// feat/feature-multi.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/feature-multi.h"
+#include "feat/resample.h"
+
+namespace kaldi {
+
+// Returns true if the two sets of options give the same windowed frames.
+static bool SameFrameOptions(const FrameExtractionOptions &a,
+                             const FrameExtractionOptions &b) {
+  return a.samp_freq == b.samp_freq &&
+      a.frame_shift_ms == b.frame_shift_ms &&
+      a.frame_length_ms == b.frame_length_ms &&
+      a.dither == b.dither &&
+      a.preemph_coeff == b.preemph_coeff &&
+      a.remove_dc_offset == b.remove_dc_offset &&
+      a.window_type == b.window_type &&
+      a.round_to_power_of_two == b.round_to_power_of_two &&
+      a.blackman_coeff == b.blackman_coeff &&
+      a.snip_edges == b.snip_edges &&
+      a.allow_downsample == b.allow_downsample &&
+      a.allow_upsample == b.allow_upsample;
+}
+
+MultiFeatureComputer::FrameGroup::FrameGroup(
+    const FrameExtractionOptions &opts):
+    frame_opts(opts), window_function(opts), srfft(NULL) {
+  int32 padded_window_size = opts.PaddedWindowSize();
+  if ((padded_window_size & (padded_window_size-1)) == 0)  // Is a power of two
+    srfft = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+}
+
+MultiFeatureComputer::~MultiFeatureComputer() {
+  for (size_t i = 0; i < computers_.size(); i++)
+    delete computers_[i];
+  for (size_t i = 0; i < groups_.size(); i++)
+    delete groups_[i];
+}
+
+void MultiFeatureComputer::AddComputerInternal(ComputerItf *computer) {
+  int32 index = computers_.size();
+  computers_.push_back(computer);
+  const FrameExtractionOptions &frame_opts = computer->GetFrameOptions();
+  for (size_t g = 0; g < groups_.size(); g++) {
+    if (SameFrameOptions(groups_[g]->frame_opts, frame_opts)) {
+      groups_[g]->computers.push_back(index);
+      return;
+    }
+  }
+  groups_.push_back(new FrameGroup(frame_opts));
+  groups_.back()->computers.push_back(index);
+}
+
+void MultiFeatureComputer::ComputeFeatures(
+    const VectorBase<BaseFloat> &wave,
+    BaseFloat sample_freq,
+    std::vector<Matrix<BaseFloat> > *features) {
+  features->resize(computers_.size());
+  for (size_t g = 0; g < groups_.size(); g++) {
+    const FrameGroup &group = *(groups_[g]);
+    BaseFloat new_sample_freq = group.frame_opts.samp_freq;
+    if (sample_freq == new_sample_freq) {
+      ComputeGroup(group, wave, features);
+    } else {
+      if (new_sample_freq < sample_freq && !group.frame_opts.allow_downsample)
+        KALDI_ERR << "Waveform and config sample Frequency mismatch: "
+                  << sample_freq << " .vs " << new_sample_freq
+                  << " (use --allow-downsample=true to allow "
+                  << " downsampling the waveform).";
+      else if (new_sample_freq > sample_freq &&
+               !group.frame_opts.allow_upsample)
+        KALDI_ERR << "Waveform and config sample Frequency mismatch: "
+                  << sample_freq << " .vs " << new_sample_freq
+                  << " (use --allow-upsample=true option to allow "
+                  << " upsampling the waveform).";
+      Vector<BaseFloat> resampled_wave;
+      ResampleWaveform(sample_freq, wave, new_sample_freq, &resampled_wave);
+      ComputeGroup(group, resampled_wave, features);
+    }
+  }
+}
+
+void MultiFeatureComputer::ComputeGroup(
+    const FrameGroup &group,
+    const VectorBase<BaseFloat> &wave,
+    std::vector<Matrix<BaseFloat> > *features) {
+  const FrameExtractionOptions &frame_opts = group.frame_opts;
+  int32 num_frames = NumFrames(wave.Dim(), frame_opts),
+      num_computers = group.computers.size();
+  bool need_raw_log_energy = false, need_log_energy = false;
+  for (int32 c = 0; c < num_computers; c++) {
+    int32 i = group.computers[c];
+    if (num_frames == 0)
+      (*features)[i].Resize(0, 0);
+    else
+      (*features)[i].Resize(num_frames, computers_[i]->Dim(), kUndefined);
+    if (computers_[i]->NeedRawLogEnergy())
+      need_raw_log_energy = true;
+    else
+      need_log_energy = true;
+  }
+  if (num_frames == 0)
+    return;
+
+  // As in OfflineFeatureTpl::Compute(), frames are extracted a block at a
+  // time.
+  const int32 block_size = 64;
+  Matrix<BaseFloat> windows;
+  Vector<BaseFloat> raw_log_energies, fft_copy(frame_opts.PaddedWindowSize(),
+                                               kUndefined);
+  for (int32 begin = 0; begin < num_frames; begin += block_size) {
+    int32 size = std::min(block_size, num_frames - begin);
+    ExtractWindows(0, wave, begin, size, frame_opts, group.window_function,
+                   &windows, (need_raw_log_energy ? &raw_log_energies : NULL));
+    for (int32 r = 0; r < size; r++) {
+      SubVector<BaseFloat> frame(windows, r);
+      // The energy after the window function, as used by computers with
+      // raw-energy=false.
+      BaseFloat log_energy = 0.0;
+      if (need_log_energy)
+        log_energy = Log(std::max<BaseFloat>(VecVec(frame, frame),
+                                             std::numeric_limits<float>::min()));
+      if (group.srfft != NULL)  // Compute FFT using split-radix algorithm.
+        group.srfft->Compute(frame.Data(), true);
+      else  // An alternative algorithm that works for non-powers-of-two.
+        RealFft(&frame, true);
+
+      for (int32 c = 0; c < num_computers; c++) {
+        int32 i = group.computers[c];
+        ComputerItf *computer = computers_[i];
+        BaseFloat this_log_energy = (computer->NeedRawLogEnergy() ?
+                                     raw_log_energies(r) : log_energy);
+        SubVector<BaseFloat> feature((*features)[i], begin + r);
+        // ComputeFromFft() uses the FFT as a workspace, so all but the last
+        // computer get a copy.
+        if (c + 1 < num_computers) {
+          fft_copy.CopyFromVec(frame);
+          computer->ComputeFromFft(this_log_energy, &fft_copy, &feature);
+        } else {
+          computer->ComputeFromFft(this_log_energy, &frame, &feature);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,150 @@
+// feat/feature-multi.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_FEATURE_MULTI_H_
+#define KALDI_FEAT_FEATURE_MULTI_H_
+
+#include <vector>
+
+#include "feat/feature-window.h"
+#include "feat/feature-fbank.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-lps.h"
+#include "feat/feature-phs.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+
+/**
+   MultiFeatureComputer computes several types of features from the same
+   waveform in one pass.  Feature types whose frame-extraction options are
+   identical share the framing, windowing and FFT of each frame; each then
+   does only the part of its computation that follows the FFT (see
+   FbankComputer::ComputeFromFft()).  Since the framing is shared, so is the
+   dithering noise.  The output is the same as computing each feature type
+   with OfflineFeatureTpl, apart from the dither.
+
+   The computer classes must provide ComputeFromFft(); currently these are
+   FbankComputer, MfccComputer, LpsComputer, PhsComputer and LpsPhsComputer.
+   Typical usage:
+   \code
+     MultiFeatureComputer computer;
+     computer.AddComputer<FbankComputer>(fbank_opts);  // output 0
+     computer.AddComputer<LpsComputer>(lps_opts);  // output 1
+     std::vector<Matrix<BaseFloat> > feats;
+     computer.ComputeFeatures(wave, samp_freq, &feats);
+   \endcode
+*/
+class MultiFeatureComputer {
+ public:
+  MultiFeatureComputer() { }
+
+  /// Adds a feature type and returns its index, which is its position in
+  /// the output of ComputeFeatures().
+  template<class C>
+  int32 AddComputer(const typename C::Options &opts) {
+    AddComputerInternal(new ComputerImpl<C>(opts));
+    return computers_.size() - 1;
+  }
+
+  int32 NumComputers() const { return computers_.size(); }
+
+  /// The feature dimension of computer i.
+  int32 Dim(int32 i) const { return computers_[i]->Dim(); }
+
+  /// The number of different framings, i.e. the number of times each frame
+  /// of the waveform is extracted and transformed.
+  int32 NumFrameGroups() const { return groups_.size(); }
+
+  /// Computes the features of all feature types; (*features)[i] is the
+  /// output of computer i.  The waveform is resampled if 'sample_freq'
+  /// differs from the sampling frequency in the options, subject to
+  /// allow-downsample and allow-upsample, as in OfflineFeatureTpl.
+  void ComputeFeatures(const VectorBase<BaseFloat> &wave,
+                       BaseFloat sample_freq,
+                       std::vector<Matrix<BaseFloat> > *features);
+
+  ~MultiFeatureComputer();
+
+ private:
+  // Interface to the computer classes, so we can store them in one vector.
+  class ComputerItf {
+   public:
+    virtual const FrameExtractionOptions &GetFrameOptions() const = 0;
+    virtual int32 Dim() const = 0;
+    virtual bool NeedRawLogEnergy() const = 0;
+    virtual void ComputeFromFft(BaseFloat signal_log_energy,
+                                VectorBase<BaseFloat> *fft,
+                                VectorBase<BaseFloat> *feature) = 0;
+    virtual ~ComputerItf() { }
+  };
+
+  template<class C>
+  class ComputerImpl: public ComputerItf {
+   public:
+    explicit ComputerImpl(const typename C::Options &opts):
+        computer_(opts),
+        need_raw_log_energy_(computer_.NeedRawLogEnergy()) { }
+    virtual const FrameExtractionOptions &GetFrameOptions() const {
+      return computer_.GetFrameOptions();
+    }
+    virtual int32 Dim() const { return computer_.Dim(); }
+    virtual bool NeedRawLogEnergy() const { return need_raw_log_energy_; }
+    virtual void ComputeFromFft(BaseFloat signal_log_energy,
+                                VectorBase<BaseFloat> *fft,
+                                VectorBase<BaseFloat> *feature) {
+      computer_.ComputeFromFft(signal_log_energy, 1.0, fft, feature);
+    }
+   private:
+    C computer_;
+    bool need_raw_log_energy_;
+  };
+
+  // The feature types that share the same frame-extraction options.
+  struct FrameGroup {
+    FrameExtractionOptions frame_opts;
+    FeatureWindowFunction window_function;
+    SplitRadixRealFft<BaseFloat> *srfft;  // NULL if not a power of two.
+    std::vector<int32> computers;  // indexes into computers_.
+    explicit FrameGroup(const FrameExtractionOptions &opts);
+    ~FrameGroup() { delete srfft; }
+  };
+
+  // Adds 'computer' to computers_ and to the appropriate frame group.
+  void AddComputerInternal(ComputerItf *computer);
+
+  // Computes the features for the computers in 'group', writing them to the
+  // corresponding elements of 'features'.  The waveform must already be at
+  // the right sampling frequency.
+  void ComputeGroup(const FrameGroup &group,
+                    const VectorBase<BaseFloat> &wave,
+                    std::vector<Matrix<BaseFloat> > *features);
+
+  std::vector<ComputerItf*> computers_;
+  std::vector<FrameGroup*> groups_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MultiFeatureComputer);
+};
+
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+
+#endif  // KALDI_FEAT_FEATURE_MULTI_H_
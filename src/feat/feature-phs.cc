@@ -62,10 +62,19 @@ void PhsComputer::Compute(BaseFloat signal_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void PhsComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                 BaseFloat vtln_warp,
+                                 VectorBase<BaseFloat> *fft,
+                                 VectorBase<BaseFloat> *feature) {
+  KALDI_ASSERT(fft->Dim() == opts_.frame_opts.PaddedWindowSize() &&
+               feature->Dim() == this->Dim());
+
   // Convert the FFT into a power spectrum.
-  ComputePhaseSpectrum(signal_frame);
-  SubVector<BaseFloat> phase_spectrum(*signal_frame,
-                                      0, signal_frame->Dim() / 2 + 1);
+  ComputePhaseSpectrum(fft);
+  SubVector<BaseFloat> phase_spectrum(*fft, 0, fft->Dim() / 2 + 1);
 
   feature->CopyFromVec(phase_spectrum);
 /*
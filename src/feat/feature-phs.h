@@ -91,6 +91,14 @@ class PhsComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+
+  /// Does the part of Compute() that follows the FFT, as for
+  /// FbankComputer::ComputeFromFft(); 'signal_log_energy' is ignored.
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *fft,
+                      VectorBase<BaseFloat> *feature);
+
   ~PhsComputer();
 
  private:
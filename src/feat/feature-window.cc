@@ -159,16 +159,16 @@ void ProcessWindow(const FrameExtractionOptions &opts,
 // ExtractWindow extracts a windowed frame of waveform with a power-of-two,
 // padded size.  It does mean subtraction, pre-emphasis and dithering as
 // requested.
-void ExtractWindow(int64 sample_offset,
-                   const VectorBase<BaseFloat> &wave,
-                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
-                   const FrameExtractionOptions &opts,
-                   const FeatureWindowFunction &window_function,
-                   Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window) {
+// Copies the (unprocessed) samples of frame f of the waveform to 'frame',
+// which must have dimension opts.WindowSize(), dealing with edge effects by
+// reflection.
+static void CopyFrameSamples(int64 sample_offset,
+                             const VectorBase<BaseFloat> &wave,
+                             int32 f,
+                             const FrameExtractionOptions &opts,
+                             VectorBase<BaseFloat> *frame) {
   KALDI_ASSERT(sample_offset >= 0 && wave.Dim() != 0);
-  int32 frame_length = opts.WindowSize(),
-      frame_length_padded = opts.PaddedWindowSize();
+  int32 frame_length = opts.WindowSize();
   int64 num_samples = sample_offset + wave.Dim(),
       start_sample = FirstSampleOfFrame(f, opts),
       end_sample = start_sample + frame_length;
@@ -180,17 +180,13 @@ void ExtractWindow(int64 sample_offset,
     KALDI_ASSERT(sample_offset == 0 || start_sample >= sample_offset);
   }
 
-  if (window->Dim() != frame_length_padded)
-    window->Resize(frame_length_padded, kUndefined);
-
   // wave_start and wave_end are start and end indexes into 'wave', for the
   // piece of wave that we're trying to extract.
   int32 wave_start = int32(start_sample - sample_offset),
       wave_end = wave_start + frame_length;
   if (wave_start >= 0 && wave_end <= wave.Dim()) {
     // the normal case-- no edge effects to consider.
-    window->Range(0, frame_length).CopyFromVec(
-        wave.Range(wave_start, frame_length));
+    frame->CopyFromVec(wave.Range(wave_start, frame_length));
   } else {
     // Deal with any end effects by reflection, if needed.  This code will only
     // be reached for about two frames per utterance, so we don't concern
@@ -207,16 +203,82 @@ void ExtractWindow(int64 sample_offset,
         if (s_in_wave < 0) s_in_wave = - s_in_wave - 1;
         else s_in_wave = 2 * wave_dim - 1 - s_in_wave;
       }
-      (*window)(s) = wave(s_in_wave);
+      (*frame)(s) = wave(s_in_wave);
     }
   }
+}
 
-  if (frame_length_padded > frame_length)
-    window->Range(frame_length, frame_length_padded - frame_length).SetZero();
+
+void ExtractWindow(int64 sample_offset,
+                   const VectorBase<BaseFloat> &wave,
+                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   Vector<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window) {
+  int32 frame_length = opts.WindowSize(),
+      frame_length_padded = opts.PaddedWindowSize();
+
+  if (window->Dim() != frame_length_padded)
+    window->Resize(frame_length_padded, kUndefined);
 
   SubVector<BaseFloat> frame(*window, 0, frame_length);
+  CopyFrameSamples(sample_offset, wave, f, opts, &frame);
+
+  if (frame_length_padded > frame_length)
+    window->Range(frame_length, frame_length_padded - frame_length).SetZero();
 
   ProcessWindow(opts, window_function, &frame, log_energy_pre_window);
 }
 
+
+void ExtractWindows(int64 sample_offset,
+                    const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    int32 num_frames,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    Matrix<BaseFloat> *windows,
+                    Vector<BaseFloat> *log_energy_pre_window) {
+  KALDI_ASSERT(num_frames > 0);
+  int32 frame_length = opts.WindowSize(),
+      frame_length_padded = opts.PaddedWindowSize();
+  if (windows->NumRows() != num_frames ||
+      windows->NumCols() != frame_length_padded)
+    windows->Resize(num_frames, frame_length_padded, kUndefined);
+  if (frame_length_padded > frame_length)
+    windows->ColRange(frame_length,
+                      frame_length_padded - frame_length).SetZero();
+  SubMatrix<BaseFloat> frames(*windows, 0, num_frames, 0, frame_length);
+
+  for (int32 f = 0; f < num_frames; f++) {
+    SubVector<BaseFloat> frame(frames, f);
+    CopyFrameSamples(sample_offset, wave, first_frame + f, opts, &frame);
+    if (opts.dither != 0.0)
+      Dither(&frame, opts.dither);
+  }
+
+  if (opts.remove_dc_offset) {
+    Vector<BaseFloat> frame_sums(num_frames);
+    frame_sums.AddColSumMat(1.0, frames, 0.0);
+    frames.AddVecToCols(-1.0 / frame_length, frame_sums);
+  }
+
+  if (log_energy_pre_window != NULL) {
+    log_energy_pre_window->Resize(num_frames, kUndefined);
+    log_energy_pre_window->AddDiagMat2(1.0, frames, kNoTrans, 0.0);
+    log_energy_pre_window->ApplyFloor(std::numeric_limits<float>::epsilon());
+    log_energy_pre_window->ApplyLog();
+  }
+
+  if (opts.preemph_coeff != 0.0) {
+    for (int32 f = 0; f < num_frames; f++) {
+      SubVector<BaseFloat> frame(frames, f);
+      Preemphasize(&frame, opts.preemph_coeff);
+    }
+  }
+
+  frames.MulColsVec(window_function.window);
+}
+
 }  // namespace kaldi
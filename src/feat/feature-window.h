@@ -216,6 +216,38 @@ void ExtractWindow(int64 sample_offset,
                    BaseFloat *log_energy_pre_window = NULL);
 
 
+/*
+  ExtractWindows() is a batched version of ExtractWindow(): it extracts the
+  windowed frames first_frame through first_frame + num_frames - 1 into the
+  rows of a matrix.  DC removal, the energy computation and windowing are done
+  on the whole block as matrix operations; dithering and pre-emphasis are done
+  row by row.  The output is the same as that of ExtractWindow(), up to
+  roundoff.  Blocks of a few tens of frames are best: the block then stays in
+  cache, and callers can reuse 'windows' from block to block.
+
+  @param [in] sample_offset, wave, opts, window_function  As for
+                   ExtractWindow().
+  @param [in] first_frame  The index of the first frame to extract.
+  @param [in] num_frames  The number of frames to extract; must be > 0, and
+                   first_frame + num_frames must not exceed
+                   NumFrames(sample_offset + wave.Dim(), opts, true).
+  @param [out] windows  Resized to num_frames by opts.PaddedWindowSize() if
+                   it does not already have that size; row i is the output
+                   of ExtractWindow() for frame first_frame + i.
+  @param [out] log_energy_pre_window  If non-NULL, resized to num_frames
+                   and set to the per-frame log-energies as in
+                   ExtractWindow().
+*/
+void ExtractWindows(int64 sample_offset,
+                    const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    int32 num_frames,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    Matrix<BaseFloat> *windows,
+                    Vector<BaseFloat> *log_energy_pre_window = NULL);
+
+
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
 
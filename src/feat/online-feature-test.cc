@@ -244,6 +244,53 @@ void TestOnlinePlp() {
   }
 }
 
+void TestOnlineLpsPhs() {
+  std::ifstream is("../feat/test_data/test.wav", std::ios_base::binary);
+  WaveData wave;
+  wave.Read(is);
+  KALDI_ASSERT(wave.Data().NumRows() == 1);
+  SubVector<BaseFloat> waveform(wave.Data(), 0);
+
+  LpsOptions op;
+  op.frame_opts.dither = 0.0;
+  op.frame_opts.samp_freq = wave.SampFreq();
+  if (RandInt(0, 1) == 0)
+    op.frame_opts.snip_edges = false;
+  PhsOptions phs_op;
+  phs_op.frame_opts = op.frame_opts;
+
+  // compute the log-power spectrum and phase offline, separately.
+  Lps lps(op);
+  Phs phs(phs_op);
+  Matrix<BaseFloat> lps_feats, phs_feats;
+  lps.Compute(waveform, 1.0, &lps_feats);
+  phs.Compute(waveform, 1.0, &phs_feats);
+
+  OnlineLpsPhs online_lps_phs(op);
+  int32 num_piece = RandInt(3, 9);
+  std::vector<int32> piece_length(num_piece, 0);
+  bool ret = RandomSplit(waveform.Dim(), &piece_length, num_piece);
+  KALDI_ASSERT(ret);
+  int32 offset_start = 0;
+  for (int32 i = 0; i < num_piece; i++) {
+    Vector<BaseFloat> wave_piece(
+      waveform.Range(offset_start, piece_length[i]));
+    online_lps_phs.AcceptWaveform(wave.SampFreq(), wave_piece);
+    offset_start += piece_length[i];
+  }
+  online_lps_phs.InputFinished();
+
+  int32 dim = lps_feats.NumCols();
+  KALDI_ASSERT(online_lps_phs.Dim() == 2 * dim);
+  OnlineColumnRangeFeature online_lps(&online_lps_phs, 0, dim),
+      online_phs(&online_lps_phs, dim, dim);
+  Matrix<BaseFloat> online_lps_feats, online_phs_feats;
+  GetOutput(&online_lps, &online_lps_feats);
+  GetOutput(&online_phs, &online_phs_feats);
+  AssertEqual(lps_feats, online_lps_feats);
+  AssertEqual(phs_feats, online_phs_feats);
+}
+
 void TestOnlineTransform() {
   std::ifstream is("../feat/test_data/test.wav", std::ios_base::binary);
   WaveData wave;
@@ -287,6 +334,108 @@ void TestOnlineTransform() {
   AssertEqual(trans_feats, output_feats);
 }
 
+// Compares OnlineCmvnContextFeature with the chain of OnlineCmvn,
+// OnlineSpliceFrames or OnlineDeltaFeature, and OnlineTransform.
+void TestOnlineCmvnContextFeature() {
+  int32 dim = 2 + rand() % 5;  // dimension of features.
+  int32 num_frames = 100 + rand() % 300;
+  Matrix<BaseFloat> input_feats(num_frames, dim);
+  input_feats.SetRandn();
+  input_feats.Add(1.0);
+
+  OnlineCmvnOptions cmvn_opts;
+  cmvn_opts.cmn_window = 10 + rand() % 150;
+  cmvn_opts.speaker_frames = rand() % (cmvn_opts.cmn_window + 1);
+  cmvn_opts.global_frames = rand() % (cmvn_opts.speaker_frames + 1);
+  cmvn_opts.normalize_variance = (rand() % 2 == 0);
+  if (rand() % 2 == 0)
+    cmvn_opts.skip_dims = "1";
+  Matrix<BaseFloat> global_feats(50, dim);
+  global_feats.SetRandn();
+  Matrix<double> global_stats(2, dim + 1);
+  for (int32 t = 0; t < global_feats.NumRows(); t++) {
+    Vector<double> feat(global_feats.Row(t));
+    global_stats.Row(0).Range(0, dim).AddVec(1.0, feat);
+    global_stats.Row(1).Range(0, dim).AddVec2(1.0, feat);
+    global_stats(0, dim) += 1.0;
+  }
+  OnlineCmvnState cmvn_state(global_stats);
+  if (rand() % 2 == 0) {
+    cmvn_state.speaker_cmvn_stats = global_stats;
+    cmvn_state.speaker_cmvn_stats.Scale(0.5);
+  }
+
+  OnlineSpliceOptions splice_opts;
+  splice_opts.left_context = rand() % 5;
+  splice_opts.right_context = rand() % 5;
+  DeltaFeaturesOptions delta_opts;
+  delta_opts.order = rand() % 3;
+  delta_opts.window = 1 + rand() % 3;
+  int32 context_type = rand() % 3;  // 0 = none, 1 = splice, 2 = deltas.
+
+  OnlineMatrixFeature matrix_feats1(input_feats), matrix_feats2(input_feats);
+  OnlineCmvn cmvn(cmvn_opts, cmvn_state, &matrix_feats1);
+  OnlineFeatureInterface *context = &cmvn;
+  if (context_type == 1)
+    context = new OnlineSpliceFrames(splice_opts, &cmvn);
+  else if (context_type == 2)
+    context = new OnlineDeltaFeature(delta_opts, &cmvn);
+  Matrix<BaseFloat> transform;
+  OnlineFeatureInterface *chain = context;
+  if (rand() % 3 != 0) {
+    transform.Resize(1 + rand() % 10, context->Dim() + rand() % 2);
+    transform.SetRandn();
+    chain = new OnlineTransform(transform, context);
+  }
+  OnlineCmvnContextFeature fused(cmvn_opts, cmvn_state,
+                                 (context_type == 1 ? &splice_opts : NULL),
+                                 (context_type == 2 ? &delta_opts : NULL),
+                                 &transform, &matrix_feats2);
+  KALDI_ASSERT(fused.Dim() == chain->Dim() &&
+               fused.NumFramesReady() == chain->NumFramesReady());
+
+  for (int32 pass = 0; pass < 2; pass++) {
+    Matrix<BaseFloat> output_feats1;
+    GetOutput(chain, &output_feats1);
+    // Get the frames in chunks of random size, as a decoder would, sometimes
+    // going back.
+    Matrix<BaseFloat> output_feats2(num_frames, fused.Dim());
+    for (int32 t = 0; t < num_frames; ) {
+      if (rand() % 5 == 0)
+        t = std::max(0, t - rand() % 200);
+      int32 n = std::min(num_frames - t, 1 + rand() % 100);
+      std::vector<int32> frames(n);
+      for (int32 i = 0; i < n; i++)
+        frames[i] = t + i;
+      SubMatrix<BaseFloat> chunk(output_feats2, t, n, 0, fused.Dim());
+      fused.GetFrames(frames, &chunk);
+      t += n;
+    }
+    KALDI_ASSERT(output_feats1.ApproxEqual(output_feats2, 1.0e-04));
+    for (int32 i = 0; i < 10; i++) {
+      int32 t = rand() % num_frames;
+      Vector<BaseFloat> feat(fused.Dim());
+      fused.GetFrame(t, &feat);
+      KALDI_ASSERT(feat.ApproxEqual(output_feats1.Row(t), 1.0e-04));
+    }
+    // On the second pass, the CMVN is frozen.
+    int32 freeze_frame = rand() % num_frames;
+    cmvn.Freeze(freeze_frame);
+    fused.Freeze(freeze_frame);
+  }
+  OnlineCmvnState state1, state2;
+  cmvn.GetState(num_frames - 1, &state1);
+  fused.GetState(num_frames - 1, &state2);
+  KALDI_ASSERT(state1.speaker_cmvn_stats.ApproxEqual(
+      state2.speaker_cmvn_stats) &&
+               state1.frozen_state.ApproxEqual(state2.frozen_state));
+
+  if (chain != context)
+    delete chain;
+  if (context != &cmvn)
+    delete context;
+}
+
 void TestOnlineAppendFeature() {
   std::ifstream is("../feat/test_data/test.wav", std::ios_base::binary);
   WaveData wave;
@@ -424,7 +573,9 @@ int main() {
     TestOnlineSpliceFrames();
     TestOnlineMfcc();
     TestOnlinePlp();
+    TestOnlineLpsPhs();
     TestOnlineTransform();
+    TestOnlineCmvnContextFeature();
     TestOnlineAppendFeature();
     TestRecyclingVector();
   }
@@ -86,7 +86,7 @@ void OnlineGenericBaseFeature<C>::MaybeCreateResampler(
               !computer_.GetFrameOptions().allow_downsample) ||
              ((sampling_rate > expected_sampling_rate) &&
               !computer_.GetFrameOptions().allow_upsample)) {
-    resampler_.reset(new LinearResample(
+    resampler_.reset(new PolyphaseResample(
         sampling_rate, expected_sampling_rate,
         std::min(sampling_rate / 2, expected_sampling_rate / 2), 6));
   } else if (sampling_rate != expected_sampling_rate) {
@@ -195,6 +195,10 @@ void OnlineGenericBaseFeature<C>::ComputeFeatures() {
 template class OnlineGenericBaseFeature<MfccComputer>;
 template class OnlineGenericBaseFeature<PlpComputer>;
 template class OnlineGenericBaseFeature<FbankComputer>;
+template class OnlineGenericBaseFeature<LpsComputer>;
+template class OnlineGenericBaseFeature<PhsComputer>;
+template class OnlineGenericBaseFeature<LpsPhsComputer>;
+template class OnlineGenericBaseFeature<FrameFftComputer>;
 
 OnlineCmvnState::OnlineCmvnState(const OnlineCmvnState &other):
     speaker_cmvn_stats(other.speaker_cmvn_stats),
@@ -589,6 +593,316 @@ OnlineDeltaFeature::OnlineDeltaFeature(const DeltaFeaturesOptions &opts,
                                        OnlineFeatureInterface *src):
     src_(src), opts_(opts), delta_features_(opts) { }
 
+const int32 OnlineCmvnContextFeature::kBlockSize;
+
+OnlineCmvnContextFeature::OnlineCmvnContextFeature(
+    const OnlineCmvnOptions &cmvn_opts,
+    const OnlineCmvnState &cmvn_state,
+    const OnlineSpliceOptions *splice_opts,
+    const DeltaFeaturesOptions *delta_opts,
+    const MatrixBase<BaseFloat> *transform,
+    OnlineFeatureInterface *src):
+    opts_(cmvn_opts), src_dim_(src->Dim()), left_context_(0),
+    right_context_(0), splice_(false),
+    delta_features_(delta_opts != NULL ? *delta_opts : DeltaFeaturesOptions()),
+    first_normalized_(0), num_normalized_(0), src_(src) {
+  KALDI_ASSERT(splice_opts == NULL || delta_opts == NULL);
+  KALDI_ASSERT(opts_.cmn_window > 0 &&
+               (opts_.normalize_mean || !opts_.normalize_variance));
+  if (!SplitStringToIntegers(opts_.skip_dims, ":", false, &skip_dims_))
+    KALDI_ERR << "Bad --skip-dims option (should be colon-separated list of "
+              <<  "integers)";
+  context_dim_ = src_dim_;
+  if (splice_opts != NULL) {
+    KALDI_ASSERT(splice_opts->left_context >= 0 &&
+                 splice_opts->right_context >= 0);
+    splice_ = true;
+    left_context_ = splice_opts->left_context;
+    right_context_ = splice_opts->right_context;
+    context_dim_ = src_dim_ * (1 + left_context_ + right_context_);
+  } else if (delta_opts != NULL) {
+    left_context_ = right_context_ = delta_opts->order * delta_opts->window;
+    context_dim_ = src_dim_ * (1 + delta_opts->order);
+  }
+  if (transform != NULL && transform->NumRows() != 0) {
+    if (transform->NumCols() == context_dim_) {  // Linear transform
+      linear_term_ = *transform;
+      offset_.Resize(transform->NumRows());
+    } else if (transform->NumCols() == context_dim_ + 1) {  // Affine transform
+      linear_term_ = transform->Range(0, transform->NumRows(), 0, context_dim_);
+      offset_.Resize(transform->NumRows());
+      offset_.CopyColFromMat(*transform, context_dim_);
+    } else {
+      KALDI_ERR << "Dimension mismatch: features have dimension "
+                << context_dim_ << " and transform #cols is "
+                << transform->NumCols();
+    }
+    context_feats_.Resize(kBlockSize, context_dim_);
+  }
+  SetState(cmvn_state);
+
+  raw_.Resize(opts_.cmn_window + kBlockSize, src_dim_);
+  window_stats_.Resize(2, src_dim_ + 1);
+  capacity_ = kBlockSize + left_context_ + right_context_;
+  normalized_.Resize(2 * capacity_ * src_dim_);
+  stats_.Resize(2, src_dim_ + 1);
+  feat_dbl_.Resize(src_dim_);
+  cmvn_offset_.Resize(src_dim_);
+  cmvn_scale_.Resize(src_dim_);
+}
+
+int32 OnlineCmvnContextFeature::Dim() const {
+  return linear_term_.NumRows() != 0 ? linear_term_.NumRows() : context_dim_;
+}
+
+int32 OnlineCmvnContextFeature::NumFramesReady() const {
+  int32 num_frames = src_->NumFramesReady();
+  if (num_frames > 0 && src_->IsLastFrame(num_frames - 1))
+    return num_frames;
+  else
+    return std::max<int32>(0, num_frames - right_context_);
+}
+
+void OnlineCmvnContextFeature::GetFrame(int32 frame,
+                                        VectorBase<BaseFloat> *feat) {
+  KALDI_ASSERT(feat->Dim() == Dim());
+  SubMatrix<BaseFloat> feat_mat(feat->Data(), 1, feat->Dim(), feat->Dim());
+  ComputeBlock(frame, 1, &feat_mat);
+}
+
+void OnlineCmvnContextFeature::GetFrames(const std::vector<int32> &frames,
+                                         MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  int32 num_frames = frames.size();
+  for (int32 i = 0; i < num_frames; ) {
+    // Find the run of consecutive frames starting at position i.
+    int32 n = 1;
+    while (i + n < num_frames && n < kBlockSize &&
+           frames[i + n] == frames[i] + n)
+      n++;
+    SubMatrix<BaseFloat> block(*feats, i, n, 0, feats->NumCols());
+    ComputeBlock(frames[i], n, &block);
+    i += n;
+  }
+}
+
+void OnlineCmvnContextFeature::ComputeBlock(int32 first_frame,
+                                            int32 num_frames,
+                                            MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(first_frame >= 0 && num_frames <= kBlockSize &&
+               first_frame + num_frames <= NumFramesReady());
+  int32 num_frames_ready = src_->NumFramesReady();
+  EnsureNormalized(std::max<int32>(0, first_frame - left_context_),
+                   std::min<int32>(num_frames_ready,
+                                   first_frame + num_frames + right_context_));
+  if (linear_term_.NumRows() == 0) {
+    for (int32 i = 0; i < num_frames; i++) {
+      SubVector<BaseFloat> feat(*feats, i);
+      ComputeContextFrame(first_frame + i, num_frames_ready, &feat);
+    }
+  } else {
+    SubMatrix<BaseFloat> context_feats(context_feats_, 0, num_frames,
+                                       0, context_dim_);
+    for (int32 i = 0; i < num_frames; i++) {
+      SubVector<BaseFloat> context_feat(context_feats, i);
+      ComputeContextFrame(first_frame + i, num_frames_ready, &context_feat);
+    }
+    feats->CopyRowsFromVec(offset_);
+    feats->AddMatMat(1.0, context_feats, kNoTrans, linear_term_, kTrans, 1.0);
+  }
+}
+
+void OnlineCmvnContextFeature::ComputeContextFrame(
+    int32 frame, int32 num_frames_ready, VectorBase<BaseFloat> *feat) {
+  if (left_context_ == 0 && right_context_ == 0) {
+    feat->CopyFromVec(NormalizedFrame(frame));
+  } else if (splice_) {
+    int32 first = frame - left_context_;
+    if (first >= 0 && frame + right_context_ < num_frames_ready) {
+      // All the context is inside the utterance, so the spliced features are
+      // consecutive in normalized_.
+      feat->CopyFromVec(SubVector<BaseFloat>(
+          normalized_, (first % capacity_) * src_dim_, context_dim_));
+    } else {
+      for (int32 t = first; t <= frame + right_context_; t++) {
+        int32 t_limited = std::min(std::max(t, 0), num_frames_ready - 1);
+        SubVector<BaseFloat> part(*feat, (t - first) * src_dim_, src_dim_);
+        part.CopyFromVec(NormalizedFrame(t_limited));
+      }
+    }
+  } else {
+    int32 begin = std::max<int32>(0, frame - left_context_),
+        end = std::min<int32>(num_frames_ready, frame + right_context_ + 1);
+    delta_features_.Process(NormalizedFrames(begin, end - begin),
+                            frame - begin, feat);
+  }
+}
+
+void OnlineCmvnContextFeature::EnsureNormalized(int32 begin, int32 end) {
+  KALDI_ASSERT(begin < end && end - begin <= capacity_);
+  if (begin < first_normalized_ ||
+      begin < std::max(num_normalized_, end) - capacity_)
+    ResetTo(begin);
+  int32 dim = src_dim_, raw_rows = raw_.NumRows();
+  while (num_normalized_ < end) {
+    int32 block_begin = num_normalized_,
+        block_end = std::min<int32>(end, block_begin + kBlockSize);
+    ReadRawFrames(block_begin, block_end);
+    for (int32 t = block_begin; t < block_end; t++) {
+      SubVector<BaseFloat> raw_feat(raw_, t % raw_rows);
+      feat_dbl_.CopyFromVec(raw_feat);
+      window_stats_.Row(0).Range(0, dim).AddVec(1.0, feat_dbl_);
+      if (opts_.normalize_variance)
+        window_stats_.Row(1).Range(0, dim).AddVec2(1.0, feat_dbl_);
+      window_stats_(0, dim) += 1.0;
+      // Subtract the frame that is leaving the window.
+      int32 prev_frame = t - opts_.cmn_window;
+      if (prev_frame >= 0) {
+        feat_dbl_.CopyFromVec(raw_.Row(prev_frame % raw_rows));
+        window_stats_.Row(0).Range(0, dim).AddVec(-1.0, feat_dbl_);
+        if (opts_.normalize_variance)
+          window_stats_.Row(1).Range(0, dim).AddVec2(-1.0, feat_dbl_);
+        window_stats_(0, dim) -= 1.0;
+      }
+      if (frozen_state_.NumRows() != 0) {
+        stats_.CopyFromMat(frozen_state_);
+      } else {
+        stats_.CopyFromMat(window_stats_);
+        OnlineCmvn::SmoothOnlineCmvnStats(orig_state_.speaker_cmvn_stats,
+                                          orig_state_.global_cmvn_stats,
+                                          opts_, &stats_);
+      }
+      SubVector<BaseFloat> feat(NormalizedFrame(t));
+      feat.CopyFromVec(raw_feat);
+      ApplyCmvnToFrame(&stats_, &feat);
+      // and the mirror copy.
+      SubVector<BaseFloat>(normalized_,
+                           (t % capacity_ + capacity_) * dim,
+                           dim).CopyFromVec(feat);
+    }
+    num_normalized_ = block_end;
+  }
+}
+
+void OnlineCmvnContextFeature::ResetTo(int32 frame) {
+  first_normalized_ = num_normalized_ = frame;
+  int32 dim = src_dim_, begin = std::max<int32>(0, frame - opts_.cmn_window);
+  ReadRawFrames(begin, frame);
+  window_stats_.SetZero();
+  for (int32 t = begin; t < frame; t++) {
+    feat_dbl_.CopyFromVec(raw_.Row(t % raw_.NumRows()));
+    window_stats_.Row(0).Range(0, dim).AddVec(1.0, feat_dbl_);
+    if (opts_.normalize_variance)
+      window_stats_.Row(1).Range(0, dim).AddVec2(1.0, feat_dbl_);
+    window_stats_(0, dim) += 1.0;
+  }
+}
+
+void OnlineCmvnContextFeature::ReadRawFrames(int32 begin, int32 end) {
+  int32 raw_rows = raw_.NumRows();
+  KALDI_ASSERT(end - begin <= raw_rows);
+  while (begin < end) {
+    // Read as many frames as fit before the end of raw_.
+    int32 row = begin % raw_rows,
+        num_frames = std::min(end - begin, raw_rows - row);
+    frame_indexes_.resize(num_frames);
+    for (int32 i = 0; i < num_frames; i++)
+      frame_indexes_[i] = begin + i;
+    SubMatrix<BaseFloat> dest(raw_, row, num_frames, 0, src_dim_);
+    src_->GetFrames(frame_indexes_, &dest);
+    begin += num_frames;
+  }
+}
+
+void OnlineCmvnContextFeature::ApplyCmvnToFrame(MatrixBase<double> *stats,
+                                                VectorBase<BaseFloat> *feat) {
+  if (!skip_dims_.empty())
+    FakeStatsForSomeDims(skip_dims_, stats);
+  if (!opts_.normalize_mean)
+    return;
+  int32 dim = src_dim_;
+  double count = (*stats)(0, dim);
+  if (count < 1.0)
+    KALDI_ERR << "Insufficient stats for cepstral mean and variance "
+              << "normalization: count = " << count;
+  if (!opts_.normalize_variance) {
+    cmvn_offset_.SetZero();
+    cmvn_offset_.AddVec(-1.0 / count, SubVector<double>(stats->RowData(0),
+                                                        dim));
+    feat->AddVec(1.0, cmvn_offset_);
+    return;
+  }
+  // This is the same computation as in ApplyCmvn().
+  for (int32 d = 0; d < dim; d++) {
+    double mean = (*stats)(0, d) / count,
+        var = ((*stats)(1, d) / count) - mean * mean,
+        floor = 1.0e-20;
+    if (var < floor) {
+      KALDI_WARN << "Flooring cepstral variance from " << var << " to "
+                 << floor;
+      var = floor;
+    }
+    double scale = 1.0 / sqrt(var);
+    if (scale != scale || 1 / scale == 0.0)
+      KALDI_ERR << "NaN or infinity in cepstral mean/variance computation";
+    cmvn_offset_(d) = -(mean * scale);
+    cmvn_scale_(d) = scale;
+  }
+  feat->MulElements(cmvn_scale_);
+  feat->AddVec(1.0, cmvn_offset_);
+}
+
+void OnlineCmvnContextFeature::Freeze(int32 cur_frame) {
+  KALDI_ASSERT(cur_frame >= 0 && cur_frame < src_->NumFramesReady());
+  int32 dim = src_dim_;
+  // The stats for frame cur_frame are those of the cmn_window source frames
+  // up to and including it.
+  Matrix<double> stats(2, dim + 1);
+  Vector<BaseFloat> feat(dim);
+  for (int32 t = std::max<int32>(0, cur_frame - opts_.cmn_window + 1);
+       t <= cur_frame; t++) {
+    src_->GetFrame(t, &feat);
+    feat_dbl_.CopyFromVec(feat);
+    stats.Row(0).Range(0, dim).AddVec(1.0, feat_dbl_);
+    if (opts_.normalize_variance)
+      stats.Row(1).Range(0, dim).AddVec2(1.0, feat_dbl_);
+    stats(0, dim) += 1.0;
+  }
+  OnlineCmvn::SmoothOnlineCmvnStats(orig_state_.speaker_cmvn_stats,
+                                    orig_state_.global_cmvn_stats,
+                                    opts_, &stats);
+  frozen_state_ = stats;
+  // The frozen CMVN applies retroactively, so the frames normalized so far
+  // are no longer valid.
+  first_normalized_ = num_normalized_;
+}
+
+void OnlineCmvnContextFeature::GetState(int32 cur_frame,
+                                        OnlineCmvnState *state_out) {
+  *state_out = orig_state_;
+  int32 dim = src_dim_;
+  if (state_out->speaker_cmvn_stats.NumRows() == 0)
+    state_out->speaker_cmvn_stats.Resize(2, dim + 1);
+  Vector<BaseFloat> feat(dim);
+  Vector<double> feat_dbl(dim);
+  for (int32 t = 0; t <= cur_frame; t++) {
+    src_->GetFrame(t, &feat);
+    feat_dbl.CopyFromVec(feat);
+    state_out->speaker_cmvn_stats(0, dim) += 1.0;
+    state_out->speaker_cmvn_stats.Row(0).Range(0, dim).AddVec(1.0, feat_dbl);
+    state_out->speaker_cmvn_stats.Row(1).Range(0, dim).AddVec2(1.0, feat_dbl);
+  }
+  state_out->frozen_state = frozen_state_;
+}
+
+void OnlineCmvnContextFeature::SetState(const OnlineCmvnState &cmvn_state) {
+  KALDI_ASSERT(num_normalized_ == 0 &&
+               "You cannot call SetState() after processing data.");
+  orig_state_ = cmvn_state;
+  frozen_state_ = cmvn_state.frozen_state;
+}
+
 void OnlineCacheFeature::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   KALDI_ASSERT(frame >= 0);
   if (static_cast<size_t>(frame) < cache_.size() && cache_[frame] != NULL) {
@@ -664,4 +978,20 @@ void OnlineAppendFeature::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
 };
 
 
+OnlineColumnRangeFeature::OnlineColumnRangeFeature(
+    OnlineFeatureInterface *src, int32 col_offset, int32 num_cols):
+    src_(src), col_offset_(col_offset), num_cols_(num_cols),
+    temp_(src->Dim()) {
+  KALDI_ASSERT(col_offset >= 0 && num_cols > 0 &&
+               col_offset + num_cols <= src->Dim());
+}
+
+void OnlineColumnRangeFeature::GetFrame(int32 frame,
+                                        VectorBase<BaseFloat> *feat) {
+  KALDI_ASSERT(feat->Dim() == num_cols_);
+  src_->GetFrame(frame, &temp_);
+  feat->CopyFromVec(temp_.Range(col_offset_, num_cols_));
+}
+
+
 }  // namespace kaldi
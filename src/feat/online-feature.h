@@ -34,6 +34,9 @@
 #include "feat/feature-mfcc.h"
 #include "feat/feature-plp.h"
 #include "feat/feature-fbank.h"
+#include "feat/feature-lps.h"
+#include "feat/feature-phs.h"
+#include "feat/feature-framefft.h"
 #include "itf/online-feature-itf.h"
 
 namespace kaldi {
@@ -130,7 +133,7 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
 
   // resampler in cases when the input sampling frequency is not equal to
   // the expected sampling rate
-  std::unique_ptr<LinearResample> resampler_;
+  std::unique_ptr<PolyphaseResample> resampler_;
 
   FeatureWindowFunction window_function_;
 
@@ -158,6 +161,10 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
 typedef OnlineGenericBaseFeature<MfccComputer> OnlineMfcc;
 typedef OnlineGenericBaseFeature<PlpComputer> OnlinePlp;
 typedef OnlineGenericBaseFeature<FbankComputer> OnlineFbank;
+typedef OnlineGenericBaseFeature<LpsComputer> OnlineLps;
+typedef OnlineGenericBaseFeature<PhsComputer> OnlinePhs;
+typedef OnlineGenericBaseFeature<LpsPhsComputer> OnlineLpsPhs;
+typedef OnlineGenericBaseFeature<FrameFftComputer> OnlineFrameFft;
 
 
 /// This class takes a Matrix<BaseFloat> and wraps it as an
@@ -386,7 +393,6 @@ class OnlineCmvn: public OnlineFeatureInterface {
   void Freeze(int32 cur_frame);
 
   virtual ~OnlineCmvn();
- private:
 
   /// Smooth the CMVN stats "stats" (which are stored in the normal format as a
   /// 2 x (dim+1) matrix), by possibly adding some stats from "global_stats"
@@ -396,6 +402,7 @@ class OnlineCmvn: public OnlineFeatureInterface {
                                     const MatrixBase<double> &global_stats,
                                     const OnlineCmvnOptions &opts,
                                     MatrixBase<double> *stats);
+ private:
 
   /// Get the most recent cached frame of CMVN stats.  [If no frames
   /// were cached, sets up empty stats for frame zero and returns that].
@@ -559,6 +566,155 @@ class OnlineDeltaFeature: public OnlineFeatureInterface {
 };
 
 
+/**
+   This class does the same as the chain OnlineCmvn -> {OnlineSpliceFrames or
+   OnlineDeltaFeature} -> OnlineTransform (with the splicing, the deltas and
+   the transform each optional), but in a single object and more efficiently.
+   Instead of recomputing the CMVN stats from cached checkpoints and calling
+   the source once per frame per stage, it reads the source in blocks into a
+   ring buffer of the last cmn_window frames, keeps running CMVN stats as
+   frames enter and leave the window, and normalizes each frame once, into a
+   second ring buffer of normalized frames.  That buffer is "mirrored" (each
+   frame is stored twice, 'capacity' rows apart), so any run of up to
+   'capacity' consecutive frames is a contiguous matrix, and the spliced
+   features of a frame are a contiguous range of memory.  GetFrames() works
+   on blocks of consecutive frames, applying the transform with one matrix
+   multiply per block.
+
+   The output is the same as that of the chain, up to roundoff.  Access is
+   expected to be mostly sequential; asking for frames that have left the ring
+   buffer works, but is slower since the CMVN stats for that point have to be
+   recomputed.
+*/
+class OnlineCmvnContextFeature: public OnlineFeatureInterface {
+ public:
+  //
+  // First, functions that are present in the interface:
+  //
+  virtual int32 Dim() const;
+
+  virtual bool IsLastFrame(int32 frame) const {
+    return src_->IsLastFrame(frame);
+  }
+  virtual BaseFloat FrameShiftInSeconds() const {
+    return src_->FrameShiftInSeconds();
+  }
+
+  virtual int32 NumFramesReady() const;
+
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
+
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
+  //
+  // Next, functions that are not in the interface.
+  //
+
+  /// At most one of 'splice_opts' and 'delta_opts' may be non-NULL; if both
+  /// are NULL there is no splicing or deltas.  'transform', if non-NULL and
+  /// nonempty, is a linear or affine transform (as for OnlineTransform) applied
+  /// to the spliced or delta features.  The CMVN state is as for OnlineCmvn.
+  OnlineCmvnContextFeature(const OnlineCmvnOptions &cmvn_opts,
+                           const OnlineCmvnState &cmvn_state,
+                           const OnlineSpliceOptions *splice_opts,
+                           const DeltaFeaturesOptions *delta_opts,
+                           const MatrixBase<BaseFloat> *transform,
+                           OnlineFeatureInterface *src);
+
+  /// As OnlineCmvn::GetState().
+  void GetState(int32 cur_frame, OnlineCmvnState *cmvn_state);
+
+  /// As OnlineCmvn::SetState(); must be called before any data is processed.
+  void SetState(const OnlineCmvnState &cmvn_state);
+
+  /// As OnlineCmvn::Freeze(); the CMVN is frozen retroactively, so
+  /// previously normalized frames are discarded.
+  void Freeze(int32 cur_frame);
+
+ private:
+  // The maximum number of output frames computed together.
+  static const int32 kBlockSize = 64;
+
+  // Returns the normalized frames [t, t + num_frames), which must be in the
+  // ring buffer, as a matrix; num_frames <= capacity_.
+  SubMatrix<BaseFloat> NormalizedFrames(int32 t, int32 num_frames) {
+    return SubMatrix<BaseFloat>(
+        normalized_.Data() + (t % capacity_) * src_dim_, num_frames,
+        src_dim_, src_dim_);
+  }
+  SubVector<BaseFloat> NormalizedFrame(int32 t) {
+    return SubVector<BaseFloat>(normalized_, (t % capacity_) * src_dim_,
+                                src_dim_);
+  }
+
+  // Makes sure the normalized frames [begin, end) are in the ring buffer.
+  void EnsureNormalized(int32 begin, int32 end);
+
+  // Restarts the computation at frame 'frame': discards the normalized frames
+  // and recomputes the CMVN window stats from the source.
+  void ResetTo(int32 frame);
+
+  // Reads source frames [begin, end) into raw_; end - begin <= raw_.NumRows().
+  void ReadRawFrames(int32 begin, int32 end);
+
+  // Normalizes 'feat' with the CMVN stats 'stats' (modified by skip_dims_),
+  // as ApplyCmvn() would, but without allocating memory.
+  void ApplyCmvnToFrame(MatrixBase<double> *stats,
+                        VectorBase<BaseFloat> *feat);
+
+  // Computes the output for frames [first_frame, first_frame + num_frames),
+  // num_frames <= kBlockSize, into the rows of 'feats'.
+  void ComputeBlock(int32 first_frame, int32 num_frames,
+                    MatrixBase<BaseFloat> *feats);
+
+  // Computes the spliced or delta features for one frame, using the
+  // edge-of-utterance rules of OnlineSpliceFrames and OnlineDeltaFeature.
+  void ComputeContextFrame(int32 frame, int32 num_frames_ready,
+                           VectorBase<BaseFloat> *feat);
+
+  OnlineCmvnOptions opts_;
+  std::vector<int32> skip_dims_;
+  OnlineCmvnState orig_state_;
+  Matrix<double> frozen_state_;
+
+  int32 src_dim_;
+  int32 left_context_;  // Frames of left and right context needed.
+  int32 right_context_;
+  bool splice_;  // True if splicing, false if deltas (if there is context).
+  DeltaFeatures delta_features_;
+  int32 context_dim_;  // Dimension of the spliced or delta features.
+  Matrix<BaseFloat> linear_term_;  // Empty if there is no transform.
+  Vector<BaseFloat> offset_;
+
+  // Source frame t is in row t % raw_.NumRows(); there are cmn_window +
+  // kBlockSize rows, so reading a block of frames does not overwrite frames
+  // that still have to be subtracted from the window stats.
+  Matrix<BaseFloat> raw_;
+  // The raw (x, x^2, count) stats of source frames
+  // [num_normalized_ - cmn_window, num_normalized_).
+  Matrix<double> window_stats_;
+
+  int32 capacity_;  // kBlockSize + left_context_ + right_context_.
+  // Normalized frame t is in rows t % capacity_ and t % capacity_ + capacity_
+  // of this 2 * capacity_ by src_dim_ matrix, stored without padding.
+  Vector<BaseFloat> normalized_;
+  int32 first_normalized_;  // The normalized frames in the buffer are
+  int32 num_normalized_;    // [max(first_normalized_, num_normalized_ -
+                            // capacity_), num_normalized_).
+
+  // Temporary variables, put here to avoid reallocation.
+  std::vector<int32> frame_indexes_;
+  Matrix<double> stats_;
+  Vector<double> feat_dbl_;
+  Vector<BaseFloat> cmvn_offset_;
+  Vector<BaseFloat> cmvn_scale_;
+  Matrix<BaseFloat> context_feats_;  // kBlockSize by context_dim_.
+
+  OnlineFeatureInterface *src_;  // Not owned here
+};
+
+
 /// This feature type can be used to cache its input, to avoid
 /// repetition of computation in a multi-pass decoding context.
 class OnlineCacheFeature: public OnlineFeatureInterface {
@@ -626,6 +782,37 @@ class OnlineAppendFeature: public OnlineFeatureInterface {
   OnlineFeatureInterface *src2_;
 };
 
+
+/// This online-feature class outputs a contiguous range of the dimensions of
+/// its input, e.g. the log-power spectrum or the phase part of OnlineLpsPhs.
+class OnlineColumnRangeFeature: public OnlineFeatureInterface {
+ public:
+  virtual int32 Dim() const { return num_cols_; }
+
+  virtual bool IsLastFrame(int32 frame) const {
+    return src_->IsLastFrame(frame);
+  }
+  virtual BaseFloat FrameShiftInSeconds() const {
+    return src_->FrameShiftInSeconds();
+  }
+
+  virtual int32 NumFramesReady() const { return src_->NumFramesReady(); }
+
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
+
+  virtual ~OnlineColumnRangeFeature() { }
+
+  /// The output is dimensions [col_offset, col_offset + num_cols) of 'src',
+  /// which is not owned here.
+  OnlineColumnRangeFeature(OnlineFeatureInterface *src,
+                           int32 col_offset, int32 num_cols);
+ private:
+  OnlineFeatureInterface *src_;  // Not owned here
+  int32 col_offset_;
+  int32 num_cols_;
+  Vector<BaseFloat> temp_;  // Holds a whole frame of src_.
+};
+
 /// @} End of "addtogroup onlinefeat"
 }  // namespace kaldi
 
@@ -0,0 +1,131 @@
+// feat/overlap-add-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/overlap-add.h"
+
+namespace kaldi {
+
+// Analyzes 'signal' into frames using the same window as the synthesizer,
+// giving the complex spectra in 'stft' and the log-power spectra and phases
+// in 'lps' and 'phase'.  Returns the number of samples covered by the frames.
+static int32 Analyze(const OverlapAddOptions &opts,
+                     const VectorBase<BaseFloat> &signal,
+                     Matrix<BaseFloat> *stft,
+                     Matrix<BaseFloat> *lps,
+                     Matrix<BaseFloat> *phase) {
+  int32 fft_size = opts.fft_size, num_bins = fft_size / 2 + 1,
+      num_frames = (signal.Dim() - fft_size) / opts.frame_shift + 1;
+  Vector<BaseFloat> window(fft_size);
+  double a = M_2PI / (fft_size - 1);
+  for (int32 i = 0; i < fft_size; i++)
+    window(i) = (opts.window_type == "hamming" ? 0.54 - 0.46 * cos(a * i) :
+                 (opts.window_type == "hanning" ? 0.5 - 0.5 * cos(a * i) :
+                  1.0));
+  stft->Resize(num_frames, fft_size);
+  lps->Resize(num_frames, num_bins);
+  phase->Resize(num_frames, num_bins);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> frame(*stft, t);
+    frame.CopyFromVec(signal.Range(t * opts.frame_shift, fft_size));
+    frame.MulElements(window);
+    RealFft(&frame, true);
+    for (int32 k = 0; k < num_bins; k++) {
+      BaseFloat re, im;
+      if (k == 0) {
+        re = frame(0); im = 0.0;
+      } else if (k == num_bins - 1) {
+        re = frame(1); im = 0.0;
+      } else {
+        re = frame(2 * k); im = frame(2 * k + 1);
+      }
+      (*lps)(t, k) = Log(std::max<BaseFloat>(re * re + im * im, 1.0e-20));
+      (*phase)(t, k) = atan2(im, re);
+    }
+  }
+  return (num_frames - 1) * opts.frame_shift + fft_size;
+}
+
+// Checks that the signal is reconstructed exactly, whether the frames are
+// given as complex spectra or as log-power spectra and phases, and however
+// the input is split up.
+void UnitTestOverlapAddReconstruction() {
+  const char *window_types[] = { "hamming", "hanning", "rectangular" };
+  for (int32 i = 0; i < 12; i++) {
+    OverlapAddOptions opts;
+    opts.fft_size = (i % 2 == 0 ? 512 : 256);
+    opts.frame_shift = opts.fft_size / (1 << (1 + Rand() % 2));
+    opts.window_type = window_types[i % 3];
+    Vector<BaseFloat> signal(5000 + Rand() % 5000);
+    signal.SetRandn();
+    signal.Scale(1000.0);
+    Matrix<BaseFloat> stft, lps, phase;
+    int32 num_samples = Analyze(opts, signal, &stft, &lps, &phase);
+    int32 num_frames = stft.NumRows();
+    bool use_lps = (i % 4 < 2);
+
+    OverlapAddSynthesizer synth(opts);
+    Vector<BaseFloat> output(num_samples), samples;
+    int32 num_output = 0;
+    for (int32 t = 0; t < num_frames; ) {
+      int32 size = std::min(num_frames - t, 1 + Rand() % 50);
+      if (use_lps)
+        synth.AcceptLpsPhase(lps.RowRange(t, size), phase.RowRange(t, size));
+      else
+        synth.AcceptStft(stft.RowRange(t, size));
+      t += size;
+      KALDI_ASSERT(synth.NumFramesAccepted() == t);
+      // Samples become ready as soon as no later frame overlaps them.
+      KALDI_ASSERT(num_output + synth.NumSamplesReady() ==
+                   t * opts.frame_shift);
+      synth.GetSamples(&samples);
+      output.Range(num_output, samples.Dim()).CopyFromVec(samples);
+      num_output += samples.Dim();
+      KALDI_ASSERT(synth.NumSamplesOutput() == num_output);
+    }
+    synth.InputFinished();
+    synth.GetSamples(&samples);
+    output.Range(num_output, samples.Dim()).CopyFromVec(samples);
+    num_output += samples.Dim();
+    KALDI_ASSERT(num_output == num_samples && synth.NumSamplesReady() == 0);
+
+    // With a Hanning window the first and last samples are multiplied by
+    // zero, so they cannot be reconstructed.
+    int32 skip = (opts.window_type == "hanning" ? 1 : 0);
+    SubVector<BaseFloat> ref(signal, skip, num_samples - 2 * skip),
+        hyp(output, skip, num_samples - 2 * skip);
+    AssertEqual(ref, hyp, 1.0e-03);
+
+    // After Reset() we should get the same output again.
+    synth.Reset();
+    synth.AcceptStft(stft);
+    synth.InputFinished();
+    synth.GetSamples(&samples);
+    KALDI_ASSERT(samples.Dim() == num_samples);
+    SubVector<BaseFloat> hyp2(samples, skip, num_samples - 2 * skip);
+    AssertEqual(ref, hyp2, 1.0e-03);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestOverlapAddReconstruction();
+  KALDI_LOG << "Tests succeeded.";
+}
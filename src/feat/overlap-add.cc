@@ -0,0 +1,191 @@
+// feat/overlap-add.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+
+#include "feat/overlap-add.h"
+
+namespace kaldi {
+
+OverlapAddSynthesizer::OverlapAddSynthesizer(const OverlapAddOptions &opts):
+    opts_(opts), srfft_(NULL), num_frames_(0), input_finished_(false),
+    buffer_offset_(0), num_valid_(0) {
+  int32 fft_size = opts.fft_size;
+  if (fft_size < 2 || (fft_size & (fft_size - 1)) != 0)
+    KALDI_ERR << "Overlap-add: FFT size must be a power of two, got "
+              << fft_size;
+  if (opts.frame_shift <= 0)
+    KALDI_ERR << "Overlap-add: invalid frame shift " << opts.frame_shift;
+  srfft_ = new SplitRadixRealFft<BaseFloat>(fft_size);
+
+  Vector<BaseFloat> window(fft_size);
+  double a = M_2PI / (fft_size - 1);
+  for (int32 i = 0; i < fft_size; i++) {
+    double i_fl = static_cast<double>(i);
+    if (opts.window_type == "hamming") {
+      window(i) = 0.54 - 0.46 * cos(a * i_fl);
+    } else if (opts.window_type == "hanning") {
+      window(i) = 0.5 - 0.5 * cos(a * i_fl);
+    } else if (opts.window_type == "rectangular") {
+      window(i) = 1.0;
+    } else {
+      KALDI_ERR << "Overlap-add: invalid window type " << opts.window_type;
+    }
+  }
+  window_sq_ = window;
+  window_sq_.ApplyPow(2.0);
+  scaled_window_ = window;
+  scaled_window_.Scale(1.0 / fft_size);
+  block_.Resize(kBlockSize, fft_size, kUndefined);
+}
+
+OverlapAddSynthesizer::~OverlapAddSynthesizer() {
+  delete srfft_;
+}
+
+void OverlapAddSynthesizer::Reset() {
+  num_frames_ = 0;
+  input_finished_ = false;
+  buffer_offset_ = 0;
+  numerator_.SetZero();
+  denominator_.SetZero();
+  num_valid_ = 0;
+}
+
+void OverlapAddSynthesizer::EnsureBufferSize(int64 end) {
+  int32 size = static_cast<int32>(end - buffer_offset_);
+  if (size > numerator_.Dim()) {
+    // The new elements are zeroed by Resize().
+    int32 new_size = std::max(size, 2 * numerator_.Dim());
+    numerator_.Resize(new_size, kCopyData);
+    denominator_.Resize(new_size, kCopyData);
+  }
+  num_valid_ = std::max(num_valid_, size);
+}
+
+void OverlapAddSynthesizer::SynthesizeBlock(SubMatrix<BaseFloat> *block) {
+  int32 num_rows = block->NumRows(), fft_size = opts_.fft_size,
+      frame_shift = opts_.frame_shift;
+  EnsureBufferSize(static_cast<int64>(num_frames_ + num_rows - 1) *
+                   frame_shift + fft_size);
+  const BaseFloat *window = scaled_window_.Data(),
+      *window_sq = window_sq_.Data();
+  for (int32 r = 0; r < num_rows; r++) {
+    BaseFloat *frame = block->RowData(r);
+    srfft_->Compute(frame, false);  // inverse FFT.
+    int32 start = static_cast<int32>(
+        static_cast<int64>(num_frames_ + r) * frame_shift - buffer_offset_);
+    BaseFloat *numerator = numerator_.Data() + start,
+        *denominator = denominator_.Data() + start;
+    for (int32 i = 0; i < fft_size; i++) {
+      numerator[i] += window[i] * frame[i];
+      denominator[i] += window_sq[i];
+    }
+  }
+  num_frames_ += num_rows;
+}
+
+void OverlapAddSynthesizer::AcceptStft(const MatrixBase<BaseFloat> &stft) {
+  if (input_finished_)
+    KALDI_ERR << "AcceptStft() called after InputFinished().";
+  KALDI_ASSERT(stft.NumCols() == opts_.fft_size);
+  int32 num_frames = stft.NumRows();
+  for (int32 begin = 0; begin < num_frames; begin += kBlockSize) {
+    int32 size = (num_frames - begin < kBlockSize ? num_frames - begin :
+                  kBlockSize);
+    SubMatrix<BaseFloat> block(block_, 0, size, 0, opts_.fft_size);
+    block.CopyFromMat(stft.RowRange(begin, size));
+    SynthesizeBlock(&block);
+  }
+}
+
+void OverlapAddSynthesizer::AcceptLpsPhase(const MatrixBase<BaseFloat> &lps,
+                                           const MatrixBase<BaseFloat> &phase) {
+  if (input_finished_)
+    KALDI_ERR << "AcceptLpsPhase() called after InputFinished().";
+  int32 num_frames = lps.NumRows(), num_bins = opts_.fft_size / 2 + 1;
+  if (lps.NumCols() != num_bins || phase.NumCols() != num_bins ||
+      phase.NumRows() != num_frames)
+    KALDI_ERR << "Overlap-add: expected log-power spectra and phases of "
+              << "dimension " << num_bins << " with the same number of "
+              << "frames, got " << lps.NumRows() << " by " << lps.NumCols()
+              << " and " << phase.NumRows() << " by " << phase.NumCols();
+  for (int32 begin = 0; begin < num_frames; begin += kBlockSize) {
+    int32 size = (num_frames - begin < kBlockSize ? num_frames - begin :
+                  kBlockSize);
+    SubMatrix<BaseFloat> block(block_, 0, size, 0, opts_.fft_size);
+    for (int32 r = 0; r < size; r++) {
+      const BaseFloat *this_lps = lps.RowData(begin + r),
+          *this_phase = phase.RowData(begin + r);
+      BaseFloat *stft = block.RowData(r);
+      // The magnitude is exp(lps / 2); the DC and Nyquist bins are real and
+      // are packed into the first two elements.
+      stft[0] = Exp(0.5 * this_lps[0]) * cos(this_phase[0]);
+      stft[1] = Exp(0.5 * this_lps[num_bins - 1]) *
+          cos(this_phase[num_bins - 1]);
+      for (int32 i = 1; i < num_bins - 1; i++) {
+        BaseFloat magnitude = Exp(0.5 * this_lps[i]);
+        stft[2 * i] = magnitude * cos(this_phase[i]);
+        stft[2 * i + 1] = magnitude * sin(this_phase[i]);
+      }
+    }
+    SynthesizeBlock(&block);
+  }
+}
+
+void OverlapAddSynthesizer::InputFinished() {
+  input_finished_ = true;
+}
+
+int32 OverlapAddSynthesizer::NumSamplesReady() const {
+  if (input_finished_)
+    return num_valid_;
+  // Frames from num_frames_ onward will start at or after this sample, so
+  // the samples before it are final.
+  int64 end = static_cast<int64>(num_frames_) * opts_.frame_shift;
+  return static_cast<int32>(std::min<int64>(end - buffer_offset_,
+                                            num_valid_));
+}
+
+void OverlapAddSynthesizer::GetSamples(Vector<BaseFloat> *samples) {
+  int32 num_ready = NumSamplesReady();
+  samples->Resize(num_ready, kUndefined);
+  const BaseFloat *numerator = numerator_.Data(),
+      *denominator = denominator_.Data();
+  BaseFloat *data = samples->Data();
+  // The denominator is only zero where the window is, e.g. at the edges of a
+  // Hanning window.
+  for (int32 i = 0; i < num_ready; i++)
+    data[i] = (denominator[i] > 0.0 ? numerator[i] / denominator[i] : 0.0);
+
+  // Shift the remaining samples to the start of the buffers.
+  int32 num_remaining = num_valid_ - num_ready;
+  if (num_ready > 0 && num_remaining > 0) {
+    memmove(numerator_.Data(), numerator_.Data() + num_ready,
+            num_remaining * sizeof(BaseFloat));
+    memmove(denominator_.Data(), denominator_.Data() + num_ready,
+            num_remaining * sizeof(BaseFloat));
+  }
+  if (num_ready > 0) {
+    numerator_.Range(num_remaining, num_ready).SetZero();
+    denominator_.Range(num_remaining, num_ready).SetZero();
+  }
+  num_valid_ = num_remaining;
+  buffer_offset_ += num_ready;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,150 @@
+// feat/overlap-add.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_OVERLAP_ADD_H_
+#define KALDI_FEAT_OVERLAP_ADD_H_
+
+#include <string>
+
+#include "base/kaldi-common.h"
+#include "matrix/matrix-lib.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+
+struct OverlapAddOptions {
+  int32 frame_shift;  // in samples
+  int32 fft_size;
+  std::string window_type;  // e.g. "hamming", "hanning", "rectangular"
+
+  OverlapAddOptions(): frame_shift(256), fft_size(512),
+                       window_type("hamming") { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("window-shift", &frame_shift, "Frame shift in samples");
+    opts->Register("fft-size", &fft_size, "Inverse FFT size (must be a power "
+                   "of two); this is also the frame length");
+    opts->Register("window-type", &window_type, "Type of synthesis window "
+                   "(\"hamming\"|\"hanning\"|\"rectangular\")");
+  }
+};
+
+
+/**
+   OverlapAddSynthesizer reconstructs a waveform from a sequence of frames of
+   short-time spectra, by inverse FFT and weighted overlap-add: frame t covers
+   samples [t * frame_shift, t * frame_shift + fft_size), is multiplied by the
+   window w and added into the output, and each output sample is divided by
+   the sum of w^2 over the frames that cover it.  If the spectra came from
+   frames analyzed with the same window, this reconstructs the signal exactly.
+
+   Frames may be supplied incrementally, and samples can be retrieved as soon
+   as no later frame can change them, so the latency is fft_size samples.
+   Internally, frames are processed in blocks of up to kBlockSize frames.
+   Typical usage:
+   \code
+     OverlapAddSynthesizer synth(opts);
+     while (more frames) {
+       synth.AcceptLpsPhase(lps_block, phase_block);
+       synth.GetSamples(&samples);  // may return an empty vector.
+       ...
+     }
+     synth.InputFinished();
+     synth.GetSamples(&samples);  // the remaining samples.
+   \endcode
+*/
+class OverlapAddSynthesizer {
+ public:
+  explicit OverlapAddSynthesizer(const OverlapAddOptions &opts);
+
+  /// Accepts frames given as log-power spectra (e.g. as computed by
+  /// compute-lps-feats) and phases (e.g. from compute-phs-feats); both must
+  /// have fft_size / 2 + 1 columns and the same number of rows.
+  void AcceptLpsPhase(const MatrixBase<BaseFloat> &lps,
+                      const MatrixBase<BaseFloat> &phase);
+
+  /// Accepts frames given as complex spectra, each row of dimension fft_size
+  /// in the packed format produced by RealFft() and SplitRadixRealFft:
+  /// (re0, re_{N/2}, re1, im1, re2, im2, ...).
+  void AcceptStft(const MatrixBase<BaseFloat> &stft);
+
+  /// Says that no more frames will be accepted, so that all remaining samples
+  /// become ready.
+  void InputFinished();
+
+  /// Returns the number of samples that are ready but have not yet been
+  /// retrieved by GetSamples().
+  int32 NumSamplesReady() const;
+
+  /// Outputs (and forgets) the samples that are ready; 'samples' is resized,
+  /// possibly to zero.
+  void GetSamples(Vector<BaseFloat> *samples);
+
+  /// Returns the number of samples retrieved so far by GetSamples().
+  int64 NumSamplesOutput() const { return buffer_offset_; }
+
+  int32 NumFramesAccepted() const { return num_frames_; }
+
+  /// Prepares to synthesize a new signal.
+  void Reset();
+
+  ~OverlapAddSynthesizer();
+
+ private:
+  // The number of frames inverse-transformed together.
+  static const int32 kBlockSize = 32;
+
+  // Inverse-transforms the rows of 'block' (in place), and adds them into the
+  // buffers as frames num_frames_, num_frames_ + 1, ...
+  void SynthesizeBlock(SubMatrix<BaseFloat> *block);
+
+  // Makes sure numerator_ and denominator_ extend to absolute sample index
+  // 'end' (exclusive).
+  void EnsureBufferSize(int64 end);
+
+  OverlapAddOptions opts_;
+  SplitRadixRealFft<BaseFloat> *srfft_;
+  // The synthesis window, divided by fft_size to normalize the inverse FFT.
+  Vector<BaseFloat> scaled_window_;
+  Vector<BaseFloat> window_sq_;
+
+  // Workspace for a block of frames.
+  Matrix<BaseFloat> block_;
+
+  int32 num_frames_;
+  bool input_finished_;
+  // The absolute index of the sample in element 0 of numerator_ and
+  // denominator_, i.e. the number of samples already output.
+  int64 buffer_offset_;
+  // The sums of the windowed frames, and of the squared window, for samples
+  // buffer_offset_ onward; only the first num_valid_ elements are in use.
+  Vector<BaseFloat> numerator_;
+  Vector<BaseFloat> denominator_;
+  int32 num_valid_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OverlapAddSynthesizer);
+};
+
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+
+#endif  // KALDI_FEAT_OVERLAP_ADD_H_
@@ -324,6 +324,59 @@ static void UnitTestSearch() {
   KALDI_LOG << "Test passed :)\n";
 }
 
+// Make sure that limiting the length of the Viterbi traceback only changes the
+// pitch on a few frames.
+static void UnitTestMaxFramesTraceback() {
+  KALDI_LOG << "=== UnitTestMaxFramesTraceback() ===\n";
+  for (int32 n = 0; n < 3; n++) {
+    PitchExtractionOptions op1;
+    op1.nccf_ballast_online = true;
+    op1.frames_per_chunk = 10;  // the traceback is pruned after each chunk.
+
+    int32 size = 50000 + rand() % 50000;
+
+    Vector<BaseFloat> v(size);
+    // init with noise plus a sine-wave whose frequency is changing randomly,
+    // switched on and off every half second so there are stretches where the
+    // pitch is ambiguous.
+
+    double cur_freq = 200.0, normalized_time = 0.0;
+
+    for (int32 i = 0; i < size; i++) {
+      v(i) = RandGauss();
+      if ((i / 8000) % 2 == 0)
+        v(i) += cos(normalized_time * M_2PI);
+      cur_freq += RandGauss();  // let the frequency wander a little.
+      if (cur_freq < 100.0) cur_freq = 100.0;
+      if (cur_freq > 300.0) cur_freq = 300.0;
+      normalized_time += cur_freq / op1.samp_freq;
+    }
+
+    Matrix<BaseFloat> m1;
+    ComputeKaldiPitch(op1, v, &m1);
+
+    PitchExtractionOptions op2(op1);
+    op2.max_frames_traceback = 20;
+    Matrix<BaseFloat> m2;
+    ComputeKaldiPitch(op2, v, &m2);
+
+    AssertEqual(m1.NumRows(), m2.NumRows());
+    // Only look at the clearly voiced frames; elsewhere the pitch is arbitrary.
+    int32 num_voiced = 0, num_differ = 0;
+    for (int32 t = 0; t < m1.NumRows(); t++) {
+      if (m1(t, 0) > 0.5) {
+        num_voiced++;
+        if (!ApproxEqual(m1(t, 1), m2(t, 1)))
+          num_differ++;
+      }
+    }
+    KALDI_LOG << num_differ << " of " << num_voiced
+              << " voiced frames differ.";
+    KALDI_ASSERT(num_voiced > 0 && num_differ * 10 < num_voiced);
+  }
+  KALDI_LOG << "Test passed :)\n";
+}
+
 static void UnitTestComputeGPE() {
   KALDI_LOG << "=== UnitTestComputeGPE ===\n";
   int32 wrong_pitch = 0, tot_voiced = 0, tot_unvoiced = 0, num_frames = 0;
@@ -599,6 +652,7 @@ static void UnitTestFeatNoKeele() {
   UnitTestSnipEdges();
   UnitTestDelay();
   UnitTestSearch();
+  UnitTestMaxFramesTraceback();
 }
 
 static void UnitTestFeatWithKeele() {
@@ -109,15 +109,24 @@ void ComputeCorrelation(const VectorBase<BaseFloat> &wave,
   SubVector<BaseFloat> wave_part(wave, 0, nccf_window_size);
   // subtract mean-frame from wave
   zero_mean_wave.Add(-wave_part.Sum() / nccf_window_size);
-  BaseFloat e1, e2, sum;
   SubVector<BaseFloat> sub_vec1(zero_mean_wave, 0, nccf_window_size);
-  e1 = VecVec(sub_vec1, sub_vec1);
+  BaseFloat e1 = VecVec(sub_vec1, sub_vec1);
+  // e2 is the energy of the window starting at "lag"; rather than recomputing
+  // it for each lag, we update it as the window slides by one sample.  It is
+  // accumulated in double so the rounding errors don't build up over the lags.
+  const BaseFloat *data = zero_mean_wave.Data();
+  SubVector<BaseFloat> first_window(zero_mean_wave, first_lag,
+                                    nccf_window_size);
+  double e2 = VecVec(first_window, first_window);
   for (int32 lag = first_lag; lag <= last_lag; lag++) {
+    if (lag > first_lag) {
+      double old_sample = data[lag - 1],
+          new_sample = data[lag + nccf_window_size - 1];
+      e2 += new_sample * new_sample - old_sample * old_sample;
+    }
     SubVector<BaseFloat> sub_vec2(zero_mean_wave, lag, nccf_window_size);
-    e2 = VecVec(sub_vec2, sub_vec2);
-    sum = VecVec(sub_vec1, sub_vec2);
-    (*inner_prod)(lag - first_lag) = sum;
-    (*norm_prod)(lag - first_lag) = e1 * e2;
+    (*inner_prod)(lag - first_lag) = VecVec(sub_vec1, sub_vec2);
+    (*norm_prod)(lag - first_lag) = e1 * std::max(e2, 0.0);
   }
 }
 
@@ -136,7 +145,7 @@ void ComputeNccf(const VectorBase<BaseFloat> &inner_prod,
                inner_prod.Dim() == nccf_vec->Dim());
   for (int32 lag = 0; lag < inner_prod.Dim(); lag++) {
     BaseFloat numerator = inner_prod(lag),
-        denominator = pow(norm_prod(lag) + nccf_ballast, 0.5),
+        denominator = std::sqrt(norm_prod(lag) + nccf_ballast),
         nccf;
     if (denominator != 0.0) {
       nccf = numerator / denominator;
@@ -197,12 +206,16 @@ void ComputeLocalCost(const VectorBase<BaseFloat> &nccf_pitch,
 // of the pitch computation.
 class PitchFrameInfo {
  public:
-  /// This function resizes the arrays for this object and updates the reference
-  /// counts for the previous object (by decrementing those reference counts
-  /// when we destroy a StateInfo object).  A StateInfo object is considered to
-  /// be destroyed when we delete it, not when its reference counts goes to
-  /// zero.
-  void Cleanup(PitchFrameInfo *prev_frame);
+  /// At input, [*min_state, *max_state] is the range of states on this frame
+  /// that some path we may still choose goes through; at output, it is the
+  /// same range for the previous frame.  Because the backpointers are
+  /// monotonic in the state index, this is a contiguous range.
+  void GetPreviousStates(int32 *min_state, int32 *max_state) const;
+
+  /// Makes "prev_info" the previous frame of this one.  This is used to cut
+  /// the traceback at this frame, with "prev_info" the object for frame -1,
+  /// after which the frames that were before this one may be deleted.
+  void SetPrevious(PitchFrameInfo *prev_info) { prev_info_ = prev_info; }
 
   /// This function may be called for the last (most recent) PitchFrameInfo
   /// object with the best state (obtained from the externally held
@@ -254,7 +267,7 @@ class PitchFrameInfo {
                          const VectorBase<BaseFloat> &nccf_pitch,
                          const VectorBase<BaseFloat> &lags,
                          const VectorBase<BaseFloat> &prev_forward_cost,
-                         std::vector<std::pair<int32, int32> > *index_info,
+                         std::vector<std::pair<int32, double> > *index_info,
                          VectorBase<BaseFloat> *this_forward_cost);
  private:
   // struct StateInfo is the information we keep for a single one of the
@@ -308,7 +321,7 @@ void PitchFrameInfo::ComputeBacktraces(
     const VectorBase<BaseFloat> &nccf_pitch,
     const VectorBase<BaseFloat> &lags,
     const VectorBase<BaseFloat> &prev_forward_cost_vec,
-    std::vector<std::pair<int32, int32> > *index_info,
+    std::vector<std::pair<int32, double> > *index_info,
     VectorBase<BaseFloat> *this_forward_cost_vec) {
   int32 num_states = nccf_pitch.Dim();
 
@@ -324,17 +337,6 @@ void PitchFrameInfo::ComputeBacktraces(
   const BaseFloat *prev_forward_cost = prev_forward_cost_vec.Data();
   BaseFloat *this_forward_cost = this_forward_cost_vec->Data();
 
-  if (index_info->empty())
-    index_info->resize(num_states);
-
-  // make it a reference for more concise indexing.
-  std::vector<std::pair<int32, int32> > &bounds = *index_info;
-
-  /* bounds[i].first will be a lower bound on the backpointer for state i,
-     bounds[i].second will be an upper bound on it.  We progressively tighten
-     these bounds till we know the backpointers exactly.
-  */
-
   if (pitch_use_naive_search) {
     // This branch is only taken in unit-testing code.
     for (int32 i = 0; i < num_states; i++) {
@@ -351,130 +353,63 @@ void PitchFrameInfo::ComputeBacktraces(
       this_forward_cost[i] = best_cost;
       state_info_[i].backpointer = best_j;
     }
-  } else {
-    int32 last_backpointer = 0;
+  } else if (inter_frame_factor <= 0.0) {
+    // No penalty for pitch changes: every state follows the best previous one.
+    int32 best_j;
+    BaseFloat best_cost = prev_forward_cost_vec.Min(&best_j);
     for (int32 i = 0; i < num_states; i++) {
-      int32 start_j = last_backpointer;
-      BaseFloat best_cost = (start_j - i) * (start_j - i) * inter_frame_factor
-          + prev_forward_cost[start_j];
-      int32 best_j = start_j;
-
-      for (int32 j = start_j + 1; j < num_states; j++) {
-        BaseFloat this_cost = (j - i) * (j - i) * inter_frame_factor
-            + prev_forward_cost[j];
-        if (this_cost < best_cost) {
-          best_cost = this_cost;
-          best_j = j;
-        } else {  // as soon as the costs stop improving, we stop searching.
-          break;  // this is a loose lower bound we're getting.
-        }
-      }
-      state_info_[i].backpointer = best_j;
       this_forward_cost[i] = best_cost;
-      bounds[i].first = best_j;  // this is now a lower bound on the
-                                 // backpointer.
-      bounds[i].second = num_states - 1;  // we have no meaningful upper bound
-                                          // yet.
-      last_backpointer = best_j;
+      state_info_[i].backpointer = best_j;
     }
-
-    // We iterate, progressively refining the upper and lower bounds until they
-    // meet and we know that the resulting backtraces are optimal.  Each
-    // iteration takes time linear in num_states.  We won't normally iterate as
-    // far as num_states; normally we only do two iterations; when printing out
-    // the number of iterations, it's rarely more than that (once I saw seven
-    // iterations).  Anyway, this part of the computation does not dominate.
-    for (int32 iter = 0; iter < num_states; iter++) {
-      bool changed = false;
-      if (iter % 2 == 0) {  // go backwards through the states
-        last_backpointer = num_states - 1;
-        for (int32 i = num_states - 1; i >= 0; i--) {
-          int32 lower_bound = bounds[i].first,
-              upper_bound = std::min(last_backpointer, bounds[i].second);
-          if (upper_bound == lower_bound) {
-            last_backpointer = lower_bound;
-            continue;
-          }
-          BaseFloat best_cost = this_forward_cost[i];
-          int32 best_j = state_info_[i].backpointer, initial_best_j = best_j;
-
-          if (best_j == upper_bound) {
-            // if best_j already equals upper bound, don't bother tightening the
-            // upper bound, we'll tighten the lower bound when the time comes.
-            last_backpointer = best_j;
-            continue;
-          }
-          // Below, we have j > lower_bound + 1 because we know we've already
-          // evaluated lower_bound and lower_bound + 1 [via knowledge of
-          // this algorithm.]
-          for (int32 j = upper_bound; j > lower_bound + 1; j--) {
-            BaseFloat this_cost = (j - i) * (j - i) * inter_frame_factor
-                + prev_forward_cost[j];
-            if (this_cost < best_cost) {
-              best_cost = this_cost;
-              best_j = j;
-            } else {  // as soon as the costs stop improving, we stop searching,
-              // unless the best j is still lower than j, in which case
-              // we obviously need to keep moving.
-              if (best_j > j)
-                break;  // this is a loose lower bound we're getting.
-            }
-          }
-          // our "best_j" is now an upper bound on the backpointer.
-          bounds[i].second = best_j;
-          if (best_j != initial_best_j) {
-            this_forward_cost[i] = best_cost;
-            state_info_[i].backpointer = best_j;
-            changed = true;
-          }
-          last_backpointer = best_j;
-        }
-      } else {  // go forwards through the states.
-        last_backpointer = 0;
-        for (int32 i = 0; i < num_states; i++) {
-          int32 lower_bound = std::max(last_backpointer, bounds[i].first),
-              upper_bound = bounds[i].second;
-          if (upper_bound == lower_bound) {
-            last_backpointer = lower_bound;
-            continue;
-          }
-          BaseFloat best_cost = this_forward_cost[i];
-          int32 best_j = state_info_[i].backpointer, initial_best_j = best_j;
-
-          if (best_j == lower_bound) {
-            // if best_j already equals lower bound, we don't bother tightening
-            // the lower bound, we'll tighten the upper bound when the time
-            // comes.
-            last_backpointer = best_j;
-            continue;
-          }
-          // Below, we have j < upper_bound because we know we've already
-          // evaluated that point.
-          for (int32 j = lower_bound; j < upper_bound - 1; j++) {
-            BaseFloat this_cost = (j - i) * (j - i) * inter_frame_factor
-                + prev_forward_cost[j];
-            if (this_cost < best_cost) {
-              best_cost = this_cost;
-              best_j = j;
-            } else {  // as soon as the costs stop improving, we stop searching,
-              // unless the best j is still higher than j, in which case
-              // we obviously need to keep moving.
-              if (best_j < j)
-                break;  // this is a loose lower bound we're getting.
-            }
-          }
-          // our "best_j" is now a lower bound on the backpointer.
-          bounds[i].first = best_j;
-          if (best_j != initial_best_j) {
-            this_forward_cost[i] = best_cost;
-            state_info_[i].backpointer = best_j;
-            changed = true;
-          }
-          last_backpointer = best_j;
-        }
+  } else {
+    /* As a function of i, the cost of coming from state j is a parabola,
+       prev_forward_cost[j] + inter_frame_factor * (j - i)^2, and the forward
+       cost is the lower envelope of these parabolas.  We compute it exactly in
+       time linear in num_states, as in the distance transform of Felzenszwalb
+       and Huttenlocher: the first pass finds the parabolas that are part of
+       the envelope, in order, and the ranges of i over which each of them is
+       the lowest; the second pass reads off the best j for each i.
+
+       envelope[k].first is the j of the k'th parabola on the envelope and
+       envelope[k].second is the (real-valued) i at which it becomes the
+       lowest; envelope[k+1].second is where it stops being the lowest.
+       Because two parabolas with the same curvature cross only once, a new
+       parabola that is lower than the last one on the envelope where that one
+       starts being the lowest hides it completely.
+    */
+    std::vector<std::pair<int32, double> > &envelope = *index_info;
+    if (envelope.size() < static_cast<size_t>(num_states + 1))
+      envelope.resize(num_states + 1);
+    const double infinity = std::numeric_limits<double>::infinity(),
+        half_inv_factor = 0.5 / inter_frame_factor;
+    int32 k = 0;
+    envelope[0].first = 0;
+    envelope[0].second = -infinity;
+    envelope[1].second = infinity;
+    for (int32 j = 1; j < num_states; j++) {
+      double intersection;
+      while (true) {
+        int32 prev_j = envelope[k].first;
+        // The i at which the parabolas for j and prev_j take the same value.
+        intersection = 0.5 * (j + prev_j) + half_inv_factor *
+            (prev_forward_cost[j] - prev_forward_cost[prev_j]) / (j - prev_j);
+        if (intersection > envelope[k].second)
+          break;
+        k--;  // envelope[0].second is -infinity, so this stops at k = 0.
       }
-      if (!changed)
-        break;
+      k++;
+      envelope[k].first = j;
+      envelope[k].second = intersection;
+      envelope[k + 1].second = infinity;
+    }
+    k = 0;
+    for (int32 i = 0; i < num_states; i++) {
+      while (envelope[k + 1].second < i)
+        k++;
+      int32 j = envelope[k].first;
+      this_forward_cost[i] = (j - i) * (j - i) * inter_frame_factor
+          + prev_forward_cost[j];
+      state_info_[i].backpointer = j;
     }
   }
   // The next statement is needed due to RecomputeBacktraces: we have to
@@ -543,8 +478,12 @@ int32 PitchFrameInfo::ComputeLatency(int32 max_latency) {
   return latency;
 }
 
-void PitchFrameInfo::Cleanup(PitchFrameInfo *prev_frame) {
-  KALDI_ERR << "Cleanup not implemented.";
+void PitchFrameInfo::GetPreviousStates(int32 *min_state,
+                                       int32 *max_state) const {
+  KALDI_ASSERT(*min_state >= state_offset_ && *max_state >= *min_state &&
+               *max_state - state_offset_ < state_info_.size());
+  *min_state = state_info_[*min_state - state_offset_].backpointer;
+  *max_state = state_info_[*max_state - state_offset_].backpointer;
 }
 
 
@@ -640,6 +579,19 @@ class OnlinePitchFeatureImpl {
   /// from AcceptWaveform().
   void UpdateRemainder(const VectorBase<BaseFloat> &downsampled_wave_part);
 
+  /// This function deletes the PitchFrameInfo objects for the frames whose
+  /// best state can no longer change: those before the most recent frame
+  /// through which all the paths pass, and (if opts_.max_frames_traceback is
+  /// nonzero) those more than that many frames back.  It is called at the end
+  /// of AcceptWaveform(), so the memory used does not grow with the length of
+  /// the signal.
+  void PruneTraceback();
+
+  /// Returns the number of frames we have processed so far.
+  int32 NumFramesProcessed() const {
+    return num_pruned_frames_ + static_cast<int32>(frame_info_.size()) - 1;
+  }
+
 
   // The following variables don't change throughout the lifetime
   // of this object.
@@ -661,12 +613,17 @@ class OnlinePitchFeatureImpl {
   // The following objects may change during the lifetime of this object.
 
   // This object is used to resample the signal.
-  LinearResample *signal_resampler_;
+  PolyphaseResample *signal_resampler_;
 
-  // frame_info_ is indexed by [frame-index + 1].  frame_info_[0] is an object
-  // that corresponds to frame -1, which is not a real frame.
+  // frame_info_ is indexed by [frame-index - num_pruned_frames_ + 1].
+  // frame_info_[0] is an object that corresponds to frame -1, which is not a
+  // real frame; after pruning, frame_info_[1] points back to it.
   std::vector<PitchFrameInfo*> frame_info_;
 
+  // The number of frames whose PitchFrameInfo objects PruneTraceback() has
+  // deleted.
+  int32 num_pruned_frames_;
+
 
   // nccf_info_ is indexed by frame-index, from frame 0 to at most
   // opts_.recompute_frame - 1.  It contains some information we'll
@@ -714,11 +671,12 @@ class OnlinePitchFeatureImpl {
 
 OnlinePitchFeatureImpl::OnlinePitchFeatureImpl(
     const PitchExtractionOptions &opts):
-    opts_(opts), forward_cost_remainder_(0.0), input_finished_(false),
+    opts_(opts), num_pruned_frames_(0), forward_cost_remainder_(0.0),
+    input_finished_(false),
     signal_sumsq_(0.0), signal_sum_(0.0), downsampled_samples_processed_(0) {
-  signal_resampler_ = new LinearResample(opts.samp_freq, opts.resample_freq,
-                                         opts.lowpass_cutoff,
-                                         opts.lowpass_filter_width);
+  signal_resampler_ = new PolyphaseResample(opts.samp_freq, opts.resample_freq,
+                                            opts.lowpass_cutoff,
+                                            opts.lowpass_filter_width);
 
   double outer_min_lag = 1.0 / opts.max_f0 -
       (opts.upsample_filter_width/(2.0 * opts.resample_freq));
@@ -793,9 +751,7 @@ int32 OnlinePitchFeatureImpl::NumFramesAvailable(
 
 void OnlinePitchFeatureImpl::UpdateRemainder(
     const VectorBase<BaseFloat> &downsampled_wave_part) {
-  // frame_info_ has an extra element at frame-1, so subtract
-  // one from the length.
-  int64 num_frames = static_cast<int64>(frame_info_.size()) - 1,
+  int64 num_frames = NumFramesProcessed(),
       next_frame = num_frames,
       frame_shift = opts_.NccfWindowShift(),
       next_frame_sample = frame_shift * next_frame;
@@ -931,7 +887,7 @@ void OnlinePitchFeatureImpl::InputFinished() {
   // after setting input_finished_ to true, NumFramesAvailable()
   // will return a slightly larger number.
   AcceptWaveform(opts_.samp_freq, Vector<BaseFloat>());
-  int32 num_frames = static_cast<size_t>(frame_info_.size() - 1);
+  int32 num_frames = NumFramesProcessed();
   if (num_frames < opts_.recompute_frame && !opts_.nccf_ballast_online)
     RecomputeBacktraces();
   frames_latency_ = 0;
@@ -944,10 +900,11 @@ void OnlinePitchFeatureImpl::InputFinished() {
 // operation (it gets called for non-online mode, but is a no-op).
 void OnlinePitchFeatureImpl::RecomputeBacktraces() {
   KALDI_ASSERT(!opts_.nccf_ballast_online);
-  int32 num_frames = static_cast<int32>(frame_info_.size()) - 1;
+  int32 num_frames = NumFramesProcessed();
 
-  // The assertion reflects how we believe this function will be called.
-  KALDI_ASSERT(num_frames <= opts_.recompute_frame);
+  // The assertions reflect how we believe this function will be called;
+  // PruneTraceback() does nothing until it has been called.
+  KALDI_ASSERT(num_frames <= opts_.recompute_frame && num_pruned_frames_ == 0);
   KALDI_ASSERT(nccf_info_.size() == static_cast<size_t>(num_frames));
   if (num_frames == 0)
     return;
@@ -981,7 +938,7 @@ void OnlinePitchFeatureImpl::RecomputeBacktraces() {
   double forward_cost_remainder = 0.0;
   Vector<BaseFloat> forward_cost(num_states),  // start off at zero.
       next_forward_cost(forward_cost);
-  std::vector<std::pair<int32, int32 > > index_info;
+  std::vector<std::pair<int32, double> > index_info;
 
   for (int32 frame = 0; frame < num_frames; frame++) {
     NccfInfo &nccf_info = *nccf_info_[frame];
@@ -1069,7 +1026,7 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
   int32 end_frame = NumFramesAvailable(
       downsampled_samples_processed_ + downsampled_wave.Dim(), opts_.snip_edges);
   // "start_frame" is the first frame-index we process
-  int32 start_frame = frame_info_.size() - 1,
+  int32 start_frame = NumFramesProcessed(),
       num_new_frames = end_frame - start_frame;
 
   if (num_new_frames == 0) {
@@ -1164,7 +1121,7 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
   // below, which is why we don't do it at the very end.
   UpdateRemainder(downsampled_wave);
 
-  std::vector<std::pair<int32, int32 > > index_info;
+  std::vector<std::pair<int32, double> > index_info;
 
   for (int32 frame = start_frame; frame < end_frame; frame++) {
     int32 frame_idx = frame - start_frame;
@@ -1190,11 +1147,44 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
   // Trace back the best-path.
   int32 best_final_state;
   forward_cost_.Min(&best_final_state);
-  lag_nccf_.resize(frame_info_.size() - 1);  // will keep any existing data.
+  lag_nccf_.resize(NumFramesProcessed());  // will keep any existing data.
   frame_info_.back()->SetBestState(best_final_state, lag_nccf_);
   frames_latency_ =
       frame_info_.back()->ComputeLatency(opts_.max_frames_latency);
   KALDI_VLOG(4) << "Latency is " << frames_latency_;
+  PruneTraceback();
+}
+
+void OnlinePitchFeatureImpl::PruneTraceback() {
+  // RecomputeBacktraces() needs all the frames up to opts_.recompute_frame.
+  if (!opts_.nccf_ballast_online &&
+      NumFramesProcessed() < opts_.recompute_frame)
+    return;
+  // Trace back the range of states that the paths from all the states of the
+  // last frame go through, until it shrinks to a single state; all later
+  // tracebacks will go through that state, and SetBestState() will stop
+  // there, so the frames before it are no longer needed.
+  int32 num_frames = static_cast<int32>(frame_info_.size()) - 1,
+      min_state = 0, max_state = lags_.Dim() - 1,
+      frame = num_frames;  // index into frame_info_.
+  while (frame > 1 && min_state != max_state) {
+    frame_info_[frame]->GetPreviousStates(&min_state, &max_state);
+    frame--;
+  }
+  int32 first_kept = (min_state == max_state ? frame : 1);
+  if (opts_.max_frames_traceback > 0 &&
+      num_frames - first_kept >= opts_.max_frames_traceback) {
+    // Fix the frames more than opts_.max_frames_traceback frames back to the
+    // current best path, which SetBestState() has just written to lag_nccf_.
+    first_kept = num_frames - opts_.max_frames_traceback + 1;
+  }
+  if (first_kept <= 1)
+    return;
+  for (int32 i = 1; i < first_kept; i++)
+    delete frame_info_[i];
+  frame_info_.erase(frame_info_.begin() + 1, frame_info_.begin() + first_kept);
+  frame_info_[1]->SetPrevious(frame_info_[0]);
+  num_pruned_frames_ += first_kept - 1;
 }
 
 
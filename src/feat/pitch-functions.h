@@ -73,6 +73,14 @@ struct PitchExtractionOptions {
   // can just leave this value at zero.
   int32 max_frames_latency;
 
+  // If nonzero, the maximum number of frames over which the Viterbi traceback
+  // may still be revised; when it gets longer than this, the older frames are
+  // fixed to the current best path.  The frames before the point where all
+  // the paths have merged are freed anyway, so this only matters for signals
+  // on which the tracking stays ambiguous for a long time, but it bounds the
+  // memory used by long streams in online operation.
+  int32 max_frames_traceback;
+
   // Only relevant for the function ComputeKaldiPitch which is called by
   // compute-kaldi-pitch-feats. If nonzero, we provide the input as chunks of
   // this size. This affects the energy normalization which has a small effect
@@ -126,6 +134,7 @@ struct PitchExtractionOptions {
       lowpass_filter_width(1),
       upsample_filter_width(5),
       max_frames_latency(0),
+      max_frames_traceback(0),
       frames_per_chunk(0),
       simulate_first_pass_online(false),
       recompute_frame(500),
@@ -190,6 +199,11 @@ struct PitchExtractionOptions {
                    "introduce into the feature processing (affects output only "
                    "if --frames-per-chunk > 0 and "
                    "--simulate-first-pass-online=true");
+    opts->Register("max-frames-traceback", &max_frames_traceback, "If nonzero, "
+                   "the maximum number of frames over which the pitch-tracking "
+                   "traceback may be revised; older frames are fixed to the "
+                   "best path at that point.  Bounds the memory used for long "
+                   "streams.");
     opts->Register("snip-edges", &snip_edges, "If this is set to false, the "
                    "incomplete frames near the ending edge won't be snipped, "
                    "so that the number of frames is the file size divided by "
@@ -0,0 +1,109 @@
+// feat/resample-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "feat/resample.h"
+
+namespace kaldi {
+
+// Times PolyphaseResample against LinearResample on a random signal, given
+// to the resamplers in chunks of 'chunk_size' samples as in online decoding
+// (or all at once if chunk_size <= 0), and reports the difference between
+// their outputs.
+static void TestResampleSpeed(int32 samp_freq_in, int32 samp_freq_out,
+                              int32 chunk_size) {
+  int32 num_zeros = 6, num_iters = 3;
+  BaseFloat num_seconds = 10.0;
+  // As in ResampleWaveform().
+  BaseFloat cutoff = 0.99 * 0.5 * std::min(samp_freq_in, samp_freq_out);
+  Vector<BaseFloat> wave(static_cast<int32>(num_seconds * samp_freq_in));
+  wave.SetRandn();
+  wave.Scale(1000.0);
+  if (chunk_size <= 0)
+    chunk_size = wave.Dim();
+
+  LinearResample linear(samp_freq_in, samp_freq_out, cutoff, num_zeros);
+  PolyphaseResample polyphase(samp_freq_in, samp_freq_out, cutoff,
+                              num_zeros);
+
+  double linear_time = 0.0, polyphase_time = 0.0;
+  Vector<BaseFloat> linear_output, polyphase_output;
+  for (int32 iter = 0; iter < num_iters; iter++) {
+    for (int32 method = 0; method < 2; method++) {
+      Vector<BaseFloat> *output = (method == 0 ? &linear_output :
+                                   &polyphase_output);
+      std::vector<Vector<BaseFloat> > pieces;
+      Timer timer;
+      for (int32 offset = 0; offset < wave.Dim(); offset += chunk_size) {
+        int32 this_size = std::min(chunk_size, wave.Dim() - offset);
+        bool flush = (offset + this_size == wave.Dim());
+        pieces.resize(pieces.size() + 1);
+        if (method == 0)
+          linear.Resample(wave.Range(offset, this_size), flush,
+                          &(pieces.back()));
+        else
+          polyphase.Resample(wave.Range(offset, this_size), flush,
+                             &(pieces.back()));
+      }
+      double elapsed = timer.Elapsed();
+      double *time = (method == 0 ? &linear_time : &polyphase_time);
+      if (iter == 0 || elapsed < *time) *time = elapsed;
+      int32 dim = 0;
+      for (size_t i = 0; i < pieces.size(); i++)
+        dim += pieces[i].Dim();
+      output->Resize(dim);
+      dim = 0;
+      for (size_t i = 0; i < pieces.size(); i++) {
+        output->Range(dim, pieces[i].Dim()).CopyFromVec(pieces[i]);
+        dim += pieces[i].Dim();
+      }
+    }
+  }
+
+  KALDI_ASSERT(linear_output.Dim() == polyphase_output.Dim());
+  Vector<BaseFloat> diff(polyphase_output);
+  diff.AddVec(-1.0, linear_output);
+  BaseFloat signal_energy = VecVec(linear_output, linear_output),
+      diff_energy = VecVec(diff, diff);
+
+  KALDI_LOG << "Resampled " << num_seconds << " seconds from "
+            << samp_freq_in << " to " << samp_freq_out << " Hz in chunks of "
+            << chunk_size << " samples with " << polyphase.NumPhases()
+            << " phases of " << polyphase.NumTaps()
+            << " taps: LinearResample took " << linear_time
+            << " seconds, PolyphaseResample took " << polyphase_time
+            << " seconds, speedup is " << (linear_time / polyphase_time);
+  KALDI_LOG << "Max absolute difference is " << diff.Max() << " / "
+            << -diff.Min() << ", signal-to-difference ratio is "
+            << (diff_energy == 0.0 ? std::numeric_limits<BaseFloat>::infinity()
+                : 10.0 * log10(signal_energy / diff_energy)) << " dB";
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  int32 chunk_sizes[] = { 0, 160 };
+  for (int32 i = 0; i < 2; i++) {
+    TestResampleSpeed(48000, 16000, chunk_sizes[i]);
+    TestResampleSpeed(44100, 16000, chunk_sizes[i]);
+    TestResampleSpeed(8000, 16000, chunk_sizes[i]);
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
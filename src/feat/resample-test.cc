@@ -275,12 +275,73 @@ void UnitTestLinearResample2() {
   AssertEqual(self1, cross, 0.001);
 }
 
+void UnitTestPolyphaseResample() {
+  // this test makes sure that PolyphaseResample gives the same results as
+  // LinearResample, including when the signal is broken up into pieces.
+  int32 samp_freq, resamp_freq;
+  if (rand() % 2 == 0) {
+    // common rates, which have a small repeating unit.
+    int32 rates[] = { 8000, 16000, 22050, 44100, 48000 };
+    samp_freq = rates[rand() % 5];
+    resamp_freq = rates[rand() % 5];
+  } else {
+    samp_freq = 1000.0 * (1.0 + RandUniform());
+    resamp_freq = 1000.0 * (1.0 + RandUniform());
+  }
+  int32 num_samp = 256 + static_cast<int32>((RandUniform() * 2048));
+  BaseFloat lowpass_freq =
+    std::min(samp_freq, resamp_freq) * 0.95 * 0.5 / (1.0 + RandUniform());
+  int32 num_zeros = 3 + rand() % 10;
+
+  Vector<BaseFloat> test_signal(num_samp);
+  test_signal.SetRandn();
+
+  LinearResample linear_resampler(samp_freq, resamp_freq,
+                                  lowpass_freq, num_zeros);
+  PolyphaseResample polyphase_resampler(samp_freq, resamp_freq,
+                                        lowpass_freq, num_zeros);
+  KALDI_ASSERT(polyphase_resampler.NumPhases() ==
+               resamp_freq / Gcd(samp_freq, resamp_freq));
+
+  Vector<BaseFloat> resampled_vec, resampled_vec2;
+  linear_resampler.Resample(test_signal, true, &resampled_vec);
+
+  // Start processing a signal and abandon it, to test Reset().
+  if (rand() % 2 == 0) {
+    Vector<BaseFloat> out_piece;
+    polyphase_resampler.Resample(test_signal.Range(0, num_samp / 2), false,
+                                 &out_piece);
+    polyphase_resampler.Reset();
+  }
+  polyphase_resampler.Resample(test_signal, true, &resampled_vec2);
+  AssertEqual(resampled_vec, resampled_vec2, 1.0e-04);
+
+  int32 input_dim_seen = 0, max_piece_size = (rand() % 2 == 0 ? 10 : 1000);
+  resampled_vec2.Resize(0);
+  while (input_dim_seen < test_signal.Dim()) {
+    int32 dim_remaining = test_signal.Dim() - input_dim_seen;
+    int32 piece_size = rand() % std::min(dim_remaining + 1, max_piece_size);
+    SubVector<BaseFloat> in_piece(test_signal, input_dim_seen, piece_size);
+    Vector<BaseFloat> out_piece;
+    bool flush = (piece_size == dim_remaining);
+    polyphase_resampler.Resample(in_piece, flush, &out_piece);
+    int32 old_output_dim = resampled_vec2.Dim();
+    resampled_vec2.Resize(old_output_dim + out_piece.Dim(), kCopyData);
+    resampled_vec2.Range(old_output_dim, out_piece.Dim())
+                  .CopyFromVec(out_piece);
+    input_dim_seen += piece_size;
+  }
+  AssertEqual(resampled_vec, resampled_vec2, 1.0e-04);
+}
+
 int main() {
   try {
     for (int32 x = 0; x < 50; x++)
       UnitTestLinearResample();
     for (int32 x = 0; x < 50; x++)
       UnitTestLinearResample2();    
+    for (int32 x = 0; x < 50; x++)
+      UnitTestPolyphaseResample();
     for (int32 x = 0; x < 50; x++)
       UnitTestArbitraryResample();
 
@@ -259,6 +259,191 @@ BaseFloat LinearResample::FilterFunc(BaseFloat t) const {
 }
 
 
+PolyphaseResample::PolyphaseResample(int32 samp_rate_in_hz,
+                                     int32 samp_rate_out_hz,
+                                     BaseFloat filter_cutoff_hz,
+                                     int32 num_zeros):
+    samp_rate_in_(samp_rate_in_hz),
+    samp_rate_out_(samp_rate_out_hz),
+    filter_cutoff_(filter_cutoff_hz),
+    num_zeros_(num_zeros) {
+  KALDI_ASSERT(samp_rate_in_hz > 0.0 &&
+               samp_rate_out_hz > 0.0 &&
+               filter_cutoff_hz > 0.0 &&
+               filter_cutoff_hz*2 <= samp_rate_in_hz &&
+               filter_cutoff_hz*2 <= samp_rate_out_hz &&
+               num_zeros > 0);
+  int32 base_freq = Gcd(samp_rate_in_, samp_rate_out_);
+  input_samples_in_unit_ = samp_rate_in_ / base_freq;
+  output_samples_in_unit_ = samp_rate_out_ / base_freq;
+
+  SetIndexesAndWeights();
+  Reset();
+}
+
+int64 PolyphaseResample::GetNumOutputSamples(int64 input_num_samp,
+                                             bool flush) const {
+  // See LinearResample::GetNumOutputSamples() for explanation.
+  int32 tick_freq = Lcm(samp_rate_in_, samp_rate_out_);
+  int32 ticks_per_input_period = tick_freq / samp_rate_in_;
+  int64 interval_length_in_ticks = input_num_samp * ticks_per_input_period;
+  if (!flush) {
+    BaseFloat window_width = num_zeros_ / (2.0 * filter_cutoff_);
+    int32 window_width_ticks = floor(window_width * tick_freq);
+    interval_length_in_ticks -= window_width_ticks;
+  }
+  if (interval_length_in_ticks <= 0)
+    return 0;
+  int32 ticks_per_output_period = tick_freq / samp_rate_out_;
+  int64 last_output_samp = interval_length_in_ticks / ticks_per_output_period;
+  if (last_output_samp * ticks_per_output_period == interval_length_in_ticks)
+    last_output_samp--;
+  return last_output_samp + 1;
+}
+
+void PolyphaseResample::SetIndexesAndWeights() {
+  first_index_.resize(output_samples_in_unit_);
+  std::vector<int32> num_indices(output_samples_in_unit_);
+
+  double window_width = num_zeros_ / (2.0 * filter_cutoff_);
+  int32 num_taps = 0;
+  for (int32 i = 0; i < output_samples_in_unit_; i++) {
+    double output_t = i / static_cast<double>(samp_rate_out_);
+    double min_t = output_t - window_width, max_t = output_t + window_width;
+    // The same indexes as in LinearResample::SetIndexesAndWeights().
+    int32 min_input_index = ceil(min_t * samp_rate_in_),
+        max_input_index = floor(max_t * samp_rate_in_);
+    first_index_[i] = min_input_index;
+    num_indices[i] = max_input_index - min_input_index + 1;
+    num_taps = std::max(num_taps, num_indices[i]);
+  }
+  // The phases with fewer indexes get zero weights at the end.
+  weights_.Resize(output_samples_in_unit_, num_taps);
+  for (int32 i = 0; i < output_samples_in_unit_; i++) {
+    double output_t = i / static_cast<double>(samp_rate_out_);
+    for (int32 j = 0; j < num_indices[i]; j++) {
+      int32 input_index = first_index_[i] + j;
+      double input_t = input_index / static_cast<double>(samp_rate_in_),
+          delta_t = input_t - output_t;
+      weights_(i, j) = FilterFunc(delta_t) / samp_rate_in_;
+    }
+  }
+}
+
+void PolyphaseResample::GetInputRange(const VectorBase<BaseFloat> &input,
+                                      int64 begin, int64 end,
+                                      Vector<BaseFloat> *dest) const {
+  KALDI_ASSERT(end >= begin);
+  dest->Resize(end - begin, kUndefined);
+  BaseFloat *dest_data = dest->Data() - begin;  // indexed by input sample.
+  int64 i = begin;
+  // Zeros before the start of the signal.
+  int64 zero_end = std::min<int64>(end, 0);
+  if (i < zero_end) {
+    std::fill(dest_data + i, dest_data + zero_end, 0.0);
+    i = zero_end;
+  }
+  // Samples from previous calls.
+  int64 history_end = std::min(end, input_sample_offset_);
+  if (i < history_end) {
+    KALDI_ASSERT(i >= history_offset_);
+    std::copy(history_.Data() + (i - history_offset_),
+              history_.Data() + (history_end - history_offset_),
+              dest_data + i);
+    i = history_end;
+  }
+  // Samples from this call.
+  int64 input_end = std::min(end, input_sample_offset_ + input.Dim());
+  if (i < input_end) {
+    std::copy(input.Data() + (i - input_sample_offset_),
+              input.Data() + (input_end - input_sample_offset_),
+              dest_data + i);
+    i = input_end;
+  }
+  // Zeros after the end of the input so far.  When flushing, these are the
+  // signal's trailing zeros.  Otherwise they are only read by the zero
+  // padding at the end of a row of weights_, since the last output sample
+  // is chosen so that its nonzero weights lie within the input.
+  if (i < end)
+    std::fill(dest_data + i, dest_data + end, 0.0);
+}
+
+void PolyphaseResample::Resample(const VectorBase<BaseFloat> &input,
+                                 bool flush,
+                                 Vector<BaseFloat> *output) {
+  int64 tot_input_samp = input_sample_offset_ + input.Dim(),
+      tot_output_samp = GetNumOutputSamples(tot_input_samp, flush);
+
+  KALDI_ASSERT(tot_output_samp >= output_sample_offset_);
+
+  int32 num_output_samp = static_cast<int32>(tot_output_samp -
+                                             output_sample_offset_);
+  output->Resize(num_output_samp, kUndefined);
+
+  if (num_output_samp > 0) {
+    int32 num_taps = weights_.NumCols();
+    // [begin, end) is the range of input samples that this call's output
+    // depends on; we put them in one contiguous buffer.
+    int64 begin = FirstInputIndex(output_sample_offset_),
+        end = FirstInputIndex(tot_output_samp - 1) + num_taps;
+    GetInputRange(input, begin, end, &buffer_);
+
+    int64 unit_index = output_sample_offset_ / output_samples_in_unit_;
+    int32 phase = static_cast<int32>(output_sample_offset_ -
+                                     unit_index * output_samples_in_unit_);
+    // unit_offset is the index into buffer_ of the first input sample of
+    // the current repeating unit.
+    int64 unit_offset = unit_index * input_samples_in_unit_ - begin;
+    const BaseFloat *buffer_data = buffer_.Data();
+    BaseFloat *output_data = output->Data();
+    for (int32 i = 0; i < num_output_samp; i++) {
+      SubVector<BaseFloat> input_part(buffer_data + unit_offset +
+                                      first_index_[phase], num_taps);
+      output_data[i] = VecVec(input_part, weights_.Row(phase));
+      if (++phase == output_samples_in_unit_) {
+        phase = 0;
+        unit_offset += input_samples_in_unit_;
+      }
+    }
+  }
+
+  if (flush) {
+    Reset();  // Reset the internal state.
+  } else {
+    // Keep the input samples that the next output sample depends on, and
+    // everything after them.
+    int64 next_begin = std::min(std::max<int64>(
+        FirstInputIndex(tot_output_samp), 0), tot_input_samp);
+    GetInputRange(input, next_begin, tot_input_samp, &buffer_);
+    history_.Swap(&buffer_);
+    history_offset_ = next_begin;
+    input_sample_offset_ = tot_input_samp;
+    output_sample_offset_ = tot_output_samp;
+  }
+}
+
+void PolyphaseResample::Reset() {
+  input_sample_offset_ = 0;
+  output_sample_offset_ = 0;
+  history_offset_ = 0;
+  history_.Resize(0);
+}
+
+// The same filter as LinearResample::FilterFunc().
+BaseFloat PolyphaseResample::FilterFunc(BaseFloat t) const {
+  BaseFloat window, filter;
+  if (fabs(t) < num_zeros_ / (2.0 * filter_cutoff_))
+    window = 0.5 * (1 + cos(M_2PI * filter_cutoff_ / num_zeros_ * t));
+  else
+    window = 0.0;  // outside support of window function
+  if (t != 0)
+    filter = sin(M_2PI * filter_cutoff_ * t) / (M_PI * t);
+  else
+    filter = 2 * filter_cutoff_;  // limit of the function at t = 0
+  return filter * window;
+}
+
+
 ArbitraryResample::ArbitraryResample(
     int32 num_samples_in, BaseFloat samp_rate_in,
     BaseFloat filter_cutoff, const Vector<BaseFloat> &sample_points,
@@ -370,8 +555,8 @@ void ResampleWaveform(BaseFloat orig_freq, const VectorBase<BaseFloat> &wave,
   BaseFloat min_freq = std::min(orig_freq, new_freq);
   BaseFloat lowpass_cutoff = 0.99 * 0.5 * min_freq;
   int32 lowpass_filter_width = 6;
-  LinearResample resampler(orig_freq, new_freq,
-                           lowpass_cutoff, lowpass_filter_width);
+  PolyphaseResample resampler(orig_freq, new_freq,
+                              lowpass_cutoff, lowpass_filter_width);
   resampler.Resample(wave, true, new_wave);
 }
 }  // namespace kaldi
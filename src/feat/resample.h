@@ -252,10 +252,113 @@ class LinearResample {
                                        ///< previously seen input signal.
 };
 
+/**
+   PolyphaseResample computes the same thing as LinearResample, and has the
+   same interface (including the streaming behaviour of Resample() with
+   flush == false, and Reset()), but is organized for speed.  The output
+   samples of a repeating unit (see LinearResample) are the phases of a
+   polyphase filter bank; each phase has the same number of taps (the shorter
+   ones are padded with zeros), stored contiguously in the rows of a matrix.
+   The input is kept in a contiguous buffer that includes the history from
+   previous calls, so each output sample is a single dot product of fixed
+   length with no special cases at the edges, done by BLAS.
+
+   Any ratio of integer sampling rates is supported; the number of phases is
+   samp_rate_out_hz / Gcd(samp_rate_in_hz, samp_rate_out_hz), e.g. 1 for
+   48k -> 16k, 2 for 8k -> 16k and 160 for 44.1k -> 16k.  The output equals
+   that of LinearResample set up with the same arguments, up to roundoff.
+*/
+class PolyphaseResample {
+ public:
+  /// The arguments are as for LinearResample.
+  PolyphaseResample(int32 samp_rate_in_hz,
+                    int32 samp_rate_out_hz,
+                    BaseFloat filter_cutoff_hz,
+                    int32 num_zeros);
+
+  /// Resamples the signal; see LinearResample::Resample() for how to process a
+  /// signal a piece at a time.
+  void Resample(const VectorBase<BaseFloat> &input,
+                bool flush,
+                Vector<BaseFloat> *output);
+
+  /// Resets the state of the object prior to processing a new signal; see
+  /// LinearResample::Reset().
+  void Reset();
+
+  inline int32 GetInputSamplingRate() { return samp_rate_in_; }
+  inline int32 GetOutputSamplingRate() { return samp_rate_out_; }
+
+  /// The number of taps of each phase of the filter.
+  int32 NumTaps() const { return weights_.NumCols(); }
+
+  /// The number of phases of the filter, i.e. the number of output samples in
+  /// a repeating unit.
+  int32 NumPhases() const { return weights_.NumRows(); }
+
+ private:
+  /// As LinearResample::GetNumOutputSamples().
+  int64 GetNumOutputSamples(int64 input_num_samp, bool flush) const;
+
+  /// Returns the first input-sample index (possibly negative) that output
+  /// sample 'samp_out' has a weight on.
+  inline int64 FirstInputIndex(int64 samp_out) const {
+    int64 unit_index = samp_out / output_samples_in_unit_;
+    int32 phase = static_cast<int32>(samp_out -
+                                     unit_index * output_samples_in_unit_);
+    return first_index_[phase] + unit_index * input_samples_in_unit_;
+  }
+
+  /// Copies the input samples with indexes begin <= i < end into 'dest',
+  /// taking them from history_ or from 'input' (which starts at index
+  /// input_sample_offset_), or using zero for indexes outside the signal.
+  void GetInputRange(const VectorBase<BaseFloat> &input,
+                     int64 begin, int64 end,
+                     Vector<BaseFloat> *dest) const;
+
+  void SetIndexesAndWeights();
+
+  BaseFloat FilterFunc(BaseFloat t) const;
+
+  // The following variables are provided by the user.
+  int32 samp_rate_in_;
+  int32 samp_rate_out_;
+  BaseFloat filter_cutoff_;
+  int32 num_zeros_;
+
+  int32 input_samples_in_unit_;   ///< as in LinearResample.
+  int32 output_samples_in_unit_;  ///< as in LinearResample; the number of
+                                  ///< phases.
+
+  /// The first input-sample index that phase i has a weight on, for the
+  /// first repeating unit; may be negative.
+  std::vector<int32> first_index_;
+
+  /// Row i contains the weights of phase i, padded with zeros to the same
+  /// number of taps.
+  Matrix<BaseFloat> weights_;
+
+  // the following variables keep track of where we are in a particular signal,
+  // if it is being provided over multiple calls to Resample().
+
+  int64 input_sample_offset_;  ///< The number of input samples we have
+                               ///< already received for this signal.
+  int64 output_sample_offset_;  ///< The number of samples we have already
+                                ///< output for this signal.
+  int64 history_offset_;  ///< The input-sample index of history_(0).
+  Vector<BaseFloat> history_;  ///< The input samples from index
+                               ///< history_offset_ up to
+                               ///< input_sample_offset_, which are still
+                               ///< needed for future output samples.
+  Vector<BaseFloat> buffer_;  ///< Temporary buffer for the input of one call
+                              ///< to Resample(), including history_.
+};
+
 /**
    Downsample or upsample a waveform. This is a convenience wrapper for the
-   class 'LinearResample'.
-   The low-pass filter cutoff used in 'LinearResample' is 0.99 of the Nyquist,
+   class 'PolyphaseResample' (formerly 'LinearResample', which gives the same
+   output).
+   The low-pass filter cutoff used is 0.99 of the Nyquist,
    where the Nyquist is half of the minimum of (orig_freq, new_freq).  The
    resampling is done with a symmetric FIR filter with N_z (number of zeros)
    as 6.
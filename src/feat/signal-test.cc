@@ -52,12 +52,32 @@ void UnitTestFFTbasedConvolution() {
     AssertEqual(signal, signal_test, 0.0001 * signal.Dim());
   }
 }
+
+void UnitTestPartitionedFilter() {
+  for (int32 i = 0; i < 10; i++) {
+    int32 signal_length = 1 + Rand() % 5000;
+    int32 filter_length = 1 + Rand() % 2000;
+    int32 block_length = (i % 2 == 0 ? 0 : 1 << (2 + Rand() % 8));
+    Vector<BaseFloat> signal(signal_length);
+    Vector<BaseFloat> filter(filter_length);
+    signal.SetRandn();
+    filter.SetRandn();
+    PartitionedFilter partitioned_filter(filter, block_length);
+    KALDI_ASSERT(partitioned_filter.NumPartitions() *
+                 partitioned_filter.BlockLength() >= filter_length);
+    Vector<BaseFloat> signal_test(signal);
+    ConvolveSignals(filter, &signal_test);
+    partitioned_filter.Convolve(&signal);
+    AssertEqual(signal, signal_test, 0.0001);
+  }
+}
 }
 
 int main() {
   using namespace kaldi;
   UnitTestFFTbasedConvolution();
   UnitTestFFTbasedBlockConvolution();
+  UnitTestPartitionedFilter();
   KALDI_LOG << "Tests succeeded.";
 
 }
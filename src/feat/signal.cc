@@ -125,5 +125,91 @@ void FFTbasedBlockConvolveSignals(const Vector<BaseFloat> &filter, Vector<BaseFl
     }
   }
 }
+
+// Adds the elementwise product of the FFTs a and b (of dimension 'dim', in the
+// format produced by SplitRadixRealFft) to c.
+static void AddElementwiseProductOfFft(const BaseFloat *a, const BaseFloat *b,
+                                       int32 dim, BaseFloat *c) {
+  // The first two elements are the real values at DC and at the Nyquist.
+  c[0] += a[0] * b[0];
+  c[1] += a[1] * b[1];
+  for (int32 i = 2; i < dim; i += 2) {
+    c[i] += a[i] * b[i] - a[i + 1] * b[i + 1];
+    c[i + 1] += a[i] * b[i + 1] + a[i + 1] * b[i];
+  }
+}
+
+// Returns a block length for a filter of length 'filter_length'.  The
+// computation per output sample is roughly proportional to
+// log(block_length) for the FFTs plus filter_length / block_length for the
+// products, which is smallest for a block length around half the filter
+// length in theory; in practice a quarter of the filter length, with a limit so
+// the FFTs stay in cache, was found to be faster.
+static int32 DefaultBlockLength(int32 filter_length) {
+  int32 block_length = RoundUpToNearestPowerOfTwo(filter_length) / 4;
+  return std::min(std::max(block_length, 64), 4096);
+}
+
+PartitionedFilter::PartitionedFilter(const VectorBase<BaseFloat> &filter,
+                                     int32 block_length):
+    filter_length_(filter.Dim()),
+    block_length_(block_length > 0 ? block_length :
+                  DefaultBlockLength(filter.Dim())),
+    srfft_(2 * block_length_) {
+  KALDI_ASSERT(filter_length_ > 0 &&
+               (block_length_ & (block_length_ - 1)) == 0);
+  int32 num_partitions = (filter_length_ + block_length_ - 1) / block_length_;
+  spectra_.Resize(num_partitions, 2 * block_length_);
+  std::vector<BaseFloat> temp_buffer;
+  for (int32 p = 0; p < num_partitions; p++) {
+    int32 offset = p * block_length_,
+        length = std::min(block_length_, filter_length_ - offset);
+    SubVector<BaseFloat> spectrum(spectra_, p);
+    spectrum.Range(0, length).CopyFromVec(filter.Range(offset, length));
+    srfft_.Compute(spectrum.Data(), true, &temp_buffer);
+  }
+}
+
+void PartitionedFilter::Convolve(Vector<BaseFloat> *signal) const {
+  int32 signal_length = signal->Dim(),
+      output_length = signal_length + filter_length_ - 1,
+      num_partitions = spectra_.NumRows(),
+      fft_length = 2 * block_length_,
+      num_blocks = (output_length + block_length_ - 1) / block_length_;
+  Vector<BaseFloat> output(output_length, kUndefined);
+
+  // 'history' is the frequency-domain delay line: row (k % num_partitions)
+  // holds the FFT of input block k, which is the input samples
+  // [(k-1) * block_length_, (k+1) * block_length_).
+  Matrix<BaseFloat> history(std::min(num_partitions, num_blocks), fft_length);
+  Vector<BaseFloat> sum(fft_length);
+  std::vector<BaseFloat> temp_buffer;
+  for (int32 k = 0; k < num_blocks; k++) {
+    SubVector<BaseFloat> block(history, k % history.NumRows());
+    int32 begin = (k - 1) * block_length_,
+        copy_begin = std::max(begin, 0),
+        copy_end = std::min(begin + fft_length, signal_length);
+    block.SetZero();
+    if (copy_end > copy_begin)
+      block.Range(copy_begin - begin, copy_end - copy_begin).CopyFromVec(
+          signal->Range(copy_begin, copy_end - copy_begin));
+    srfft_.Compute(block.Data(), true, &temp_buffer);
+
+    sum.SetZero();
+    for (int32 p = 0; p < num_partitions && p <= k; p++)
+      AddElementwiseProductOfFft(spectra_.RowData(p),
+                                 history.RowData((k - p) % history.NumRows()),
+                                 fft_length, sum.Data());
+    srfft_.Compute(sum.Data(), false, &temp_buffer);
+
+    // The second half of the circular convolution is the linear convolution
+    // for output samples [k * block_length_, (k+1) * block_length_).
+    int32 offset = k * block_length_,
+        length = std::min(block_length_, output_length - offset);
+    output.Range(offset, length).CopyFromVec(sum.Range(block_length_, length));
+  }
+  output.Scale(1.0 / fft_length);
+  signal->Swap(&output);
 }
 
+}  // namespace kaldi
@@ -53,6 +53,45 @@ void FFTbasedConvolveSignals(const Vector<BaseFloat> &filter, Vector<BaseFloat>
 */
 void FFTbasedBlockConvolveSignals(const Vector<BaseFloat> &filter, Vector<BaseFloat> *signal);
 
+/*
+   PartitionedFilter stores the spectrum of a finite impulse response filter
+   (e.g. a room impulse response) for uniformly partitioned overlap-save
+   convolution.  The filter is split into partitions of block_length samples,
+   and the FFT of each (zero-padded to 2 * block_length) is computed once, in
+   the constructor; this object can then be used to convolve any number of
+   signals, so when the same filter is applied to many signals its FFT is not
+   recomputed.  Each block of block_length output samples costs one forward and
+   one inverse FFT of size 2 * block_length, plus one complex multiply-add
+   per partition and frequency bin.
+
+   Convolve() is const and may be called from several threads at once.
+*/
+class PartitionedFilter {
+ public:
+  /// 'block_length' is the partition size and must be a power of two; if
+  /// <= 0 it is chosen from the filter length to minimize the time per output
+  /// sample.
+  explicit PartitionedFilter(const VectorBase<BaseFloat> &filter,
+                             int32 block_length = 0);
+
+  int32 FilterLength() const { return filter_length_; }
+  int32 BlockLength() const { return block_length_; }
+  int32 NumPartitions() const { return spectra_.NumRows(); }
+
+  /// Convolves 'signal' with the filter.  As with the functions above, the
+  /// length of the signal will be extended to (original signal length +
+  /// filter length - 1).
+  void Convolve(Vector<BaseFloat> *signal) const;
+
+ private:
+  int32 filter_length_;
+  int32 block_length_;
+  SplitRadixRealFft<BaseFloat> srfft_;  // of size 2 * block_length_.
+  // Row p is the FFT of samples [p * block_length_, (p+1) * block_length_)
+  // of the filter, zero-padded to 2 * block_length_.
+  Matrix<BaseFloat> spectra_;
+};
+
 }  // namespace kaldi
 
 #endif  // KALDI_FEAT_SIGNAL_H_
@@ -0,0 +1,95 @@
+// feat/wave-augment-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/wave-augment.h"
+
+namespace kaldi {
+
+void UnitTestWaveAugmenter() {
+  WaveAugmentOptions opts;
+  opts.speeds = "0.9,1.0,1.1";
+  opts.snrs = "10";
+  opts.min_volume = 0.5;
+  opts.reverberant_target = (Rand() % 2 == 0);
+  WaveAugmenter augmenter(opts, 16000);
+  for (int32 i = 0; i < 3; i++) {
+    Vector<BaseFloat> rir(500 + Rand() % 1000);
+    rir.SetRandn();
+    rir(10) = 100.0;  // the direct path.
+    rir.Scale(0.01);
+    augmenter.AddRir(rir);
+    Vector<BaseFloat> noise(1000 + Rand() % 10000);
+    noise.SetRandn();
+    augmenter.AddNoise(noise);
+  }
+
+  for (int32 i = 0; i < 10; i++) {
+    Vector<BaseFloat> input(8000 + Rand() % 8000);
+    input.SetRandn();
+    input.Scale(1000.0);
+    int32 seed = Rand();
+    Vector<BaseFloat> noisy, clean, noise, noisy2, clean2, noise2;
+    std::string description;
+    augmenter.Augment(input, seed, &noisy, &clean, &noise, &description);
+    KALDI_LOG << "Augmentation was: " << description;
+    // The same seed gives the same output.
+    augmenter.Augment(input, seed, &noisy2, &clean2, &noise2);
+    AssertEqual(noisy, noisy2, 0.0);
+    AssertEqual(clean, clean2, 0.0);
+
+    KALDI_ASSERT(noisy.Dim() == clean.Dim() && noisy.Dim() == noise.Dim());
+    KALDI_ASSERT(std::abs(noisy.Dim() - input.Dim()) <= input.Dim() / 9 + 1);
+    Vector<BaseFloat> sum(clean);
+    sum.AddVec(1.0, noise);
+    AssertEqual(sum, noisy);
+  }
+
+  // With no reverberation, the SNR is exactly as specified.
+  WaveAugmenter augmenter2(opts, 16000);
+  Vector<BaseFloat> noise(3000);
+  noise.SetRandn();
+  augmenter2.AddNoise(noise);
+  Vector<BaseFloat> input(10000), noisy, clean, noise_out;
+  input.SetRandn();
+  augmenter2.Augment(input, Rand(), &noisy, &clean, &noise_out);
+  AssertEqual(VecVec(clean, clean), 10.0 * VecVec(noise_out, noise_out),
+              1.0e-03);
+}
+
+void UnitTestComputeIrm() {
+  Matrix<BaseFloat> clean_lps(10, 20), noise_lps(10, 20), irm;
+  clean_lps.SetRandn();
+  noise_lps.SetRandn();
+  ComputeIrm(clean_lps, noise_lps, &irm);
+  for (int32 r = 0; r < irm.NumRows(); r++) {
+    for (int32 c = 0; c < irm.NumCols(); c++) {
+      BaseFloat s = Exp(clean_lps(r, c)), n = Exp(noise_lps(r, c));
+      AssertEqual(irm(r, c), std::sqrt(s / (s + n)), 1.0e-04);
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestWaveAugmenter();
+  UnitTestComputeIrm();
+  KALDI_LOG << "Tests succeeded.";
+}
@@ -0,0 +1,162 @@
+// feat/wave-augment.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "feat/wave-augment.h"
+#include "feat/resample.h"
+
+namespace kaldi {
+
+WaveAugmenter::Rir::Rir(const VectorBase<BaseFloat> &rir):
+    peak_index(0), filter(rir) {
+  rir.Max(&peak_index);
+}
+
+WaveAugmenter::WaveAugmenter(const WaveAugmentOptions &opts,
+                             BaseFloat samp_freq):
+    opts_(opts), samp_freq_(samp_freq) {
+  if (!SplitStringToFloats(opts.speeds, ",", true, &speeds_) ||
+      speeds_.empty())
+    KALDI_ERR << "Invalid --speeds option '" << opts.speeds << "'";
+  if (!SplitStringToFloats(opts.snrs, ",", true, &snrs_) || snrs_.empty())
+    KALDI_ERR << "Invalid --snrs option '" << opts.snrs << "'";
+  for (size_t i = 0; i < speeds_.size(); i++)
+    if (speeds_[i] <= 0.0)
+      KALDI_ERR << "Invalid speed " << speeds_[i];
+  KALDI_ASSERT(opts.min_volume > 0.0 && opts.max_volume >= opts.min_volume &&
+               opts.rir_prob >= 0.0 && opts.rir_prob <= 1.0 &&
+               opts.noise_prob >= 0.0 && opts.noise_prob <= 1.0);
+}
+
+WaveAugmenter::~WaveAugmenter() {
+  DeletePointers(&rirs_);
+  DeletePointers(&noises_);
+}
+
+void WaveAugmenter::AddRir(const VectorBase<BaseFloat> &rir) {
+  KALDI_ASSERT(rir.Dim() > 0);
+  rirs_.push_back(new Rir(rir));
+}
+
+void WaveAugmenter::AddNoise(const VectorBase<BaseFloat> &noise) {
+  KALDI_ASSERT(noise.Dim() > 0);
+  noises_.push_back(new Vector<BaseFloat>(noise));
+}
+
+void WaveAugmenter::ChangeSpeed(BaseFloat speed,
+                                Vector<BaseFloat> *signal) const {
+  // Changing the speed by a factor 'speed' is the same as treating the signal
+  // as if it had been sampled at samp_freq_ * speed, and resampling it to
+  // samp_freq_.
+  int32 samp_freq_out = static_cast<int32>(samp_freq_),
+      samp_freq_in = static_cast<int32>(samp_freq_ * speed + 0.5);
+  BaseFloat cutoff = 0.99 * 0.5 * std::min(samp_freq_in, samp_freq_out);
+  PolyphaseResample resampler(samp_freq_in, samp_freq_out, cutoff, 6);
+  Vector<BaseFloat> output;
+  resampler.Resample(*signal, true, &output);
+  signal->Swap(&output);
+}
+
+void WaveAugmenter::Augment(const VectorBase<BaseFloat> &input,
+                            int32 seed,
+                            Vector<BaseFloat> *noisy,
+                            Vector<BaseFloat> *clean,
+                            Vector<BaseFloat> *noise,
+                            std::string *description) const {
+  RandomState rand_state;
+  rand_state.seed = seed;
+  std::ostringstream os;
+
+  Vector<BaseFloat> speech(input);
+  BaseFloat speed = speeds_[RandInt(0, speeds_.size() - 1, &rand_state)];
+  if (speed != 1.0)
+    ChangeSpeed(speed, &speech);
+  os << "speed=" << speed;
+  int32 num_samp = speech.Dim();
+
+  // 'noisy' starts off as the (possibly reverberant) speech.
+  noisy->Resize(num_samp, kUndefined);
+  if (!rirs_.empty() && WithProb(opts_.rir_prob, &rand_state)) {
+    int32 r = RandInt(0, rirs_.size() - 1, &rand_state);
+    const Rir &rir = *(rirs_[r]);
+    Vector<BaseFloat> reverberant(speech);
+    rir.filter.Convolve(&reverberant);
+    // Shift by the position of the peak of the RIR (the direct path), so the
+    // reverberant speech is aligned with the dry speech.
+    noisy->CopyFromVec(reverberant.Range(rir.peak_index, num_samp));
+    os << " rir=" << r;
+  } else {
+    noisy->CopyFromVec(speech);
+  }
+  if (opts_.reverberant_target)
+    *clean = *noisy;
+  else
+    clean->Swap(&speech);
+
+  if (!noises_.empty() && WithProb(opts_.noise_prob, &rand_state)) {
+    int32 n = RandInt(0, noises_.size() - 1, &rand_state);
+    const Vector<BaseFloat> &this_noise = *(noises_[n]);
+    BaseFloat snr_db = snrs_[RandInt(0, snrs_.size() - 1, &rand_state)];
+    // Take the noise starting at a random offset, repeating it if necessary.
+    Vector<BaseFloat> noise_part(num_samp, kUndefined);
+    int32 offset = RandInt(0, this_noise.Dim() - 1, &rand_state);
+    for (int32 i = 0; i < num_samp; ) {
+      int32 length = std::min(num_samp - i, this_noise.Dim() - offset);
+      noise_part.Range(i, length).CopyFromVec(this_noise.Range(offset, length));
+      i += length;
+      offset = 0;
+    }
+    // Scale the noise to get the SNR relative to the (possibly reverberant)
+    // speech.
+    BaseFloat speech_power = VecVec(*noisy, *noisy),
+        noise_power = VecVec(noise_part, noise_part);
+    if (noise_power > 0.0)
+      noisy->AddVec(sqrt(pow(10.0, -snr_db / 10.0) * speech_power /
+                         noise_power), noise_part);
+    os << " noise=" << n << " snr=" << snr_db;
+  }
+
+  BaseFloat volume = opts_.min_volume + (opts_.max_volume - opts_.min_volume) *
+      RandUniform(&rand_state);
+  if (volume != 1.0) {
+    noisy->Scale(volume);
+    clean->Scale(volume);
+    os << " volume=" << volume;
+  }
+
+  *noise = *noisy;
+  noise->AddVec(-1.0, *clean);
+  if (description != NULL)
+    *description = os.str();
+}
+
+void ComputeIrm(const MatrixBase<BaseFloat> &clean_lps,
+                const MatrixBase<BaseFloat> &noise_lps,
+                Matrix<BaseFloat> *irm) {
+  KALDI_ASSERT(SameDim(clean_lps, noise_lps));
+  // sqrt(S / (S + N)) = 1 / sqrt(1 + exp(log N - log S)).
+  irm->Resize(noise_lps.NumRows(), noise_lps.NumCols(), kUndefined);
+  irm->CopyFromMat(noise_lps);
+  irm->AddMat(-1.0, clean_lps);
+  irm->ApplyExp();
+  irm->Add(1.0);
+  irm->ApplyPow(0.5);
+  irm->InvertElements();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,142 @@
+// feat/wave-augment.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_WAVE_AUGMENT_H_
+#define KALDI_FEAT_WAVE_AUGMENT_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/signal.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+
+struct WaveAugmentOptions {
+  std::string speeds;
+  std::string snrs;
+  BaseFloat min_volume;
+  BaseFloat max_volume;
+  BaseFloat rir_prob;
+  BaseFloat noise_prob;
+  bool reverberant_target;
+
+  WaveAugmentOptions(): speeds("1.0"), snrs("20,15,10,5,0"),
+                        min_volume(1.0), max_volume(1.0), rir_prob(1.0),
+                        noise_prob(1.0), reverberant_target(false) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("speeds", &speeds, "Comma-separated list of speed "
+                   "perturbation factors, one of which is chosen at random "
+                   "for each utterance, e.g. '0.9,1.0,1.1'.");
+    opts->Register("snrs", &snrs, "Comma-separated list of signal-to-noise "
+                   "ratios (dB), one of which is chosen at random for each "
+                   "utterance.");
+    opts->Register("min-volume", &min_volume, "Minimum of the random volume "
+                   "scale applied to the whole output.");
+    opts->Register("max-volume", &max_volume, "Maximum of the random volume "
+                   "scale applied to the whole output.");
+    opts->Register("rir-prob", &rir_prob, "Probability of reverberating an "
+                   "utterance (if there are impulse responses).");
+    opts->Register("noise-prob", &noise_prob, "Probability of adding noise to "
+                   "an utterance (if there are noises).");
+    opts->Register("reverberant-target", &reverberant_target, "If true, the "
+                   "clean target is the reverberant speech; if false it is "
+                   "the dry speech, aligned with the reverberant speech, so "
+                   "the reverberation counts as part of the noise.");
+  }
+};
+
+
+/**
+   WaveAugmenter corrupts clean speech for training speech-enhancement and
+   robust models: it applies speed perturbation, convolution with a room
+   impulse response (RIR), additive noise at a signal-to-noise ratio and a
+   volume change, each chosen at random.  Along with the corrupted ("noisy")
+   signal it gives the matching clean target and the noise (the noisy signal
+   minus the clean target), all of the same length as the speed-perturbed
+   input.
+
+   The random choices for an utterance depend only on the seed given to
+   Augment(), so the output is reproducible and does not depend on the order
+   or the thread in which utterances are processed.  The RIRs and noises are
+   held in memory.
+*/
+class WaveAugmenter {
+ public:
+  WaveAugmenter(const WaveAugmentOptions &opts, BaseFloat samp_freq);
+
+  /// Adds a room impulse response, with samples scaled so the peak is
+  /// of the order of 1.
+  void AddRir(const VectorBase<BaseFloat> &rir);
+
+  /// Adds a noise signal.  If it is shorter than an utterance it is repeated.
+  void AddNoise(const VectorBase<BaseFloat> &noise);
+
+  int32 NumRirs() const { return rirs_.size(); }
+  int32 NumNoises() const { return noises_.size(); }
+
+  /// Augments 'input' (at the sampling frequency given to the constructor),
+  /// with the random choices made by a generator seeded with 'seed'.  If
+  /// 'description' is non-NULL, a summary of the choices is written to it.
+  /// This function is const and may be called from several threads at once.
+  void Augment(const VectorBase<BaseFloat> &input,
+               int32 seed,
+               Vector<BaseFloat> *noisy,
+               Vector<BaseFloat> *clean,
+               Vector<BaseFloat> *noise,
+               std::string *description = NULL) const;
+
+  ~WaveAugmenter();
+
+ private:
+  // Changes the speed of 'signal' by the factor 'speed' by resampling.
+  void ChangeSpeed(BaseFloat speed, Vector<BaseFloat> *signal) const;
+
+  WaveAugmentOptions opts_;
+  BaseFloat samp_freq_;
+  std::vector<BaseFloat> speeds_;
+  std::vector<BaseFloat> snrs_;
+
+  struct Rir {
+    int32 peak_index;
+    PartitionedFilter filter;
+    explicit Rir(const VectorBase<BaseFloat> &rir);
+  };
+  std::vector<Rir*> rirs_;
+  std::vector<Vector<BaseFloat>* > noises_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveAugmenter);
+};
+
+
+/// Computes the ideal ratio mask sqrt(S / (S + N)) from the log-power spectra
+/// of the clean speech S and the noise N, as compute-irm-feats does.
+void ComputeIrm(const MatrixBase<BaseFloat> &clean_lps,
+                const MatrixBase<BaseFloat> &noise_lps,
+                Matrix<BaseFloat> *irm);
+
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+
+#endif  // KALDI_FEAT_WAVE_AUGMENT_H_
@@ -0,0 +1,317 @@
+// featbin/compute-augmented-feats.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "util/kaldi-thread.h"
+#include "feat/feature-fbank.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-lps.h"
+#include "feat/wave-augment.h"
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+
+// Computes the input features for the network, of a type chosen at run time.
+class InputFeatureComputer {
+ public:
+  InputFeatureComputer(const std::string &type, const std::string &config):
+      fbank_(NULL), mfcc_(NULL), lps_(NULL) {
+    if (type == "fbank") {
+      FbankOptions opts;
+      if (config != "") ReadConfigFromFile(config, &opts);
+      fbank_ = new Fbank(opts);
+      frame_opts_ = opts.frame_opts;
+    } else if (type == "mfcc") {
+      MfccOptions opts;
+      if (config != "") ReadConfigFromFile(config, &opts);
+      mfcc_ = new Mfcc(opts);
+      frame_opts_ = opts.frame_opts;
+    } else if (type == "lps") {
+      LpsOptions opts;
+      if (config != "") ReadConfigFromFile(config, &opts);
+      lps_ = new Lps(opts);
+      frame_opts_ = opts.frame_opts;
+    } else {
+      KALDI_ERR << "Invalid --feat-type '" << type
+                << "', expected fbank, mfcc or lps.";
+    }
+  }
+
+  const FrameExtractionOptions &FrameOptions() const { return frame_opts_; }
+
+  // May be called from several threads at once.
+  void Compute(const VectorBase<BaseFloat> &wave,
+               Matrix<BaseFloat> *feats) const {
+    if (fbank_ != NULL) fbank_->Compute(wave, 1.0, feats);
+    else if (mfcc_ != NULL) mfcc_->Compute(wave, 1.0, feats);
+    else lps_->Compute(wave, 1.0, feats);
+  }
+
+  ~InputFeatureComputer() {
+    delete fbank_;
+    delete mfcc_;
+    delete lps_;
+  }
+ private:
+  // These are pointers to const so that Compute() calls the const Compute()
+  // of the feature classes, which works on a copy of the object and is
+  // therefore safe to call from several threads.
+  const Fbank *fbank_;
+  const Mfcc *mfcc_;
+  const Lps *lps_;
+  FrameExtractionOptions frame_opts_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(InputFeatureComputer);
+};
+
+// This class is used to parallelize the augmentation and feature extraction
+// over multiple threads.  The work happens in the operator (), the output
+// happens in the destructor.  Writers that are NULL are not used.
+class AugmentTask {
+ public:
+  AugmentTask(const WaveAugmenter &augmenter,
+              const InputFeatureComputer &feature_computer,
+              const Lps &lps,
+              const std::string &utt, const VectorBase<BaseFloat> &wave,
+              int32 seed,
+              BaseFloatMatrixWriter *noisy_writer,
+              BaseFloatMatrixWriter *clean_writer,
+              BaseFloatMatrixWriter *noise_writer,
+              BaseFloatMatrixWriter *irm_writer):
+      augmenter_(augmenter), feature_computer_(feature_computer), lps_(lps),
+      utt_(utt), wave_(wave), seed_(seed), noisy_writer_(noisy_writer),
+      clean_writer_(clean_writer), noise_writer_(noise_writer),
+      irm_writer_(irm_writer) { }
+
+  void operator () () {
+    Vector<BaseFloat> noisy, clean, noise;
+    augmenter_.Augment(wave_, seed_, &noisy, &clean, &noise, &description_);
+    feature_computer_.Compute(noisy, &noisy_feats_);
+    if (clean_writer_ != NULL || irm_writer_ != NULL)
+      lps_.Compute(clean, 1.0, &clean_lps_);
+    if (noise_writer_ != NULL || irm_writer_ != NULL)
+      lps_.Compute(noise, 1.0, &noise_lps_);
+    if (irm_writer_ != NULL)
+      ComputeIrm(clean_lps_, noise_lps_, &irm_);
+  }
+
+  ~AugmentTask() {
+    KALDI_VLOG(2) << "Augmentation for " << utt_ << " was: " << description_;
+    noisy_writer_->Write(utt_, noisy_feats_);
+    if (clean_writer_ != NULL)
+      clean_writer_->Write(utt_, clean_lps_);
+    if (noise_writer_ != NULL)
+      noise_writer_->Write(utt_, noise_lps_);
+    if (irm_writer_ != NULL)
+      irm_writer_->Write(utt_, irm_);
+  }
+ private:
+  const WaveAugmenter &augmenter_;
+  const InputFeatureComputer &feature_computer_;
+  const Lps &lps_;
+  std::string utt_;
+  Vector<BaseFloat> wave_;
+  int32 seed_;
+  BaseFloatMatrixWriter *noisy_writer_;
+  BaseFloatMatrixWriter *clean_writer_;
+  BaseFloatMatrixWriter *noise_writer_;
+  BaseFloatMatrixWriter *irm_writer_;
+  std::string description_;
+  Matrix<BaseFloat> noisy_feats_;
+  Matrix<BaseFloat> clean_lps_;
+  Matrix<BaseFloat> noise_lps_;
+  Matrix<BaseFloat> irm_;
+};
+
+// Reads channel 'channel' of each wave file in 'rspecifier' into 'augmenter',
+// as impulse responses if 'is_rir' is true and as noises otherwise.
+void ReadAugmentationSignals(const std::string &rspecifier, bool is_rir,
+                             int32 channel, BaseFloat samp_freq,
+                             WaveAugmenter *augmenter) {
+  SequentialTableReader<WaveHolder> reader(rspecifier);
+  for (; !reader.Done(); reader.Next()) {
+    const WaveData &wave = reader.Value();
+    if (wave.SampFreq() != samp_freq || channel >= wave.Data().NumRows()) {
+      KALDI_WARN << "Not using " << (is_rir ? "impulse response " : "noise ")
+                 << reader.Key() << ": sampling frequency is "
+                 << wave.SampFreq() << " and it has "
+                 << wave.Data().NumRows() << " channels.";
+      continue;
+    }
+    Vector<BaseFloat> signal(wave.Data().Row(channel));
+    if (is_rir) {
+      signal.Scale(1.0 / (1 << 15));  // as in wav-reverberate.
+      augmenter->AddRir(signal);
+    } else {
+      augmenter->AddNoise(signal);
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Corrupts clean speech on the fly (speed perturbation, reverberation,\n"
+        "additive noise and volume perturbation, see WaveAugmenter) and\n"
+        "computes features of the corrupted speech together with targets\n"
+        "for speech enhancement: the log-power spectra (LPS) of the clean\n"
+        "speech and of the noise, and the ideal ratio mask (IRM), as\n"
+        "compute-lps-feats, compute-noise-feats and compute-irm-feats would.\n"
+        "No intermediate wave files are written.  The random choices for\n"
+        "each utterance depend only on --seed and the utterance id, so the\n"
+        "output does not depend on --num-threads (provided dithering is off).\n"
+        "The impulse responses and noises are held in memory.\n"
+        "\n"
+        "Usage:  compute-augmented-feats [options...] <wav-rspecifier> "
+        "<noisy-feats-wspecifier> [<clean-lps-wspecifier> "
+        "[<noise-lps-wspecifier> [<irm-wspecifier>]]]\n"
+        "e.g.\n"
+        "compute-augmented-feats --num-threads=8 --rir-rspecifier=scp:rir.scp "
+        "--noise-rspecifier=scp:noise.scp --snrs=20,10,5,0 --speeds=0.9,1.0,1.1 "
+        "--feat-type=fbank --feat-config=conf/fbank.conf "
+        "--lps-config=conf/lps.conf scp:wav.scp ark:noisy_fbank.ark "
+        "ark:clean_lps.ark ark:noise_lps.ark ark:irm.ark\n"
+        "Use an empty string to skip an output, e.g. \"\" for the noise LPS.\n";
+
+    ParseOptions po(usage);
+    WaveAugmentOptions augment_opts;
+    TaskSequencerConfig sequencer_config;
+    std::string rir_rspecifier, noise_rspecifier, feat_type = "lps",
+        feat_config, lps_config;
+    int32 channel = -1, rir_channel = 0, noise_channel = 0, seed = 0;
+    augment_opts.Register(&po);
+    sequencer_config.Register(&po);
+    po.Register("rir-rspecifier", &rir_rspecifier, "Table of room impulse "
+                "responses (wave files); if empty, no reverberation.");
+    po.Register("noise-rspecifier", &noise_rspecifier, "Table of noises "
+                "(wave files); if empty, no additive noise.");
+    po.Register("feat-type", &feat_type, "Type of the features of the noisy "
+                "speech: fbank, mfcc or lps.");
+    po.Register("feat-config", &feat_config, "Configuration file for the "
+                "features of the noisy speech.");
+    po.Register("lps-config", &lps_config, "Configuration file for the LPS "
+                "of the clean speech and the noise (for the targets).");
+    po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, "
+                "0 -> left, 1 -> right)");
+    po.Register("rir-channel", &rir_channel, "Channel of the impulse "
+                "responses to use.");
+    po.Register("noise-channel", &noise_channel, "Channel of the noises to "
+                "use.");
+    po.Register("seed", &seed, "Seed for the random choices; each utterance "
+                "uses this combined with its id.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 2 || po.NumArgs() > 5) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string wav_rspecifier = po.GetArg(1),
+        noisy_wspecifier = po.GetArg(2),
+        clean_wspecifier = po.GetOptArg(3),
+        noise_wspecifier = po.GetOptArg(4),
+        irm_wspecifier = po.GetOptArg(5);
+
+    InputFeatureComputer feature_computer(feat_type, feat_config);
+    LpsOptions lps_opts;
+    if (lps_config != "")
+      ReadConfigFromFile(lps_config, &lps_opts);
+    Lps lps(lps_opts);
+    BaseFloat samp_freq = lps_opts.frame_opts.samp_freq;
+    if (feature_computer.FrameOptions().samp_freq != samp_freq)
+      KALDI_ERR << "The sampling frequencies in --feat-config and "
+                << "--lps-config differ.";
+    if (feature_computer.FrameOptions().dither != 0.0 ||
+        lps_opts.frame_opts.dither != 0.0)
+      KALDI_WARN << "Dithering is on, so the output will not be exactly "
+                 << "reproducible.";
+
+    WaveAugmenter augmenter(augment_opts, samp_freq);
+    if (rir_rspecifier != "")
+      ReadAugmentationSignals(rir_rspecifier, true, rir_channel, samp_freq,
+                              &augmenter);
+    if (noise_rspecifier != "")
+      ReadAugmentationSignals(noise_rspecifier, false, noise_channel,
+                              samp_freq, &augmenter);
+    KALDI_LOG << "Read " << augmenter.NumRirs() << " impulse responses and "
+              << augmenter.NumNoises() << " noises.";
+
+    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    BaseFloatMatrixWriter noisy_writer(noisy_wspecifier);
+    BaseFloatMatrixWriter *clean_writer = (clean_wspecifier != "" ?
+        new BaseFloatMatrixWriter(clean_wspecifier) : NULL),
+        *noise_writer = (noise_wspecifier != "" ?
+        new BaseFloatMatrixWriter(noise_wspecifier) : NULL),
+        *irm_writer = (irm_wspecifier != "" ?
+        new BaseFloatMatrixWriter(irm_wspecifier) : NULL);
+
+    int32 num_utts = 0, num_success = 0;
+    {
+      TaskSequencer<AugmentTask> sequencer(sequencer_config);
+      StringHasher hasher;
+      for (; !reader.Done(); reader.Next()) {
+        num_utts++;
+        std::string utt = reader.Key();
+        const WaveData &wave_data = reader.Value();
+        if (wave_data.SampFreq() != samp_freq) {
+          KALDI_WARN << "Sampling frequency of " << utt << " is "
+                     << wave_data.SampFreq() << ", expected " << samp_freq;
+          continue;
+        }
+        int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+        {  // This block works out the channel (0=left, 1=right...)
+          KALDI_ASSERT(num_chan > 0);  // should have been caught in
+          // reading code if no channels.
+          if (channel == -1) {
+            this_chan = 0;
+            if (num_chan != 1)
+              KALDI_WARN << "Channel not specified but you have data with "
+                         << num_chan  << " channels; defaulting to zero";
+          } else {
+            if (this_chan >= num_chan) {
+              KALDI_WARN << "File with id " << utt << " has "
+                         << num_chan << " channels but you specified channel "
+                         << channel << ", producing no output.";
+              continue;
+            }
+          }
+        }
+        SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
+        int32 utt_seed = static_cast<int32>(hasher(utt) + seed);
+        sequencer.Run(new AugmentTask(augmenter, feature_computer, lps, utt,
+                                      waveform, utt_seed, &noisy_writer,
+                                      clean_writer, noise_writer, irm_writer));
+        num_success++;
+      }
+      // Destructor of "sequencer" will wait for any remaining tasks.
+    }
+    delete clean_writer;
+    delete noise_writer;
+    delete irm_writer;
+
+    KALDI_LOG << " Done " << num_success << " out of " << num_utts
+              << " utterances.";
+    return (num_success != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
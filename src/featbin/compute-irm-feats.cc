@@ -27,6 +27,11 @@ int main(int argc, char *argv[]) {
     po.Register("ibm", &ibm_out,"If 1, output IBM mask. If greater than 1, then mask with higher threshold.");
     po.Register("lps-floor",&lps_floor, "If flooring == \"custom\", mask is only non-zero if clean lps > lps_floor");
     po.Register("flooring", &flooring, "[none:raw irm|mean use global clean lps mean as lps_floor |custom see lps-floor]");
+    bool sorted = false;
+    po.Register("sorted", &sorted, "If true, both inputs must be sorted on "
+                "key, and keys missing from the second input are skipped; "
+                "otherwise the inputs are read in lockstep and must have the "
+                "same keys in the same order.");
 
     po.Read(argc, argv);
     if (po.NumArgs() != 3) {
@@ -39,25 +44,16 @@ int main(int argc, char *argv[]) {
     std::string wspecifier = po.GetArg(3);
 
     BaseFloatMatrixWriter feat_writer(wspecifier);
-    SequentialBaseFloatMatrixReader cln_reader(cspecifier);
-    SequentialBaseFloatMatrixReader nsy_reader(nspecifier);
     int32 num_no_key = 0, num_done=0;
-    for (; !cln_reader.Done() && ! nsy_reader.Done(); 
-            cln_reader.Next(),nsy_reader.Next()) {
-      std::string key = cln_reader.Key();
-      if(nsy_reader.Key() != key){
-        KALDI_WARN << "Missing key: " << key << " in noisy reader.";
-        num_no_key++;
-        continue;
-      }
-      Matrix<BaseFloat> cln = cln_reader.Value();
-      Matrix<BaseFloat> nsy = nsy_reader.Value();
+    // Computes the mask of one utterance and writes it.
+    auto compute_irm = [&](const std::string &key, Matrix<BaseFloat> cln,
+                           Matrix<BaseFloat> nsy) {
       KALDI_ASSERT(cln.NumRows() == nsy.NumRows());
       KALDI_ASSERT(cln.NumCols() == nsy.NumCols());
 
       if (cln.NumRows() == 0) {
         KALDI_WARN << "Empty feature matrix for key " << key;
-        continue;
+        return;
       }
       Matrix<BaseFloat> floor_mask;
       if (flooring == "mean" || flooring == "custom"){
@@ -86,6 +82,35 @@ int main(int argc, char *argv[]) {
       }
       feat_writer.Write(key, nsy);
       num_done++;
+    };
+
+    if (sorted) {
+      std::vector<std::string> rspecifiers;
+      rspecifiers.push_back(cspecifier);
+      rspecifiers.push_back(nspecifier);
+      SequentialBaseFloatMatrixJoinReader reader(rspecifiers);
+      for (; !reader.Done(); reader.Next()) {
+        std::string key = reader.Key();
+        if (!reader.HasKey(1)) {
+          KALDI_WARN << "Missing key: " << key << " in noisy reader.";
+          num_no_key++;
+          continue;
+        }
+        compute_irm(key, reader.Value(0), reader.Value(1));
+      }
+    } else {
+      SequentialBaseFloatMatrixReader cln_reader(cspecifier);
+      SequentialBaseFloatMatrixReader nsy_reader(nspecifier);
+      for (; !cln_reader.Done() && !nsy_reader.Done();
+           cln_reader.Next(), nsy_reader.Next()) {
+        std::string key = cln_reader.Key();
+        if (nsy_reader.Key() != key) {
+          KALDI_WARN << "Missing key: " << key << " in noisy reader.";
+          num_no_key++;
+          continue;
+        }
+        compute_irm(key, cln_reader.Value(), nsy_reader.Value());
+      }
     }
 
     KALDI_LOG << "Done calculating IRM for " << num_done << " files "
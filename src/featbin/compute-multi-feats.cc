@@ -0,0 +1,162 @@
+// featbin/compute-multi-feats.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/feature-multi.h"
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+
+// Adds a computer of type 'type' to 'computer', with options read from
+// 'config' (or the defaults if 'config' is empty).
+static void AddComputerOfType(const std::string &type,
+                              const std::string &config,
+                              MultiFeatureComputer *computer) {
+  if (type == "fbank") {
+    FbankOptions opts;
+    if (config != "") ReadConfigFromFile(config, &opts);
+    computer->AddComputer<FbankComputer>(opts);
+  } else if (type == "mfcc") {
+    MfccOptions opts;
+    if (config != "") ReadConfigFromFile(config, &opts);
+    computer->AddComputer<MfccComputer>(opts);
+  } else if (type == "lps") {
+    LpsOptions opts;
+    if (config != "") ReadConfigFromFile(config, &opts);
+    computer->AddComputer<LpsComputer>(opts);
+  } else if (type == "phs") {
+    PhsOptions opts;
+    if (config != "") ReadConfigFromFile(config, &opts);
+    computer->AddComputer<PhsComputer>(opts);
+  } else {
+    KALDI_ERR << "Unknown feature type '" << type
+              << "'; expected fbank, mfcc, lps or phs.";
+  }
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Compute several types of features from the same waveforms in one\n"
+        "pass.  Feature types with identical frame-extraction options share\n"
+        "the framing and the FFT of each frame.  Each output is specified as\n"
+        "<type>:<config-file>:<feats-wspecifier>, where <type> is one of\n"
+        "fbank, mfcc, lps or phs and an empty <config-file> means the default\n"
+        "options.  Note: outputs that share framing also share the dithering.\n"
+        "\n"
+        "Usage: compute-multi-feats [options...] <wav-rspecifier> "
+        "<type>:<config-file>:<feats-wspecifier> "
+        "[<type>:<config-file>:<feats-wspecifier> ...]\n"
+        "e.g.: compute-multi-feats scp:wav.scp fbank:conf/fbank.conf:ark:fbank.ark "
+        "lps:conf/lps.conf:ark:lps.ark\n";
+
+    ParseOptions po(usage);
+    int32 channel = -1;
+    BaseFloat min_duration = 0.0;
+    po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, "
+                "0 -> left, 1 -> right)");
+    po.Register("min-duration", &min_duration, "Minimum duration of segments "
+                "to process (in seconds).");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string wav_rspecifier = po.GetArg(1);
+
+    MultiFeatureComputer computer;
+    int32 num_outputs = po.NumArgs() - 1;
+    std::vector<BaseFloatMatrixWriter*> writers(num_outputs);
+    for (int32 i = 0; i < num_outputs; i++) {
+      std::string output = po.GetArg(i + 2);
+      // The wspecifier may itself contain ':', so only split on the first two.
+      size_t pos1 = output.find(':'),
+          pos2 = (pos1 == std::string::npos ? pos1 :
+                  output.find(':', pos1 + 1));
+      if (pos2 == std::string::npos)
+        KALDI_ERR << "Invalid output specification '" << output
+                  << "', expected <type>:<config-file>:<feats-wspecifier>";
+      AddComputerOfType(output.substr(0, pos1),
+                        output.substr(pos1 + 1, pos2 - pos1 - 1), &computer);
+      writers[i] = new BaseFloatMatrixWriter(output.substr(pos2 + 1));
+    }
+    KALDI_LOG << "Computing " << num_outputs << " feature types with "
+              << computer.NumFrameGroups() << " different framings.";
+
+    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+
+    int32 num_utts = 0, num_success = 0;
+    std::vector<Matrix<BaseFloat> > features;
+    for (; !reader.Done(); reader.Next()) {
+      num_utts++;
+      std::string utt = reader.Key();
+      const WaveData &wave_data = reader.Value();
+      if (wave_data.Duration() < min_duration) {
+        KALDI_WARN << "File: " << utt << " is too short ("
+                   << wave_data.Duration() << " sec): producing no output.";
+        continue;
+      }
+      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
+      {  // This block works out the channel (0=left, 1=right...)
+        KALDI_ASSERT(num_chan > 0);  // should have been caught in
+        // reading code if no channels.
+        if (channel == -1) {
+          this_chan = 0;
+          if (num_chan != 1)
+            KALDI_WARN << "Channel not specified but you have data with "
+                       << num_chan  << " channels; defaulting to zero";
+        } else {
+          if (this_chan >= num_chan) {
+            KALDI_WARN << "File with id " << utt << " has "
+                       << num_chan << " channels but you specified channel "
+                       << channel << ", producing no output.";
+            continue;
+          }
+        }
+      }
+
+      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
+      try {
+        computer.ComputeFeatures(waveform, wave_data.SampFreq(), &features);
+      } catch (...) {
+        KALDI_WARN << "Failed to compute features for utterance " << utt;
+        continue;
+      }
+      for (int32 i = 0; i < num_outputs; i++)
+        writers[i]->Write(utt, features[i]);
+      if (num_utts % 10 == 0)
+        KALDI_LOG << "Processed " << num_utts << " utterances";
+      KALDI_VLOG(2) << "Processed features for key " << utt;
+      num_success++;
+    }
+    for (int32 i = 0; i < num_outputs; i++)
+      delete writers[i];
+    KALDI_LOG << " Done " << num_success << " out of " << num_utts
+              << " utterances.";
+    return (num_success != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
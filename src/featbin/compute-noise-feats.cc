@@ -21,6 +21,11 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     float mask_floor = 1e-12;
     po.Register("mask-floor", &mask_floor,"To prevent 1/0 and log(0)");
+    bool sorted = false;
+    po.Register("sorted", &sorted, "If true, both inputs must be sorted on "
+                "key, and keys missing from the second input are skipped; "
+                "otherwise the inputs are read in lockstep and must have the "
+                "same keys in the same order.");
 
     po.Read(argc, argv);
     if (po.NumArgs() != 3) {
@@ -33,25 +38,16 @@ int main(int argc, char *argv[]) {
     std::string wspecifier = po.GetArg(3);
 
     BaseFloatMatrixWriter feat_writer(wspecifier);
-    SequentialBaseFloatMatrixReader cln_reader(cspecifier);
-    SequentialBaseFloatMatrixReader mask_reader(mspecifier);
     int32 num_no_key = 0, num_done=0;
-    for (; !cln_reader.Done() && ! mask_reader.Done(); 
-            cln_reader.Next(),mask_reader.Next()) {
-      std::string key = cln_reader.Key();
-      if(mask_reader.Key() != key){
-        KALDI_WARN << "Missing key: " << key << " in mask reader.";
-        num_no_key++;
-        continue;
-      }
-      Matrix<BaseFloat> cln = cln_reader.Value();
-      Matrix<BaseFloat> msk = mask_reader.Value();
+    // Computes the noise of one utterance and writes it.
+    auto compute_noise = [&](const std::string &key, Matrix<BaseFloat> cln,
+                             Matrix<BaseFloat> msk) {
       KALDI_ASSERT(cln.NumRows() == msk.NumRows());
       KALDI_ASSERT(cln.NumCols() == msk.NumCols());
 
       if (cln.NumRows() == 0) {
         KALDI_WARN << "Empty feature matrix for key " << key;
-        continue;
+        return;
       }
       KALDI_ASSERT(msk.Min()>0 && msk.Max()<=1);
       msk.ApplyFloor(mask_floor);
@@ -65,6 +61,35 @@ int main(int argc, char *argv[]) {
       KALDI_ASSERT(KALDI_ISFINITE(msk.Sum()));
       feat_writer.Write(key, msk);
       num_done++;
+    };
+
+    if (sorted) {
+      std::vector<std::string> rspecifiers;
+      rspecifiers.push_back(cspecifier);
+      rspecifiers.push_back(mspecifier);
+      SequentialBaseFloatMatrixJoinReader reader(rspecifiers);
+      for (; !reader.Done(); reader.Next()) {
+        std::string key = reader.Key();
+        if (!reader.HasKey(1)) {
+          KALDI_WARN << "Missing key: " << key << " in mask reader.";
+          num_no_key++;
+          continue;
+        }
+        compute_noise(key, reader.Value(0), reader.Value(1));
+      }
+    } else {
+      SequentialBaseFloatMatrixReader cln_reader(cspecifier);
+      SequentialBaseFloatMatrixReader mask_reader(mspecifier);
+      for (; !cln_reader.Done() && !mask_reader.Done();
+           cln_reader.Next(), mask_reader.Next()) {
+        std::string key = cln_reader.Key();
+        if (mask_reader.Key() != key) {
+          KALDI_WARN << "Missing key: " << key << " in mask reader.";
+          num_no_key++;
+          continue;
+        }
+        compute_noise(key, cln_reader.Value(), mask_reader.Value());
+      }
     }
 
     KALDI_LOG << "Done calculating noise feats for " << num_done << " files "
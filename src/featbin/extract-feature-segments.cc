@@ -21,6 +21,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/feature-store.h"
 #include "feat/feature-mfcc.h"
 #include "matrix/kaldi-matrix.h"
 
@@ -41,6 +42,8 @@ int main(int argc, char *argv[]) {
         "'ranges' in scp files are supported; search for 'ranges' in\n"
         "http://kaldi-asr.org/doc/io_tut.html, or see the script\n"
         "utils/data/subsegment_data_dir.sh.\n"
+        "With a feature store as input (fstore:), only the frames of the\n"
+        "segments are read.\n"
         "Usage:  "
         "extract-feature-segments [options...] <feats-rspecifier> "
         " <segments-file> <feats-wspecifier>\n"
@@ -89,7 +92,19 @@ int main(int argc, char *argv[]) {
 
     BaseFloatMatrixWriter feat_writer(wspecifier);
 
-    RandomAccessBaseFloatMatrixReader feat_reader(rspecifier);
+    // From a feature store we read just the frames of each segment (the
+    // utterance lengths are in its index), otherwise the whole utterances,
+    std::string store_index;
+    bool from_store = (ClassifyRspecifier(rspecifier, &store_index, NULL) ==
+                       kFeatureStoreRspecifier);
+    FeatureStoreReader store_reader;
+    RandomAccessBaseFloatMatrixReader feat_reader;
+    if (from_store) {
+      if (!store_reader.Open(store_index))
+        KALDI_ERR << "Error opening feature store " << rspecifier;
+    } else {
+      feat_reader.Open(rspecifier);
+    }
 
     Input ki(segments_rxfilename);  // no binary argment: never binary.
 
@@ -151,16 +166,20 @@ int main(int argc, char *argv[]) {
       /* check whether a segment start time and end time exists in utterance
        * if fails , skips the segment.
        */
-      if (!feat_reader.HasKey(utterance)) {
+      if (from_store ? !store_reader.HasKey(utterance) :
+          !feat_reader.HasKey(utterance)) {
         KALDI_WARN << "Did not find features for utterance " << utterance
                    << ", skipping segment " << segment;
         continue;
       }
-      const Matrix<BaseFloat> &feats = feat_reader.Value(utterance);
+      const Matrix<BaseFloat> *feats = NULL;
+      if (!from_store) feats = &feat_reader.Value(utterance);
       // total number of samples present in wav data
-      int32 num_samp = feats.NumRows();
+      int32 num_samp = (from_store ? store_reader.NumFrames(utterance) :
+                        feats->NumRows());
       // total number of channels present in wav file
-      int32 num_chan = feats.NumCols();
+      int32 num_chan = (from_store ? store_reader.Dim(utterance) :
+                        feats->NumCols());
       // Convert start & end times of the segment to corresponding sample number
       int32 start_samp = static_cast<int32>(round(
           (start * 1000.0 / frame_shift)));
@@ -208,9 +227,12 @@ int main(int argc, char *argv[]) {
         continue;
       }
 
-      SubMatrix<BaseFloat> segment_matrix(feats, start_samp,
-          end_samp-start_samp, 0, num_chan);
-      Matrix<BaseFloat> outmatrix(segment_matrix);
+      Matrix<BaseFloat> outmatrix;
+      if (from_store) {
+        store_reader.ReadFrames(utterance, start_samp, end_samp, &outmatrix);
+      } else {
+        outmatrix = feats->RowRange(start_samp, end_samp - start_samp);
+      }
       // write segment in feature archive.
       feat_writer.Write(segment, outmatrix);
       num_success++;
@@ -23,49 +23,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
-
-namespace kaldi {
-
-// returns true if successfully appended.
-bool AppendFeats(const std::vector<Matrix<BaseFloat> > &in,
-                 std::string utt,
-                 int32 tolerance,
-                 Matrix<BaseFloat> *out) {
-  // Check the lengths
-  int32 min_len = in[0].NumRows(),
-      max_len = in[0].NumRows(),
-      tot_dim = in[0].NumCols();
-  for (int32 i = 1; i < in.size(); i++) {
-    int32 len = in[i].NumRows(), dim = in[i].NumCols();
-    tot_dim += dim;
-    if(len < min_len) min_len = len;
-    if(len > max_len) max_len = len;
-  }
-  if (max_len - min_len > tolerance || min_len == 0) {
-    KALDI_WARN << "Length mismatch " << max_len << " vs. " << min_len
-               << (utt.empty() ? "" : " for utt ") << utt
-               << " exceeds tolerance " << tolerance;
-    out->Resize(0, 0);
-    return false;
-  }
-  if (max_len - min_len > 0) {
-    KALDI_VLOG(2) << "Length mismatch " << max_len << " vs. " << min_len
-                  << (utt.empty() ? "" : " for utt ") << utt 
-                  << " within tolerance " << tolerance;
-  }
-  out->Resize(min_len, tot_dim);
-  int32 dim_offset = 0;
-  for (int32 i = 0; i < in.size(); i++) {
-    int32 this_dim = in[i].NumCols();
-    out->Range(0, min_len, dim_offset, this_dim).CopyFromMat(
-        in[i].Range(0, min_len, 0, this_dim));
-    dim_offset += this_dim;
-  }
-  return true;
-}
-
-
-}
+#include "feat/feature-functions.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -84,10 +42,14 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
 
     int32 length_tolerance = 0;
-    bool binary = true;
+    bool binary = true, sorted = false;
     po.Register("length-tolerance", &length_tolerance,
                 "If length is different, trim as shortest up to a frame "
                 " difference of length-tolerance, otherwise exclude segment.");
+    po.Register("sorted", &sorted, "If true, all the inputs must be sorted on "
+                "key, and utterances missing from some input are skipped; "
+                "otherwise the inputs are stepped in lockstep and must have "
+                "the same keys in the same order.");
     po.Register("binary", &binary, "If true, output files in binary "
                 "(only relevant for single-file operation, i.e. no tables)");
     
@@ -106,6 +68,18 @@ int main(int argc, char *argv[]) {
       string wspecifier = po.GetArg(po.NumArgs());
       BaseFloatMatrixWriter feat_writer(wspecifier);
     
+      if (sorted) {
+        std::vector<std::string> rspecifiers;
+        for (int32 i = 1; i < po.NumArgs(); i++)
+          rspecifiers.push_back(po.GetArg(i));
+        int32 num_done = 0, num_err = 0;
+        PasteSortedFeatTables(rspecifiers, length_tolerance, &feat_writer,
+                              &num_done, &num_err);
+        KALDI_LOG << "Done " << num_done << " utts, errors on "
+                  << num_err;
+        return (num_done == 0 ? -1 : 0);
+      }
+
       // First input is sequential
       string rspecifier1 = po.GetArg(1);
       SequentialBaseFloatMatrixReader input1(rspecifier1);
@@ -142,7 +116,7 @@ int main(int argc, char *argv[]) {
         if (i != static_cast<int32>(input.size()))
           continue;
         Matrix<BaseFloat> output;
-        if (!AppendFeats(feats, utt, length_tolerance, &output)) {
+        if (!PasteFeats(feats, utt, length_tolerance, &output)) {
           num_err++;
           continue; // it will have printed a warning.
         }
@@ -167,7 +141,7 @@ int main(int argc, char *argv[]) {
       for (int32 i = 1; i < po.NumArgs(); i++)
         ReadKaldiObject(po.GetArg(i), &(feats[i-1]));
       Matrix<BaseFloat> output;
-      if (!AppendFeats(feats, "", length_tolerance, &output))
+      if (!PasteFeats(feats, "", length_tolerance, &output))
         return 1; // it will have printed a warning.
       std::string output_wxfilename = po.GetArg(po.NumArgs());
       WriteKaldiObject(output, output_wxfilename, binary);
@@ -0,0 +1,289 @@
+// featbin/wav-reverberate-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "util/kaldi-thread.h"
+#include "feat/wave-reader.h"
+#include "feat/signal.h"
+
+namespace kaldi {
+
+// A room impulse response, prepared for convolution.
+struct RirInfo {
+  BaseFloat samp_freq;
+  int32 peak_index;  // The position of the peak, i.e. the direct path.
+  PartitionedFilter filter;
+  RirInfo(BaseFloat samp_freq, const VectorBase<BaseFloat> &rir,
+          int32 block_length):
+      samp_freq(samp_freq), peak_index(0), filter(rir, block_length) {
+    rir.Max(&peak_index);
+  }
+};
+
+/*
+   This class holds the most recently used room impulse responses, in the
+   form used for convolution, so that the FFT of each is computed only
+   once for many utterances (as long as the RIRs that are in use at any
+   time fit in the cache).  It is not thread safe; it is only used from the
+   main thread, and the RirInfo objects are shared with the tasks, so it's
+   OK if an RIR is removed from the cache while a task is still using it.
+*/
+class RirCache {
+ public:
+  RirCache(const std::string &rir_rspecifier, int32 capacity,
+           int32 rir_channel, int32 block_length):
+      rir_reader_(rir_rspecifier), capacity_(capacity),
+      rir_channel_(rir_channel), block_length_(block_length),
+      num_hits_(0), num_misses_(0) {
+    KALDI_ASSERT(capacity > 0);
+  }
+
+  // Returns the RIR with key 'rir_id', or NULL if it could not be read.
+  std::shared_ptr<const RirInfo> Get(const std::string &rir_id) {
+    MapType::iterator iter = map_.find(rir_id);
+    if (iter != map_.end()) {
+      num_hits_++;
+      // Move it to the front of the list, i.e. make it the most recently
+      // used.
+      list_.splice(list_.begin(), list_, iter->second);
+      return iter->second->second;
+    }
+    num_misses_++;
+    if (!rir_reader_.HasKey(rir_id)) {
+      KALDI_WARN << "No impulse response for " << rir_id;
+      return std::shared_ptr<const RirInfo>();
+    }
+    const WaveData &rir_wave = rir_reader_.Value(rir_id);
+    if (rir_channel_ >= rir_wave.Data().NumRows()) {
+      KALDI_WARN << "Impulse response " << rir_id << " has "
+                 << rir_wave.Data().NumRows() << " channels but you "
+                 << "specified channel " << rir_channel_;
+      return std::shared_ptr<const RirInfo>();
+    }
+    Vector<BaseFloat> rir(rir_wave.Data().Row(rir_channel_));
+    rir.Scale(1.0 / (1 << 15));
+    std::shared_ptr<const RirInfo> ans(
+        new RirInfo(rir_wave.SampFreq(), rir, block_length_));
+    if (static_cast<int32>(list_.size()) == capacity_) {
+      // Remove the least recently used RIR.
+      map_.erase(list_.back().first);
+      list_.pop_back();
+    }
+    list_.push_front(std::make_pair(rir_id, ans));
+    map_[rir_id] = list_.begin();
+    return ans;
+  }
+
+  int64 NumHits() const { return num_hits_; }
+  int64 NumMisses() const { return num_misses_; }
+
+ private:
+  typedef std::list<std::pair<std::string, std::shared_ptr<const RirInfo> > >
+      ListType;
+  typedef std::unordered_map<std::string, ListType::iterator,
+                             StringHasher> MapType;
+
+  RandomAccessTableReader<WaveHolder> rir_reader_;
+  int32 capacity_;
+  int32 rir_channel_;
+  int32 block_length_;
+  ListType list_;  // Most recently used first.
+  MapType map_;  // Indexes list_ by RIR id.
+  int64 num_hits_;
+  int64 num_misses_;
+};
+
+// This class is used to parallelize the reverberation over multiple threads.
+// The work happens in the operator (), the output happens in the destructor.
+class ReverberateTask {
+ public:
+  ReverberateTask(const std::string &utt, const WaveData &wave,
+                  int32 input_channel,
+                  const std::shared_ptr<const RirInfo> &rir,
+                  bool shift_output, bool normalize_output, BaseFloat volume,
+                  TableWriter<WaveHolder> *writer):
+      utt_(utt), samp_freq_(wave.SampFreq()),
+      signal_(wave.Data().Row(input_channel)), rir_(rir),
+      shift_output_(shift_output), normalize_output_(normalize_output),
+      volume_(volume), writer_(writer) { }
+
+  void operator () () {
+    int32 num_samp_input = signal_.Dim();
+    BaseFloat power_before_reverb = VecVec(signal_, signal_) / signal_.Dim();
+    rir_->filter.Convolve(&signal_);
+    BaseFloat power_after_reverb = VecVec(signal_, signal_) / signal_.Dim();
+    if (volume_ > 0)
+      signal_.Scale(volume_);
+    else if (normalize_output_ && power_after_reverb > 0.0)
+      signal_.Scale(sqrt(power_before_reverb / power_after_reverb));
+    if (shift_output_) {
+      // Shift the output by the position of the peak of the impulse
+      // response, so it's aligned with the input and of the same length.
+      Vector<BaseFloat> shifted(signal_.Range(rir_->peak_index,
+                                              num_samp_input));
+      signal_.Swap(&shifted);
+    }
+    rir_.reset();  // We no longer need it.
+  }
+
+  ~ReverberateTask() {
+    Matrix<BaseFloat> data(1, signal_.Dim(), kUndefined);
+    data.CopyRowFromVec(signal_, 0);
+    writer_->Write(utt_, WaveData(samp_freq_, data));
+  }
+ private:
+  std::string utt_;
+  BaseFloat samp_freq_;
+  Vector<BaseFloat> signal_;
+  std::shared_ptr<const RirInfo> rir_;
+  bool shift_output_;
+  bool normalize_output_;
+  BaseFloat volume_;
+  TableWriter<WaveHolder> *writer_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Reverberates a table of wave files, each with the room impulse\n"
+        "response given for it by <utt2rir-rspecifier>.  This is intended\n"
+        "for data augmentation with many utterances and a smaller number of\n"
+        "RIRs: it uses partitioned overlap-save convolution, keeps the\n"
+        "spectra of the most recently used RIRs in memory (see --cache-size)\n"
+        "and can process utterances in parallel (see --num-threads).  The\n"
+        "output is single-channel.  For additive noise, see wav-reverberate.\n"
+        "\n"
+        "Usage:  wav-reverberate-parallel [options...] <wav-rspecifier> "
+        "<rir-rspecifier> <utt2rir-rspecifier> <wav-wspecifier>\n"
+        "e.g.\n"
+        "wav-reverberate-parallel --num-threads=8 scp:wav.scp scp:rir.scp "
+        "ark:utt2rir ark:reverb.ark\n";
+
+    ParseOptions po(usage);
+    bool shift_output = true;
+    int32 input_channel = 0;
+    int32 rir_channel = 0;
+    bool normalize_output = true;
+    BaseFloat volume = 0;
+    int32 cache_size = 1000;
+    int32 block_length = 0;
+    TaskSequencerConfig sequencer_config;
+
+    po.Register("shift-output", &shift_output,
+                "If true, the reverberated waveform will be shifted by the "
+                "amount of the peak position of the RIR and the length of "
+                "the output waveform will be equal to the input waveform. "
+                "If false, the length of the output waveform will be "
+                "equal to (original input length + rir length - 1).");
+    po.Register("input-wave-channel", &input_channel,
+                "Specifies the channel to be used from input as only a "
+                "single channel will be used to generate reverberated output");
+    po.Register("rir-channel", &rir_channel,
+                "Specifies the channel of the room impulse response");
+    po.Register("normalize-output", &normalize_output,
+                "If true, then after reverberating, scale so that the signal "
+                "energy is the same as the original input signal. "
+                "See also the --volume option.");
+    po.Register("volume", &volume,
+                "If nonzero, a scaling factor on the signal that is applied "
+                "after reverberating. If you set this option to a nonzero "
+                "value, it will be as if you had also specified "
+                "--normalize-output=false.");
+    po.Register("cache-size", &cache_size,
+                "Number of impulse responses whose spectra are kept in "
+                "memory.");
+    po.Register("block-length", &block_length,
+                "Partition size for the convolution, in samples; must be a "
+                "power of two.  If <= 0, it is chosen for each RIR from its "
+                "length.");
+    sequencer_config.Register(&po);
+
+    po.Read(argc, argv);
+    if (po.NumArgs() != 4) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string wav_rspecifier = po.GetArg(1),
+        rir_rspecifier = po.GetArg(2),
+        utt2rir_rspecifier = po.GetArg(3),
+        wav_wspecifier = po.GetArg(4);
+
+    SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    RandomAccessTokenReader utt2rir_reader(utt2rir_rspecifier);
+    RirCache rir_cache(rir_rspecifier, cache_size, rir_channel, block_length);
+    TableWriter<WaveHolder> wav_writer(wav_wspecifier);
+
+    int32 num_done = 0, num_err = 0;
+    {
+      TaskSequencer<ReverberateTask> sequencer(sequencer_config);
+      for (; !wav_reader.Done(); wav_reader.Next()) {
+        std::string utt = wav_reader.Key();
+        const WaveData &wave = wav_reader.Value();
+        if (!utt2rir_reader.HasKey(utt)) {
+          KALDI_WARN << "No impulse response specified for " << utt;
+          num_err++;
+          continue;
+        }
+        if (input_channel >= wave.Data().NumRows()) {
+          KALDI_WARN << "File with id " << utt << " has "
+                     << wave.Data().NumRows() << " channels but you "
+                     << "specified channel " << input_channel;
+          num_err++;
+          continue;
+        }
+        std::string rir_id = utt2rir_reader.Value(utt);
+        std::shared_ptr<const RirInfo> rir = rir_cache.Get(rir_id);
+        if (rir == nullptr) {
+          num_err++;
+          continue;
+        }
+        if (rir->samp_freq != wave.SampFreq()) {
+          KALDI_WARN << "Sampling frequency of " << utt << " ("
+                     << wave.SampFreq() << ") does not match that of the "
+                     << "impulse response " << rir_id << " ("
+                     << rir->samp_freq << ")";
+          num_err++;
+          continue;
+        }
+        sequencer.Run(new ReverberateTask(utt, wave, input_channel, rir,
+                                          shift_output, normalize_output,
+                                          volume, &wav_writer));
+        num_done++;
+      }
+      // Destructor of "sequencer" will wait for any remaining tasks.
+    }
+
+    KALDI_LOG << "Reverberated " << num_done << " utterances, errors on "
+              << num_err << "; impulse-response cache had "
+              << rir_cache.NumHits() << " hits and " << rir_cache.NumMisses()
+              << " misses.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
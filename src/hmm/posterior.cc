@@ -89,13 +89,15 @@ void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
                         // The Posterior is terminated by a newlinhe.
     if (is.fail())
       KALDI_ERR << "holder of Posterior: error reading line " << (is.eof() ? "[eof]" : "");
-    std::istringstream line_is(line);
+    // We parse the line in memory rather than via an istringstream, as this
+    // is much faster.
+    const char *c = line.c_str();
     while (1) {
-      std::string str;
-      line_is >> std::ws;  // eat up whitespace.
-      if (line_is.eof()) break;
-      line_is >> str;
-      if (str != "[") {
+      while (isspace(static_cast<unsigned char>(*c))) c++;
+      if (*c == '\0') break;
+      if (*c != '[' || !IsNumberTerminator(c[1])) {
+        std::string str(c);
+        str = str.substr(0, str.find_first_of(" \t\r"));
         int32 str_int;
         // if str is an integer, we can give a slightly more concrete suggestion
         // of what might have gone wrong.
@@ -104,20 +106,20 @@ void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
                       "': did you provide alignments instead of posteriors?" :
                       "'.");
       }
-      std::vector<std::pair<int32, BaseFloat> > this_vec;
+      c++;
+      post->resize(post->size() + 1);
+      std::vector<std::pair<int32, BaseFloat> > &this_vec = post->back();
       while (1) {
-        line_is >> std::ws;
-        if (line_is.peek() == ']') {
-          line_is.get();
+        while (isspace(static_cast<unsigned char>(*c))) c++;
+        if (*c == ']') {
+          c++;
           break;
         }
         int32 i; BaseFloat p;
-        line_is >> i >> p;
-        if (line_is.fail())
+        if (!ParseBasicTypeFromText(&c, &i) || !ParseBasicTypeFromText(&c, &p))
           KALDI_ERR << "Error reading Posterior object (could not get data after \"[\");";
         this_vec.push_back(std::make_pair(i, p));
       }
-      post->push_back(this_vec);
     }
   }
 }
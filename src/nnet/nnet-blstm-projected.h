@@ -27,6 +27,7 @@
 
 #include "nnet/nnet-component.h"
 #include "nnet/nnet-utils.h"
+#include "nnet/nnet-lstm-cell.h"
 #include "cudamatrix/cu-math.h"
 
 /*************************************
@@ -541,25 +542,9 @@ class BlstmProjected : public MultistreamComponent {
     b_propagate_buf_.Resize((T+2)*S, 7 * cell_dim_ + proj_dim_, kSetZero);
 
     // forward-direction activations,
-    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf_.ColRange(0*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf_.ColRange(1*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf_.ColRange(2*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf_.ColRange(3*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YC(f_propagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf_.ColRange(5*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YM(f_propagate_buf_.ColRange(6*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YR(f_propagate_buf_.ColRange(7*cell_dim_, proj_dim_));
     CuSubMatrix<BaseFloat> F_YGIFO(f_propagate_buf_.ColRange(0, 4*cell_dim_));
 
     // backward-direction activations,
-    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf_.ColRange(0*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf_.ColRange(1*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf_.ColRange(2*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf_.ColRange(3*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YC(b_propagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf_.ColRange(5*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YM(b_propagate_buf_.ColRange(6*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YR(b_propagate_buf_.ColRange(7*cell_dim_, proj_dim_));
     CuSubMatrix<BaseFloat> B_YGIFO(b_propagate_buf_.ColRange(0, 4*cell_dim_));
 
     // FORWARD DIRECTION,
@@ -569,69 +554,30 @@ class BlstmProjected : public MultistreamComponent {
     // bias -> g, i, f, o
     F_YGIFO.RowRange(1*S, T*S).AddVecToRows(1.0, f_bias_);
 
+    LstmCell f_cell(cell_dim_, cell_clip_, diff_clip_, cell_diff_clip_,
+                    f_peephole_i_c_, f_peephole_f_c_, f_peephole_o_c_);
+
     // BufferPadding [T0]:dummy, [1, T]:current sequence, [T+1]:dummy
     for (int t = 1; t <= T; t++) {
-      // multistream buffers for current time-step,
-      CuSubMatrix<BaseFloat> y_all(f_propagate_buf_.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_g(F_YG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_i(F_YI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_f(F_YF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_o(F_YO.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_c(F_YC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_h(F_YH.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_m(F_YM.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_r(F_YR.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_gifo(F_YGIFO.RowRange(t*S, S));
-
-      // r(t-1) -> g, i, f, o
-      y_gifo.AddMatMat(1.0, F_YR.RowRange((t-1)*S, S), kNoTrans, f_w_gifo_r_, kTrans, 1.0);
-
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, F_YC.RowRange((t-1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g * i -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-      // c(t-1) * f -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, F_YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-      if (cell_clip_ > 0.0) {
-        y_c.ApplyFloor(-cell_clip_);   // Optional clipping of cell activation,
-        y_c.ApplyCeiling(cell_clip_);  // Google paper Interspeech2014: LSTM for LVCSR
+      // the streams not finished at 't',
+      const int32 n = NumActiveStreams(t);
+      if (n > 0) {
+        CuSubMatrix<BaseFloat> y_prev(f_propagate_buf_.RowRange((t-1)*S, n));
+        CuSubMatrix<BaseFloat> y(f_propagate_buf_.RowRange(t*S, n));
+
+        // r(t-1) -> g, i, f, o
+        y.ColRange(0, 4*cell_dim_).AddMatMat(1.0, y_prev.ColRange(7*cell_dim_, proj_dim_),
+                                             kNoTrans, f_w_gifo_r_, kTrans, 1.0);
+
+        // g, i, f, o -> c, h, m (incl. the peepholes from c),
+        f_cell.Propagate(y_prev, &y);
+
+        // m -> r
+        y.ColRange(7*cell_dim_, proj_dim_).AddMatMat(1.0, y.ColRange(6*cell_dim_, cell_dim_),
+                                                     kNoTrans, f_w_r_m_, kTrans, 0.0);
       }
-
-      // c(t) -> o(t) via peephole (not recurrent, using c(t))
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, f_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing,
-      y_o.Sigmoid(y_o);
-
-      // c -> h, tanh squashing,
-      y_h.Tanh(y_c);
-
-      // h * o -> m via output gate,
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
-
-      // m -> r
-      y_r.AddMatMat(1.0, y_m, kNoTrans, f_w_r_m_, kTrans, 0.0);
-
       // set zeros to padded frames,
-      if (sequence_lengths_.size() > 0) {
-        for (int s = 0; s < S; s++) {
-          if (t > sequence_lengths_[s]) {
-            y_all.Row(s).SetZero();
-          }
-        }
-      }
+      ZeroPaddedFrames(t, &f_propagate_buf_);
     }
 
     // BACKWARD DIRECTION,
@@ -641,69 +587,30 @@ class BlstmProjected : public MultistreamComponent {
     // bias -> g, i, f, o
     B_YGIFO.RowRange(1*S, T*S).AddVecToRows(1.0, b_bias_);
 
+    LstmCell b_cell(cell_dim_, cell_clip_, diff_clip_, cell_diff_clip_,
+                    b_peephole_i_c_, b_peephole_f_c_, b_peephole_o_c_);
+
     // BufferPadding [T0]:dummy, [1, T]:current sequence, [T+1]:dummy
     for (int t = T; t >= 1; t--) {
-      // multistream buffers for current time-step,
-      CuSubMatrix<BaseFloat> y_all(b_propagate_buf_.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_g(B_YG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_i(B_YI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_f(B_YF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_o(B_YO.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_c(B_YC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_h(B_YH.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_m(B_YM.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_r(B_YR.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_gifo(B_YGIFO.RowRange(t*S, S));
-
-      // r(t+1) -> g, i, f, o
-      y_gifo.AddMatMat(1.0, B_YR.RowRange((t+1)*S, S), kNoTrans, b_w_gifo_r_, kTrans, 1.0);
-
-      // c(t+1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-
-      // c(t+1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, B_YC.RowRange((t+1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g * i -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-      // c(t+1) * f -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, B_YC.RowRange((t+1)*S, S), y_f, 1.0);
-
-      if (cell_clip_ > 0.0) {
-        y_c.ApplyFloor(-cell_clip_);   // optional clipping of cell activation,
-        y_c.ApplyCeiling(cell_clip_);  // google paper Interspeech2014: LSTM for LVCSR
+      // the streams not finished at 't',
+      const int32 n = NumActiveStreams(t);
+      if (n > 0) {
+        CuSubMatrix<BaseFloat> y_prev(b_propagate_buf_.RowRange((t+1)*S, n));
+        CuSubMatrix<BaseFloat> y(b_propagate_buf_.RowRange(t*S, n));
+
+        // r(t+1) -> g, i, f, o
+        y.ColRange(0, 4*cell_dim_).AddMatMat(1.0, y_prev.ColRange(7*cell_dim_, proj_dim_),
+                                             kNoTrans, b_w_gifo_r_, kTrans, 1.0);
+
+        // g, i, f, o -> c, h, m (incl. the peepholes from c),
+        b_cell.Propagate(y_prev, &y);
+
+        // m -> r
+        y.ColRange(7*cell_dim_, proj_dim_).AddMatMat(1.0, y.ColRange(6*cell_dim_, cell_dim_),
+                                                     kNoTrans, b_w_r_m_, kTrans, 0.0);
       }
-
-      // c(t) -> o(t) via peephole (not recurrent, using c(t))
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, b_peephole_o_c_, 1.0);
-
-      // o sigmoid squashing,
-      y_o.Sigmoid(y_o);
-
-      // h tanh squashing,
-      y_h.Tanh(y_c);
-
-      // h * o -> m via output gate,
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
-
-      // m -> r
-      y_r.AddMatMat(1.0, y_m, kNoTrans, b_w_r_m_, kTrans, 0.0);
-
       // set zeros to padded frames,
-      if (sequence_lengths_.size() > 0) {
-        for (int s = 0; s < S; s++) {
-          if (t > sequence_lengths_[s]) {
-            y_all.Row(s).SetZero();
-          }
-        }
-      }
+      ZeroPaddedFrames(t, &b_propagate_buf_);
     }
 
     CuMatrix<BaseFloat> YR_FB;
@@ -732,259 +639,94 @@ class BlstmProjected : public MultistreamComponent {
 
     // FORWARD DIRECTION,
     // forward-direction activations,
-    CuSubMatrix<BaseFloat> F_YG(f_propagate_buf_.ColRange(0*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YI(f_propagate_buf_.ColRange(1*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YF(f_propagate_buf_.ColRange(2*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YO(f_propagate_buf_.ColRange(3*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_YC(f_propagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_YH(f_propagate_buf_.ColRange(5*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_YM(f_propagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_YR(f_propagate_buf_.ColRange(7*cell_dim_, proj_dim_));
 
     // forward-direction derivatives,
-    CuSubMatrix<BaseFloat> F_DG(f_backpropagate_buf_.ColRange(0*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_DI(f_backpropagate_buf_.ColRange(1*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_DF(f_backpropagate_buf_.ColRange(2*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_DO(f_backpropagate_buf_.ColRange(3*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_DC(f_backpropagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_DH(f_backpropagate_buf_.ColRange(5*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> F_DM(f_backpropagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> F_DR(f_backpropagate_buf_.ColRange(7*cell_dim_, proj_dim_));
     CuSubMatrix<BaseFloat> F_DGIFO(f_backpropagate_buf_.ColRange(0, 4*cell_dim_));
 
     // pre-copy partial derivatives from the BLSTM output,
     F_DR.RowRange(1*S, T*S).CopyFromMat(out_diff.ColRange(0, proj_dim_));
 
+    LstmCell f_cell(cell_dim_, cell_clip_, diff_clip_, cell_diff_clip_,
+                    f_peephole_i_c_, f_peephole_f_c_, f_peephole_o_c_);
+
     // BufferPadding [T0]:dummy, [1,T]:current sequence, [T+1]: dummy,
     for (int t = T; t >= 1; t--) {
-      CuSubMatrix<BaseFloat> y_g(F_YG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_i(F_YI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_f(F_YF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_o(F_YO.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_c(F_YC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_h(F_YH.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_m(F_YM.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_r(F_YR.RowRange(t*S, S));
-
-      CuSubMatrix<BaseFloat> d_all(f_backpropagate_buf_.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_g(F_DG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_i(F_DI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_f(F_DF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_o(F_DO.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_c(F_DC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_h(F_DH.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_m(F_DM.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_r(F_DR.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_gifo(F_DGIFO.RowRange(t*S, S));
-
-      // r
-      //   Version 1 (precise gradients):
-      //   backprop error from g(t+1), i(t+1), f(t+1), o(t+1) to r(t)
-      d_r.AddMatMat(1.0, F_DGIFO.RowRange((t+1)*S, S), kNoTrans, f_w_gifo_r_, kNoTrans, 1.0);
-
-      /*
-      //   Version 2 (Alex Graves' PhD dissertation):
-      //   only backprop g(t+1) to r(t)
-      CuSubMatrix<BaseFloat> w_g_r_(w_gifo_r_.RowRange(0, cell_dim_));
-      d_r.AddMatMat(1.0, DG.RowRange((t+1)*S,S), kNoTrans, w_g_r_, kNoTrans, 1.0);
-      */
-
-      /*
-      //   Version 3 (Felix Gers' PhD dissertation):
-      //   truncate gradients of g(t+1), i(t+1), f(t+1), o(t+1) once they leak out memory block
-      //   CEC(with forget connection) is the only "error-bridge" through time
-      ;
-      */
-
-      // r -> m
-      d_m.AddMatMat(1.0, d_r, kNoTrans, f_w_r_m_, kNoTrans, 0.0);
-
-      // m -> h, via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
-      // 1. diff from h(t)
-      // 2. diff from c(t+1) (via forget-gate between CEC)
-      // 3. diff from i(t+1) (via peephole)
-      // 4. diff from f(t+1) (via peephole)
-      // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, F_DC.RowRange((t+1)*S, S), F_YF.RowRange((t+1)*S, S), 1.0);
-      d_c.AddMatDiagVec(1.0, F_DI.RowRange((t+1)*S, S), kNoTrans, f_peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, F_DF.RowRange((t+1)*S, S), kNoTrans, f_peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o                      , kNoTrans, f_peephole_o_c_, 1.0);
-      // optionally clip the cell_derivative,
-      if (cell_diff_clip_ > 0.0) {
-        d_c.ApplyFloor(-cell_diff_clip_);
-        d_c.ApplyCeiling(cell_diff_clip_);
-      }
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, F_YC.RowRange((t-1)*S, S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g, via input gate
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
-
-      // Clipping per-frame derivatives for the next `t'.
-      // Clipping applied to gates and input gate (as done in Google).
-      // [ICASSP2015, Sak, Learning acoustic frame labelling...],
-      //
-      // The path from 'out_diff' to 'd_c' via 'd_h' is unclipped,
-      // which is probably important for the 'Constant Error Carousel'
-      // to work well.
-      //
-      if (diff_clip_ > 0.0) {
-        d_gifo.ApplyFloor(-diff_clip_);
-        d_gifo.ApplyCeiling(diff_clip_);
+      // the streams not finished at 't',
+      const int32 n = NumActiveStreams(t);
+      if (n > 0) {
+        CuSubMatrix<BaseFloat> y_prev(f_propagate_buf_.RowRange((t-1)*S, n));
+        CuSubMatrix<BaseFloat> y(f_propagate_buf_.RowRange(t*S, n));
+        CuSubMatrix<BaseFloat> y_next(f_propagate_buf_.RowRange((t+1)*S, n));
+        CuSubMatrix<BaseFloat> d(f_backpropagate_buf_.RowRange(t*S, n));
+        CuSubMatrix<BaseFloat> d_next(f_backpropagate_buf_.RowRange((t+1)*S, n));
+        CuSubMatrix<BaseFloat> d_r(d.ColRange(7*cell_dim_, proj_dim_));
+
+        // r
+        //   Version 1 (precise gradients):
+        //   backprop error from g(t+1), i(t+1), f(t+1), o(t+1) to r(t)
+        d_r.AddMatMat(1.0, d_next.ColRange(0, 4*cell_dim_), kNoTrans, f_w_gifo_r_, kNoTrans, 1.0);
+
+        // r -> m
+        d.ColRange(6*cell_dim_, cell_dim_).AddMatMat(1.0, d_r, kNoTrans, f_w_r_m_, kNoTrans, 0.0);
+
+        // m -> h, o, c, f, i, g (clipped),
+        f_cell.Backpropagate(y_prev, y, y_next, d_next, &d);
       }
-
       // set zeros to padded frames,
-      if (sequence_lengths_.size() > 0) {
-        for (int s = 0; s < S; s++) {
-          if (t > sequence_lengths_[s]) {
-            d_all.Row(s).SetZero();
-          }
-        }
-      }
+      ZeroPaddedFrames(t, &f_backpropagate_buf_);
     }
 
     // BACKWARD DIRECTION,
     // backward-direction activations,
-    CuSubMatrix<BaseFloat> B_YG(b_propagate_buf_.ColRange(0*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YI(b_propagate_buf_.ColRange(1*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YF(b_propagate_buf_.ColRange(2*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YO(b_propagate_buf_.ColRange(3*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_YC(b_propagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_YH(b_propagate_buf_.ColRange(5*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_YM(b_propagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_YR(b_propagate_buf_.ColRange(7*cell_dim_, proj_dim_));
 
     // backward-direction derivatives,
-    CuSubMatrix<BaseFloat> B_DG(b_backpropagate_buf_.ColRange(0*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_DI(b_backpropagate_buf_.ColRange(1*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_DF(b_backpropagate_buf_.ColRange(2*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_DO(b_backpropagate_buf_.ColRange(3*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_DC(b_backpropagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_DH(b_backpropagate_buf_.ColRange(5*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> B_DM(b_backpropagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> B_DR(b_backpropagate_buf_.ColRange(7*cell_dim_, proj_dim_));
     CuSubMatrix<BaseFloat> B_DGIFO(b_backpropagate_buf_.ColRange(0, 4*cell_dim_));
 
     // pre-copy partial derivatives from the BLSTM output,
     B_DR.RowRange(1*S, T*S).CopyFromMat(out_diff.ColRange(proj_dim_, proj_dim_));
 
+    LstmCell b_cell(cell_dim_, cell_clip_, diff_clip_, cell_diff_clip_,
+                    b_peephole_i_c_, b_peephole_f_c_, b_peephole_o_c_);
+
     // BufferPadding [T0]:dummy, [1,T]:current sequence, [T+1]: dummy,
     for (int t = 1; t <= T; t++) {
-      CuSubMatrix<BaseFloat> y_g(B_YG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_i(B_YI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_f(B_YF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_o(B_YO.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_c(B_YC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_h(B_YH.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_m(B_YM.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_r(B_YR.RowRange(t*S, S));
-
-      CuSubMatrix<BaseFloat> d_all(b_backpropagate_buf_.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_g(B_DG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_i(B_DI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_f(B_DF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_o(B_DO.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_c(B_DC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_h(B_DH.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_m(B_DM.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_r(B_DR.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_gifo(B_DGIFO.RowRange(t*S, S));
-
-      // r
-      //   Version 1 (precise gradients):
-      //   backprop error from g(t-1), i(t-1), f(t-1), o(t-1) to r(t)
-      d_r.AddMatMat(1.0, B_DGIFO.RowRange((t-1)*S, S), kNoTrans, b_w_gifo_r_, kNoTrans, 1.0);
-
-      /*
-      //   Version 2 (Alex Graves' PhD dissertation):
-      //   only backprop g(t+1) to r(t)
-      CuSubMatrix<BaseFloat> w_g_r_(w_gifo_r_.RowRange(0, cell_dim_));
-      d_r.AddMatMat(1.0, DG.RowRange((t+1)*S,S), kNoTrans, w_g_r_, kNoTrans, 1.0);
-      */
-
-      /*
-      //   Version 3 (Felix Gers' PhD dissertation):
-      //   truncate gradients of g(t+1), i(t+1), f(t+1), o(t+1) once they leak out memory block
-      //   CEC(with forget connection) is the only "error-bridge" through time
-      */
-
-      // r -> m
-      d_m.AddMatMat(1.0, d_r, kNoTrans, b_w_r_m_, kNoTrans, 0.0);
-
-      // m -> h via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
-      // 1. diff from h(t)
-      // 2. diff from c(t+1) (via forget-gate between CEC)
-      // 3. diff from i(t+1) (via peephole)
-      // 4. diff from f(t+1) (via peephole)
-      // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, B_DC.RowRange((t-1)*S, S), B_YF.RowRange((t-1)*S, S), 1.0);
-      d_c.AddMatDiagVec(1.0, B_DI.RowRange((t-1)*S, S), kNoTrans, b_peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, B_DF.RowRange((t-1)*S, S), kNoTrans, b_peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o                      , kNoTrans, b_peephole_o_c_, 1.0);
-      // optionally clip the cell_derivative,
-      if (cell_diff_clip_ > 0.0) {
-        d_c.ApplyFloor(-cell_diff_clip_);
-        d_c.ApplyCeiling(cell_diff_clip_);
-      }
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, B_YC.RowRange((t-1)*S, S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g, via input gate,
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
-
-      // Clipping per-frame derivatives for the next `t'.
-      // Clipping applied to gates and input gate (as done in Google).
-      // [ICASSP2015, Sak, Learning acoustic frame labelling...],
-      //
-      // The path from 'out_diff' to 'd_c' via 'd_h' is unclipped,
-      // which is probably important for the 'Constant Error Carousel'
-      // to work well.
-      //
-      if (diff_clip_ > 0.0) {
-        d_gifo.ApplyFloor(-diff_clip_);
-        d_gifo.ApplyCeiling(diff_clip_);
+      // the streams not finished at 't',
+      const int32 n = NumActiveStreams(t);
+      if (n > 0) {
+        CuSubMatrix<BaseFloat> y_prev(b_propagate_buf_.RowRange((t+1)*S, n));
+        CuSubMatrix<BaseFloat> y(b_propagate_buf_.RowRange(t*S, n));
+        CuSubMatrix<BaseFloat> y_next(b_propagate_buf_.RowRange((t-1)*S, n));
+        CuSubMatrix<BaseFloat> d(b_backpropagate_buf_.RowRange(t*S, n));
+        CuSubMatrix<BaseFloat> d_next(b_backpropagate_buf_.RowRange((t-1)*S, n));
+        CuSubMatrix<BaseFloat> d_r(d.ColRange(7*cell_dim_, proj_dim_));
+
+        // r
+        //   Version 1 (precise gradients):
+        //   backprop error from g(t-1), i(t-1), f(t-1), o(t-1) to r(t)
+        d_r.AddMatMat(1.0, d_next.ColRange(0, 4*cell_dim_), kNoTrans, b_w_gifo_r_, kNoTrans, 1.0);
+
+        // r -> m
+        d.ColRange(6*cell_dim_, cell_dim_).AddMatMat(1.0, d_r, kNoTrans, b_w_r_m_, kNoTrans, 0.0);
+
+        // m -> h, o, c, f, i, g (clipped),
+        b_cell.Backpropagate(y_prev, y, y_next, d_next, &d);
       }
-
       // set zeros to padded frames,
-      if (sequence_lengths_.size() > 0) {
-        for (int s = 0; s < S; s++) {
-          if (t > sequence_lengths_[s]) {
-            d_all.Row(s).SetZero();
-          }
-        }
-      }
+      ZeroPaddedFrames(t, &b_backpropagate_buf_);
     }
 
     // g,i,f,o -> x, calculating input derivatives,
@@ -1044,9 +786,9 @@ class BlstmProjected : public MultistreamComponent {
     // backward direction backpropagate
     // weight x -> g, i, f, o
     b_w_gifo_x_corr_.AddMatMat(1.0, B_DGIFO.RowRange(1*S, T*S), kTrans, in, kNoTrans, mmt);
-    // recurrent weight r -> g, i, f, o
+    // recurrent weight r -> g, i, f, o, r(t+1) --> g, i, f, o
     b_w_gifo_r_corr_.AddMatMat(1.0, B_DGIFO.RowRange(1*S, T*S), kTrans,
-                                    B_YR.RowRange(0*S, T*S)   , kNoTrans, mmt);
+                                    B_YR.RowRange(2*S, T*S)   , kNoTrans, mmt);
     // bias of g, i, f, o
     b_bias_corr_.AddRowSumMat(1.0, B_DGIFO.RowRange(1*S, T*S), mmt);
 
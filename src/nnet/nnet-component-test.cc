@@ -25,6 +25,8 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-convolutional-component.h"
 #include "nnet/nnet-max-pooling-component.h"
+#include "nnet/nnet-lstm-projected.h"
+#include "nnet/nnet-blstm-projected.h"
 #include "util/common-utils.h"
 
 namespace kaldi {
@@ -264,6 +266,116 @@ namespace nnet1 {
     delete c;
   }
 
+
+  // A batch of streams gives the same outputs, input derivatives and
+  // gradient as the streams one by one (the batch is processed packed
+  // when 'lengths' are sorted by decreasing length, masked otherwise),
+  void UnitTestLstmStreams(const std::string &proto,
+                           const std::vector<int32> &lengths) {
+    Component* c = Component::Init(proto);
+    MultistreamComponent* mc = dynamic_cast<MultistreamComponent*>(c);
+    UpdatableComponent* uc = dynamic_cast<UpdatableComponent*>(c);
+    const int32 S = lengths.size(),
+      T = *std::max_element(lengths.begin(), lengths.end());
+
+    // the streams, zero-padded and interleaved frame by frame,
+    std::vector<CuMatrix<BaseFloat> > in_s(S), out_diff_s(S);
+    CuMatrix<BaseFloat> in(T*S, c->InputDim()),
+                        out_diff(T*S, c->OutputDim());
+    for (int32 s = 0; s < S; s++) {
+      in_s[s].Resize(lengths[s], c->InputDim());
+      in_s[s].SetRandn();
+      out_diff_s[s].Resize(lengths[s], c->OutputDim());
+      out_diff_s[s].SetRandn();
+      for (int32 t = 0; t < lengths[s]; t++) {
+        in.Row(t*S + s).CopyFromVec(in_s[s].Row(t));
+        out_diff.Row(t*S + s).CopyFromVec(out_diff_s[s].Row(t));
+      }
+    }
+
+    // multi-stream,
+    CuMatrix<BaseFloat> out, in_diff;
+    mc->SetSeqLengths(lengths);
+    mc->ResetStreams(std::vector<int32>(S, 1));
+    c->Propagate(in, &out);
+    c->Backpropagate(in, out, out_diff, &in_diff);
+    Vector<BaseFloat> gradient(uc->NumParams());
+    uc->GetGradient(&gradient);
+
+    // one stream at a time,
+    Vector<BaseFloat> gradient_ref(uc->NumParams()), gradient_s(uc->NumParams());
+    for (int32 s = 0; s < S; s++) {
+      CuMatrix<BaseFloat> out_ref, in_diff_ref;
+      mc->SetSeqLengths(std::vector<int32>(1, lengths[s]));
+      mc->ResetStreams(std::vector<int32>(1, 1));
+      c->Propagate(in_s[s], &out_ref);
+      c->Backpropagate(in_s[s], out_ref, out_diff_s[s], &in_diff_ref);
+      uc->GetGradient(&gradient_s);
+      gradient_ref.AddVec(1.0, gradient_s);
+      for (int32 t = 0; t < T; t++) {
+        if (t < lengths[s]) {
+          AssertEqual(out.Row(t*S + s), out_ref.Row(t));
+          AssertEqual(in_diff.Row(t*S + s), in_diff_ref.Row(t));
+        } else {
+          // the padded frames,
+          KALDI_ASSERT(out.Row(t*S + s).Max() == 0.0 &&
+                       out.Row(t*S + s).Min() == 0.0);
+        }
+      }
+    }
+    AssertEqual(gradient, gradient_ref);
+
+    delete c;
+  }
+
+  // The input derivatives and the gradient agree with the finite
+  // differences of the objective 'sum(out .* out_diff)',
+  void UnitTestLstmGradient(const std::string &proto) {
+    Component* c = Component::Init(proto);
+    UpdatableComponent* uc = dynamic_cast<UpdatableComponent*>(c);
+    CuMatrix<BaseFloat> in(6, c->InputDim()), out_diff(6, c->OutputDim()),
+                        out, in_diff;
+    in.SetRandn();
+    out_diff.SetRandn();
+    c->Propagate(in, &out);
+    c->Backpropagate(in, out, out_diff, &in_diff);
+    Vector<BaseFloat> gradient(uc->NumParams()), params(uc->NumParams());
+    uc->GetGradient(&gradient);
+    uc->GetParams(&params);
+
+    const BaseFloat delta = 1e-3;
+    for (int32 n = 0; n < 10; n++) {
+      // input,
+      int32 r = RandInt(0, in.NumRows() - 1), d = RandInt(0, in.NumCols() - 1);
+      BaseFloat x = in(r, d);
+      in(r, d) = x + delta;
+      c->Propagate(in, &out);
+      BaseFloat obj_plus = TraceMatMat(out, out_diff, kTrans);
+      in(r, d) = x - delta;
+      c->Propagate(in, &out);
+      BaseFloat obj_minus = TraceMatMat(out, out_diff, kTrans);
+      in(r, d) = x;
+      KALDI_ASSERT(std::abs((obj_plus - obj_minus) / (2 * delta) - in_diff(r, d))
+                   < 0.01 * (1.0 + std::abs(in_diff(r, d))));
+
+      // parameter,
+      int32 p = RandInt(0, params.Dim() - 1);
+      Vector<BaseFloat> params_shift(params);
+      params_shift(p) += delta;
+      uc->SetParams(params_shift);
+      c->Propagate(in, &out);
+      obj_plus = TraceMatMat(out, out_diff, kTrans);
+      params_shift(p) -= 2 * delta;
+      uc->SetParams(params_shift);
+      c->Propagate(in, &out);
+      obj_minus = TraceMatMat(out, out_diff, kTrans);
+      uc->SetParams(params);
+      KALDI_ASSERT(std::abs((obj_plus - obj_minus) / (2 * delta) - gradient(p))
+                   < 0.01 * (1.0 + std::abs(gradient(p))));
+    }
+    delete c;
+  }
+
 }  // namespace nnet1
 }  // namespace kaldi
 
@@ -287,6 +399,21 @@ int main() {
     UnitTestConvolutionalComponent3x3();
     UnitTestMaxPoolingComponent();
     UnitTestDropoutComponent();
+    {
+      const std::string lstm = "<LstmProjected> <InputDim> 5 <OutputDim> 4 "
+        "<CellDim> 6 <ParamRange> 0.5 <CellClip> 0 <DiffClip> 0",
+        blstm = "<BlstmProjected> <InputDim> 5 <OutputDim> 8 "
+        "<CellDim> 6 <ParamRange> 0.5 <CellClip> 0 <DiffClip> 0";
+      int32 sorted[] = { 9, 7, 7, 3, 1 }, unsorted[] = { 3, 9, 1, 7, 7 };
+      std::vector<int32> sorted_lengths(sorted, sorted + 5),
+        unsorted_lengths(unsorted, unsorted + 5);
+      UnitTestLstmStreams(lstm, sorted_lengths);
+      UnitTestLstmStreams(lstm, unsorted_lengths);
+      UnitTestLstmStreams(blstm, sorted_lengths);
+      UnitTestLstmStreams(blstm, unsorted_lengths);
+      UnitTestLstmGradient(lstm);
+      UnitTestLstmGradient(blstm);
+    }
     // end of unit-tests,
     if (loop == 0)
         KALDI_LOG << "Tests without GPU use succeeded.";
@@ -136,6 +136,12 @@ class Component {
     return false;
   }
 
+  /// Number of frames before/after the current one which are needed to
+  /// compute its output (e.g. <Splice>, FSMN memory blocks), used in the
+  /// chunk-by-chunk forward pass (OnlineNnetForward),
+  virtual int32 LeftContext() const { return 0; }
+  virtual int32 RightContext() const { return 0; }
+
   /// Get the dimension of the input,
   int32 InputDim() const {
     return input_dim_;
@@ -295,7 +301,8 @@ class UpdatableComponent : public Component {
 class MultistreamComponent : public UpdatableComponent {
  public:
   MultistreamComponent(int32 input_dim, int32 output_dim):
-    UpdatableComponent(input_dim, output_dim)
+    UpdatableComponent(input_dim, output_dim),
+    sorted_lengths_(false)
   { }
 
   bool IsMultistream() const {
@@ -304,6 +311,13 @@ class MultistreamComponent : public UpdatableComponent {
 
   virtual void SetSeqLengths(const std::vector<int32>& sequence_lengths) {
     sequence_lengths_ = sequence_lengths;
+    // are the streams sorted by decreasing length?
+    sorted_lengths_ = true;
+    for (size_t s = 1; s < sequence_lengths_.size(); s++) {
+      if (sequence_lengths_[s] > sequence_lengths_[s-1]) {
+        sorted_lengths_ = false;
+      }
+    }
   }
 
   int32 NumStreams() const {
@@ -315,7 +329,35 @@ class MultistreamComponent : public UpdatableComponent {
   { }
 
  protected:
+  /// The number of streams to be processed in frame 't' (1-based, as in
+  /// the buffers of the LSTMs). If the streams are sorted by decreasing
+  /// length, the streams not finished at 't' are the first 'n' ones and
+  /// the recursion can skip the rest of the batch. Otherwise all the
+  /// streams are processed, and the padded frames are zeroed afterwards,
+  int32 NumActiveStreams(int32 t) const {
+    if (sequence_lengths_.empty() || !sorted_lengths_) return NumStreams();
+    int32 n = 0;
+    while (n < sequence_lengths_.size() && sequence_lengths_[n] >= t) n++;
+    return n;
+  }
+
+  /// Sets zeros to the padded frames in the rows of frame 't' of 'buf'
+  /// (a buffer with 'NumStreams()' rows per frame),
+  void ZeroPaddedFrames(int32 t, CuMatrixBase<BaseFloat> *buf) const {
+    if (sequence_lengths_.empty()) return;
+    const int32 S = NumStreams(), n = NumActiveStreams(t);
+    if (n < S) {
+      buf->RowRange(t*S + n, S - n).SetZero();
+    }
+    for (int32 s = 0; s < n; s++) {
+      if (t > sequence_lengths_[s]) {
+        buf->Row(t*S + s).SetZero();
+      }
+    }
+  }
+
   std::vector<int32> sequence_lengths_;
+  bool sorted_lengths_;
 };
 
 
@@ -0,0 +1,143 @@
+// nnet/nnet-data-loader-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-data-loader.h"
+#include "hmm/posterior.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace kaldi;
+using namespace kaldi::nnet1;
+
+// Every frame carries its global index in all the streams: in all the
+// columns of the matrix stream, as the pdf-id of the posterior stream
+// and as the frame weight. The fill function mimics the loop of the
+// frmshuff trainers over utterances of random length.
+static void UnitTestDoubleBufferedLoader(bool randomize) {
+  NnetDataRandomizerOptions opts;
+  opts.randomizer_size = 500 + Rand() % 500;
+  opts.minibatch_size = 16 + Rand() % 50;
+  RandomizerMask randomizer_mask(opts);
+
+  int32 num_utts = 100 + Rand() % 100, utt = 0, total_frames = 0;
+  std::vector<int32> utt_lengths(num_utts);
+  for (int32 i = 0; i < num_utts; i++) utt_lengths[i] = 1 + Rand() % 200;
+
+  DoubleBufferedLoader<RandomizerBundle>::FillFunction fill =
+      [&](RandomizerBundle *buf) -> bool {
+    for ( ; utt < num_utts; utt++) {
+      if (buf->IsFull()) break;
+      int32 len = utt_lengths[utt];
+      Matrix<BaseFloat> mat(len, 3);
+      Posterior post(len);
+      Vector<BaseFloat> weights(len);
+      for (int32 t = 0; t < len; t++) {
+        mat.Row(t).Set(total_frames + t);
+        post[t].push_back(std::make_pair(total_frames + t, 1.0));
+        weights(t) = total_frames + t;
+      }
+      buf->Mat(0).AddData(CuMatrix<BaseFloat>(mat));
+      buf->Post(0).AddData(post);
+      buf->Vec(0).AddData(weights);
+      total_frames += len;
+    }
+    if (randomize) buf->Randomize(&randomizer_mask);
+    return (utt < num_utts);
+  };
+
+  std::vector<int32> seen;
+  {
+    DoubleBufferedLoader<RandomizerBundle> loader(
+        RandomizerBundle(opts, 1, 1, 1), fill);
+    RandomizerBundle *buf;
+    while ((buf = loader.Next()) != NULL) {
+      for ( ; !buf->Done(); buf->Next()) {
+        Matrix<BaseFloat> mat(buf->Mat(0).Value());
+        const Posterior &post = buf->Post(0).Value();
+        const Vector<BaseFloat> &weights = buf->Vec(0).Value();
+        KALDI_ASSERT(mat.NumRows() == opts.minibatch_size);
+        for (int32 r = 0; r < mat.NumRows(); r++) {
+          // the streams were shuffled consistently,
+          KALDI_ASSERT(mat(r, 0) == mat(r, 2));
+          KALDI_ASSERT(post[r][0].first == static_cast<int32>(mat(r, 0)));
+          KALDI_ASSERT(weights(r) == mat(r, 0));
+          seen.push_back(post[r][0].first);
+        }
+      }
+    }
+  }
+  // all the input was read, no frame was delivered twice, and only the
+  // leftovers (less than a mini-batch in each of the two buffers) are lost,
+  KALDI_ASSERT(utt == num_utts);
+  std::sort(seen.begin(), seen.end());
+  KALDI_ASSERT(std::unique(seen.begin(), seen.end()) == seen.end());
+  KALDI_ASSERT(static_cast<int32>(seen.size()) >
+               total_frames - 2 * opts.minibatch_size);
+  KALDI_ASSERT(seen.back() < total_frames);
+}
+
+// An error in the background thread surfaces in Next(),
+static void UnitTestDoubleBufferedLoaderError() {
+  NnetDataRandomizerOptions opts;
+  int32 num_calls = 0;
+  DoubleBufferedLoader<RandomizerBundle>::FillFunction fill =
+      [&](RandomizerBundle *buf) -> bool {
+    if (++num_calls == 3) KALDI_ERR << "Reading failed (this is expected).";
+    buf->Mat(0).AddData(CuMatrix<BaseFloat>(opts.minibatch_size, 2));
+    return true;
+  };
+  DoubleBufferedLoader<RandomizerBundle> loader(
+      RandomizerBundle(opts, 1, 0, 0), fill);
+  KALDI_ASSERT(loader.Next() != NULL);
+  KALDI_ASSERT(loader.Next() != NULL);
+  bool caught = false;
+  try {
+    loader.Next();
+  } catch (const std::exception &e) {
+    caught = true;
+  }
+  KALDI_ASSERT(caught);
+  KALDI_ASSERT(loader.Next() == NULL);
+}
+
+// Destroying the loader before the input is consumed stops the thread,
+static void UnitTestDoubleBufferedLoaderEarlyExit() {
+  NnetDataRandomizerOptions opts;
+  DoubleBufferedLoader<RandomizerBundle>::FillFunction fill =
+      [&](RandomizerBundle *buf) -> bool {
+    buf->Mat(0).AddData(CuMatrix<BaseFloat>(opts.minibatch_size, 2));
+    return true;  // endless input,
+  };
+  DoubleBufferedLoader<RandomizerBundle> loader(
+      RandomizerBundle(opts, 1, 0, 0), fill);
+  for (int32 i = 0; i < 5; i++) {
+    RandomizerBundle *buf = loader.Next();
+    KALDI_ASSERT(buf != NULL && !buf->Done());
+  }
+}
+
+int main() {
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestDoubleBufferedLoader(true);
+    UnitTestDoubleBufferedLoader(false);
+  }
+  UnitTestDoubleBufferedLoaderError();
+  UnitTestDoubleBufferedLoaderEarlyExit();
+  std::cout << "Tests succeeded.\n";
+  return 0;
+}
@@ -0,0 +1,52 @@
+// nnet/nnet-data-loader.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-data-loader.h"
+
+#include <vector>
+
+namespace kaldi {
+namespace nnet1 {
+
+RandomizerBundle::RandomizerBundle(const NnetDataRandomizerOptions &opts,
+                                   int32 num_matrix, int32 num_posterior,
+                                   int32 num_vector):
+    mat_(num_matrix, MatrixRandomizer(opts)),
+    post_(num_posterior, PosteriorRandomizer(opts)),
+    vec_(num_vector, VectorRandomizer(opts)) {
+  KALDI_ASSERT(num_matrix > 0);
+}
+
+void RandomizerBundle::Next() {
+  for (size_t i = 0; i < mat_.size(); i++) mat_[i].Next();
+  for (size_t i = 0; i < post_.size(); i++) post_[i].Next();
+  for (size_t i = 0; i < vec_.size(); i++) vec_[i].Next();
+}
+
+void RandomizerBundle::Randomize(RandomizerMask *mask) {
+  // a buffer which got no new data still has its cursor on the leftover
+  // from the previous fill, it has no full mini-batch and the
+  // randomizers would refuse to shuffle it,
+  if (Done()) return;
+  const std::vector<int32> &m = mask->Generate(NumFrames());
+  for (size_t i = 0; i < mat_.size(); i++) mat_[i].Randomize(m);
+  for (size_t i = 0; i < post_.size(); i++) post_[i].Randomize(m);
+  for (size_t i = 0; i < vec_.size(); i++) vec_[i].Randomize(m);
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
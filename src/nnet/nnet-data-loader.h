@@ -0,0 +1,213 @@
+// nnet/nnet-data-loader.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET_NNET_DATA_LOADER_H_
+#define KALDI_NNET_NNET_DATA_LOADER_H_
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/kaldi-semaphore.h"
+#include "cudamatrix/cu-device.h"
+#include "nnet/nnet-randomizer.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/**
+ * A group of randomizers holding the same frames, in the same order:
+ * matrix streams (features, regression targets), posterior streams
+ * (alignments) and vector streams (frame weights). The frames are added
+ * stream by stream, the group is shuffled with a single mask, and the
+ * mini-batches of all the streams are advanced together.
+ *
+ * Stream 0 of the matrix streams is the 'reference' stream used by
+ * IsFull(), Done() and NumFrames(), so every bundle needs at least one
+ * matrix stream.
+ */
+class RandomizerBundle {
+ public:
+  RandomizerBundle(const NnetDataRandomizerOptions &opts,
+                   int32 num_matrix, int32 num_posterior, int32 num_vector);
+
+  MatrixRandomizer& Mat(int32 i) { return mat_.at(i); }
+  PosteriorRandomizer& Post(int32 i) { return post_.at(i); }
+  VectorRandomizer& Vec(int32 i) { return vec_.at(i); }
+
+  /// Returns true, when capacity is full (stop adding data),
+  bool IsFull() { return mat_[0].IsFull(); }
+
+  /// Number of frames stored inside the bundle,
+  int32 NumFrames() { return mat_[0].NumFrames(); }
+
+  /// Returns true, if no more data for another mini-batch,
+  bool Done() { return mat_[0].Done(); }
+
+  /// Sets the cursors of all the streams to next mini-batch,
+  void Next();
+
+  /// Shuffles all the streams with one mask drawn from 'mask'.
+  /// Does nothing when there is not a single full mini-batch
+  /// (i.e. nothing was added since the buffer was emptied),
+  void Randomize(RandomizerMask *mask);
+
+ private:
+  std::vector<MatrixRandomizer> mat_;
+  std::vector<PosteriorRandomizer> post_;
+  std::vector<VectorRandomizer> vec_;
+};
+
+
+/**
+ * Double-buffered loader for the frame-shuffling trainers.
+ *
+ * The loader keeps two copies of 'Buffer' (typically a RandomizerBundle,
+ * or a struct with several of them). While the trainer consumes the
+ * mini-batches of one copy, a background thread calls the user-supplied
+ * 'fill' function on the other copy: it reads the next utterances,
+ * applies the feature transform, adds the frames and shuffles them.
+ * So the time spent on input is hidden behind the training.
+ *
+ * 'fill' is called with one buffer at a time and should add data until
+ * the buffer is full or the input is exhausted; it returns false when
+ * there is no more input (the data added by that last call is still
+ * handed to the trainer). All the objects touched by 'fill' (readers,
+ * feature transform, RandomizerMask, counters) belong to the background
+ * thread until Next() returns NULL, the trainer must not access them
+ * in the meantime. An exception thrown in 'fill' is re-thrown by Next().
+ *
+ * Usage:
+ * \code
+ *   DoubleBufferedLoader<RandomizerBundle> loader(bundle, fill);
+ *   RandomizerBundle *buf;
+ *   while ((buf = loader.Next()) != NULL) {
+ *     for ( ; !buf->Done(); buf->Next()) {
+ *       ... train with buf->Mat(0).Value() ...
+ *     }
+ *   }
+ * \endcode
+ *
+ * With CUDA, the background thread gets its own CUDA stream; the caller
+ * must have called CuDevice::Instantiate().AllowMultithreading() before
+ * constructing the loader.
+ */
+template<class Buffer>
+class DoubleBufferedLoader {
+ public:
+  typedef std::function<bool(Buffer*)> FillFunction;
+
+  /// Both buffers are copies of 'prototype', the background
+  /// thread starts filling the first one right away,
+  DoubleBufferedLoader(const Buffer &prototype, const FillFunction &fill):
+    fill_(fill),
+    current_(-1),
+    finished_(false),
+    stop_(false),
+    empty_sem_(2) {
+    buffer_[0] = new Buffer(prototype);
+    buffer_[1] = new Buffer(prototype);
+    last_[0] = last_[1] = false;
+    thread_ = std::thread(DoubleBufferedLoader<Buffer>::Run, this);
+  }
+
+  ~DoubleBufferedLoader() {
+    // ask the background thread to stop after the fill in progress,
+    stop_ = true;
+    empty_sem_.Signal();
+    empty_sem_.Signal();
+    thread_.join();
+    delete buffer_[0];
+    delete buffer_[1];
+  }
+
+  /// Returns the next filled (and shuffled) buffer, or NULL when all the
+  /// input was consumed. The buffer returned by the previous call is
+  /// handed back to the background thread, so it must not be used
+  /// anymore. Blocks while the background thread is still filling.
+  Buffer* Next() {
+    if (finished_) return NULL;
+    if (current_ >= 0) {
+      if (last_[current_]) {
+        finished_ = true;
+        return NULL;
+      }
+      empty_sem_.Signal();  // refill the buffer we just consumed,
+    }
+    current_ = (current_ + 1) % 2;
+    filled_sem_.Wait();
+    SynchronizeGpu();
+    if (error_[current_]) {
+      finished_ = true;
+      std::rethrow_exception(error_[current_]);
+    }
+    return buffer_[current_];
+  }
+
+ private:
+  static void Run(DoubleBufferedLoader<Buffer> *loader) {
+    loader->RunInBackground();
+  }
+
+  void RunInBackground() {
+    for (int32 b = 0; ; b = (b + 1) % 2) {
+      empty_sem_.Wait();
+      if (stop_) return;
+      bool more;
+      try {
+        more = fill_(buffer_[b]);
+      } catch (...) {
+        error_[b] = std::current_exception();
+        more = false;
+      }
+      last_[b] = !more;
+      // make the data visible to the CUDA stream of the trainer,
+      SynchronizeGpu();
+      filled_sem_.Signal();
+      if (!more) return;
+    }
+  }
+
+  FillFunction fill_;
+  Buffer *buffer_[2];
+
+  /// 'last_[b]' and 'error_[b]' are written by the background thread
+  /// before it signals that buffer 'b' is filled,
+  bool last_[2];
+  std::exception_ptr error_[2];
+
+  int32 current_;  ///< Buffer owned by the trainer (-1 before the 1st Next()),
+  bool finished_;
+  std::atomic<bool> stop_;
+
+  /// 'empty_sem_' counts the buffers the background thread may fill,
+  /// 'filled_sem_' counts the buffers ready for the trainer,
+  Semaphore empty_sem_;
+  Semaphore filled_sem_;
+  std::thread thread_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DoubleBufferedLoader);
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_DATA_LOADER_H_
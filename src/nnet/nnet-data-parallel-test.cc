@@ -0,0 +1,168 @@
+// nnet/nnet-data-parallel-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-data-parallel.h"
+#include "nnet/nnet-component.h"
+
+#include <vector>
+
+using namespace kaldi;
+using namespace kaldi::nnet1;
+
+static void InitNnet(Nnet *nnet) {
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 10 <OutputDim> 20 <ParamStddev> 0.3"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Sigmoid> <InputDim> 20 <OutputDim> 20"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 20 <OutputDim> 5 <ParamStddev> 0.3"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Softmax> <InputDim> 5 <OutputDim> 5"));
+  NnetTrainOptions trn_opts;
+  trn_opts.learn_rate = 0.01;
+  trn_opts.momentum = 0.9;
+  trn_opts.l2_penalty = 1e-4;
+  nnet->SetTrainOptions(trn_opts);
+}
+
+// Random mini-batches, the posterior is the argmax of a linear function
+// of the input (so there is something to learn),
+static void GetMinibatches(int32 num_minibatches,
+                           std::vector<CuMatrix<BaseFloat> > *feats,
+                           std::vector<Posterior> *post,
+                           std::vector<Vector<BaseFloat> > *weights) {
+  Matrix<BaseFloat> proj(10, 5);
+  proj.SetRandn();
+  for (int32 m = 0; m < num_minibatches; m++) {
+    int32 num_rows = 50 + Rand() % 30;
+    Matrix<BaseFloat> mat(num_rows, 10);
+    mat.SetRandn();
+    Matrix<BaseFloat> scores(num_rows, 5);
+    scores.AddMatMat(1.0, mat, kNoTrans, proj, kNoTrans, 0.0);
+    Posterior p(num_rows);
+    for (int32 r = 0; r < num_rows; r++) {
+      int32 best;
+      scores.Row(r).Max(&best);
+      p[r].push_back(std::make_pair(best, 1.0));
+    }
+    Vector<BaseFloat> w(num_rows);
+    w.Set(1.0);
+    feats->push_back(CuMatrix<BaseFloat>(mat));
+    post->push_back(p);
+    weights->push_back(w);
+  }
+}
+
+static void Train(FrmshuffObjective *objective,
+                  const std::vector<CuMatrix<BaseFloat> > &feats,
+                  const std::vector<Posterior> &post,
+                  const std::vector<Vector<BaseFloat> > &weights) {
+  for (size_t m = 0; m < feats.size(); m++) {
+    FrmshuffMinibatch mb;
+    mb.feats = &feats[m];
+    mb.posterior = &post[m];
+    mb.frame_weights = &weights[m];
+    objective->Step(mb, false);
+  }
+  objective->Finish();
+}
+
+// The 'sync' mode does the same updates as the single-thread training,
+static void UnitTestParallelSync() {
+  std::vector<CuMatrix<BaseFloat> > feats;
+  std::vector<Posterior> post;
+  std::vector<Vector<BaseFloat> > weights;
+  GetMinibatches(20, &feats, &post, &weights);
+
+  Nnet nnet_ref;
+  InitNnet(&nnet_ref);
+  Nnet nnet(nnet_ref);
+
+  LossOptions loss_opts;
+  Xent xent_ref(loss_opts), xent(loss_opts);
+  LossObjective objective_ref(&nnet_ref, &xent_ref);
+  Train(&objective_ref, feats, post, weights);
+
+  NnetParallelOptions opts;
+  opts.num_threads = 3;
+  {
+    ParallelLossObjective objective(opts, &nnet, &xent);
+    Train(&objective, feats, post, weights);
+  }
+  // the learning rate was restored,
+  KALDI_ASSERT(nnet.GetTrainOptions().learn_rate ==
+               nnet_ref.GetTrainOptions().learn_rate);
+
+  Vector<BaseFloat> params_ref, params;
+  nnet_ref.GetParams(&params_ref);
+  nnet.GetParams(&params);
+  KALDI_LOG << "Loss " << xent_ref.AvgLoss() << " vs. " << xent.AvgLoss();
+  KALDI_ASSERT(params.ApproxEqual(params_ref, 1e-4));
+  KALDI_ASSERT(ApproxEqual(xent.AvgLoss(), xent_ref.AvgLoss(), 1e-4));
+}
+
+// The 'async' mode sees all the data and learns something,
+static void UnitTestParallelAsync() {
+  std::vector<CuMatrix<BaseFloat> > feats;
+  std::vector<Posterior> post;
+  std::vector<Vector<BaseFloat> > weights;
+  GetMinibatches(60, &feats, &post, &weights);
+
+  Nnet nnet;
+  InitNnet(&nnet);
+  Vector<BaseFloat> params_init;
+  nnet.GetParams(&params_init);
+
+  LossOptions loss_opts;
+  Xent xent(loss_opts);
+  NnetParallelOptions opts;
+  opts.num_threads = 3;
+  opts.parallel_mode = "async";
+  opts.sync_period = 2;
+  {
+    ParallelLossObjective objective(opts, &nnet, &xent);
+    Train(&objective, feats, post, weights);
+  }
+  int32 num_frames = 0;
+  for (size_t m = 0; m < feats.size(); m++) num_frames += feats[m].NumRows();
+
+  // cross-validation of the trained model and the initial one,
+  Nnet nnet_init(nnet);
+  nnet_init.SetParams(params_init);
+  Xent xent_cv(loss_opts), xent_init(loss_opts);
+  LossObjective objective_cv(&nnet, &xent_cv),
+    objective_init(&nnet_init, &xent_init);
+  for (size_t m = 0; m < feats.size(); m++) {
+    FrmshuffMinibatch mb;
+    mb.feats = &feats[m];
+    mb.posterior = &post[m];
+    mb.frame_weights = &weights[m];
+    objective_cv.Step(mb, true);
+    objective_init.Step(mb, true);
+  }
+  KALDI_LOG << "Loss " << xent_init.AvgLoss() << " -> " << xent_cv.AvgLoss();
+  KALDI_ASSERT(xent_cv.AvgLoss() < xent_init.AvgLoss());
+}
+
+int main() {
+  for (int32 i = 0; i < 3; i++) {
+    UnitTestParallelSync();
+  }
+  UnitTestParallelAsync();
+  std::cout << "Tests succeeded.\n";
+  return 0;
+}
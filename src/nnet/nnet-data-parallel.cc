@@ -0,0 +1,331 @@
+// nnet/nnet-data-parallel.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-data-parallel.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "util/kaldi-thread.h"
+#include "cudamatrix/cu-device.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+// One phase of the 'sync' step, thread 'r' works with replica 'r'
+// on its part of the mini-batch,
+class ParallelLossObjective::SyncJob : public MultiThreadable {
+ public:
+  enum Phase { kForward, kBackward, kSetParams };
+
+  SyncJob(ParallelLossObjective *obj, const CuMatrixBase<BaseFloat> *feats,
+          Phase phase):
+    obj_(obj), feats_(feats), phase_(phase) { }
+
+  void operator() () {
+    const int32 r = thread_id_,
+      num_rows = feats_->NumRows(),
+      begin = (r * num_rows) / num_threads_,
+      end = ((r + 1) * num_rows) / num_threads_;
+    Nnet *replica = obj_->replica_[r];
+    switch (phase_) {
+      case kForward:
+        replica->Propagate(feats_->RowRange(begin, end - begin),
+                           &obj_->replica_out_[r]);
+        break;
+      case kBackward:
+        replica->Backpropagate(
+            obj_->obj_diff_.RowRange(begin, end - begin), NULL);
+        replica->GetParams(&obj_->params_[r]);
+        break;
+      case kSetParams:
+        replica->SetParams(obj_->shared_params_);
+        break;
+    }
+  }
+
+ private:
+  ParallelLossObjective *obj_;
+  const CuMatrixBase<BaseFloat> *feats_;
+  Phase phase_;
+};
+
+
+ParallelLossObjective::ParallelLossObjective(const NnetParallelOptions &opts,
+                                             Nnet *nnet, LossItf *loss):
+    opts_(opts), nnet_(nnet), loss_(loss),
+    train_opts_(nnet->GetTrainOptions()),
+    num_busy_(0), stop_(false) {
+  if (opts_.num_threads < 1) {
+    KALDI_ERR << "Bad --num-threads " << opts_.num_threads;
+  }
+  if (opts_.parallel_mode != "sync" && opts_.parallel_mode != "async") {
+    KALDI_ERR << "Unknown --parallel-mode " << opts_.parallel_mode
+              << ", use sync|async";
+  }
+  if (opts_.sync_period < 1) {
+    KALDI_ERR << "Bad --parallel-sync-period " << opts_.sync_period;
+  }
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    KALDI_ERR << "Data-parallel training is for the CPU, use --use-gpu=no "
+              << "(or --num-threads=1).";
+  }
+#endif
+  const int32 num_replicas = opts_.num_threads;
+  params_.resize(num_replicas);
+  replica_out_.resize(num_replicas);
+  if (opts_.parallel_mode == "sync") {
+    // the average of the N updates has to be the full update,
+    NnetTrainOptions replica_opts(train_opts_);
+    replica_opts.learn_rate *= num_replicas;
+    replica_.push_back(nnet_);
+    for (int32 r = 1; r < num_replicas; r++) {
+      replica_.push_back(new Nnet(*nnet_));
+    }
+    for (int32 r = 0; r < num_replicas; r++) {
+      replica_[r]->SetTrainOptions(replica_opts);
+    }
+  } else {
+    // the updates of N threads merged with stale parameters behave like
+    // an implicit momentum of about 1 - 1/N, we reduce the explicit
+    // momentum by that much (or the training diverges with the usual 0.9),
+    NnetTrainOptions replica_opts(train_opts_);
+    BaseFloat implicit_momentum = 1.0 - 1.0 / num_replicas;
+    replica_opts.momentum = std::max<BaseFloat>(
+        0.0, train_opts_.momentum - implicit_momentum);
+    if (replica_opts.momentum != train_opts_.momentum) {
+      KALDI_LOG << "Async data-parallel training, the momentum is reduced "
+                << "from " << train_opts_.momentum << " to "
+                << replica_opts.momentum;
+    }
+    nnet_->GetParams(&shared_params_);
+    num_steps_.resize(num_replicas, 0);
+    for (int32 r = 0; r < num_replicas; r++) {
+      replica_.push_back(new Nnet(*nnet_));
+      replica_[r]->SetTrainOptions(replica_opts);
+      params_[r] = shared_params_;
+    }
+    for (int32 r = 0; r < num_replicas; r++) {
+      threads_.push_back(std::thread(&ParallelLossObjective::RunWorker,
+                                     this, r));
+    }
+  }
+  KALDI_LOG << "Data-parallel training with " << num_replicas
+            << " threads, --parallel-mode=" << opts_.parallel_mode;
+}
+
+ParallelLossObjective::~ParallelLossObjective() {
+  if (!threads_.empty()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    queue_cond_.notify_all();
+    for (size_t t = 0; t < threads_.size(); t++) threads_[t].join();
+    for (size_t j = 0; j < queue_.size(); j++) delete queue_[j];
+  }
+  for (size_t r = 0; r < replica_.size(); r++) {
+    if (replica_[r] != nnet_) delete replica_[r];
+  }
+}
+
+void ParallelLossObjective::Step(const FrmshuffMinibatch &mb,
+                                 bool crossvalidate) {
+  if (mb.flags != NULL) {
+    KALDI_ERR << "Data-parallel training does not support the frame flags "
+              << "(FSMN), use --num-threads=1.";
+  }
+  if (opts_.parallel_mode == "sync") {
+    StepSync(mb, crossvalidate);
+  } else {
+    StepAsync(mb, crossvalidate);
+  }
+}
+
+void ParallelLossObjective::StepSync(const FrmshuffMinibatch &mb,
+                                     bool crossvalidate) {
+  const CuMatrixBase<BaseFloat> &feats = *mb.feats;
+  const int32 num_parts = std::min<int32>(replica_.size(), feats.NumRows());
+  // forward pass of the parts,
+  {
+    MultiThreader<SyncJob> m(num_parts,
+                             SyncJob(this, &feats, SyncJob::kForward));
+  }
+  // the loss on the whole mini-batch,
+  nnet_out_.Resize(feats.NumRows(), replica_out_[0].NumCols(), kUndefined);
+  for (int32 r = 0; r < num_parts; r++) {
+    const int32 begin = (r * feats.NumRows()) / num_parts;
+    nnet_out_.RowRange(begin, replica_out_[r].NumRows())
+        .CopyFromMat(replica_out_[r]);
+  }
+  EvalMinibatchLoss(loss_, mb, nnet_out_, &obj_diff_);
+  if (crossvalidate) return;
+  // back-propagate the parts, update the replicas,
+  {
+    MultiThreader<SyncJob> m(num_parts,
+                             SyncJob(this, &feats, SyncJob::kBackward));
+  }
+  // average the replicas which did an update (the others have the
+  // parameters from the previous step, i.e. no update),
+  shared_params_ = params_[0];
+  for (int32 r = 1; r < replica_.size(); r++) {
+    if (r >= num_parts) replica_[r]->GetParams(&params_[r]);
+    shared_params_.AddVec(1.0, params_[r]);
+  }
+  shared_params_.Scale(1.0 / replica_.size());
+  {
+    MultiThreader<SyncJob> m(replica_.size(),
+                             SyncJob(this, &feats, SyncJob::kSetParams));
+  }
+}
+
+void ParallelLossObjective::StepAsync(const FrmshuffMinibatch &mb,
+                                      bool crossvalidate) {
+  Job *job = new Job;
+  job->feats = *mb.feats;
+  job->has_targets = (mb.targets != NULL);
+  if (job->has_targets) {
+    job->targets = *mb.targets;
+  } else {
+    job->posterior = *mb.posterior;
+  }
+  job->frame_weights = *mb.frame_weights;
+  job->crossvalidate = crossvalidate;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  // keep at most one waiting mini-batch per thread,
+  done_cond_.wait(lock, [this]() {
+    return queue_.size() < replica_.size() || error_;
+  });
+  if (error_) {
+    delete job;
+    std::rethrow_exception(error_);
+  }
+  queue_.push_back(job);
+  queue_cond_.notify_one();
+}
+
+void ParallelLossObjective::RunWorker(int32 r) {
+  Nnet *replica = replica_[r];
+  CuMatrix<BaseFloat> nnet_out, obj_diff;
+  while (true) {
+    Job *job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_cond_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return;  // stop_,
+      job = queue_.front();
+      queue_.pop_front();
+      num_busy_++;
+    }
+    try {
+      FrmshuffMinibatch mb;
+      mb.feats = &job->feats;
+      if (job->has_targets) {
+        mb.targets = &job->targets;
+      } else {
+        mb.posterior = &job->posterior;
+      }
+      mb.frame_weights = &job->frame_weights;
+
+      replica->Propagate(job->feats, &nnet_out);
+      {
+        std::unique_lock<std::mutex> lock(loss_mutex_);
+        EvalMinibatchLoss(loss_, mb, nnet_out, &obj_diff);
+      }
+      if (!job->crossvalidate) {
+        replica->Backpropagate(obj_diff, NULL);
+        if (++num_steps_[r] % opts_.sync_period == 0) {
+          MergeReplica(r);
+        }
+      }
+    } catch (...) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+    delete job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      num_busy_--;
+    }
+    done_cond_.notify_all();
+  }
+}
+
+void ParallelLossObjective::MergeReplica(int32 r) {
+  Vector<BaseFloat> params;
+  replica_[r]->GetParams(&params);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // shared += (replica - replica at the last merge),
+    shared_params_.AddVec(1.0, params);
+    shared_params_.AddVec(-1.0, params_[r]);
+    params_[r] = shared_params_;
+  }
+  replica_[r]->SetParams(params_[r]);
+}
+
+void ParallelLossObjective::Drain() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cond_.wait(lock, [this]() {
+    return (queue_.empty() && num_busy_ == 0) || error_;
+  });
+}
+
+void ParallelLossObjective::Finish() {
+  if (opts_.parallel_mode == "sync") {
+    nnet_->SetTrainOptions(train_opts_);
+    return;
+  }
+  if (threads_.empty()) return;  // finished already,
+  Drain();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cond_.notify_all();
+  for (size_t t = 0; t < threads_.size(); t++) threads_[t].join();
+  threads_.clear();
+  if (error_) std::rethrow_exception(error_);
+  for (int32 r = 0; r < replica_.size(); r++) {
+    MergeReplica(r);
+  }
+  nnet_->SetParams(shared_params_);
+}
+
+std::string ParallelLossObjective::Info(bool crossvalidate) const {
+  // the statistics of the 1st replica, after its last mini-batch,
+  if (!threads_.empty()) Drain();
+  std::ostringstream os;
+  os << replica_[0]->InfoPropagate();
+  if (!crossvalidate) {
+    os << replica_[0]->InfoBackPropagate() << replica_[0]->InfoGradient();
+  }
+  return os.str();
+}
+
+std::string ParallelLossObjective::Report() {
+  Xent *xent = dynamic_cast<Xent*>(loss_);
+  if (xent != NULL) {
+    return xent->ReportPerClass() + "\n" + xent->Report();
+  }
+  return loss_->Report();
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
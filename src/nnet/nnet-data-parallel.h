@@ -0,0 +1,156 @@
+// nnet/nnet-data-parallel.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_DATA_PARALLEL_H_
+#define KALDI_NNET_NNET_DATA_PARALLEL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "nnet/nnet-nnet.h"
+#include "nnet/nnet-loss.h"
+#include "nnet/nnet-frmshuff-trainer.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+struct NnetParallelOptions {
+  int32 num_threads;
+  std::string parallel_mode;
+  int32 sync_period;
+
+  NnetParallelOptions():
+    num_threads(1),
+    parallel_mode("sync"),
+    sync_period(4)
+  { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("num-threads", &num_threads,
+        "Number of threads for CPU data-parallel training "
+        "(1 = no data-parallelism)");
+    opts->Register("parallel-mode", &parallel_mode,
+        "sync|async, 'sync' splits each mini-batch among the threads and "
+        "averages the models after every mini-batch (deterministic, same "
+        "update as with 1 thread), 'async' gives whole mini-batches to "
+        "the threads which merge their updates in the shared model "
+        "(non-deterministic, faster; the staleness of the merged updates "
+        "acts as a momentum of about 1 - 1/num-threads, so the --momentum "
+        "is reduced by that much)");
+    opts->Register("parallel-sync-period", &sync_period,
+        "With --parallel-mode=async, number of mini-batches a thread "
+        "processes between merging its updates in the shared model");
+  }
+};
+
+
+/**
+ * Data-parallel training of one network with a loss on the CPU.
+ * Each thread trains its own replica of the network, the replicas
+ * are kept in sync by their parameters (Nnet::GetParams/SetParams):
+ *
+ * 'sync' mode: the mini-batch is split among the replicas, the loss is
+ * evaluated on the whole mini-batch, then each replica back-propagates
+ * its part with the learning rate multiplied by the number of replicas,
+ * and the replicas are set to the average of their parameters. As the
+ * SGD update (incl. momentum and L2) is linear in the gradient, this is
+ * the same update as with a single thread (L1 and max-norm are applied
+ * per replica, so they are approximated). The first replica is 'nnet'.
+ *
+ * 'async' mode: the mini-batches are queued for the threads, each
+ * thread trains its replica, and every 'sync_period' mini-batches it
+ * adds the change of its replica to the shared model and takes the
+ * shared model back. This is the Hogwild-like mode, the result depends
+ * on the thread scheduling. The staleness of the merged updates acts as
+ * an implicit momentum of about 1 - 1/N (N threads), so the replicas
+ * train with the momentum reduced by that much. The shared model is
+ * copied to 'nnet' in Finish().
+ *
+ * Not for the components with inter-frame state (FSMN, LSTM streams),
+ * the frames are assumed independent.
+ */
+class ParallelLossObjective : public FrmshuffObjective {
+ public:
+  ParallelLossObjective(const NnetParallelOptions &opts, Nnet *nnet,
+                        LossItf *loss);
+  ~ParallelLossObjective();
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+  void Finish();
+
+ private:
+  class SyncJob;
+
+  void StepSync(const FrmshuffMinibatch &mb, bool crossvalidate);
+  void StepAsync(const FrmshuffMinibatch &mb, bool crossvalidate);
+
+  /// Worker thread of the 'async' mode,
+  void RunWorker(int32 r);
+  /// Adds the change of replica 'r' to the shared model ('async' mode),
+  void MergeReplica(int32 r);
+  /// Waits until all the queued mini-batches were processed,
+  void Drain() const;
+
+  /// A copy of the mini-batch queued in the 'async' mode,
+  struct Job {
+    CuMatrix<BaseFloat> feats, targets;
+    Posterior posterior;
+    Vector<BaseFloat> frame_weights;
+    bool has_targets, crossvalidate;
+  };
+
+  NnetParallelOptions opts_;
+  Nnet *nnet_;
+  LossItf *loss_;
+  NnetTrainOptions train_opts_;  ///< The original options of 'nnet',
+
+  /// The replicas, replica_[0] is 'nnet_' in 'sync' mode,
+  std::vector<Nnet*> replica_;
+  /// The parameters of the replicas, in 'async' mode the values the
+  /// replicas had after the last merge,
+  std::vector<Vector<BaseFloat> > params_;
+  CuMatrix<BaseFloat> nnet_out_, obj_diff_;
+  std::vector<CuMatrix<BaseFloat> > replica_out_;
+
+  // 'async' mode,
+  Vector<BaseFloat> shared_params_;
+  std::vector<int32> num_steps_;
+  std::deque<Job*> queue_;
+  int32 num_busy_;
+  bool stop_;
+  std::exception_ptr error_;  ///< The first error of a worker thread,
+  mutable std::mutex mutex_;  ///< Guards the queue, the shared model,
+  std::mutex loss_mutex_;
+  mutable std::condition_variable queue_cond_, done_cond_;
+  std::vector<std::thread> threads_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ParallelLossObjective);
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_DATA_PARALLEL_H_
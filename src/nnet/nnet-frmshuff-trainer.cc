@@ -0,0 +1,865 @@
+// nnet/nnet-frmshuff-trainer.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-frmshuff-trainer.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "base/timer.h"
+#include "cudamatrix/cu-device.h"
+#include "nnet/nnet-data-loader.h"
+#include "nnet/nnet-utils.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+void EvalMinibatchLoss(LossItf *loss, const FrmshuffMinibatch &mb,
+                       const CuMatrixBase<BaseFloat> &nnet_out,
+                       CuMatrix<BaseFloat> *obj_diff) {
+  if (mb.targets != NULL) {
+    loss->Eval(*mb.frame_weights, nnet_out, *mb.targets, obj_diff);
+  } else {
+    KALDI_ASSERT(mb.posterior != NULL);
+    loss->Eval(*mb.frame_weights, nnet_out, *mb.posterior, obj_diff);
+  }
+}
+
+static std::string NnetInfo(const Nnet &nnet, bool crossvalidate) {
+  std::ostringstream os;
+  os << nnet.InfoPropagate();
+  if (!crossvalidate) {
+    os << nnet.InfoBackPropagate() << nnet.InfoGradient();
+  }
+  return os.str();
+}
+
+
+void LossObjective::Step(const FrmshuffMinibatch &mb, bool crossvalidate) {
+  if (mb.flags != NULL) nnet_->SetFlags(*mb.flags);
+  nnet_->Propagate(*mb.feats, &nnet_out_);
+  // gradients re-scaled by weights in Eval,
+  EvalMinibatchLoss(loss_, mb, nnet_out_, &obj_diff_);
+  if (!crossvalidate) {
+    nnet_->Backpropagate(obj_diff_, NULL);
+  }
+}
+
+std::string LossObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*nnet_, crossvalidate);
+}
+
+std::string LossObjective::Report() {
+  Xent *xent = dynamic_cast<Xent*>(loss_);
+  if (xent != NULL) {
+    return xent->ReportPerClass() + "\n" + xent->Report();
+  }
+  return loss_->Report();
+}
+
+
+void FgsmObjective::Step(const FrmshuffMinibatch &mb, bool crossvalidate) {
+  nnet_->Propagate(*mb.feats, &nnet_out_);
+  EvalMinibatchLoss(loss_, mb, nnet_out_, &obj_diff_);
+  if (crossvalidate) return;
+  nnet_->Backpropagate(obj_diff_, &in_diff_);
+  // the sign of the input gradient: -1 / +1,
+  in_diff_.ApplyHeaviside();
+  in_diff_.Scale(2.0);
+  in_diff_.Add(-1.0);
+  adv_in_ = *mb.feats;
+  adv_in_.AddMat(step_, in_diff_);
+  // update on the adversarial example,
+  nnet_->Propagate(adv_in_, &nnet_out_);
+  EvalMinibatchLoss(adv_loss_, mb, nnet_out_, &obj_diff_);
+  nnet_->Backpropagate(obj_diff_, NULL);
+}
+
+std::string FgsmObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*nnet_, crossvalidate);
+}
+
+std::string FgsmObjective::Report() {
+  std::string ans = loss_->Report();
+  if (adv_loss_->AvgLoss() != 0.0) {  // not used in cross-validation,
+    ans += "\nAdversarial examples:\n" + adv_loss_->Report();
+  }
+  return ans;
+}
+
+
+void ChainedObjective::Step(const FrmshuffMinibatch &mb, bool crossvalidate) {
+  bottom_->Propagate(*mb.feats, &bottom_out_);
+  top_->Propagate(bottom_out_, &top_out_);
+  EvalMinibatchLoss(loss_, mb, top_out_, &obj_diff_);
+  if (monitor_ != NULL) {
+    KALDI_ASSERT(mb.posterior != NULL);
+    monitor_->Propagate(bottom_out_, &monitor_out_);
+    monitor_loss_->Eval(*mb.frame_weights, monitor_out_, *mb.posterior,
+                        &monitor_diff_);
+  }
+  if (!crossvalidate) {
+    top_->Backpropagate(obj_diff_, &bottom_diff_);
+    bottom_->Backpropagate(bottom_diff_, NULL);
+  }
+}
+
+std::string ChainedObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*bottom_, crossvalidate) + NnetInfo(*top_, crossvalidate);
+}
+
+std::string ChainedObjective::Report() {
+  std::string ans = loss_->Report();
+  if (monitor_ != NULL) {
+    ans += "\nMonitor network:\n" + monitor_loss_->Report();
+  }
+  return ans;
+}
+
+
+void MergedTargetsObjective::Step(const FrmshuffMinibatch &mb,
+                                  bool crossvalidate) {
+  KALDI_ASSERT(mb.targets != NULL && mb.posterior != NULL);
+  PosteriorToMatrix(*mb.posterior, post_dim_, &post_mat_);
+  targets_.Resize(mb.targets->NumRows(), post_dim_ + mb.targets->NumCols(),
+                  kUndefined);
+  targets_.ColRange(0, post_dim_).CopyFromMat(post_mat_);
+  targets_.ColRange(post_dim_, mb.targets->NumCols()).CopyFromMat(*mb.targets);
+  nnet_->Propagate(*mb.feats, &nnet_out_);
+  loss_->Eval(*mb.frame_weights, nnet_out_, targets_, &obj_diff_);
+  if (!crossvalidate) {
+    nnet_->Backpropagate(obj_diff_, NULL);
+  }
+}
+
+std::string MergedTargetsObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*nnet_, crossvalidate);
+}
+
+std::string MergedTargetsObjective::Report() {
+  Xent *xent = dynamic_cast<Xent*>(loss_);
+  if (xent != NULL) {
+    return xent->ReportPerClass() + "\n" + xent->Report();
+  }
+  return loss_->Report();
+}
+
+
+AtnObjective::AtnObjective(Nnet *enh, Nnet *atn, LossItf *loss,
+                           LossOptions &loss_opts, BaseFloat loss_weight,
+                           int32 repeat_atn, bool train_enh, bool train_atn):
+    enh_(enh), atn_(atn), loss_(loss),
+    atn_loss_(loss_opts), adv_loss_(loss_opts), enh_adv_loss_(loss_opts),
+    loss_weight_(loss_weight), repeat_atn_(repeat_atn),
+    train_enh_(train_enh), train_atn_(train_atn) {
+  KALDI_ASSERT(atn_->InputDim() == atn_->OutputDim());
+  KALDI_ASSERT(atn_->OutputDim() == enh_->InputDim());
+}
+
+void AtnObjective::Step(const FrmshuffMinibatch &mb, bool crossvalidate) {
+  const CuMatrixBase<BaseFloat> &in = *mb.feats;
+  const Vector<BaseFloat> &weights = *mb.frame_weights;
+  // the batch loss of 'loss' stops the atn training (for mse),
+  Mse *mse = dynamic_cast<Mse*>(loss_);
+  if (train_enh_) {
+    enh_->Propagate(in, &enh_out_);
+    loss_->Eval(weights, enh_out_, *mb.targets, &obj_diff_);
+    if (!crossvalidate) {
+      enh_->Backpropagate(obj_diff_, NULL);
+    }
+  }
+  if (train_atn_) {
+    // the adversarial target is the centre frame of the spliced input,
+    int32 dim_out = enh_->OutputDim(),
+      half_splice = (enh_->InputDim() / dim_out - 1) / 2;
+    in_center_ = in.ColRange(dim_out * half_splice, dim_out);
+    for (int32 i = 0; i < repeat_atn_; i++) {
+      atn_->Propagate(in, &atn_out_);
+      atn_loss_.Eval(weights, atn_out_, in, &atn_diff_);
+      enh_->Propagate(atn_out_, &enh_out_);
+      adv_loss_.Eval(weights, enh_out_, in_center_, &adv_diff_);
+      if (!crossvalidate) {
+        enh_->Feedbackward(adv_diff_, &in_diff_);
+        atn_diff_.AddMat(loss_weight_, in_diff_);
+        atn_->Backpropagate(atn_diff_, NULL);
+      }
+      if (adv_loss_.BatchLoss() < (mse != NULL ? mse->BatchLoss() : 0.0)) {
+        break;
+      }
+    }
+  }
+  if (train_enh_) {
+    // train 'enh' on the transformed input,
+    atn_->Propagate(in, &atn_out_);
+    enh_->Propagate(atn_out_, &enh_out_);
+    enh_adv_loss_.Eval(weights, enh_out_, *mb.targets, &obj_diff_);
+    if (!crossvalidate) {
+      enh_->Backpropagate(obj_diff_, NULL);
+    }
+  }
+  KALDI_VLOG(1) << "Batch losses : "
+                << (mse != NULL ? mse->BatchLoss() : 0.0) << ", "
+                << atn_loss_.BatchLoss() << ", " << adv_loss_.BatchLoss()
+                << ", " << enh_adv_loss_.BatchLoss();
+}
+
+std::string AtnObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*enh_, crossvalidate) + NnetInfo(*atn_, crossvalidate);
+}
+
+std::string AtnObjective::Report() {
+  std::ostringstream os;
+  os << "enh: " << loss_->Report() << "\n"
+     << "atn: " << atn_loss_.Report() << "\n"
+     << "adversarial: " << adv_loss_.Report() << "\n"
+     << "enh on atn output: " << enh_adv_loss_.Report();
+  if (train_enh_) {
+    os << "\nENH training loss (wMse): "
+       << loss_->AvgLoss() + loss_weight_ * enh_adv_loss_.AvgLoss();
+  }
+  if (train_atn_) {
+    os << "\nATN training loss (wMse): "
+       << atn_loss_.AvgLoss() + loss_weight_ * adv_loss_.AvgLoss();
+  }
+  return os.str();
+}
+
+
+CycleObjective::CycleObjective(Nnet *nnet0, Nnet *nnet1,
+                               LossItf *loss_fwd, LossItf *loss_bwd,
+                               LossItf *loss_feats, LossItf *loss_targets,
+                               const std::vector<BaseFloat> &loss_weights,
+                               bool joint_update):
+    nnet0_(nnet0), nnet1_(nnet1),
+    loss_fwd_(loss_fwd), loss_bwd_(loss_bwd),
+    loss_feats_(loss_feats), loss_targets_(loss_targets),
+    loss_weights_(loss_weights), joint_update_(joint_update) {
+  KALDI_ASSERT(loss_weights_.size() == 4);
+  KALDI_ASSERT(joint_update_ || (loss_feats_ != NULL &&
+                                 loss_targets_ != NULL));
+}
+
+void CycleObjective::ResetJointBuffers(int32 num_rows) {
+  int32 feat_dim = nnet0_->InputDim(), tgt_dim = nnet0_->OutputDim();
+  fwd_in_.Resize(num_rows, feat_dim);
+  fwd_tgt_.Resize(num_rows, tgt_dim);
+  bwd_in_.Resize(num_rows, tgt_dim);
+  bwd_tgt_.Resize(num_rows, feat_dim);
+  fwd_weights_.Resize(num_rows);
+  bwd_weights_.Resize(num_rows);
+}
+
+void CycleObjective::Step(const FrmshuffMinibatch &mb, bool crossvalidate) {
+  const int32 n = (mb.feats != NULL ? mb.feats->NumRows() :
+                   mb.targets->NumRows());
+  weights_ = *mb.frame_weights;
+  if (joint_update_) {
+    if (fwd_in_.NumRows() == 0) ResetJointBuffers(2 * n);
+    KALDI_ASSERT(fwd_in_.NumRows() == 2 * n);
+    switch (mb.input) {
+      case 0:  // paired,
+        fwd_in_.RowRange(0, n).CopyFromMat(*mb.feats);
+        fwd_tgt_.RowRange(0, n).CopyFromMat(*mb.targets);
+        bwd_in_.RowRange(0, n).CopyFromMat(*mb.targets);
+        bwd_tgt_.RowRange(0, n).CopyFromMat(*mb.feats);
+        weights_.Scale(loss_weights_[0]);
+        fwd_weights_.Range(0, n).CopyFromVec(weights_);
+        weights_.CopyFromVec(*mb.frame_weights);
+        weights_.Scale(loss_weights_[1]);
+        bwd_weights_.Range(0, n).CopyFromVec(weights_);
+        break;
+      case 1:  // unpaired features, reconstructed by 'nnet1',
+        nnet0_->Feedforward(*mb.feats, &out0_);
+        bwd_in_.RowRange(n, n).CopyFromMat(out0_);
+        bwd_tgt_.RowRange(n, n).CopyFromMat(*mb.feats);
+        weights_.Scale(loss_weights_[2]);
+        bwd_weights_.Range(n, n).CopyFromVec(weights_);
+        break;
+      case 2:  // unpaired targets, reconstructed by 'nnet0',
+        nnet1_->Feedforward(*mb.targets, &out1_);
+        fwd_in_.RowRange(n, n).CopyFromMat(out1_);
+        fwd_tgt_.RowRange(n, n).CopyFromMat(*mb.targets);
+        weights_.Scale(loss_weights_[3]);
+        fwd_weights_.Range(n, n).CopyFromVec(weights_);
+        break;
+      default:
+        KALDI_ERR << "Unexpected input " << mb.input;
+    }
+    return;
+  }
+  switch (mb.input) {
+    case 0:  // paired,
+      nnet0_->Propagate(*mb.feats, &out0_);
+      nnet1_->Propagate(*mb.targets, &out1_);
+      weights_.Scale(loss_weights_[0]);
+      loss_fwd_->Eval(weights_, out0_, *mb.targets, &diff0_);
+      weights_.CopyFromVec(*mb.frame_weights);
+      weights_.Scale(loss_weights_[1]);
+      loss_bwd_->Eval(weights_, out1_, *mb.feats, &diff1_);
+      if (!crossvalidate) {
+        nnet0_->Backpropagate(diff0_, NULL);
+        nnet1_->Backpropagate(diff1_, NULL);
+      }
+      break;
+    case 1:  // unpaired features, only 'nnet1' is trained,
+      nnet0_->Propagate(*mb.feats, &out0_);
+      nnet1_->Propagate(out0_, &out1_);
+      weights_.Scale(loss_weights_[2]);
+      loss_feats_->Eval(weights_, out1_, *mb.feats, &diff1_);
+      if (!crossvalidate) {
+        nnet1_->Backpropagate(diff1_, NULL);
+      }
+      break;
+    case 2:  // unpaired targets, only 'nnet0' is trained,
+      nnet1_->Propagate(*mb.targets, &out1_);
+      nnet0_->Propagate(out1_, &out0_);
+      weights_.Scale(loss_weights_[3]);
+      loss_targets_->Eval(weights_, out0_, *mb.targets, &diff0_);
+      if (!crossvalidate) {
+        nnet0_->Backpropagate(diff0_, NULL);
+      }
+      break;
+    default:
+      KALDI_ERR << "Unexpected input " << mb.input;
+  }
+}
+
+void CycleObjective::EndRound(bool crossvalidate) {
+  if (!joint_update_ || fwd_in_.NumRows() == 0) return;
+  nnet0_->Propagate(fwd_in_, &out0_);
+  nnet1_->Propagate(bwd_in_, &out1_);
+  loss_fwd_->Eval(fwd_weights_, out0_, fwd_tgt_, &diff0_);
+  loss_bwd_->Eval(bwd_weights_, out1_, bwd_tgt_, &diff1_);
+  if (!crossvalidate) {
+    nnet0_->Backpropagate(diff0_, NULL);
+    nnet1_->Backpropagate(diff1_, NULL);
+  }
+  // the inputs exhausted in the next round leave zero-weight rows,
+  ResetJointBuffers(fwd_in_.NumRows());
+}
+
+std::string CycleObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*nnet0_, crossvalidate) + NnetInfo(*nnet1_, crossvalidate);
+}
+
+std::string CycleObjective::Report() {
+  std::string ans = loss_fwd_->Report() + "\n" + loss_bwd_->Report();
+  if (!joint_update_) {
+    ans += "\n" + loss_feats_->Report() + "\n" + loss_targets_->Report();
+  }
+  return ans;
+}
+
+
+ClusterFgsmObjective::ClusterFgsmObjective(Nnet *nnet, Nnet *regression,
+                                           Nnet *cluster,
+                                           LossOptions &loss_opts,
+                                           BaseFloat error_ratio,
+                                           BaseFloat step):
+    nnet_(nnet), regression_(regression), cluster_(cluster),
+    mse_(loss_opts), mse_adv_(loss_opts),
+    xent_(loss_opts), xent_adv_(loss_opts),
+    error_ratio_(error_ratio), step_(step)
+  { }
+
+void ClusterFgsmObjective::Step(const FrmshuffMinibatch &mb,
+                                bool crossvalidate) {
+  KALDI_ASSERT(mb.targets != NULL && mb.posterior != NULL);
+  if (mb.aux_weights != NULL) {
+    xent_weights_ = *mb.aux_weights;
+  } else {
+    xent_weights_.Resize(mb.feats->NumRows(), kUndefined);
+    xent_weights_.Set(1.0);
+  }
+  nnet_->Propagate(*mb.feats, &nnet_out_);
+  regression_->Propagate(nnet_out_, &regression_out_);
+  cluster_->Propagate(nnet_out_, &cluster_out_);
+  xent_.Eval(xent_weights_, cluster_out_, *mb.posterior, &cluster_diff_);
+  mse_.Eval(*mb.frame_weights, regression_out_, *mb.targets,
+            &regression_diff_);
+  if (crossvalidate) return;
+
+  regression_->Backpropagate(regression_diff_, &regression_in_diff_);
+  cluster_->Backpropagate(cluster_diff_, &cluster_in_diff_);
+  // the input gradient for the adversarial example: the regression error
+  // up, the cluster error down,
+  trunk_diff_ = regression_in_diff_;
+  trunk_diff_.AddMat(-error_ratio_, cluster_in_diff_);
+  nnet_->Feedbackward(trunk_diff_, &in_diff_);
+  // the update of the trunk,
+  regression_in_diff_.AddMat(error_ratio_, cluster_in_diff_);
+  nnet_->Backpropagate(regression_in_diff_, NULL);
+
+  // the sign of the input gradient: -1 / +1,
+  in_diff_.ApplyHeaviside();
+  in_diff_.Scale(2.0);
+  in_diff_.Add(-1.0);
+  adv_in_ = *mb.feats;
+  adv_in_.AddMat(step_, in_diff_);
+  // update on the adversarial example,
+  nnet_->Propagate(adv_in_, &nnet_out_);
+  regression_->Propagate(nnet_out_, &regression_out_);
+  cluster_->Propagate(nnet_out_, &cluster_out_);
+  mse_adv_.Eval(*mb.frame_weights, regression_out_, *mb.targets,
+                &regression_diff_);
+  xent_adv_.Eval(xent_weights_, cluster_out_, *mb.posterior, &cluster_diff_);
+  regression_->Backpropagate(regression_diff_, &regression_in_diff_);
+  cluster_->Backpropagate(cluster_diff_, &cluster_in_diff_);
+  regression_in_diff_.AddMat(error_ratio_, cluster_in_diff_);
+  nnet_->Backpropagate(regression_in_diff_, NULL);
+}
+
+std::string ClusterFgsmObjective::Info(bool crossvalidate) const {
+  return NnetInfo(*nnet_, crossvalidate) +
+    NnetInfo(*regression_, crossvalidate) +
+    NnetInfo(*cluster_, crossvalidate);
+}
+
+std::string ClusterFgsmObjective::Report() {
+  std::ostringstream os;
+  os << mse_.Report() << "\n" << xent_.Report();
+  // the total, the adversarial mse is not used in cross-validation,
+  BaseFloat total;
+  if (mse_adv_.AvgLoss() != 0.0) {
+    os << "\nAdversarial examples:\n" << mse_adv_.Report();
+    total = 0.5 * (mse_.AvgLoss() + mse_adv_.AvgLoss()) +
+      error_ratio_ * xent_.AvgLoss();
+  } else {
+    total = mse_.AvgLoss() + error_ratio_ * xent_.AvgLoss();
+  }
+  os << "\nAvgLoss: " << total << " (Mse+Xent)";
+  return os.str();
+}
+
+
+/// The readers of one FrmshuffInput: the sequential features and/or matrix
+/// targets (in lock-step), and the posteriors (random access).
+class FrmshuffInputReader {
+ public:
+  explicit FrmshuffInputReader(const FrmshuffInput &input):
+    has_feats_(input.feature_rspecifier != ""),
+    has_targets_(input.targets_rspecifier != ""),
+    has_posterior_(input.posterior_rspecifier != "") {
+    KALDI_ASSERT(has_feats_ || has_targets_);
+    if (has_feats_) feature_reader_.Open(input.feature_rspecifier);
+    if (has_targets_) targets_reader_.Open(input.targets_rspecifier);
+    if (has_posterior_) posterior_reader_.Open(input.posterior_rspecifier);
+  }
+
+  bool HasFeats() const { return has_feats_; }
+  bool HasTargets() const { return has_targets_; }
+  bool HasPosterior() const { return has_posterior_; }
+
+  bool Done() {
+    return (has_feats_ ? feature_reader_.Done() : targets_reader_.Done());
+  }
+
+  /// The key of the current utterance, checks that the features and
+  /// the matrix targets are in lock-step.
+  std::string Key() {
+    if (!has_feats_) return targets_reader_.Key();
+    if (has_targets_) {
+      if (targets_reader_.Done()) {
+        KALDI_ERR << "Out of matrix targets at " << feature_reader_.Key();
+      }
+      if (targets_reader_.Key() != feature_reader_.Key()) {
+        KALDI_ERR << "Features and matrix targets are not in the same "
+                  << "order: " << feature_reader_.Key() << " vs. "
+                  << targets_reader_.Key();
+      }
+    }
+    return feature_reader_.Key();
+  }
+
+  /// Advances the features and the matrix targets,
+  void Next() {
+    if (has_feats_) feature_reader_.Next();
+    if (has_targets_) targets_reader_.Next();
+  }
+
+  const Matrix<BaseFloat> &Feats() { return feature_reader_.Value(); }
+  const Matrix<BaseFloat> &Targets() { return targets_reader_.Value(); }
+  RandomAccessPosteriorReader &PosteriorReader() { return posterior_reader_; }
+
+ private:
+  bool has_feats_, has_targets_, has_posterior_;
+  SequentialBaseFloatMatrixReader feature_reader_, targets_reader_;
+  RandomAccessPosteriorReader posterior_reader_;
+};
+
+
+void FrmshuffTrainer::Train(const std::string &feature_rspecifier,
+                            const std::string &targets_rspecifier,
+                            const std::string &posterior_rspecifier,
+                            FrmshuffObjective *objective) {
+  KALDI_ASSERT(targets_rspecifier != "" || posterior_rspecifier != "");
+  std::vector<FrmshuffInput> inputs;
+  inputs.push_back(FrmshuffInput(feature_rspecifier, targets_rspecifier,
+                                 posterior_rspecifier));
+  Train(inputs, objective);
+}
+
+
+void FrmshuffTrainer::Train(const std::vector<FrmshuffInput> &inputs,
+                            FrmshuffObjective *objective) {
+  const int32 num_inputs = inputs.size();
+  KALDI_ASSERT(num_inputs > 0);
+
+  Nnet nnet_transf, nnet_transt;
+  if (opts_.feature_transform != "") {
+    nnet_transf.Read(opts_.feature_transform);
+  }
+  if (opts_.targets_transform != "") {
+    nnet_transt.Read(opts_.targets_transform);
+  }
+  if (opts_.crossvalidate) {
+    nnet_transf.SetDropoutRate(0.0);
+  }
+
+  std::vector<FrmshuffInputReader*> readers;
+  for (int32 i = 0; i < num_inputs; i++) {
+    readers.push_back(new FrmshuffInputReader(inputs[i]));
+  }
+  RandomAccessBaseFloatVectorReader weights_reader;
+  if (opts_.frame_weights != "") {
+    weights_reader.Open(opts_.frame_weights);
+  }
+  RandomAccessBaseFloatReader utt_weights_reader;
+  if (opts_.utt_weights != "") {
+    utt_weights_reader.Open(opts_.utt_weights);
+  }
+  const bool has_aux_weights = (opts_.aux_weights != "");
+  RandomAccessBaseFloatVectorReader aux_weights_reader;
+  if (has_aux_weights) {
+    aux_weights_reader.Open(opts_.aux_weights);
+  }
+
+  RandomizerMask randomizer_mask(rnd_opts_);
+  FrameSelector frame_selector(opts_.weight_sampling,
+                               rnd_opts_.randomizer_seed);
+  CuMatrix<BaseFloat> feats_transf, targets_transf;
+
+  Timer time;
+  KALDI_LOG << (opts_.crossvalidate ? "CROSS-VALIDATION" : "TRAINING")
+            << " STARTED";
+
+  int64 num_frames_loaded = 0;
+
+  // streams of the randomizer bundles: matrix 0 is the features (or the
+  // targets of a targets-only input), matrix 1 the targets; vector 0 the
+  // frame weights, followed by the optional flags and aux weights,
+  const int32 kWeightsVec = 0, kFlagsVec = 1,
+    kAuxWeightsVec = (opts_.utterance_flags ? 2 : 1);
+
+  // fill the randomizers, this runs in a background thread
+  // while we train on the previous buffer,
+  typedef std::vector<RandomizerBundle> Buffer;
+  DoubleBufferedLoader<Buffer>::FillFunction fill =
+      [&](Buffer *buf) -> bool {
+    bool more = false;
+    for (int32 i = 0; i < num_inputs; i++) {
+      FrmshuffInputReader &reader = *readers[i];
+      RandomizerBundle &bundle = (*buf)[i];
+      const bool has_feats = reader.HasFeats(),
+                 has_targets = reader.HasTargets(),
+                 has_posterior = reader.HasPosterior();
+      const int32 targets_mat = (has_feats ? 1 : 0);
+      for ( ; !reader.Done(); reader.Next()) {
+        if (bundle.IsFull()) {
+          // break the loop without calling Next(),
+          // we keep the 'utt' for next round,
+          break;
+        }
+        std::string utt = reader.Key(),
+          key = (key_map_ ? key_map_(utt) : utt);
+        KALDI_VLOG(3) << "Reading " << utt;
+        // check that we have posteriors,
+        if (has_posterior && !reader.PosteriorReader().HasKey(key)) {
+          KALDI_WARN << key << ", missing targets";
+          num_no_tgt_mat_++;
+          continue;
+        }
+        // check we have per-frame weights,
+        if (opts_.frame_weights != "" && !weights_reader.HasKey(key)) {
+          KALDI_WARN << key << ", missing per-frame weights";
+          num_other_error_++;
+          continue;
+        }
+        // check we have per-utterance weights,
+        if (opts_.utt_weights != "" && !utt_weights_reader.HasKey(key)) {
+          KALDI_WARN << key << ", missing per-utterance weight";
+          num_other_error_++;
+          continue;
+        }
+        if (has_aux_weights && !aux_weights_reader.HasKey(key)) {
+          KALDI_WARN << key << ", missing aux per-frame weights";
+          num_other_error_++;
+          continue;
+        }
+        Matrix<BaseFloat> mat, targets;
+        if (has_feats) mat = reader.Feats();
+        if (has_targets) targets = reader.Targets();
+        int32 num_rows = (has_feats ? mat.NumRows() : targets.NumRows());
+        Posterior post;
+        if (has_posterior) {
+          post = reader.PosteriorReader().Value(key);
+        }
+        // get per-frame weights,
+        Vector<BaseFloat> weights;
+        if (opts_.frame_weights != "") {
+          weights = weights_reader.Value(key);
+        } else {  // all per-frame weights are 1.0,
+          weights.Resize(num_rows);
+          weights.Set(1.0);
+        }
+        // multiply with per-utterance weight,
+        if (opts_.utt_weights != "") {
+          BaseFloat w = utt_weights_reader.Value(key);
+          KALDI_ASSERT(w >= 0.0);
+          if (w == 0.0) continue;  // remove sentence from training,
+          weights.Scale(w);
+        }
+        Vector<BaseFloat> aux_weights;
+        if (has_aux_weights) {
+          aux_weights = aux_weights_reader.Value(key);
+        }
+
+        // skip too long utterances (or we run out of memory),
+        if (num_rows > opts_.max_frames) {
+          KALDI_WARN << "Utterance too long, skipping! " << utt
+            << " (length " << num_rows << ", max_frames "
+            << opts_.max_frames << ")";
+          num_other_error_++;
+          continue;
+        }
+
+        // correct small length mismatch or drop sentence,
+        {
+          // add lengths to vector,
+          std::vector<int32> length;
+          if (has_feats) length.push_back(mat.NumRows());
+          if (has_targets) length.push_back(targets.NumRows());
+          if (has_posterior) length.push_back(post.size());
+          length.push_back(weights.Dim());
+          if (has_aux_weights) length.push_back(aux_weights.Dim());
+          // find min, max,
+          int32 min = *std::min_element(length.begin(), length.end());
+          int32 max = *std::max_element(length.begin(), length.end());
+          // fix or drop ?
+          if (max - min < opts_.length_tolerance) {
+            // we truncate to shortest,
+            if (has_feats && mat.NumRows() != min) {
+              mat.Resize(min, mat.NumCols(), kCopyData);
+            }
+            if (has_targets && targets.NumRows() != min) {
+              targets.Resize(min, targets.NumCols(), kCopyData);
+            }
+            if (has_posterior && post.size() != min) post.resize(min);
+            if (weights.Dim() != min) weights.Resize(min, kCopyData);
+            if (has_aux_weights && aux_weights.Dim() != min) {
+              aux_weights.Resize(min, kCopyData);
+            }
+          } else {
+            KALDI_WARN << "Length mismatch! Targets "
+                       << (has_targets ? targets.NumRows() : post.size())
+                       << ", features " << mat.NumRows() << ", " << utt;
+            num_other_error_++;
+            continue;
+          }
+        }
+        // apply the transforms (if empty, input is copied),
+        if (has_feats) {
+          nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
+        }
+        if (has_targets) {
+          nnet_transt.Feedforward(CuMatrix<BaseFloat>(targets),
+                                  &targets_transf);
+        }
+
+        // remove frames with '0' weight from training, (and sample from
+        // the low-weight frames, with --weight-sampling),
+        std::vector<MatrixIndexT> keep_frames;
+        if (frame_selector.Select(&weights, &keep_frames)) {
+          // when all frames are removed, we skip the sentence,
+          if (keep_frames.size() == 0) continue;
+          CuArray<MatrixIndexT> keep_frames_cu(keep_frames);
+          CuMatrix<BaseFloat> tmp;
+
+          // filter feature-frames,
+          if (has_feats) {
+            tmp.Resize(keep_frames.size(), feats_transf.NumCols());
+            tmp.CopyRows(feats_transf, keep_frames_cu);
+            tmp.Swap(&feats_transf);
+          }
+          // filter targets,
+          if (has_targets) {
+            tmp.Resize(keep_frames.size(), targets_transf.NumCols());
+            tmp.CopyRows(targets_transf, keep_frames_cu);
+            tmp.Swap(&targets_transf);
+          }
+          if (has_posterior) {
+            Posterior tmp_post;
+            for (int32 i = 0; i < keep_frames.size(); i++) {
+              tmp_post.push_back(post[keep_frames[i]]);
+            }
+            tmp_post.swap(post);
+          }
+          if (has_aux_weights) {
+            Vector<BaseFloat> tmp_weights(keep_frames.size(), kUndefined);
+            for (int32 i = 0; i < keep_frames.size(); i++) {
+              tmp_weights(i) = aux_weights(keep_frames[i]);
+            }
+            tmp_weights.Swap(&aux_weights);
+          }
+        }
+
+        // pass data to randomizers,
+        if (has_feats) bundle.Mat(0).AddData(feats_transf);
+        if (has_targets) {
+          KALDI_ASSERT(!has_feats ||
+                       feats_transf.NumRows() == targets_transf.NumRows());
+          bundle.Mat(targets_mat).AddData(targets_transf);
+        }
+        num_rows = (has_feats ? feats_transf.NumRows() :
+                    targets_transf.NumRows());
+        if (has_posterior) {
+          KALDI_ASSERT(num_rows == post.size());
+          bundle.Post(0).AddData(post);
+        }
+        bundle.Vec(kWeightsVec).AddData(weights);
+        if (opts_.utterance_flags) {
+          Vector<BaseFloat> flags(num_rows, kUndefined);
+          flags.Set(static_cast<BaseFloat>(num_done_));
+          bundle.Vec(kFlagsVec).AddData(flags);
+        }
+        if (has_aux_weights) bundle.Vec(kAuxWeightsVec).AddData(aux_weights);
+        num_done_++;
+        num_frames_loaded += num_rows;
+
+        // report the speed,
+        if (num_done_ % 5000 == 0) {
+          double time_now = time.Elapsed();
+          KALDI_VLOG(1) << "After " << num_done_ << " utterances: "
+            << "time elapsed = " << time_now / 60 << " min; "
+            << "loaded " << num_frames_loaded / time_now
+            << " frames per sec.";
+        }
+      }
+
+      // randomize,
+      if (!opts_.crossvalidate && opts_.randomize) {
+        bundle.Randomize(&randomizer_mask);
+      }
+      if (!reader.Done()) more = true;
+    }
+    return more;
+  };
+
+  Buffer prototype;
+  for (int32 i = 0; i < num_inputs; i++) {
+    const FrmshuffInputReader &reader = *readers[i];
+    prototype.push_back(RandomizerBundle(
+        rnd_opts_, (reader.HasFeats() && reader.HasTargets()) ? 2 : 1,
+        reader.HasPosterior() ? 1 : 0,
+        1 + (opts_.utterance_flags ? 1 : 0) + (has_aux_weights ? 1 : 0)));
+  }
+  DoubleBufferedLoader<Buffer> loader(prototype, fill);
+
+  // main loop,
+  Buffer *buf;
+  int64 next_info = 25000;
+  while ((buf = loader.Next()) != NULL) {
+#if HAVE_CUDA == 1
+    // check that GPU computes accurately,
+    CuDevice::Instantiate().CheckGpuHealth();
+#endif
+    // train with data from randomizers (using mini-batches), in rounds of
+    // one mini-batch per input,
+    while (true) {
+      bool done = true;
+      for (int32 i = 0; i < num_inputs; i++) {
+        RandomizerBundle &bundle = (*buf)[i];
+        if (bundle.Done()) continue;
+        done = false;
+        const FrmshuffInputReader &reader = *readers[i];
+        FrmshuffMinibatch mb;
+        mb.input = i;
+        if (reader.HasFeats()) mb.feats = &bundle.Mat(0).Value();
+        if (reader.HasTargets()) {
+          mb.targets = &bundle.Mat(reader.HasFeats() ? 1 : 0).Value();
+        }
+        if (reader.HasPosterior()) mb.posterior = &bundle.Post(0).Value();
+        mb.frame_weights = &bundle.Vec(kWeightsVec).Value();
+        if (opts_.utterance_flags) mb.flags = &bundle.Vec(kFlagsVec).Value();
+        if (has_aux_weights) {
+          mb.aux_weights = &bundle.Vec(kAuxWeightsVec).Value();
+        }
+
+        objective->Step(mb, opts_.crossvalidate);
+
+        // 1st mini-batch : show what happens in network,
+        if (total_frames_ == 0) {
+          KALDI_VLOG(1) << "### After " << total_frames_ << " frames,";
+          KALDI_VLOG(1) << objective->Info(opts_.crossvalidate);
+        }
+
+        total_frames_ += bundle.Mat(0).Value().NumRows();
+
+        // monitor the NN training (--verbose=2), print every 25k frames,
+        if (total_frames_ >= next_info) {
+          KALDI_VLOG(2) << "### After " << total_frames_ << " frames,";
+          KALDI_VLOG(2) << objective->Info(opts_.crossvalidate);
+          next_info += 25000;
+        }
+        bundle.Next();
+      }
+      if (done) break;
+      objective->EndRound(opts_.crossvalidate);
+    }
+  }  // main loop,
+  objective->Finish();
+  if (frame_selector.NumFramesKept() < frame_selector.NumFramesIn()) {
+    KALDI_LOG << "Frame selection kept " << frame_selector.NumFramesKept()
+              << " of " << frame_selector.NumFramesIn() << " frames.";
+  }
+
+  // after last mini-batch : show what happens in network,
+  KALDI_VLOG(1) << "### After " << total_frames_ << " frames,";
+  KALDI_VLOG(1) << objective->Info(opts_.crossvalidate);
+
+  for (int32 i = 0; i < num_inputs; i++) {
+    delete readers[i];
+  }
+  elapsed_ = time.Elapsed();
+}
+
+
+std::string FrmshuffTrainer::Report() const {
+  std::ostringstream os;
+  os << "Done " << num_done_ << " files, "
+     << num_no_tgt_mat_ << " with no tgt_mats, "
+     << num_other_error_ << " with other errors. "
+     << "[" << (opts_.crossvalidate ? "CROSS-VALIDATION" : "TRAINING")
+     << ", " << (opts_.randomize ? "RANDOMIZED" : "NOT-RANDOMIZED")
+     << ", " << elapsed_ / 60 << " min, processing "
+     << total_frames_ / elapsed_ << " frames per sec.]";
+  return os.str();
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
@@ -0,0 +1,420 @@
+// nnet/nnet-frmshuff-trainer.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_FRMSHUFF_TRAINER_H_
+#define KALDI_NNET_NNET_FRMSHUFF_TRAINER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/posterior.h"
+#include "cudamatrix/cu-matrix.h"
+#include "nnet/nnet-nnet.h"
+#include "nnet/nnet-loss.h"
+#include "nnet/nnet-randomizer.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/**
+ * This file contains the engine of the frame-shuffling trainers
+ * (nnet-train-frmshuff and its regression/adversarial/multi-condition
+ * variants). The engine does the part which used to be copy-pasted in
+ * every binary: reading the features and targets, the feature/targets
+ * transforms, the length checks, the frame weights, the randomization
+ * (with the input read in a background thread, see nnet-data-loader.h)
+ * and the progress reports. What is done with a mini-batch is decided
+ * by a FrmshuffObjective, so a new training recipe only needs a new
+ * objective and a thin binary.
+ */
+
+struct FrmshuffTrainOptions {
+  bool crossvalidate;
+  bool randomize;
+  std::string feature_transform;
+  std::string targets_transform;
+  std::string frame_weights;
+  std::string utt_weights;
+  int32 length_tolerance;
+  int32 max_frames;
+  BaseFloat weight_sampling;
+  /// Attach to each frame the index of its utterance (FrmshuffMinibatch::flags),
+  /// used by the FSMN components. Not a command-line option,
+  bool utterance_flags;
+  /// Second set of per-frame weights (FrmshuffMinibatch::aux_weights), for
+  /// the objectives with 2 losses. Not registered here, the binary names
+  /// the option,
+  std::string aux_weights;
+
+  FrmshuffTrainOptions():
+    crossvalidate(false),
+    randomize(true),
+    length_tolerance(5),
+    max_frames(360000),
+    weight_sampling(0.0),
+    utterance_flags(false)
+  { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("cross-validate", &crossvalidate,
+        "Perform cross-validation (don't back-propagate)");
+    opts->Register("randomize", &randomize,
+        "Perform the frame-level shuffling within the Cache::");
+    opts->Register("feature-transform", &feature_transform,
+        "Feature transform in Nnet format");
+    opts->Register("targets-transform", &targets_transform,
+        "Transform of the matrix targets in Nnet format");
+    opts->Register("frame-weights", &frame_weights,
+        "Per-frame weights, used to re-scale gradients.");
+    opts->Register("utt-weights", &utt_weights,
+        "Per-utterance weights, used to re-scale frame-weights.");
+    opts->Register("length-tolerance", &length_tolerance,
+        "Allowed length mismatch of features/targets/weights "
+        "(in frames, we truncate to the shortest)");
+    opts->Register("max-frames", &max_frames,
+        "Maximum number of frames an utterance can have (skipped if longer)");
+    opts->Register("weight-sampling", &weight_sampling,
+        "Importance sampling by frame weight: a frame with weight w below "
+        "this value is kept with probability w / value, with the weight "
+        "raised to the value (0 = off, only zero-weight frames are dropped)");
+  }
+};
+
+
+/// One input of the trainer. The usual trainers have one input with
+/// features and targets, the chain trainers also have inputs with unpaired
+/// features or unpaired targets only. Each input has its own randomizer.
+struct FrmshuffInput {
+  /// Features (read sequentially), may be empty for a targets-only input,
+  std::string feature_rspecifier;
+  /// Matrix targets (read sequentially, in lock-step with the features),
+  std::string targets_rspecifier;
+  /// Posterior targets (random access),
+  std::string posterior_rspecifier;
+
+  FrmshuffInput() { }
+  FrmshuffInput(const std::string &feature_rspecifier,
+                const std::string &targets_rspecifier,
+                const std::string &posterior_rspecifier):
+    feature_rspecifier(feature_rspecifier),
+    targets_rspecifier(targets_rspecifier),
+    posterior_rspecifier(posterior_rspecifier)
+  { }
+};
+
+
+/// One mini-batch, as passed to FrmshuffObjective::Step().
+/// The pointers not provided by the trainer are NULL.
+struct FrmshuffMinibatch {
+  const CuMatrixBase<BaseFloat> *feats;
+  const CuMatrixBase<BaseFloat> *targets;  ///< Matrix targets (regression),
+  const Posterior *posterior;  ///< Posterior targets (or alignment),
+  const Vector<BaseFloat> *frame_weights;
+  const Vector<BaseFloat> *flags;  ///< Utterance index of each frame,
+  const Vector<BaseFloat> *aux_weights;  ///< See FrmshuffTrainOptions,
+  int32 input;  ///< Index of the FrmshuffInput the mini-batch comes from,
+
+  FrmshuffMinibatch():
+    feats(NULL), targets(NULL), posterior(NULL),
+    frame_weights(NULL), flags(NULL), aux_weights(NULL), input(0)
+  { }
+};
+
+
+/// What the trainer does with a mini-batch.
+class FrmshuffObjective {
+ public:
+  virtual ~FrmshuffObjective() { }
+
+  /// Forward pass, objective function and (unless 'crossvalidate')
+  /// back-propagation with the update,
+  virtual void Step(const FrmshuffMinibatch &mb, bool crossvalidate) = 0;
+
+  /// Statistics of the network(s) for the verbose log,
+  virtual std::string Info(bool crossvalidate) const = 0;
+
+  /// Final report of the objective function(s),
+  virtual std::string Report() = 0;
+
+  /// Called after each round of Step() calls: a round is one mini-batch
+  /// of every input which still has data (i.e. after every Step() when
+  /// there is a single input),
+  virtual void EndRound(bool crossvalidate) { }
+
+  /// Called after the last mini-batch (i.e. to finish pending work),
+  virtual void Finish() { }
+};
+
+
+/// Evaluates 'loss' against the targets of the mini-batch: the matrix
+/// targets if present, the posteriors otherwise,
+void EvalMinibatchLoss(LossItf *loss, const FrmshuffMinibatch &mb,
+                       const CuMatrixBase<BaseFloat> &nnet_out,
+                       CuMatrix<BaseFloat> *obj_diff);
+
+
+/// The usual case: one network, one loss ('xent', 'mse', ...),
+/// evaluated against the matrix targets if present, or the posteriors.
+class LossObjective : public FrmshuffObjective {
+ public:
+  LossObjective(Nnet *nnet, LossItf *loss): nnet_(nnet), loss_(loss) { }
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  Nnet *nnet_;
+  LossItf *loss_;
+  CuMatrix<BaseFloat> nnet_out_, obj_diff_;
+};
+
+
+/// Adversarial training with the fast gradient sign method: after the
+/// update on the clean mini-batch, the input is moved by 'step' in the
+/// direction of the sign of the input gradient, and the network is
+/// updated once more on the perturbed input with 'adv_loss'.
+class FgsmObjective : public FrmshuffObjective {
+ public:
+  FgsmObjective(Nnet *nnet, LossItf *loss, LossItf *adv_loss,
+                BaseFloat step):
+    nnet_(nnet), loss_(loss), adv_loss_(adv_loss), step_(step)
+  { }
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  Nnet *nnet_;
+  LossItf *loss_, *adv_loss_;
+  BaseFloat step_;
+  CuMatrix<BaseFloat> nnet_out_, obj_diff_, in_diff_, adv_in_;
+};
+
+
+/// Two networks applied in a chain (i.e. a network split at some layer),
+/// the loss is evaluated on the output of 'top'. Optionally, a 'monitor'
+/// network is fed by the output of 'bottom', and its loss against the
+/// posteriors is reported (the monitor network is not trained).
+class ChainedObjective : public FrmshuffObjective {
+ public:
+  ChainedObjective(Nnet *bottom, Nnet *top, LossItf *loss):
+    bottom_(bottom), top_(top), loss_(loss),
+    monitor_(NULL), monitor_loss_(NULL)
+  { }
+
+  void SetMonitor(Nnet *monitor, LossItf *monitor_loss) {
+    monitor_ = monitor;
+    monitor_loss_ = monitor_loss;
+  }
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  Nnet *bottom_, *top_;
+  LossItf *loss_;
+  Nnet *monitor_;
+  LossItf *monitor_loss_;
+  CuMatrix<BaseFloat> bottom_out_, top_out_, obj_diff_, bottom_diff_,
+    monitor_out_, monitor_diff_;
+};
+
+
+/// The loss against the matrix [ posteriors | matrix targets ], i.e. the
+/// posteriors (as a 'post_dim' matrix) pasted before the matrix targets,
+/// for a 'multitask' loss with a classification and a regression part.
+class MergedTargetsObjective : public FrmshuffObjective {
+ public:
+  MergedTargetsObjective(Nnet *nnet, LossItf *loss, int32 post_dim):
+    nnet_(nnet), loss_(loss), post_dim_(post_dim)
+  { }
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  Nnet *nnet_;
+  LossItf *loss_;
+  int32 post_dim_;
+  CuMatrix<BaseFloat> post_mat_, targets_, nnet_out_, obj_diff_;
+};
+
+
+/// Enhancement network 'enh' trained together with an adversarial
+/// transformation network 'atn' (of the input features): 'atn' is trained
+/// to stay close to its input ('atn_loss'), while leading 'enh' to output
+/// the centre frame of its (noisy) input ('adv_loss', weighted by
+/// 'loss_weight'); 'enh' is trained on the clean and on the transformed
+/// input ('loss' and 'enh_adv_loss'). Either network can be frozen.
+class AtnObjective : public FrmshuffObjective {
+ public:
+  AtnObjective(Nnet *enh, Nnet *atn, LossItf *loss, LossOptions &loss_opts,
+               BaseFloat loss_weight, int32 repeat_atn,
+               bool train_enh, bool train_atn);
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  Nnet *enh_, *atn_;
+  LossItf *loss_;
+  Mse atn_loss_, adv_loss_, enh_adv_loss_;
+  BaseFloat loss_weight_;
+  int32 repeat_atn_;
+  bool train_enh_, train_atn_;
+  CuMatrix<BaseFloat> enh_out_, atn_out_, in_center_, obj_diff_, atn_diff_,
+    adv_diff_, in_diff_;
+};
+
+
+/// Chain training of a forward network 'nnet0' (features -> targets) and
+/// a backward network 'nnet1' (targets -> features), with 3 inputs:
+/// paired features/targets (input 0), unpaired features (input 1) and
+/// unpaired targets (input 2). The paired data train both networks
+/// directly, the unpaired features train 'nnet1' to reconstruct them from
+/// the output of 'nnet0', and the unpaired targets train 'nnet0' to
+/// reconstruct them from the output of 'nnet1'. The 4 'loss_weights' scale
+/// the losses: paired forward, paired backward, unpaired features, unpaired
+/// targets.
+///
+/// With 'joint_update', the paired data and the reconstructions of the
+/// unpaired data are collected during a round (the network outputs are
+/// computed without training), and both networks are updated once per
+/// round on the 2 * minibatch_size frames.
+class CycleObjective : public FrmshuffObjective {
+ public:
+  CycleObjective(Nnet *nnet0, Nnet *nnet1,
+                 LossItf *loss_fwd, LossItf *loss_bwd,
+                 LossItf *loss_feats, LossItf *loss_targets,
+                 const std::vector<BaseFloat> &loss_weights,
+                 bool joint_update);
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  void EndRound(bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  /// Resizes the joint-update buffers (zeroed) to 'num_rows' rows,
+  void ResetJointBuffers(int32 num_rows);
+
+  Nnet *nnet0_, *nnet1_;
+  LossItf *loss_fwd_, *loss_bwd_, *loss_feats_, *loss_targets_;
+  std::vector<BaseFloat> loss_weights_;
+  bool joint_update_;
+  Vector<BaseFloat> weights_;
+  CuMatrix<BaseFloat> out0_, out1_, diff0_, diff1_;
+  // joint update: rows [0, n) are the paired data, rows [n, 2n) the
+  // reconstructions of the unpaired data,
+  CuMatrix<BaseFloat> fwd_in_, fwd_tgt_, bwd_in_, bwd_tgt_;
+  Vector<BaseFloat> fwd_weights_, bwd_weights_;
+};
+
+
+/// Trunk network 'nnet' with a regression head (trained by 'mse' on the
+/// matrix targets) and a cluster head (trained by 'xent' on the posteriors,
+/// weighted by 'error_ratio'). The trunk gets the gradient of the
+/// regression head plus the cluster one, and is updated once more on the
+/// input moved by 'step' in the direction of the sign of the gradient of
+/// the regression head minus the cluster one (fast gradient sign method).
+/// The xent is weighted by FrmshuffMinibatch::aux_weights if present.
+class ClusterFgsmObjective : public FrmshuffObjective {
+ public:
+  ClusterFgsmObjective(Nnet *nnet, Nnet *regression, Nnet *cluster,
+                       LossOptions &loss_opts, BaseFloat error_ratio,
+                       BaseFloat step);
+
+  void Step(const FrmshuffMinibatch &mb, bool crossvalidate);
+  std::string Info(bool crossvalidate) const;
+  std::string Report();
+
+ private:
+  Nnet *nnet_, *regression_, *cluster_;
+  Mse mse_, mse_adv_;
+  Xent xent_, xent_adv_;
+  BaseFloat error_ratio_, step_;
+  Vector<BaseFloat> xent_weights_;
+  CuMatrix<BaseFloat> nnet_out_, regression_out_, cluster_out_,
+    regression_diff_, cluster_diff_, regression_in_diff_, cluster_in_diff_,
+    trunk_diff_, in_diff_, adv_in_;
+};
+
+
+/**
+ * One epoch of frame-shuffling training (or cross-validation).
+ *
+ * The features are read sequentially, the targets come from
+ * 'targets_rspecifier' (matrices, read in lock-step with the features)
+ * and/or 'posterior_rspecifier' (random access), at least one of them
+ * is needed. The frame weights and utterance weights are read from
+ * the options.
+ *
+ * With several inputs, each input is read and shuffled separately,
+ * the objective gets one mini-batch of each input per round, until all
+ * the inputs are exhausted. An input may then have only features or only
+ * targets (passed through the targets transform).
+ */
+class FrmshuffTrainer {
+ public:
+  /// Maps the key of the features to the key of the posteriors,
+  /// frame weights and utterance weights (multi-condition training),
+  typedef std::function<std::string(const std::string&)> KeyMap;
+
+  FrmshuffTrainer(const FrmshuffTrainOptions &opts,
+                  const NnetDataRandomizerOptions &rnd_opts):
+    opts_(opts), rnd_opts_(rnd_opts),
+    num_done_(0), num_no_tgt_mat_(0), num_other_error_(0),
+    total_frames_(0), elapsed_(0.0)
+  { }
+
+  void SetKeyMap(const KeyMap &key_map) { key_map_ = key_map; }
+
+  void Train(const std::string &feature_rspecifier,
+             const std::string &targets_rspecifier,
+             const std::string &posterior_rspecifier,
+             FrmshuffObjective *objective);
+
+  void Train(const std::vector<FrmshuffInput> &inputs,
+             FrmshuffObjective *objective);
+
+  /// The summary line "Done N files, ...",
+  std::string Report() const;
+
+ private:
+  const FrmshuffTrainOptions &opts_;
+  const NnetDataRandomizerOptions &rnd_opts_;
+  KeyMap key_map_;
+
+  int32 num_done_, num_no_tgt_mat_, num_other_error_;
+  int64 total_frames_;
+  double elapsed_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FrmshuffTrainer);
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_FRMSHUFF_TRAINER_H_
@@ -42,6 +42,11 @@ namespace nnet1 {
    Component* Copy() const { return new Fsmn(*this); }
    ComponentType GetType() const { return kFsmn; }
 
+   // the left filter has the taps t, t-s, ..., t-(l_order-1)*s,
+   // the right filter t+s, ..., t+r_order*s,
+   int32 LeftContext() const { return std::max(0, (l_order_ - 1) * l_stride_); }
+   int32 RightContext() const { return std::max(0, r_order_ * r_stride_); }
+
    void SetFlags(const Vector<BaseFloat> &flags) {
      flags_.Resize(flags.Dim(), kSetZero);
      flags_.CopyFromVec(flags);
@@ -0,0 +1,117 @@
+// nnet/nnet-loss-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-loss.h"
+
+using namespace kaldi;
+using namespace kaldi::nnet1;
+
+static void GetData(int32 num_rows, int32 num_cols,
+                    Matrix<BaseFloat> *net_out, Matrix<BaseFloat> *target,
+                    Vector<BaseFloat> *weights) {
+  net_out->Resize(num_rows, num_cols);
+  net_out->SetRandn();
+  target->Resize(num_rows, num_cols);
+  target->SetRandn();
+  weights->Resize(num_rows);
+  for (int32 r = 0; r < num_rows; r++) {
+    // zero, one and fractional weights,
+    (*weights)(r) = (r % 3 == 0 ? 0.0 : (r % 3 == 1 ? 1.0 : RandUniform()));
+  }
+}
+
+// The loss and the derivative, as a sequence of matrix operations,
+// (power 2 is Mse, power 4 is Quartic),
+static double RefLoss(const Vector<BaseFloat> &w,
+                      const Matrix<BaseFloat> &net_out,
+                      const Matrix<BaseFloat> &target,
+                      int32 power, Matrix<BaseFloat> *diff) {
+  Matrix<BaseFloat> e(net_out);
+  e.AddMat(-1.0, target);
+  Matrix<BaseFloat> loss_mat(e);
+  if (power == 2) {
+    e.MulRowsVec(w);
+    *diff = e;
+    loss_mat = e;
+    loss_mat.MulElements(e);
+    loss_mat.MulRowsVec(w);
+    return 0.5 * loss_mat.Sum();
+  }
+  *diff = e;
+  diff->ApplyPow(3.0);
+  diff->MulRowsVec(w);
+  loss_mat.MulElements(e);
+  loss_mat.MulElements(loss_mat);
+  loss_mat.MulRowsVec(w);
+  return 0.25 * loss_mat.Sum();
+}
+
+static void UnitTestRegressionLoss(const std::string &objective_function,
+                                   int32 power) {
+  LossOptions opts;
+  LossItf *loss = NewLoss(objective_function, opts);
+  double tot_loss = 0.0, tot_frames = 0.0;
+  for (int32 i = 0; i < 5; i++) {
+    Matrix<BaseFloat> net_out, target, ref_diff;
+    Vector<BaseFloat> weights;
+    GetData(10 + Rand() % 100, 1 + Rand() % 300, &net_out, &target, &weights);
+    tot_loss += RefLoss(weights, net_out, target, power, &ref_diff);
+    tot_frames += static_cast<int32>(weights.Sum());
+
+    CuMatrix<BaseFloat> diff;
+    loss->Eval(weights, CuMatrix<BaseFloat>(net_out),
+               CuMatrix<BaseFloat>(target), &diff);
+    AssertEqual(Matrix<BaseFloat>(diff), ref_diff, 1e-5);
+  }
+  KALDI_ASSERT(ApproxEqual(loss->AvgLoss(), tot_loss / tot_frames, 1e-4));
+  delete loss;
+}
+
+static void UnitTestLogSpectralDistance() {
+  Matrix<BaseFloat> net_out, target;
+  Vector<BaseFloat> weights;
+  GetData(50, 257, &net_out, &target, &weights);
+  net_out.Scale(5.0);
+  target.Scale(5.0);
+
+  // the reference (as in eval-loss-lsd),
+  Matrix<BaseFloat> y(net_out), x(target);
+  y.ApplyFloor(y.Max() - 5 * M_LN10);
+  x.ApplyFloor(x.Max() - 5 * M_LN10);
+  y.AddMat(-1.0, x);
+  y.Scale(10 * M_LOG10E);
+  y.ApplyPow(2.0);
+  Vector<BaseFloat> ref_lsd(y.NumRows());
+  for (int32 r = 0; r < y.NumRows(); r++) {
+    ref_lsd(r) = std::sqrt(y.Row(r).Sum() / y.NumCols());
+  }
+
+  Vector<BaseFloat> frame_lsd;
+  double tot_lsd = LogSpectralDistance(net_out, target, &frame_lsd);
+  AssertEqual(frame_lsd, ref_lsd, 1e-5);
+  KALDI_ASSERT(ApproxEqual(tot_lsd, ref_lsd.Sum(), 1e-5));
+}
+
+int main() {
+  for (int32 i = 0; i < 3; i++) {
+    UnitTestRegressionLoss("mse", 2);
+    UnitTestRegressionLoss("quartic", 4);
+    UnitTestLogSpectralDistance();
+  }
+  std::cout << "Tests succeeded.\n";
+  return 0;
+}
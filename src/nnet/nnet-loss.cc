@@ -25,6 +25,7 @@
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-utils.h"
 #include "cudamatrix/cu-math.h"
+#include "cudamatrix/cu-device.h"
 #include "hmm/posterior.h"
 
 namespace kaldi {
@@ -226,6 +227,50 @@ std::string Xent::ReportPerClass() {
 
 /* Mse */
 
+/**
+ * Helper function of Mse::Eval and Quartic::Eval (CPU),
+ * computes the weighted derivative and the loss in a single pass,
+ * with e = y - t and w the frame weight:
+ *  power 2 : diff = w e,   returns sum of w (w e)^2,
+ *  power 4 : diff = w e^3, returns sum of w e^4,
+ * (the same as the sequence of matrix operations on GPU).
+ */
+static double RegressionLossCpu(const VectorBase<BaseFloat> &frame_weights,
+                                const MatrixBase<BaseFloat> &net_out,
+                                const MatrixBase<BaseFloat> &target,
+                                int32 power,
+                                MatrixBase<BaseFloat> *diff) {
+  KALDI_ASSERT(power == 2 || power == 4);
+  const int32 num_rows = net_out.NumRows(), num_cols = net_out.NumCols();
+  double loss = 0.0;
+  for (int32 r = 0; r < num_rows; r++) {
+    const BaseFloat w = frame_weights(r);
+    const BaseFloat *y = net_out.RowData(r), *t = target.RowData(r);
+    BaseFloat *d = diff->RowData(r);
+    if (w == 0.0) {  // skip the frames with zero weight,
+      std::fill(d, d + num_cols, 0.0);
+      continue;
+    }
+    double row_loss = 0.0;
+    if (power == 2) {
+      for (int32 c = 0; c < num_cols; c++) {
+        BaseFloat d_c = w * (y[c] - t[c]);
+        d[c] = d_c;
+        row_loss += d_c * d_c;
+      }
+    } else {
+      for (int32 c = 0; c < num_cols; c++) {
+        BaseFloat e = y[c] - t[c], e2 = e * e;
+        d[c] = w * e * e2;
+        row_loss += e2 * e2;
+      }
+    }
+    loss += w * row_loss;
+  }
+  return loss;
+}
+
+
 void Mse::Eval(const VectorBase<BaseFloat> &frame_weights,
                const CuMatrixBase<BaseFloat>& net_out,
                const CuMatrixBase<BaseFloat>& target,
@@ -236,25 +281,39 @@ void Mse::Eval(const VectorBase<BaseFloat> &frame_weights,
   KALDI_ASSERT(net_out.NumRows() == frame_weights.Dim());
 
   KALDI_ASSERT(KALDI_ISFINITE(frame_weights.Sum()));
-  KALDI_ASSERT(KALDI_ISFINITE(net_out.Sum()));
-  KALDI_ASSERT(KALDI_ISFINITE(target.Sum()));
 
   int32 num_frames = frame_weights.Sum();
   KALDI_ASSERT(num_frames >= 0.0);
-
-  // get frame_weights to GPU,
-  frame_weights_ = frame_weights;
-
-  // compute derivative w.r.t. neural nerwork outputs
-  *diff = net_out;  // y
-  diff->AddMat(-1.0, target);  // (y - t)
-  diff->MulRowsVec(frame_weights_);  // weighting,
-
-  // Compute MeanSquareError loss of mini-batch
-  diff_pow_2_ = *diff;
-  diff_pow_2_.MulElements(diff_pow_2_);  // (y - t)^2
-  diff_pow_2_.MulRowsVec(frame_weights_);  // w*(y - t)^2
-  double mean_square_error = 0.5 * diff_pow_2_.Sum();  // sum the matrix,
+  num_tgt_ = net_out.NumCols();
+
+  double mean_square_error;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    KALDI_ASSERT(KALDI_ISFINITE(net_out.Sum()));
+    KALDI_ASSERT(KALDI_ISFINITE(target.Sum()));
+
+    // get frame_weights to GPU,
+    frame_weights_ = frame_weights;
+
+    // compute derivative w.r.t. neural nerwork outputs
+    *diff = net_out;  // y
+    diff->AddMat(-1.0, target);  // (y - t)
+    diff->MulRowsVec(frame_weights_);  // weighting,
+
+    // Compute MeanSquareError loss of mini-batch
+    diff_pow_2_ = *diff;
+    diff_pow_2_.MulElements(diff_pow_2_);  // (y - t)^2
+    diff_pow_2_.MulRowsVec(frame_weights_);  // w*(y - t)^2
+    mean_square_error = 0.5 * diff_pow_2_.Sum();  // sum the matrix,
+  } else
+#endif
+  {
+    // derivative and loss in one pass (a NaN/inf in the inputs of
+    // a frame with non-zero weight shows up in the loss),
+    diff->Resize(net_out.NumRows(), net_out.NumCols(), kUndefined);
+    mean_square_error = 0.5 * RegressionLossCpu(frame_weights, net_out.Mat(),
+                                                target.Mat(), 2, &diff->Mat());
+  }
   KALDI_ASSERT(KALDI_ISFINITE(mean_square_error));
   batch_loss_ = mean_square_error/num_frames;
 
@@ -299,8 +358,7 @@ void Mse::Eval(const VectorBase<BaseFloat> &frame_weights,
 
 std::string Mse::Report() {
   // compute root mean square,
-  int32 num_tgt = diff_pow_2_.NumCols();
-  BaseFloat root_mean_square = sqrt(loss_/frames_/num_tgt);
+  BaseFloat root_mean_square = sqrt(loss_/frames_/num_tgt_);
   // build the message,
   std::ostringstream oss;
   oss << "AvgLoss: " << loss_/frames_ << " (Mse), "
@@ -494,28 +552,41 @@ void Quartic::Eval(const VectorBase<BaseFloat> &frame_weights,
   KALDI_ASSERT(net_out.NumRows() == frame_weights.Dim());
 
   KALDI_ASSERT(KALDI_ISFINITE(frame_weights.Sum()));
-  KALDI_ASSERT(KALDI_ISFINITE(net_out.Sum()));
-  KALDI_ASSERT(KALDI_ISFINITE(target.Sum()));
 
   int32 num_frames = frame_weights.Sum();
   KALDI_ASSERT(num_frames >= 0.0);
-
-  // get frame_weights to GPU,
-  frame_weights_ = frame_weights;
-
-  // compute derivative w.r.t. neural nerwork outputs
-  out_diff_ = net_out;
-  out_diff_.AddMat(-1.0, target);
-  *diff = out_diff_;
-  diff->ApplyPow(3.0);
-  diff->MulRowsVec(frame_weights_);  // weighting,
-
-  // Compute MeanSquareError loss of mini-batch
-  diff_pow_2_ = out_diff_;
-  diff_pow_2_.MulElements(diff_pow_2_);  // (y - t)^2
-  diff_pow_2_.MulElements(diff_pow_2_);  // (y - t)^4
-  diff_pow_2_.MulRowsVec(frame_weights_);  // w*(y - t)^2
-  double mean_square_error = 0.25 * diff_pow_2_.Sum();  // sum the matrix,
+  num_tgt_ = net_out.NumCols();
+
+  double mean_square_error;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    KALDI_ASSERT(KALDI_ISFINITE(net_out.Sum()));
+    KALDI_ASSERT(KALDI_ISFINITE(target.Sum()));
+
+    // get frame_weights to GPU,
+    frame_weights_ = frame_weights;
+
+    // compute derivative w.r.t. neural nerwork outputs
+    out_diff_ = net_out;
+    out_diff_.AddMat(-1.0, target);
+    *diff = out_diff_;
+    diff->ApplyPow(3.0);
+    diff->MulRowsVec(frame_weights_);  // weighting,
+
+    // Compute MeanSquareError loss of mini-batch
+    diff_pow_2_ = out_diff_;
+    diff_pow_2_.MulElements(diff_pow_2_);  // (y - t)^2
+    diff_pow_2_.MulElements(diff_pow_2_);  // (y - t)^4
+    diff_pow_2_.MulRowsVec(frame_weights_);  // w*(y - t)^2
+    mean_square_error = 0.25 * diff_pow_2_.Sum();  // sum the matrix,
+  } else
+#endif
+  {
+    // derivative and loss in one pass,
+    diff->Resize(net_out.NumRows(), net_out.NumCols(), kUndefined);
+    mean_square_error = 0.25 * RegressionLossCpu(frame_weights, net_out.Mat(),
+                                                 target.Mat(), 4, &diff->Mat());
+  }
   KALDI_ASSERT(KALDI_ISFINITE(mean_square_error));
   batch_loss_ = mean_square_error/num_frames;
 
@@ -560,8 +631,7 @@ void Quartic::Eval(const VectorBase<BaseFloat> &frame_weights,
 
 std::string Quartic::Report() {
   // compute root mean square,
-  int32 num_tgt = diff_pow_2_.NumCols();
-  BaseFloat root_mean_square = sqrt(loss_/frames_/num_tgt);
+  BaseFloat root_mean_square = sqrt(loss_/frames_/num_tgt_);
   // build the message,
   std::ostringstream oss;
   oss << "AvgLoss: " << loss_/frames_ << " (Quartic), "
@@ -574,5 +644,51 @@ std::string Quartic::Report() {
   return oss.str();
 }
 
+
+LossItf* NewLoss(const std::string &objective_function, LossOptions &opts) {
+  if (objective_function == "xent") {
+    return new Xent(opts);
+  } else if (objective_function == "mse") {
+    return new Mse(opts);
+  } else if (objective_function == "quartic") {
+    return new Quartic(opts);
+  } else if (0 == objective_function.compare(0, 9, "multitask")) {
+    MultiTaskLoss *multitask = new MultiTaskLoss(opts);
+    multitask->InitFromString(objective_function);
+    return multitask;
+  }
+  KALDI_ERR << "Unknown objective function code : " << objective_function;
+  return NULL;
+}
+
+
+double LogSpectralDistance(const MatrixBase<BaseFloat> &net_out,
+                           const MatrixBase<BaseFloat> &target,
+                           Vector<BaseFloat> *frame_lsd) {
+  KALDI_ASSERT(net_out.NumRows() == target.NumRows());
+  KALDI_ASSERT(net_out.NumCols() == target.NumCols());
+  const int32 num_rows = net_out.NumRows(), num_cols = net_out.NumCols();
+  if (frame_lsd != NULL) frame_lsd->Resize(num_rows, kUndefined);
+  if (num_rows == 0) return 0.0;
+  // the floors, and then floor + diff + square + row-mean in one pass,
+  const BaseFloat out_floor = net_out.Max() - 5 * M_LN10,
+    tgt_floor = target.Max() - 5 * M_LN10,
+    scale = 10 * M_LOG10E;
+  double tot_lsd = 0.0;
+  for (int32 r = 0; r < num_rows; r++) {
+    const BaseFloat *y = net_out.RowData(r), *x = target.RowData(r);
+    double sum = 0.0;
+    for (int32 c = 0; c < num_cols; c++) {
+      BaseFloat e = scale * (std::max(y[c], out_floor) -
+                             std::max(x[c], tgt_floor));
+      sum += e * e;
+    }
+    BaseFloat lsd = std::sqrt(sum / num_cols);
+    if (frame_lsd != NULL) (*frame_lsd)(r) = lsd;
+    tot_lsd += lsd;
+  }
+  return tot_lsd;
+}
+
 }  // namespace nnet1
 }  // namespace kaldi
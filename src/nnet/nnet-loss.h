@@ -159,7 +159,8 @@ class Mse : public LossItf {
     loss_(0.0),
     frames_progress_(0.0),
     loss_progress_(0.0),
-    batch_loss_(0.0)
+    batch_loss_(0.0),
+    num_tgt_(0)
   { }
 
   ~Mse()
@@ -195,6 +196,7 @@ class Mse : public LossItf {
   double loss_progress_;
   double batch_loss_;
   std::vector<float> loss_vec_;
+  int32 num_tgt_;
 
   CuVector<BaseFloat> frame_weights_;
   CuMatrix<BaseFloat> tgt_mat_;
@@ -261,7 +263,8 @@ class Quartic : public LossItf {
     loss_(0.0),
     frames_progress_(0.0),
     loss_progress_(0.0),
-    batch_loss_(0.0)
+    batch_loss_(0.0),
+    num_tgt_(0)
   { }
 
   ~Quartic()
@@ -297,6 +300,7 @@ class Quartic : public LossItf {
   double loss_progress_;
   double batch_loss_;
   std::vector<float> loss_vec_;
+  int32 num_tgt_;
 
   CuVector<BaseFloat> frame_weights_;
   CuMatrix<BaseFloat> tgt_mat_;
@@ -304,6 +308,21 @@ class Quartic : public LossItf {
   CuMatrix<BaseFloat> diff_pow_2_;
 };
 
+
+/// Creates the loss named by the '--objective-function' option of the
+/// trainers: 'xent', 'mse', 'quartic' or a multitask definition
+/// 'multitask,<type1>,<dim1>,<weight1>,...' (see MultiTaskLoss),
+LossItf* NewLoss(const std::string &objective_function, LossOptions &opts);
+
+/// Log-spectral distance of the log-power spectra 'net_out' and 'target'
+/// (frames in rows), in dB, both floored to 50dB below their maximum:
+///   LSD(t) = sqrt(mean_f (10 log10(e) (y(t,f) - x(t,f)))^2),
+/// returns the sum over the frames, the per-frame values go
+/// to 'frame_lsd' (if not NULL),
+double LogSpectralDistance(const MatrixBase<BaseFloat> &net_out,
+                           const MatrixBase<BaseFloat> &target,
+                           Vector<BaseFloat> *frame_lsd = NULL);
+
 }  // namespace nnet1
 }  // namespace kaldi
 
@@ -0,0 +1,292 @@
+// nnet/nnet-lstm-cell.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET_NNET_LSTM_CELL_H_
+#define KALDI_NNET_NNET_LSTM_CELL_H_
+
+#include <algorithm>
+
+#include "base/kaldi-common.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "cudamatrix/cu-device.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/**
+ * The element-wise part of one time-step of the projected LSTM cell,
+ * shared by LstmProjected and both directions of BlstmProjected.
+ *
+ * The matrices are blocks of rows of the activation/derivative buffers
+ * with the columns [g i f o c h m r] (7 * cell_dim + proj_dim), a row is
+ * a stream. The 'prev' rows are the previous time-step in the direction
+ * of the recursion (t-1 for the forward LSTM, t+1 for the backward one),
+ * the 'next' rows are the following time-step.
+ *
+ * On the CPU all the gates are computed in a single pass over the rows,
+ * on the GPU it is the sequence of CuMatrix kernels.
+ */
+class LstmCell {
+ public:
+  LstmCell(int32 cell_dim, BaseFloat cell_clip, BaseFloat diff_clip,
+           BaseFloat cell_diff_clip,
+           CuVectorBase<BaseFloat> &peephole_i_c,
+           CuVectorBase<BaseFloat> &peephole_f_c,
+           CuVectorBase<BaseFloat> &peephole_o_c):
+    cell_dim_(cell_dim), cell_clip_(cell_clip), diff_clip_(diff_clip),
+    cell_diff_clip_(cell_diff_clip), peephole_i_c_(peephole_i_c),
+    peephole_f_c_(peephole_f_c), peephole_o_c_(peephole_o_c)
+  { }
+
+  /// Forward pass, 'y' contains the pre-activations of g, i, f, o
+  /// (incl. the recurrent part), computes g, i, f, o, c, h, m,
+  void Propagate(const CuMatrixBase<BaseFloat> &y_prev,
+                 CuMatrixBase<BaseFloat> *y) const {
+    KALDI_ASSERT(y_prev.NumRows() == y->NumRows());
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+      PropagateKernels(y_prev, y);
+      return;
+    }
+#endif
+    const int32 C = cell_dim_;
+    const BaseFloat *p_i = peephole_i_c_.Data(),
+      *p_f = peephole_f_c_.Data(),
+      *p_o = peephole_o_c_.Data();
+    for (int32 r = 0; r < y->NumRows(); r++) {
+      const BaseFloat *prev = y_prev.Mat().RowData(r);
+      BaseFloat *row = y->Mat().RowData(r);
+      BaseFloat *g = row, *i = row + C, *f = row + 2*C, *o = row + 3*C,
+        *c = row + 4*C, *h = row + 5*C, *m = row + 6*C;
+      const BaseFloat *c_prev = prev + 4*C;
+      for (int32 j = 0; j < C; j++) {
+        i[j] = Sigmoid(i[j] + p_i[j] * c_prev[j]);
+        f[j] = Sigmoid(f[j] + p_f[j] * c_prev[j]);
+        g[j] = Tanh(g[j]);
+        BaseFloat c_j = g[j] * i[j] + c_prev[j] * f[j];
+        if (cell_clip_ > 0.0) {
+          c_j = std::min(cell_clip_, std::max(-cell_clip_, c_j));
+        }
+        c[j] = c_j;
+        o[j] = Sigmoid(o[j] + p_o[j] * c_j);
+        h[j] = Tanh(c_j);
+        m[j] = h[j] * o[j];
+      }
+    }
+  }
+
+  /// Backward pass, 'd' contains the derivative of m, computes the
+  /// derivatives of h, o, c, f, i, g (the gates clipped by 'diff_clip'),
+  void Backpropagate(const CuMatrixBase<BaseFloat> &y_prev,
+                     const CuMatrixBase<BaseFloat> &y,
+                     const CuMatrixBase<BaseFloat> &y_next,
+                     const CuMatrixBase<BaseFloat> &d_next,
+                     CuMatrixBase<BaseFloat> *d) const {
+    KALDI_ASSERT(y.NumRows() == d->NumRows());
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled()) {
+      BackpropagateKernels(y_prev, y, y_next, d_next, d);
+      return;
+    }
+#endif
+    const int32 C = cell_dim_;
+    const BaseFloat *p_i = peephole_i_c_.Data(),
+      *p_f = peephole_f_c_.Data(),
+      *p_o = peephole_o_c_.Data();
+    for (int32 r = 0; r < d->NumRows(); r++) {
+      const BaseFloat *row = y.Mat().RowData(r),
+        *c_prev = y_prev.Mat().RowData(r) + 4*C,
+        *f_next = y_next.Mat().RowData(r) + 2*C,
+        *row_next = d_next.Mat().RowData(r);
+      const BaseFloat *g = row, *i = row + C, *f = row + 2*C, *o = row + 3*C,
+        *h = row + 5*C;
+      const BaseFloat *di_next = row_next + C, *df_next = row_next + 2*C,
+        *dc_next = row_next + 4*C;
+      BaseFloat *drow = d->Mat().RowData(r);
+      BaseFloat *dg = drow, *di = drow + C, *df = drow + 2*C,
+        *d_o = drow + 3*C, *dc = drow + 4*C, *dh = drow + 5*C,
+        *dm = drow + 6*C;
+      for (int32 j = 0; j < C; j++) {
+        // m -> h, o,
+        dh[j] = dm[j] * o[j] * (1.0 - h[j] * h[j]);
+        BaseFloat do_j = dm[j] * h[j] * o[j] * (1.0 - o[j]);
+        // c: from h(t), c(t+1), i(t+1), f(t+1), o(t),
+        BaseFloat dc_j = dh[j] + dc_next[j] * f_next[j] + di_next[j] * p_i[j]
+          + df_next[j] * p_f[j] + do_j * p_o[j];
+        if (cell_diff_clip_ > 0.0) {
+          dc_j = std::min(cell_diff_clip_, std::max(-cell_diff_clip_, dc_j));
+        }
+        dc[j] = dc_j;
+        BaseFloat df_j = dc_j * c_prev[j] * f[j] * (1.0 - f[j]),
+          di_j = dc_j * g[j] * i[j] * (1.0 - i[j]),
+          dg_j = dc_j * i[j] * (1.0 - g[j] * g[j]);
+        if (diff_clip_ > 0.0) {
+          do_j = std::min(diff_clip_, std::max(-diff_clip_, do_j));
+          df_j = std::min(diff_clip_, std::max(-diff_clip_, df_j));
+          di_j = std::min(diff_clip_, std::max(-diff_clip_, di_j));
+          dg_j = std::min(diff_clip_, std::max(-diff_clip_, dg_j));
+        }
+        d_o[j] = do_j;
+        df[j] = df_j;
+        di[j] = di_j;
+        dg[j] = dg_j;
+      }
+    }
+  }
+
+ private:
+  // same formulas as VectorBase::Sigmoid(), VectorBase::Tanh(),
+  static inline BaseFloat Sigmoid(BaseFloat x) {
+    if (x > 0.0) {
+      return 1.0 / (1.0 + Exp(-x));
+    } else {
+      BaseFloat ex = Exp(x);
+      return ex / (ex + 1.0);
+    }
+  }
+
+  static inline BaseFloat Tanh(BaseFloat x) {
+    if (x > 0.0) {
+      BaseFloat inv_expx = Exp(-x);
+      return -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+    } else {
+      BaseFloat expx = Exp(x);
+      return 1.0 - 2.0 / (1.0 + expx * expx);
+    }
+  }
+
+  void PropagateKernels(const CuMatrixBase<BaseFloat> &y_prev,
+                        CuMatrixBase<BaseFloat> *y) const {
+    const int32 C = cell_dim_;
+    CuSubMatrix<BaseFloat> y_g(y->ColRange(0*C, C));
+    CuSubMatrix<BaseFloat> y_i(y->ColRange(1*C, C));
+    CuSubMatrix<BaseFloat> y_f(y->ColRange(2*C, C));
+    CuSubMatrix<BaseFloat> y_o(y->ColRange(3*C, C));
+    CuSubMatrix<BaseFloat> y_c(y->ColRange(4*C, C));
+    CuSubMatrix<BaseFloat> y_h(y->ColRange(5*C, C));
+    CuSubMatrix<BaseFloat> y_m(y->ColRange(6*C, C));
+    CuSubMatrix<BaseFloat> c_prev(y_prev.ColRange(4*C, C));
+
+    // c(t-1) -> i(t), f(t) via peephole,
+    y_i.AddMatDiagVec(1.0, c_prev, kNoTrans, peephole_i_c_, 1.0);
+    y_f.AddMatDiagVec(1.0, c_prev, kNoTrans, peephole_f_c_, 1.0);
+    // i, f sigmoid squashing, g tanh squashing,
+    y_i.Sigmoid(y_i);
+    y_f.Sigmoid(y_f);
+    y_g.Tanh(y_g);
+    // g * i -> c, c(t-1) * f -> c(t) via forget-gate,
+    y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
+    y_c.AddMatMatElements(1.0, c_prev, y_f, 1.0);
+    if (cell_clip_ > 0.0) {
+      y_c.ApplyFloor(-cell_clip_);   // optional clipping of cell activation,
+      y_c.ApplyCeiling(cell_clip_);  // google paper Interspeech2014: LSTM for LVCSR
+    }
+    // c(t) -> o(t) via peephole (non-recurrent, using c(t)),
+    y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
+    y_o.Sigmoid(y_o);
+    // h tanh squashing, h * o -> m via output gate,
+    y_h.Tanh(y_c);
+    y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
+  }
+
+  void BackpropagateKernels(const CuMatrixBase<BaseFloat> &y_prev,
+                            const CuMatrixBase<BaseFloat> &y,
+                            const CuMatrixBase<BaseFloat> &y_next,
+                            const CuMatrixBase<BaseFloat> &d_next,
+                            CuMatrixBase<BaseFloat> *d) const {
+    const int32 C = cell_dim_;
+    CuSubMatrix<BaseFloat> y_g(y.ColRange(0*C, C));
+    CuSubMatrix<BaseFloat> y_i(y.ColRange(1*C, C));
+    CuSubMatrix<BaseFloat> y_f(y.ColRange(2*C, C));
+    CuSubMatrix<BaseFloat> y_o(y.ColRange(3*C, C));
+    CuSubMatrix<BaseFloat> y_h(y.ColRange(5*C, C));
+
+    CuSubMatrix<BaseFloat> d_g(d->ColRange(0*C, C));
+    CuSubMatrix<BaseFloat> d_i(d->ColRange(1*C, C));
+    CuSubMatrix<BaseFloat> d_f(d->ColRange(2*C, C));
+    CuSubMatrix<BaseFloat> d_o(d->ColRange(3*C, C));
+    CuSubMatrix<BaseFloat> d_c(d->ColRange(4*C, C));
+    CuSubMatrix<BaseFloat> d_h(d->ColRange(5*C, C));
+    CuSubMatrix<BaseFloat> d_m(d->ColRange(6*C, C));
+    CuSubMatrix<BaseFloat> d_gifo(d->ColRange(0, 4*C));
+
+    // m -> h via output gate,
+    d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
+    d_h.DiffTanh(y_h, d_h);
+
+    // o
+    d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
+    d_o.DiffSigmoid(y_o, d_o);
+
+    // c
+    // 1. diff from h(t)
+    // 2. diff from c(t+1) (via forget-gate between CEC)
+    // 3. diff from i(t+1) (via peephole)
+    // 4. diff from f(t+1) (via peephole)
+    // 5. diff from o(t)   (via peephole, not recurrent)
+    d_c.CopyFromMat(d_h);
+    d_c.AddMatMatElements(1.0, d_next.ColRange(4*C, C),
+                          y_next.ColRange(2*C, C), 1.0);
+    d_c.AddMatDiagVec(1.0, d_next.ColRange(1*C, C), kNoTrans, peephole_i_c_, 1.0);
+    d_c.AddMatDiagVec(1.0, d_next.ColRange(2*C, C), kNoTrans, peephole_f_c_, 1.0);
+    d_c.AddMatDiagVec(1.0, d_o, kNoTrans, peephole_o_c_, 1.0);
+    // optionally clip the cell_derivative,
+    if (cell_diff_clip_ > 0.0) {
+      d_c.ApplyFloor(-cell_diff_clip_);
+      d_c.ApplyCeiling(cell_diff_clip_);
+    }
+
+    // f
+    d_f.AddMatMatElements(1.0, d_c, y_prev.ColRange(4*C, C), 0.0);
+    d_f.DiffSigmoid(y_f, d_f);
+
+    // i
+    d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
+    d_i.DiffSigmoid(y_i, d_i);
+
+    // c -> g via input gate
+    d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
+    d_g.DiffTanh(y_g, d_g);
+
+    // Clipping per-frame derivatives for the next `t'.
+    // Clipping applied to gates and input gate (as done in Google).
+    // [ICASSP2015, Sak, Learning acoustic frame labelling...],
+    //
+    // The path from 'out_diff' to 'd_c' via 'd_h' is unclipped,
+    // which is probably important for the 'Constant Error Carousel'
+    // to work well.
+    //
+    if (diff_clip_ > 0.0) {
+      d_gifo.ApplyFloor(-diff_clip_);
+      d_gifo.ApplyCeiling(diff_clip_);
+    }
+  }
+
+  int32 cell_dim_;
+  BaseFloat cell_clip_, diff_clip_, cell_diff_clip_;
+  // (non-const, as in CuMatrixBase::AddMatDiagVec()),
+  CuVectorBase<BaseFloat> &peephole_i_c_;
+  CuVectorBase<BaseFloat> &peephole_f_c_;
+  CuVectorBase<BaseFloat> &peephole_o_c_;
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_LSTM_CELL_H_
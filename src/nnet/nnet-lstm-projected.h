@@ -27,6 +27,7 @@
 
 #include "nnet/nnet-component.h"
 #include "nnet/nnet-utils.h"
+#include "nnet/nnet-lstm-cell.h"
 #include "cudamatrix/cu-math.h"
 
 /*************************************
@@ -384,13 +385,6 @@ class LstmProjected : public MultistreamComponent {
     }
 
     // split activations by neuron types,
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YI(propagate_buf_.ColRange(1*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(2*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(3*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(5*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(7*cell_dim_, proj_dim_));
     CuSubMatrix<BaseFloat> YGIFO(propagate_buf_.ColRange(0, 4*cell_dim_));
 
@@ -400,69 +394,30 @@ class LstmProjected : public MultistreamComponent {
     // bias -> g, i, f, o
     YGIFO.RowRange(1*S, T*S).AddVecToRows(1.0, bias_);
 
+    LstmCell cell(cell_dim_, cell_clip_, diff_clip_, cell_diff_clip_,
+                  peephole_i_c_, peephole_f_c_, peephole_o_c_);
+
     // BufferPadding [T0]:dummy, [1, T]:current sequence, [T+1]:dummy
     for (int t = 1; t <= T; t++) {
-      // multistream buffers for current time-step,
-      CuSubMatrix<BaseFloat> y_all(propagate_buf_.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_g(YG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_i(YI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_f(YF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_o(YO.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_c(YC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_h(YH.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_m(YM.RowRange(t*S, S));
-       CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_gifo(YGIFO.RowRange(t*S, S));
-
-      // r(t-1) -> g, i, f, o
-      y_gifo.AddMatMat(1.0, YR.RowRange((t-1)*S, S), kNoTrans, w_gifo_r_, kTrans,  1.0);
-
-      // c(t-1) -> i(t) via peephole
-      y_i.AddMatDiagVec(1.0, YC.RowRange((t-1)*S, S), kNoTrans, peephole_i_c_, 1.0);
-
-      // c(t-1) -> f(t) via peephole
-      y_f.AddMatDiagVec(1.0, YC.RowRange((t-1)*S, S), kNoTrans, peephole_f_c_, 1.0);
-
-      // i, f sigmoid squashing
-      y_i.Sigmoid(y_i);
-      y_f.Sigmoid(y_f);
-
-      // g tanh squashing
-      y_g.Tanh(y_g);
-
-      // g * i -> c
-      y_c.AddMatMatElements(1.0, y_g, y_i, 0.0);
-      // c(t-1) * f -> c(t) via forget-gate
-      y_c.AddMatMatElements(1.0, YC.RowRange((t-1)*S, S), y_f, 1.0);
-
-      if (cell_clip_ > 0.0) {
-        y_c.ApplyFloor(-cell_clip_);   // optional clipping of cell activation,
-        y_c.ApplyCeiling(cell_clip_);  // google paper Interspeech2014: LSTM for LVCSR
+      // the streams not finished at 't',
+      const int32 n = NumActiveStreams(t);
+      if (n > 0) {
+        CuSubMatrix<BaseFloat> y_prev(propagate_buf_.RowRange((t-1)*S, n));
+        CuSubMatrix<BaseFloat> y(propagate_buf_.RowRange(t*S, n));
+
+        // r(t-1) -> g, i, f, o
+        y.ColRange(0, 4*cell_dim_).AddMatMat(1.0, y_prev.ColRange(7*cell_dim_, proj_dim_),
+                                             kNoTrans, w_gifo_r_, kTrans, 1.0);
+
+        // g, i, f, o -> c, h, m (incl. the peepholes from c),
+        cell.Propagate(y_prev, &y);
+
+        // m -> r
+        y.ColRange(7*cell_dim_, proj_dim_).AddMatMat(1.0, y.ColRange(6*cell_dim_, cell_dim_),
+                                                     kNoTrans, w_r_m_, kTrans, 0.0);
       }
-
-      // c(t) -> o(t) via peephole (non-recurrent, using c(t))
-      y_o.AddMatDiagVec(1.0, y_c, kNoTrans, peephole_o_c_, 1.0);
-
-      // o sigmoid squashing,
-      y_o.Sigmoid(y_o);
-
-      // h tanh squashing,
-      y_h.Tanh(y_c);
-
-      // h * o -> m via output gate,
-      y_m.AddMatMatElements(1.0, y_h, y_o, 0.0);
-
-      // m -> r
-      y_r.AddMatMat(1.0, y_m, kNoTrans, w_r_m_, kTrans, 0.0);
-
       // set zeros to padded frames,
-      if (sequence_lengths_.size() > 0) {
-        for (int s = 0; s < S; s++) {
-          if (t > sequence_lengths_[s]) {
-            y_all.Row(s).SetZero();
-          }
-        }
-      }
+      ZeroPaddedFrames(t, &propagate_buf_);
     }
 
     // set the 'projection layer' output as the LSTM output,
@@ -485,130 +440,61 @@ class LstmProjected : public MultistreamComponent {
     backpropagate_buf_.Resize((T+2)*S, 7 * cell_dim_ + proj_dim_, kSetZero);
 
     // split activations by neuron types,
-    CuSubMatrix<BaseFloat> YG(propagate_buf_.ColRange(0*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YI(propagate_buf_.ColRange(1*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YF(propagate_buf_.ColRange(2*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YO(propagate_buf_.ColRange(3*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> YC(propagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> YH(propagate_buf_.ColRange(5*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> YM(propagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> YR(propagate_buf_.ColRange(7*cell_dim_, proj_dim_));
 
     // split derivatives by neuron types,
-    CuSubMatrix<BaseFloat> DG(backpropagate_buf_.ColRange(0*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> DI(backpropagate_buf_.ColRange(1*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> DF(backpropagate_buf_.ColRange(2*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> DO(backpropagate_buf_.ColRange(3*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> DC(backpropagate_buf_.ColRange(4*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> DH(backpropagate_buf_.ColRange(5*cell_dim_, cell_dim_));
-    CuSubMatrix<BaseFloat> DM(backpropagate_buf_.ColRange(6*cell_dim_, cell_dim_));
     CuSubMatrix<BaseFloat> DR(backpropagate_buf_.ColRange(7*cell_dim_, proj_dim_));
     CuSubMatrix<BaseFloat> DGIFO(backpropagate_buf_.ColRange(0, 4*cell_dim_));
 
     // pre-copy partial derivatives from the LSTM output,
     DR.RowRange(1*S, T*S).CopyFromMat(out_diff);
 
+    LstmCell cell(cell_dim_, cell_clip_, diff_clip_, cell_diff_clip_,
+                  peephole_i_c_, peephole_f_c_, peephole_o_c_);
+
     // BufferPadding [T0]:dummy, [1,T]:current sequence, [T+1]: dummy,
     for (int t = T; t >= 1; t--) {
-      CuSubMatrix<BaseFloat> y_g(YG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_i(YI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_f(YF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_o(YO.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_c(YC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> y_h(YH.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_m(YM.RowRange(t*S, S));
-      // CuSubMatrix<BaseFloat> y_r(YR.RowRange(t*S, S));
-
-      CuSubMatrix<BaseFloat> d_all(backpropagate_buf_.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_g(DG.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_i(DI.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_f(DF.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_o(DO.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_c(DC.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_h(DH.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_m(DM.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_r(DR.RowRange(t*S, S));
-      CuSubMatrix<BaseFloat> d_gifo(DGIFO.RowRange(t*S, S));
-
-      // r
-      //   Version 1 (precise gradients):
-      //   backprop error from g(t+1), i(t+1), f(t+1), o(t+1) to r(t)
-      d_r.AddMatMat(1.0, DGIFO.RowRange((t+1)*S, S), kNoTrans, w_gifo_r_, kNoTrans, 1.0);
-
-      /*
-      //   Version 2 (Alex Graves' PhD dissertation):
-      //   only backprop g(t+1) to r(t)
-      CuSubMatrix<BaseFloat> w_g_r_(w_gifo_r_.RowRange(0, cell_dim_));
-      d_r.AddMatMat(1.0, DG.RowRange((t+1)*S,S), kNoTrans, w_g_r_, kNoTrans, 1.0);
-      */
-
-      /*
-      //   Version 3 (Felix Gers' PhD dissertation):
-      //   truncate gradients of g(t+1), i(t+1), f(t+1), o(t+1) once they leak out memory block
-      //   CEC(with forget connection) is the only "error-bridge" through time
-      */
-
-      // r -> m
-      d_m.AddMatMat(1.0, d_r, kNoTrans, w_r_m_, kNoTrans, 0.0);
-
-      // m -> h via output gate
-      d_h.AddMatMatElements(1.0, d_m, y_o, 0.0);
-      d_h.DiffTanh(y_h, d_h);
-
-      // o
-      d_o.AddMatMatElements(1.0, d_m, y_h, 0.0);
-      d_o.DiffSigmoid(y_o, d_o);
-
-      // c
-      // 1. diff from h(t)
-      // 2. diff from c(t+1) (via forget-gate between CEC)
-      // 3. diff from i(t+1) (via peephole)
-      // 4. diff from f(t+1) (via peephole)
-      // 5. diff from o(t)   (via peephole, not recurrent)
-      d_c.AddMat(1.0, d_h);
-      d_c.AddMatMatElements(1.0, DC.RowRange((t+1)*S, S), YF.RowRange((t+1)*S,S), 1.0);
-      d_c.AddMatDiagVec(1.0, DI.RowRange((t+1)*S, S), kNoTrans, peephole_i_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, DF.RowRange((t+1)*S, S), kNoTrans, peephole_f_c_, 1.0);
-      d_c.AddMatDiagVec(1.0, d_o                    , kNoTrans, peephole_o_c_, 1.0);
-      // optionally clip the cell_derivative,
-      if (cell_diff_clip_ > 0.0) {
-        d_c.ApplyFloor(-cell_diff_clip_);
-        d_c.ApplyCeiling(cell_diff_clip_);
-      }
-
-      // f
-      d_f.AddMatMatElements(1.0, d_c, YC.RowRange((t-1)*S,S), 0.0);
-      d_f.DiffSigmoid(y_f, d_f);
-
-      // i
-      d_i.AddMatMatElements(1.0, d_c, y_g, 0.0);
-      d_i.DiffSigmoid(y_i, d_i);
-
-      // c -> g via input gate
-      d_g.AddMatMatElements(1.0, d_c, y_i, 0.0);
-      d_g.DiffTanh(y_g, d_g);
-
-      // Clipping per-frame derivatives for the next `t'.
-      // Clipping applied to gates and input gate (as done in Google).
-      // [ICASSP2015, Sak, Learning acoustic frame labelling...],
-      //
-      // The path from 'out_diff' to 'd_c' via 'd_h' is unclipped,
-      // which is probably important for the 'Constant Error Carousel'
-      // to work well.
-      //
-      if (diff_clip_ > 0.0) {
-        d_gifo.ApplyFloor(-diff_clip_);
-        d_gifo.ApplyCeiling(diff_clip_);
+      // the streams not finished at 't',
+      const int32 n = NumActiveStreams(t);
+      if (n > 0) {
+        CuSubMatrix<BaseFloat> y_prev(propagate_buf_.RowRange((t-1)*S, n));
+        CuSubMatrix<BaseFloat> y(propagate_buf_.RowRange(t*S, n));
+        CuSubMatrix<BaseFloat> y_next(propagate_buf_.RowRange((t+1)*S, n));
+        CuSubMatrix<BaseFloat> d(backpropagate_buf_.RowRange(t*S, n));
+        CuSubMatrix<BaseFloat> d_next(backpropagate_buf_.RowRange((t+1)*S, n));
+        CuSubMatrix<BaseFloat> d_r(d.ColRange(7*cell_dim_, proj_dim_));
+
+        // r
+        //   Version 1 (precise gradients):
+        //   backprop error from g(t+1), i(t+1), f(t+1), o(t+1) to r(t)
+        d_r.AddMatMat(1.0, d_next.ColRange(0, 4*cell_dim_), kNoTrans, w_gifo_r_, kNoTrans, 1.0);
+
+        /*
+        //   Version 2 (Alex Graves' PhD dissertation):
+        //   only backprop g(t+1) to r(t)
+        CuSubMatrix<BaseFloat> w_g_r_(w_gifo_r_.RowRange(0, cell_dim_));
+        d_r.AddMatMat(1.0, DG.RowRange((t+1)*S,S), kNoTrans, w_g_r_, kNoTrans, 1.0);
+        */
+
+        /*
+        //   Version 3 (Felix Gers' PhD dissertation):
+        //   truncate gradients of g(t+1), i(t+1), f(t+1), o(t+1) once they leak out memory block
+        //   CEC(with forget connection) is the only "error-bridge" through time
+        */
+
+        // r -> m
+        d.ColRange(6*cell_dim_, cell_dim_).AddMatMat(1.0, d_r, kNoTrans, w_r_m_, kNoTrans, 0.0);
+
+        // m -> h, o, c, f, i, g (clipped),
+        cell.Backpropagate(y_prev, y, y_next, d_next, &d);
       }
-
       // set zeros to padded frames,
-      if (sequence_lengths_.size() > 0) {
-        for (int s = 0; s < S; s++) {
-          if (t > sequence_lengths_[s]) {
-            d_all.Row(s).SetZero();
-          }
-        }
-      }
+      ZeroPaddedFrames(t, &backpropagate_buf_);
     }
 
     // g,i,f,o -> x, calculating input derivatives,
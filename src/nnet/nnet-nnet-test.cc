@@ -0,0 +1,235 @@
+// nnet/nnet-nnet-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-nnet.h"
+#include "nnet/nnet-loss.h"
+
+#include <vector>
+
+using namespace kaldi;
+using namespace kaldi::nnet1;
+
+static void InitNnet(bool bf16_activations, Nnet *nnet) {
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 10 <OutputDim> 30 <ParamStddev> 0.3"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Sigmoid> <InputDim> 30 <OutputDim> 30"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 30 <OutputDim> 30 <ParamStddev> 0.3"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Tanh> <InputDim> 30 <OutputDim> 30"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 30 <OutputDim> 5 <ParamStddev> 0.3"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Softmax> <InputDim> 5 <OutputDim> 5"));
+  NnetTrainOptions trn_opts;
+  trn_opts.learn_rate = 0.02;
+  trn_opts.momentum = 0.5;
+  trn_opts.bf16_activations = bf16_activations;
+  nnet->SetTrainOptions(trn_opts);
+}
+
+// Random mini-batches, the targets are the argmax of a linear function
+// of the input (so there is something to learn),
+static void GetMinibatches(int32 num_minibatches,
+                           std::vector<CuMatrix<BaseFloat> > *feats,
+                           std::vector<Posterior> *post) {
+  Matrix<BaseFloat> proj(10, 5);
+  proj.SetRandn();
+  for (int32 m = 0; m < num_minibatches; m++) {
+    int32 num_rows = 64;
+    Matrix<BaseFloat> mat(num_rows, 10);
+    mat.SetRandn();
+    Matrix<BaseFloat> scores(num_rows, 5);
+    scores.AddMatMat(1.0, mat, kNoTrans, proj, kNoTrans, 0.0);
+    Posterior p(num_rows);
+    for (int32 r = 0; r < num_rows; r++) {
+      int32 best;
+      scores.Row(r).Max(&best);
+      p[r].push_back(std::make_pair(best, 1.0));
+    }
+    feats->push_back(CuMatrix<BaseFloat>(mat));
+    post->push_back(p);
+  }
+}
+
+// The bfloat16 activations give the same output, and nearly the same
+// derivatives and update, the float forward-pass buffers are freed (the
+// derivatives stay in float),
+static void UnitTestBf16Step() {
+  std::vector<CuMatrix<BaseFloat> > feats;
+  std::vector<Posterior> post;
+  GetMinibatches(1, &feats, &post);
+
+  Nnet nnet, nnet_bf16;
+  InitNnet(false, &nnet);
+  InitNnet(true, &nnet_bf16);
+  Vector<BaseFloat> params;
+  nnet.GetParams(&params);
+  nnet_bf16.SetParams(params);
+
+  LossOptions loss_opts;
+  Xent xent(loss_opts), xent_bf16(loss_opts);
+  Vector<BaseFloat> weights(feats[0].NumRows());
+  weights.Set(1.0);
+  CuMatrix<BaseFloat> out, out_bf16, diff, diff_bf16, in_diff, in_diff_bf16;
+  nnet.Propagate(feats[0], &out);
+  nnet_bf16.Propagate(feats[0], &out_bf16);
+  AssertEqual(Matrix<BaseFloat>(out), Matrix<BaseFloat>(out_bf16));
+  // only the output is kept in float,
+  KALDI_ASSERT(nnet_bf16.PropagateBuffer()[0].NumRows() == 0);
+  KALDI_ASSERT(nnet_bf16.PropagateBuffer()[nnet.NumComponents()].NumRows() ==
+               feats[0].NumRows());
+
+  xent.Eval(weights, out, post[0], &diff);
+  xent_bf16.Eval(weights, out_bf16, post[0], &diff_bf16);
+  nnet.Backpropagate(diff, &in_diff);
+  nnet_bf16.Backpropagate(diff_bf16, &in_diff_bf16);
+  for (int32 i = 0; i < nnet.NumComponents(); i++) {
+    KALDI_ASSERT(nnet_bf16.PropagateBuffer()[i].NumRows() == 0);
+    KALDI_ASSERT(nnet_bf16.BackpropagateBuffer()[i+1].NumRows() ==
+                 feats[0].NumRows());
+  }
+  AssertEqual(Matrix<BaseFloat>(in_diff), Matrix<BaseFloat>(in_diff_bf16),
+              0.02);
+
+  // the update,
+  Vector<BaseFloat> params_bf16;
+  nnet.GetParams(&params);
+  nnet_bf16.GetParams(&params_bf16);
+  KALDI_ASSERT(params.ApproxEqual(params_bf16, 1e-3));
+
+  // the forward-pass statistics come from the bfloat16 buffers,
+  KALDI_LOG << nnet_bf16.InfoPropagate() << nnet_bf16.InfoBackPropagate();
+}
+
+// Training with the bfloat16 activations converges as with float,
+static void UnitTestBf16Convergence() {
+  // (seeded, so the result does not depend on the tests run before),
+  srand(0);
+  std::vector<CuMatrix<BaseFloat> > feats, feats_cv;
+  std::vector<Posterior> post, post_cv;
+  GetMinibatches(300, &feats, &post);
+  feats_cv.assign(feats.end() - 20, feats.end());
+  post_cv.assign(post.end() - 20, post.end());
+  feats.resize(280);
+  post.resize(280);
+
+  Nnet nnet, nnet_bf16;
+  InitNnet(false, &nnet);
+  InitNnet(true, &nnet_bf16);
+  Vector<BaseFloat> params;
+  nnet.GetParams(&params);
+  nnet_bf16.SetParams(params);
+
+  LossOptions loss_opts;
+  Xent xent_init(loss_opts), xent_cv(loss_opts), xent_cv_bf16(loss_opts);
+  Vector<BaseFloat> weights(feats[0].NumRows());
+  weights.Set(1.0);
+  CuMatrix<BaseFloat> out, diff;
+  for (size_t m = 0; m < feats_cv.size(); m++) {
+    nnet.Feedforward(feats_cv[m], &out);
+    xent_init.Eval(weights, out, post_cv[m], &diff);
+  }
+  for (int32 epoch = 0; epoch < 2; epoch++) {
+    for (size_t m = 0; m < feats.size(); m++) {
+      Xent xent(loss_opts);
+      nnet.Propagate(feats[m], &out);
+      xent.Eval(weights, out, post[m], &diff);
+      nnet.Backpropagate(diff, NULL);
+      nnet_bf16.Propagate(feats[m], &out);
+      xent.Eval(weights, out, post[m], &diff);
+      nnet_bf16.Backpropagate(diff, NULL);
+    }
+  }
+  for (size_t m = 0; m < feats_cv.size(); m++) {
+    nnet.Feedforward(feats_cv[m], &out);
+    xent_cv.Eval(weights, out, post_cv[m], &diff);
+    nnet_bf16.Feedforward(feats_cv[m], &out);
+    xent_cv_bf16.Eval(weights, out, post_cv[m], &diff);
+  }
+  KALDI_LOG << "Loss " << xent_init.AvgLoss() << " -> " << xent_cv.AvgLoss()
+            << " (float), " << xent_cv_bf16.AvgLoss() << " (bf16)";
+  KALDI_ASSERT(xent_cv.AvgLoss() < 0.5 * xent_init.AvgLoss());
+  KALDI_ASSERT(ApproxEqual(xent_cv.AvgLoss(), xent_cv_bf16.AvgLoss(), 0.05));
+}
+
+// Recomputing the dropped outputs in the backward pass gives exactly the
+// same derivatives and update,
+static void UnitTestRecompute() {
+  std::vector<CuMatrix<BaseFloat> > feats;
+  std::vector<Posterior> post;
+  GetMinibatches(1, &feats, &post);
+
+  Nnet nnet, nnet_recompute;
+  InitNnet(false, &nnet);
+  InitNnet(false, &nnet_recompute);
+  NnetTrainOptions trn_opts = nnet.GetTrainOptions();
+  trn_opts.recompute_components = "<AffineTransform>,Sigmoid";
+  nnet_recompute.SetTrainOptions(trn_opts);
+  Vector<BaseFloat> params;
+  nnet.GetParams(&params);
+  nnet_recompute.SetParams(params);
+  KALDI_LOG << nnet_recompute.InfoRecompute();
+
+  LossOptions loss_opts;
+  Xent xent(loss_opts);
+  Vector<BaseFloat> weights(feats[0].NumRows());
+  weights.Set(1.0);
+  CuMatrix<BaseFloat> out, out_recompute, diff, in_diff, in_diff_recompute;
+  nnet.Propagate(feats[0], &out);
+  nnet_recompute.Propagate(feats[0], &out_recompute);
+  AssertEqual(Matrix<BaseFloat>(out), Matrix<BaseFloat>(out_recompute), 0.0);
+  // the outputs of the <AffineTransform>s and the <Sigmoid> are dropped,
+  // the outputs of the <Tanh> and the <Softmax> are kept,
+  const std::vector<CuMatrix<BaseFloat> > &buf =
+    nnet_recompute.PropagateBuffer();
+  KALDI_ASSERT(buf[1].NumRows() == 0 && buf[2].NumRows() == 0 &&
+               buf[3].NumRows() == 0 && buf[4].NumRows() > 0 &&
+               buf[5].NumRows() == 0 && buf[6].NumRows() > 0);
+
+  xent.Eval(weights, out, post[0], &diff);
+  nnet.Backpropagate(diff, &in_diff);
+  nnet_recompute.Backpropagate(diff, &in_diff_recompute);
+  AssertEqual(Matrix<BaseFloat>(in_diff), Matrix<BaseFloat>(in_diff_recompute),
+              0.0);
+  Vector<BaseFloat> params_recompute;
+  nnet.GetParams(&params);
+  nnet_recompute.GetParams(&params_recompute);
+  AssertEqual(params, params_recompute, 0.0);
+
+  // with the bfloat16 activations, the recomputed buffers come from the
+  // last kept one, (restored from bfloat16),
+  trn_opts.bf16_activations = true;
+  nnet_recompute.SetTrainOptions(trn_opts);
+  nnet_recompute.Propagate(feats[0], &out_recompute);
+  nnet_recompute.Backpropagate(diff, &in_diff_recompute);
+  nnet.Propagate(feats[0], &out);
+  nnet.Backpropagate(diff, &in_diff);
+  AssertEqual(Matrix<BaseFloat>(in_diff), Matrix<BaseFloat>(in_diff_recompute),
+              0.02);
+}
+
+int main() {
+  for (int32 i = 0; i < 3; i++) {
+    UnitTestBf16Step();
+    UnitTestRecompute();
+  }
+  UnitTestBf16Convergence();
+  std::cout << "Tests succeeded.\n";
+  return 0;
+}
@@ -82,11 +82,23 @@ void Nnet::Propagate(const CuMatrixBase<BaseFloat> &in,
   if (propagate_buf_.size() != NumComponents()+1) {
     propagate_buf_.resize(NumComponents()+1);
   }
+  const bool bf16 = opts_.bf16_activations;
+  if (bf16 && propagate_bf16_.size() != NumComponents()+1) {
+    propagate_bf16_.resize(NumComponents()+1);
+  }
   // Copy input to first buffer,
   propagate_buf_[0] = in;
   // Propagate through all the components,
   for (int32 i = 0; i < static_cast<int32>(components_.size()); i++) {
     components_[i]->Propagate(propagate_buf_[i], &propagate_buf_[i+1]);
+    // the input is not needed until the backward pass,
+    if (i > 0 && IsRecomputed(i-1)) {
+      propagate_buf_[i].Resize(0, 0);
+      if (bf16) propagate_bf16_[i].Clear();
+    } else if (bf16) {
+      propagate_bf16_[i].CopyFromMat(propagate_buf_[i]);
+      propagate_buf_[i].Resize(0, 0);
+    }
   }
   // Copy the output from the last buffer,
   (*out) = propagate_buf_[NumComponents()];
@@ -109,10 +121,12 @@ void Nnet::Backpropagate(const CuMatrixBase<BaseFloat> &out_diff,
   if (backpropagate_buf_.size() != NumComponents()+1) {
     backpropagate_buf_.resize(NumComponents()+1);
   }
+  const bool bf16 = opts_.bf16_activations;
   // Copy 'out_diff' to last buffer,
   backpropagate_buf_[NumComponents()] = out_diff;
   // Loop from last Component to the first,
   for (int32 i = NumComponents()-1; i >= 0; i--) {
+    RestorePropagateBuf(i);
     // Backpropagate through 'Component',
     components_[i]->Backpropagate(propagate_buf_[i],
                                   propagate_buf_[i+1],
@@ -124,7 +138,13 @@ void Nnet::Backpropagate(const CuMatrixBase<BaseFloat> &out_diff,
         dynamic_cast<UpdatableComponent*>(components_[i]);
       uc->Update(propagate_buf_[i], backpropagate_buf_[i+1]);
     }
+    // the output (still in bfloat16 from the forward pass, or recomputed)
+    // is not needed anymore,
+    if ((bf16 || IsRecomputed(i)) && i+1 < NumComponents()) {
+      propagate_buf_[i+1].Resize(0, 0);
+    }
   }
+  if (bf16) propagate_buf_[0].Resize(0, 0);
   // Export the derivative (if applicable),
   if (NULL != in_diff) {
     (*in_diff) = backpropagate_buf_[0];
@@ -155,6 +175,7 @@ void Nnet::Feedbackward(const CuMatrixBase<BaseFloat> &out_diff,
   if (backpropagate_buf_.size() != NumComponents()+1) {
     backpropagate_buf_.resize(NumComponents()+1);
   }
+  for (int32 i = 0; i < NumComponents(); i++) RestorePropagateBuf(i);
   // Copy 'out_diff' to last buffer,
   backpropagate_buf_[NumComponents()] = out_diff;
   // Loop from last Component to the first,
@@ -182,6 +203,22 @@ int32 Nnet::InputDim() const {
   return components_.front()->InputDim();
 }
 
+int32 Nnet::LeftContext() const {
+  int32 ans = 0;
+  for (int32 c = 0; c < NumComponents(); c++) {
+    ans += components_[c]->LeftContext();
+  }
+  return ans;
+}
+
+int32 Nnet::RightContext() const {
+  int32 ans = 0;
+  for (int32 c = 0; c < NumComponents(); c++) {
+    ans += components_[c]->RightContext();
+  }
+  return ans;
+}
+
 const Component& Nnet::GetComponent(int32 c) const {
   return *(components_.at(c));
 }
@@ -452,16 +489,31 @@ std::string Nnet::InfoGradient(bool header) const {
   return ostr.str();
 }
 
+/// The statistics of forward-pass buffer 'i', which may be kept in bfloat16,
+static std::string BufferStatistics(
+    const std::vector<CuMatrix<BaseFloat> > &buf,
+    const std::vector<CuBf16Matrix> &buf_bf16, int32 i) {
+  if (buf[i].NumRows() == 0 && i < buf_bf16.size() &&
+      buf_bf16[i].NumRows() > 0) {
+    CuMatrix<BaseFloat> mat(buf_bf16[i].NumRows(), buf_bf16[i].NumCols(),
+                            kUndefined);
+    buf_bf16[i].CopyToMat(&mat);
+    return MomentStatistics(mat);
+  }
+  return MomentStatistics(buf[i]);
+}
+
 std::string Nnet::InfoPropagate(bool header) const {
   std::ostringstream ostr;
   // forward-pass buffer stats
   if (header) ostr << "\n### FORWARD PROPAGATION BUFFER CONTENT :\n";
-  ostr << "[0] output of <Input> " << MomentStatistics(propagate_buf_[0])
-       << std::endl;
+  ostr << "[0] output of <Input> "
+       << BufferStatistics(propagate_buf_, propagate_bf16_, 0) << std::endl;
   for (int32 i = 0; i < NumComponents(); i++) {
     ostr << "[" << 1+i << "] output of "
          << Component::TypeToMarker(components_[i]->GetType())
-         << MomentStatistics(propagate_buf_[i+1]) << std::endl;
+         << BufferStatistics(propagate_buf_, propagate_bf16_, i+1)
+         << std::endl;
     // nested networks too...
     if (Component::kParallelComponent == components_[i]->GetType()) {
       ostr <<
@@ -479,12 +531,13 @@ std::string Nnet::InfoBackPropagate(bool header) const {
   std::ostringstream ostr;
   // forward-pass buffer stats
   if (header) ostr << "\n### BACKWARD PROPAGATION BUFFER CONTENT :\n";
-  ostr << "[0] diff of <Input> " << MomentStatistics(backpropagate_buf_[0])
-       << std::endl;
+  ostr << "[0] diff of <Input> "
+       << MomentStatistics(backpropagate_buf_[0]) << std::endl;
   for (int32 i = 0; i < NumComponents(); i++) {
     ostr << "["<<1+i<< "] diff-output of "
          << Component::TypeToMarker(components_[i]->GetType())
-         << MomentStatistics(backpropagate_buf_[i+1]) << std::endl;
+         << MomentStatistics(backpropagate_buf_[i+1])
+         << std::endl;
     // nested networks too...
     if (Component::kParallelComponent == components_[i]->GetType()) {
       ostr <<
@@ -537,11 +590,85 @@ void Nnet::Destroy() {
   components_.resize(0);
   propagate_buf_.resize(0);
   backpropagate_buf_.resize(0);
+  propagate_bf16_.resize(0);
+}
+
+
+void Nnet::RestorePropagateBuf(int32 i) {
+  if (propagate_buf_[i].NumRows() > 0) return;
+  if (i < propagate_bf16_.size() && propagate_bf16_[i].NumRows() > 0) {
+    propagate_buf_[i].Resize(propagate_bf16_[i].NumRows(),
+                             propagate_bf16_[i].NumCols(), kUndefined);
+    propagate_bf16_[i].CopyToMat(&propagate_buf_[i]);
+  } else if (i > 0 && IsRecomputed(i-1)) {
+    // from the last buffer that was kept,
+    RestorePropagateBuf(i-1);
+    components_[i-1]->Propagate(propagate_buf_[i-1], &propagate_buf_[i]);
+  }
+}
+
+
+bool Nnet::IsRecomputed(int32 c) const {
+  return (c+1 < NumComponents() &&
+          std::find(recompute_types_.begin(), recompute_types_.end(),
+                    components_[c]->GetType()) != recompute_types_.end());
+}
+
+
+std::string Nnet::InfoRecompute() const {
+  // the activations kept between the passes (floats per frame), and the
+  // cost of the forward pass (roughly, multiply-adds per frame),
+  int64 num_kept = InputDim(), num_kept_recompute = InputDim();
+  double cost = 0.0, cost_recompute = 0.0;
+  int32 num_recomputed = 0;
+  for (int32 c = 0; c < NumComponents(); c++) {
+    const Component &comp = *components_[c];
+    double comp_cost = (comp.IsUpdatable() ?
+        dynamic_cast<const UpdatableComponent&>(comp).NumParams() :
+        comp.OutputDim());
+    num_kept += comp.OutputDim();
+    cost += comp_cost;
+    if (IsRecomputed(c)) {
+      num_recomputed++;
+      cost_recompute += comp_cost;
+    } else {
+      num_kept_recompute += comp.OutputDim();
+    }
+  }
+  std::ostringstream os;
+  os << "Recomputing the outputs of " << num_recomputed << " of the "
+     << NumComponents() << " components in the backward pass, the activations "
+     << "kept between the passes go from " << num_kept << " to "
+     << num_kept_recompute << " floats per frame, the forward pass costs about "
+     << 100.0 * cost_recompute / std::max(cost, 1.0) << "% more.";
+  return os.str();
 }
 
 
 void Nnet::SetTrainOptions(const NnetTrainOptions& opts) {
   opts_ = opts;
+  // the components with the output recomputed in the backward pass,
+  recompute_types_.clear();
+  std::vector<std::string> markers;
+  SplitStringToVector(opts_.recompute_components, ",", true, &markers);
+  for (size_t k = 0; k < markers.size(); k++) {
+    std::string marker = markers[k];
+    if (marker[0] != '<') marker = "<" + marker + ">";
+    Component::ComponentType t = Component::MarkerToType(marker);
+    switch (t) {
+      case Component::kDropout:
+      case Component::kLstmProjected:
+      case Component::kBlstmProjected:
+      case Component::kRecurrentComponent:
+      case Component::kParallelComponent:
+      case Component::kMultiBasisComponent:
+        KALDI_ERR << "The output of " << marker << " cannot be recomputed "
+                  << "(random, keeps a state, or has nested networks).";
+      default:
+        break;
+    }
+    recompute_types_.push_back(t);
+  }
   // set values to individual components,
   for (int32 l = 0; l < NumComponents(); l++) {
     if (GetComponent(l).IsUpdatable()) {
@@ -555,6 +682,7 @@ void Nnet::LhnAdaptation(const CuMatrix<BaseFloat> &out_diff, CuMatrix<BaseFloat
   KALDI_ASSERT((int32)propagate_buf_.size() >= NumComponents()+1);
   // we need at least L-1 error derivative bufers
   KALDI_ASSERT((int32)backpropagate_buf_.size() >= NumComponents()-1);
+  for (int32 i = 0; i < NumComponents(); i++) RestorePropagateBuf(i);
   //////////////////////////////////////
   // Backpropagation
   //
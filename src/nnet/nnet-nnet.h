@@ -28,6 +28,7 @@
 #include "base/kaldi-common.h"
 #include "util/kaldi-io.h"
 #include "matrix/matrix-lib.h"
+#include "cudamatrix/cu-compressed-matrix.h"
 #include "nnet/nnet-trnopts.h"
 #include "nnet/nnet-component.h"
 
@@ -61,6 +62,11 @@ class Nnet {
   /// Dimensionality of network outputs (posteriors | bn-features | etc.),
   int32 OutputDim() const;
 
+  /// Number of frames of left/right context the network needs for one
+  /// output frame (the sum over the components, e.g. <Splice>, FSMN),
+  int32 LeftContext() const;
+  int32 RightContext() const;
+
   /// Returns the number of 'Components' which form the NN.
   /// Typically a NN layer is composed of 2 components:
   /// the <AffineTransform> with trainable parameters
@@ -104,7 +110,9 @@ class Nnet {
   /// Remove the last of the Components,
   void RemoveLastComponent();
 
-  /// Access to the forward-pass buffers
+  /// Access to the forward-pass buffers (with 'bf16_activations' or
+  /// 'recompute_components' in the training options, the buffers not in use
+  /// are empty),
   const std::vector<CuMatrix<BaseFloat> >& PropagateBuffer() const {
     return propagate_buf_;
   }
@@ -160,6 +168,10 @@ class Nnet {
   /// Relese the memory,
   void Destroy();
 
+  /// Summary of the activation checkpointing ('recompute_components' in
+  /// the training options): the activations kept and the extra compute,
+  std::string InfoRecompute() const;
+
   /// Set hyper-parameters of the training (pushes to all UpdatableComponents),
   void SetTrainOptions(const NnetTrainOptions& opts);
   /// Get training hyper-parameters from the network,
@@ -178,6 +190,22 @@ class Nnet {
   /// Buffers for backward pass (on demand initialization),
   std::vector<CuMatrix<BaseFloat> > backpropagate_buf_;
 
+  /// With 'bf16_activations' in the training options, the forward-pass
+  /// buffers not in use are kept here in bfloat16 (and the float ones are
+  /// freed),
+  std::vector<CuBf16Matrix> propagate_bf16_;
+
+  /// Restores the forward-pass buffer 'i' from bfloat16 (if it is there),
+  /// or recomputes it (if it was dropped, see 'recompute_components'),
+  void RestorePropagateBuf(int32 i);
+
+  /// The component types from 'recompute_components' in the training options,
+  std::vector<Component::ComponentType> recompute_types_;
+
+  /// True if the output of component 'c' is dropped after the forward pass
+  /// and recomputed in the backward pass (never the output of the network),
+  bool IsRecomputed(int32 c) const;
+
   /// Option class with hyper-parameters passed to UpdatableComponent(s)
   NnetTrainOptions opts_;
 };
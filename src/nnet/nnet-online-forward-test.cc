@@ -0,0 +1,93 @@
+// nnet/nnet-online-forward-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-online-forward.h"
+#include "nnet/nnet-component.h"
+
+using namespace kaldi;
+using namespace kaldi::nnet1;
+
+static void InitNnet(Nnet *nnet) {
+  nnet->AppendComponentPointer(Component::Init(
+      "<Splice> <InputDim> 4 <OutputDim> 20 <ReadVector> [ -2 -1 0 1 2 ]"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 20 <OutputDim> 8 <ParamStddev> 0.3"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Sigmoid> <InputDim> 8 <OutputDim> 8"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Fsmn> <InputDim> 8 <OutputDim> 8 <LOrder> 3 <ROrder> 2 "
+      "<LStride> 1 <RStride> 2"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<LstmProjected> <InputDim> 8 <OutputDim> 6 <CellDim> 10 "
+      "<ParamRange> 0.5 <CellClip> 50 <DiffClip> 1"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<Splice> <InputDim> 6 <OutputDim> 18 <ReadVector> [ -1 0 3 ]"));
+  nnet->AppendComponentPointer(Component::Init(
+      "<AffineTransform> <InputDim> 18 <OutputDim> 4 <ParamStddev> 0.3"));
+}
+
+// Streaming with random chunk sizes gives the whole-utterance output,
+static void UnitTestOnlineForward() {
+  Nnet nnet;
+  InitNnet(&nnet);
+  KALDI_ASSERT(nnet.LeftContext() == 2 + 2 + 1);
+  KALDI_ASSERT(nnet.RightContext() == 2 + 4 + 3);
+
+  OnlineNnetForward online(&nnet);
+  KALDI_ASSERT(online.Latency() == nnet.RightContext());
+  for (int32 utt = 0; utt < 4; utt++) {
+    int32 num_frames = (utt == 0 ? 3 : 20 + Rand() % 50);
+    CuMatrix<BaseFloat> feats(num_frames, 4);
+    feats.SetRandn();
+
+    CuMatrix<BaseFloat> ref;
+    nnet.Feedforward(feats, &ref);
+
+    online.Reset();
+    CuMatrix<BaseFloat> out(num_frames, ref.NumCols()), chunk_out;
+    int32 num_out = 0;
+    for (int32 t = 0; t < num_frames; ) {
+      int32 chunk = std::min(num_frames - t, 1 + Rand() % 7);
+      online.AcceptFrames(feats.RowRange(t, chunk));
+      t += chunk;
+      // the output frames come with the latency,
+      KALDI_ASSERT(num_out + online.NumFramesReady() ==
+                   std::max(0, t - online.Latency()));
+      online.GetFrames(&chunk_out);
+      if (chunk_out.NumRows() > 0) {
+        out.RowRange(num_out, chunk_out.NumRows()).CopyFromMat(chunk_out);
+        num_out += chunk_out.NumRows();
+      }
+    }
+    online.InputFinished();
+    online.GetFrames(&chunk_out);
+    KALDI_ASSERT(num_out + chunk_out.NumRows() == num_frames);
+    out.RowRange(num_out, chunk_out.NumRows()).CopyFromMat(chunk_out);
+    KALDI_ASSERT(online.NumFramesAccepted() == num_frames);
+    KALDI_ASSERT(online.NumFramesOutput() == num_frames);
+
+    AssertEqual(Matrix<BaseFloat>(out), Matrix<BaseFloat>(ref), 1e-4);
+  }
+}
+
+int main() {
+  for (int32 i = 0; i < 3; i++) {
+    UnitTestOnlineForward();
+  }
+  std::cout << "Tests succeeded.\n";
+  return 0;
+}
@@ -0,0 +1,178 @@
+// nnet/nnet-online-forward.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet/nnet-online-forward.h"
+
+#include <algorithm>
+
+namespace kaldi {
+namespace nnet1 {
+
+// Appends the rows of 'src' to 'dst',
+static void AppendRows(const CuMatrixBase<BaseFloat> &src,
+                       CuMatrix<BaseFloat> *dst) {
+  if (src.NumRows() == 0) return;
+  if (dst->NumRows() == 0) {
+    *dst = src;
+    return;
+  }
+  KALDI_ASSERT(src.NumCols() == dst->NumCols());
+  CuMatrix<BaseFloat> tmp(dst->NumRows() + src.NumRows(), src.NumCols(),
+                          kUndefined);
+  tmp.RowRange(0, dst->NumRows()).CopyFromMat(*dst);
+  tmp.RowRange(dst->NumRows(), src.NumRows()).CopyFromMat(src);
+  dst->Swap(&tmp);
+}
+
+
+OnlineNnetForward::OnlineNnetForward(Nnet *nnet):
+    nnet_(nnet), latency_(0) {
+  for (int32 c = 0; c < nnet_->NumComponents(); c++) {
+    Component &comp = nnet_->GetComponent(c);
+    switch (comp.GetType()) {
+      case Component::kBlstmProjected:
+      case Component::kRecurrentComponent:
+      case Component::kSentenceAveragingComponent:
+      case Component::kSimpleSentenceAveragingComponent:
+      case Component::kParallelComponent:
+        KALDI_ERR << "Component " << Component::TypeToMarker(comp.GetType())
+                  << " cannot be used in the chunk-by-chunk forward pass.";
+      default:
+        break;
+    }
+    Stage stage;
+    stage.comp = &comp;
+    stage.left_context = comp.LeftContext();
+    stage.right_context = comp.RightContext();
+    stage.lstm = (comp.GetType() == Component::kLstmProjected);
+    stages_.push_back(stage);
+    latency_ += stage.right_context;
+  }
+  Reset();
+}
+
+void OnlineNnetForward::Reset() {
+  for (size_t s = 0; s < stages_.size(); s++) {
+    Stage &stage = stages_[s];
+    stage.buf.Resize(0, 0);
+    stage.buf_begin = stage.num_in = stage.num_out = 0;
+    if (stage.lstm) {
+      // a single stream, starting with zero state,
+      MultistreamComponent *comp =
+        dynamic_cast<MultistreamComponent*>(stage.comp);
+      comp->SetSeqLengths(std::vector<int32>());
+      comp->ResetStreams(std::vector<int32>(1, 1));
+    }
+  }
+  input_finished_ = false;
+  ready_.Resize(0, 0);
+  num_frames_accepted_ = num_frames_output_ = 0;
+}
+
+void OnlineNnetForward::AcceptFrames(const CuMatrixBase<BaseFloat> &feats) {
+  KALDI_ASSERT(!input_finished_ && "AcceptFrames() after InputFinished()");
+  if (feats.NumRows() == 0) return;
+  KALDI_ASSERT(feats.NumCols() == nnet_->InputDim());
+  num_frames_accepted_ += feats.NumRows();
+  Forward(feats);
+}
+
+void OnlineNnetForward::InputFinished() {
+  if (input_finished_) return;
+  input_finished_ = true;
+  // the stages flush the frames waiting for the right context,
+  Forward(CuMatrix<BaseFloat>());
+  // the LSTMs go back to the whole-utterance mode (no state kept
+  // between the calls of Nnet::Propagate()),
+  for (size_t s = 0; s < stages_.size(); s++) {
+    if (stages_[s].lstm) {
+      dynamic_cast<MultistreamComponent*>(stages_[s].comp)->SetSeqLengths(
+          std::vector<int32>());
+    }
+  }
+}
+
+void OnlineNnetForward::GetFrames(CuMatrix<BaseFloat> *out) {
+  out->Resize(0, 0);
+  out->Swap(&ready_);
+  num_frames_output_ += out->NumRows();
+}
+
+void OnlineNnetForward::Forward(const CuMatrixBase<BaseFloat> &feats) {
+  if (stages_.empty()) {
+    AppendRows(feats, &ready_);
+    return;
+  }
+  CuMatrix<BaseFloat> in, out;
+  Advance(0, feats, &out);
+  for (size_t s = 1; s < stages_.size(); s++) {
+    in.Swap(&out);
+    Advance(s, in, &out);
+  }
+  AppendRows(out, &ready_);
+}
+
+void OnlineNnetForward::Advance(int32 s, const CuMatrixBase<BaseFloat> &in,
+                                CuMatrix<BaseFloat> *out) {
+  Stage &stage = stages_[s];
+  out->Resize(0, 0);
+  AppendRows(in, &stage.buf);
+  stage.num_in += in.NumRows();
+
+  // the frames with the right context available (or all at the end),
+  int64 end = stage.num_in;
+  if (!input_finished_) end -= stage.right_context;
+  if (end <= stage.num_out) return;
+
+  // the window with the context of the new frames; at the beginning or
+  // the end of the utterance it is cut, as in the whole-utterance case,
+  int64 win_begin = std::max(stage.buf_begin,
+                             stage.num_out - stage.left_context),
+    win_end = std::min(stage.num_in, end + stage.right_context);
+  CuSubMatrix<BaseFloat> window(stage.buf.RowRange(
+      win_begin - stage.buf_begin, win_end - win_begin));
+  if (stage.lstm) {
+    KALDI_ASSERT(win_begin == stage.num_out && win_end == end);
+    dynamic_cast<MultistreamComponent*>(stage.comp)->SetSeqLengths(
+        std::vector<int32>(1, end - stage.num_out));
+  }
+  CuMatrix<BaseFloat> win_out;
+  stage.comp->Propagate(window, &win_out);
+  if (win_begin == stage.num_out && win_end == end) {
+    out->Swap(&win_out);
+  } else {
+    *out = win_out.RowRange(stage.num_out - win_begin, end - stage.num_out);
+  }
+  stage.num_out = end;
+
+  // keep only the left context of the next frame,
+  int64 keep_begin = std::max(stage.buf_begin,
+                              stage.num_out - stage.left_context);
+  if (keep_begin > stage.buf_begin) {
+    if (keep_begin == stage.num_in) {
+      stage.buf.Resize(0, 0);
+    } else {
+      CuMatrix<BaseFloat> tmp(stage.buf.RowRange(
+          keep_begin - stage.buf_begin, stage.num_in - keep_begin));
+      stage.buf.Swap(&tmp);
+    }
+    stage.buf_begin = keep_begin;
+  }
+}
+
+}  // namespace nnet1
+}  // namespace kaldi
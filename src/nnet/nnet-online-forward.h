@@ -0,0 +1,109 @@
+// nnet/nnet-online-forward.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET_NNET_ONLINE_FORWARD_H_
+#define KALDI_NNET_NNET_ONLINE_FORWARD_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "cudamatrix/cu-matrix.h"
+#include "nnet/nnet-nnet.h"
+
+namespace kaldi {
+namespace nnet1 {
+
+/**
+ * Chunk-by-chunk (streaming) forward pass of an nnet1 network, for the
+ * low-latency inference, e.g. an enhancement network between the online
+ * LPS front end (OnlineEnhancementFeaturePipeline) and the overlap-add
+ * resynthesis (OverlapAddSynthesizer).
+ *
+ * The input frames come in chunks of any size through AcceptFrames(),
+ * an output frame is ready as soon as the right context of the network
+ * is available, i.e. the output is delayed by Latency() frames. After
+ * InputFinished() all the frames are ready. The output is the same as
+ * with Nnet::Feedforward() on the whole utterance:
+ *  - each component keeps the input frames of its left context from the
+ *    previous chunks, and waits for the frames of its right context
+ *    (<Splice>, the FSMN memory blocks), the beginning and the end of
+ *    the utterance are handled by the component itself,
+ *  - <LstmProjected> carries its state from one chunk to the next.
+ * The components which need the whole utterance (<BlstmProjected>,
+ * <RecurrentComponent>, the sentence averaging) or have nested networks
+ * (<ParallelComponent>) are not supported.
+ */
+class OnlineNnetForward {
+ public:
+  /// The 'nnet' is not owned, and should not be used by anything
+  /// else until the stream is finished (the LSTMs keep the state),
+  explicit OnlineNnetForward(Nnet *nnet);
+
+  /// Appends the input frames,
+  void AcceptFrames(const CuMatrixBase<BaseFloat> &feats);
+
+  /// Says that no more frames will come, so all the frames become ready,
+  void InputFinished();
+
+  /// The number of output frames ready, but not retrieved by GetFrames(),
+  int32 NumFramesReady() const { return ready_.NumRows(); }
+
+  /// Outputs (and forgets) the ready frames, 'out' is resized,
+  /// possibly to zero rows,
+  void GetFrames(CuMatrix<BaseFloat> *out);
+
+  int64 NumFramesAccepted() const { return num_frames_accepted_; }
+  int64 NumFramesOutput() const { return num_frames_output_; }
+
+  /// The delay of the output in frames (right context of the network),
+  int32 Latency() const { return latency_; }
+
+  /// Prepares for a new utterance (resets the LSTM state),
+  void Reset();
+
+ private:
+  /// A component with the input frames it still needs,
+  struct Stage {
+    Component *comp;
+    int32 left_context, right_context;
+    bool lstm;
+    CuMatrix<BaseFloat> buf;  ///< The input frames [buf_begin, num_in),
+    int64 buf_begin, num_in, num_out;
+  };
+
+  /// Gives the new input frames 'in' to stage 's', and the new output
+  /// frames of the stage to 'out',
+  void Advance(int32 s, const CuMatrixBase<BaseFloat> &in,
+               CuMatrix<BaseFloat> *out);
+
+  /// Runs all the stages on the new input frames,
+  void Forward(const CuMatrixBase<BaseFloat> &feats);
+
+  Nnet *nnet_;
+  std::vector<Stage> stages_;
+  bool input_finished_;
+  CuMatrix<BaseFloat> ready_;
+  int64 num_frames_accepted_, num_frames_output_;
+  int32 latency_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineNnetForward);
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
+#endif  // KALDI_NNET_NNET_ONLINE_FORWARD_H_
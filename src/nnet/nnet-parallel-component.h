@@ -346,7 +346,7 @@ class ParallelComponent : public MultistreamComponent {
    * which was MultistreamComponent::SetSeqLengths(...)
    */
   void SetSeqLengths(const std::vector<int32> &sequence_lengths) {
-    sequence_lengths_ = sequence_lengths;
+    MultistreamComponent::SetSeqLengths(sequence_lengths);
     // loop over nnets,
     for (int32 i = 0; i < nnet_.size(); i++) {
       nnet_[i].SetSeqLengths(sequence_lengths);
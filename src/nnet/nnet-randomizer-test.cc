@@ -229,11 +229,57 @@ void UnitTestStdVectorRandomizer() {
 }
 
 
+void UnitTestFrameSelector() {
+  // zero, low and high weights,
+  Vector<BaseFloat> w(30000);
+  for (int32 i = 0; i < w.Dim(); i++) {
+    w(i) = (i % 3 == 0 ? 0.0 : (i % 3 == 1 ? 0.1 : 1.0 + RandUniform()));
+  }
+  // without sampling, only the zero-weight frames are dropped,
+  {
+    FrameSelector s(0.0, 777);
+    Vector<BaseFloat> w2(w);
+    std::vector<MatrixIndexT> keep;
+    KALDI_ASSERT(s.Select(&w2, &keep));
+    KALDI_ASSERT(keep.size() == 20000 && w2.Dim() == 20000);
+    for (int32 i = 0; i < keep.size(); i++) {
+      KALDI_ASSERT(w2(i) == w(keep[i]) && w2(i) > 0.0);
+    }
+    // nothing to drop,
+    Vector<BaseFloat> w3(w2);
+    KALDI_ASSERT(!s.Select(&w3, &keep));
+    AssertEqual(w3, w2, 0.0);
+    KALDI_ASSERT(s.NumFramesIn() == 50000 && s.NumFramesKept() == 40000);
+  }
+  // with sampling, the high weights are kept, the low weights are
+  // sampled and raised, the sum of weights is kept (in expectation),
+  {
+    FrameSelector s(0.5, 777);
+    Vector<BaseFloat> w2(w);
+    std::vector<MatrixIndexT> keep;
+    KALDI_ASSERT(s.Select(&w2, &keep));
+    int32 num_low = 0;
+    for (int32 i = 0; i < keep.size(); i++) {
+      if (w(keep[i]) < 0.5) {
+        KALDI_ASSERT(w2(i) == 0.5);
+        num_low++;
+      } else {
+        KALDI_ASSERT(w2(i) == w(keep[i]));
+      }
+    }
+    KALDI_LOG << "Kept " << num_low << " of 10000 low-weight frames.";
+    KALDI_ASSERT(num_low > 1700 && num_low < 2300);  // 2000 expected,
+    KALDI_ASSERT(ApproxEqual(w2.Sum(), w.Sum(), 0.02));
+  }
+}
+
+
 int main() {
   UnitTestRandomizerMask();
   UnitTestMatrixRandomizer();
   UnitTestVectorRandomizer();
   UnitTestStdVectorRandomizer();
+  UnitTestFrameSelector();
 
   std::cout << "Tests succeeded.\n";
 }
@@ -42,6 +42,46 @@ const std::vector<int32>& RandomizerMask::Generate(int32 mask_size) {
 }
 
 
+/* FrameSelector:: */
+
+FrameSelector::FrameSelector(BaseFloat weight_sampling, int32 seed):
+    weight_sampling_(weight_sampling),
+    num_frames_in_(0),
+    num_frames_kept_(0) {
+  KALDI_ASSERT(weight_sampling_ >= 0.0);
+  rand_state_.seed = seed + 27437;
+}
+
+bool FrameSelector::Select(Vector<BaseFloat> *weights,
+                           std::vector<MatrixIndexT> *keep_frames) {
+  keep_frames->clear();
+  num_frames_in_ += weights->Dim();
+  // are there any frames to be removed? (frames with zero weight, or
+  // low-weight frames we sample from),
+  BaseFloat weight_min = (weights->Dim() > 0 ? weights->Min() : 1.0);
+  KALDI_ASSERT(weight_min >= 0.0);
+  if (weight_min > 0.0 && weight_min >= weight_sampling_) {
+    num_frames_kept_ += weights->Dim();
+    return false;
+  }
+  Vector<BaseFloat> kept_weights(weights->Dim(), kUndefined);
+  for (MatrixIndexT i = 0; i < weights->Dim(); i++) {
+    BaseFloat w = (*weights)(i);
+    if (w == 0.0) continue;
+    if (w < weight_sampling_) {
+      if (RandUniform(&rand_state_) * weight_sampling_ >= w) continue;
+      w = weight_sampling_;
+    }
+    kept_weights(keep_frames->size()) = w;
+    keep_frames->push_back(i);
+  }
+  num_frames_kept_ += keep_frames->size();
+  weights->Resize(keep_frames->size(), kUndefined);
+  weights->CopyFromVec(kept_weights.Range(0, keep_frames->size()));
+  return true;
+}
+
+
 /* MatrixRandomizer:: */
 
 void MatrixRandomizer::AddData(const CuMatrixBase<BaseFloat>& m) {
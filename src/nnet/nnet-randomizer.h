@@ -81,6 +81,35 @@ class RandomizerMask {
 };
 
 
+/**
+ * Selects the frames which are passed to the randomizers, by the per-frame
+ * weights. The frames with zero weight do not contribute to the gradient,
+ * so they are dropped before the forward pass. With 'weight_sampling' > 0,
+ * the frames with a weight 'w' below 'weight_sampling' are importance-sampled:
+ * a frame is kept with probability w / weight_sampling and its weight is
+ * raised to 'weight_sampling', so the expected gradient is unchanged.
+ */
+class FrameSelector {
+ public:
+  FrameSelector(BaseFloat weight_sampling, int32 seed);
+
+  /// Selects the frames of an utterance, 'weights' are replaced by the
+  /// (re-scaled) weights of the kept frames. Returns false if all the frames
+  /// are kept, otherwise 'keep_frames' has the indices of the kept frames,
+  bool Select(Vector<BaseFloat> *weights,
+              std::vector<MatrixIndexT> *keep_frames);
+
+  int64 NumFramesIn() const { return num_frames_in_; }
+  int64 NumFramesKept() const { return num_frames_kept_; }
+
+ private:
+  BaseFloat weight_sampling_;
+  RandomState rand_state_;  // the selection runs in the loader thread,
+  int64 num_frames_in_;
+  int64 num_frames_kept_;
+};
+
+
 /**
  * Shuffles rows of a matrix according to the indices in the mask,
  */
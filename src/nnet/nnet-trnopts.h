@@ -33,13 +33,16 @@ struct NnetTrainOptions {
   BaseFloat momentum;
   BaseFloat l2_penalty;
   BaseFloat l1_penalty;
+  bool bf16_activations;
+  std::string recompute_components;
 
   // default values
   NnetTrainOptions():
     learn_rate(0.008),
     momentum(0.0),
     l2_penalty(0.0),
-    l1_penalty(0.0)
+    l1_penalty(0.0),
+    bf16_activations(false)
   { }
 
   // register options
@@ -48,6 +51,17 @@ struct NnetTrainOptions {
     opts->Register("momentum", &momentum, "Momentum");
     opts->Register("l2-penalty", &l2_penalty, "L2 penalty (weight decay)");
     opts->Register("l1-penalty", &l1_penalty, "L1 penalty (promote sparsity)");
+    opts->Register("bf16-activations", &bf16_activations,
+                   "Keep the activations between the forward and the "
+                   "backward pass in bfloat16 (activation storage only, half "
+                   "of the memory; the computation, the derivatives, the "
+                   "weights and the updates stay in float)");
+    opts->Register("recompute-components", &recompute_components,
+                   "Comma-separated list of component types (e.g. "
+                   "'<Sigmoid>,<AffineTransform>'), the outputs of these "
+                   "components are freed after the forward pass and recomputed "
+                   "in the backward pass (activation checkpointing, less "
+                   "memory for more compute)");
   }
 
   // print for debug purposes
@@ -56,7 +70,9 @@ struct NnetTrainOptions {
        << "learn_rate" << opts.learn_rate << ", "
        << "momentum" << opts.momentum << ", "
        << "l2_penalty" << opts.l2_penalty << ", "
-       << "l1_penalty" << opts.l1_penalty;
+       << "l1_penalty" << opts.l1_penalty << ", "
+       << "bf16_activations" << opts.bf16_activations << ", "
+       << "recompute_components" << opts.recompute_components;
     return os;
   }
 };
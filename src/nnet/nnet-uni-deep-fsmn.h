@@ -43,6 +43,9 @@ namespace nnet1 {
    Component* Copy() const { return new UniDeepFsmn(*this); }
    ComponentType GetType() const { return kUniDeepFsmn; }
 
+   // the left filter has the taps t, t-s, ..., t-(l_order-1)*s,
+   int32 LeftContext() const { return std::max(0, (l_order_ - 1) * l_stride_); }
+
    void SetFlags(const Vector<BaseFloat> &flags) {
      flags_.Resize(flags.Dim(), kSetZero);
      flags_.CopyFromVec(flags);
@@ -51,6 +51,18 @@ class Splice: public Component {
   Component* Copy() const { return new Splice(*this); }
   ComponentType GetType() const { return kSplice; }
 
+  int32 LeftContext() const {
+    std::vector<int32> offsets;
+    frame_offsets_.CopyToVec(&offsets);
+    return std::max(0, -*std::min_element(offsets.begin(), offsets.end()));
+  }
+
+  int32 RightContext() const {
+    std::vector<int32> offsets;
+    frame_offsets_.CopyToVec(&offsets);
+    return std::max(0, *std::max_element(offsets.begin(), offsets.end()));
+  }
+
   void InitData(std::istream &is) {
     // define options,
     std::vector<std::vector<int32> > build_vector;
@@ -761,8 +761,9 @@ void ComputationChecker::CheckComputationCompression() const {
                      kDecompressMatrix &&
                      command_index < middle_command &&
                      next_command_index > middle_command);
-        if (command.alpha == 0.0) {
-          // alpha == 0.0 means we're only retaining the sign; we should
+        if (command.alpha == 0.0 && command.arg2 != kCompressedMatrixBf16) {
+          // alpha == 0.0 means we're only retaining the sign (bfloat16 has
+          // no range, so alpha is always 0.0 there); we should
           // only do this if this is the output of a ReLU.
           // make sure there are only 2 commands after this: the uncompress
           // command, and a relu backprop command.  (Any deallocation
@@ -1040,12 +1041,13 @@ void ComputationChecker::CheckComputationIndexes() const {
             !computation_.IsWholeMatrix(c.arg1))
           KALDI_ERR << "submatrix index out of range or invalid";
         if (c.arg2 < static_cast<int32>(kCompressedMatrixInt8) ||
-            c.arg2 > static_cast<int32>(kCompressedMatrixUint16))
+            c.arg2 > static_cast<int32>(kCompressedMatrixBf16))
           KALDI_ERR << "Invalid compressed-matrix type.";
         if (c.arg3 != 0 && c.arg3 != 1)
           KALDI_ERR << "Invalid 'truncate' option for compressing matrix.";
         if (c.alpha < 0.0 || c.alpha > 1000.0 ||
-            (c.alpha == 0.0 && c.arg2 != kCompressedMatrixUint8))
+            (c.alpha == 0.0 && c.arg2 != kCompressedMatrixUint8 &&
+             c.arg2 != kCompressedMatrixBf16))
           KALDI_ERR << "Invalid alpha in kCompressMatrix command.";
         break;
       }
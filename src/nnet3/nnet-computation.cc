@@ -632,8 +632,9 @@ static void PrintCommand(std::ostream &os_out,
       if (c.arg2 == kCompressedMatrixInt8) { compressed_matrix_type = "int8"; }
       else if (c.arg2 == kCompressedMatrixUint8) { compressed_matrix_type = "uint8"; }
       else if (c.arg2 == kCompressedMatrixInt16) { compressed_matrix_type = "int16"; }
+      else if (c.arg2 == kCompressedMatrixBf16) { compressed_matrix_type = "bf16"; }
       else {
-        KALDI_ASSERT(c.arg2 == kCompressedMatrixInt16);
+        KALDI_ASSERT(c.arg2 == kCompressedMatrixUint16);
         compressed_matrix_type = "uint16";
       }
       os << "CompressMatrix(" << submatrix_strings[c.arg1] << ", "
@@ -251,8 +251,8 @@ struct ComputationRequestPtrEqual {
    - kCompressMatrix: Compresses the matrix which should be referred to
      by submatrix-index arg1.  arg2 is a number that determines the
      compression type (it's converted from the enum
-     CuCompressedMatrixType; 1=int8, 2=uint8, 3=int16, 4=uint16), and alpha
-     determines the 'range' parameter (c.f. NewCuCompressedMatrix()).  arg3
+     CuCompressedMatrixType; 1=int8, 2=uint8, 3=int16, 4=uint16, 5=bf16),
+     and alpha determines the 'range' parameter (c.f. NewCuCompressedMatrix()).  arg3
      will be converted to the 'truncate' argument to the class
      CuCompressedMatrix; it should be false (0) if you know that the input is
      limited to the allowed range, and true (1) if the input may exceed that
@@ -382,10 +382,16 @@ void NnetComputer::ExecuteCommand() {
         }
         break;
       }
-      case kCompressMatrix:
-        // This does nothing if CUDA is not in use.
+      case kCompressMatrix: {
+        // This does nothing if CUDA is not in use, except for the bfloat16
+        // compression (CuBf16Matrix) which is also done on the CPU.
+        CuCompressedMatrixType type =
+            static_cast<CuCompressedMatrixType>(c.arg2);
+        bool compress = (type == kCompressedMatrixBf16);
 #if HAVE_CUDA == 1
-        if (CuDevice::Instantiate().Enabled()) {
+        compress = compress || CuDevice::Instantiate().Enabled();
+#endif
+        if (compress) {
           if (compressed_matrices_.empty())
             compressed_matrices_.resize(matrices_.size(), NULL);
           int32 m = computation_.submatrices[c.arg1].matrix_index;
@@ -393,22 +399,21 @@ void NnetComputer::ExecuteCommand() {
                        matrices_[m].NumRows() != 0);
           BaseFloat range = c.alpha;
           bool truncate = (c.arg3 != 0);
-          compressed_matrices_[m] = NewCuCompressedMatrix(
-              static_cast<CuCompressedMatrixType>(c.arg2),
-              range, truncate);
+          compressed_matrices_[m] = NewCuCompressedMatrix(type, range,
+                                                          truncate);
           compressed_matrices_[m]->CopyFromMat(matrices_[m]);
           matrices_[m].Resize(0, 0);
         }
-#endif
         break;
-      case kDecompressMatrix:
-#if HAVE_CUDA == 1
-        if (CuDevice::Instantiate().Enabled()) {
-          int32 m = computation_.submatrices[c.arg1].matrix_index;
+      }
+      case kDecompressMatrix: {
+        // The matrix was not compressed if CUDA is not in use (see above).
+        int32 m = computation_.submatrices[c.arg1].matrix_index;
+        if (!compressed_matrices_.empty() &&
+            compressed_matrices_[m] != NULL) {
           CuCompressedMatrixBase *compressed_matrix =
               compressed_matrices_[m];
-          KALDI_ASSERT(compressed_matrix != NULL &&
-                       matrices_[m].NumRows() == 0);
+          KALDI_ASSERT(matrices_[m].NumRows() == 0);
           matrices_[m].Resize(compressed_matrix->NumRows(),
                               compressed_matrix->NumCols(),
                               kUndefined,
@@ -417,8 +422,8 @@ void NnetComputer::ExecuteCommand() {
           delete compressed_matrix;
           compressed_matrices_[m] = NULL;
         }
-#endif
         break;
+      }
       case kNoOperation: case kNoOperationPermanent: case kNoOperationMarker:
       case kNoOperationLabel:
         break;
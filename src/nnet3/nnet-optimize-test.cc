@@ -200,6 +200,8 @@ static void UnitTestNnetOptimizeInternal(int32 srand_seed) {
   // (without really changing anything).
   if (RandInt(0, 3) == 0) optimize_all.min_deriv_time = -200;
   if (RandInt(0, 3) == 0) optimize_all.max_deriv_time = 1000;
+  // sometimes recompute in the backward pass whatever can be recomputed.
+  if (RandInt(0, 1) == 0) optimize_all.recompute_components = "*";
 
   // this is useful for debugging as it removes nans:
   // optimize_all.initialize_undefined = false;
@@ -266,6 +268,11 @@ static void UnitTestNnetOptimizeInternal(int32 srand_seed) {
   optimize = optimize_all;
 
 
+  optimize.recompute_components = "";
+  bool succ_no_recompute = UnitTestNnetOptimizeWithOptions(srand_seed, optimize,
+                                                           compiler);
+  optimize = optimize_all;
+
   optimize.min_deriv_time = std::numeric_limits<int32>::min();
   optimize.max_deriv_time = std::numeric_limits<int32>::max();
   optimize.max_deriv_time_relative = std::numeric_limits<int32>::max();
@@ -288,15 +295,210 @@ static void UnitTestNnetOptimizeInternal(int32 srand_seed) {
     << "\n  allocate_from_other  ... " << KALDI_SUCCFAIL(succ_no_allocate_from_other)
     << "\n  move_sizing_commands ... " << KALDI_SUCCFAIL(succ_no_move_sizing_commands)
     << "\n  snip_row_ops         ... " << KALDI_SUCCFAIL(succ_no_snip_row_ops)
+    << "\n  recompute_components ... " << KALDI_SUCCFAIL(succ_no_recompute)
     << "\n  no_deriv_time        ... " << KALDI_SUCCFAIL(succ_no_deriv_time);
 #undef KALDI_SUCCFAIL
 }
 
+// Recomputation in the backward pass on a plain Affine/ReLU TDNN, where some
+// of the spliced ReLU outputs qualify: the max memory use goes down, and the
+// outputs, input-derivs and model derivatives are the same as without it.
+// (The randomly generated networks in the tests above seldom have anything
+// that qualifies.)
+static void UnitTestNnetOptimizeRecomputation() {
+  srand(0);
+  int32 num_layers = 5, hidden_dim = 64;
+  std::ostringstream os;
+  os << "input-node name=input dim=10\n";
+  std::string prev = "input";
+  int32 prev_dim = 10;
+  for (int32 l = 1; l <= num_layers; l++) {
+    os << "component name=affine" << l << " type=AffineComponent input-dim="
+       << (3 * prev_dim) << " output-dim=" << hidden_dim << "\n"
+       << "component-node name=affine" << l << " component=affine" << l
+       << " input=Append(Offset(" << prev << ", -1), " << prev << ", Offset("
+       << prev << ", 1))\n"
+       << "component name=relu" << l << " type=RectifiedLinearComponent dim="
+       << hidden_dim << "\n"
+       << "component-node name=relu" << l << " component=relu" << l
+       << " input=affine" << l << "\n";
+    prev = "relu" + std::to_string(l);
+    prev_dim = hidden_dim;
+  }
+  os << "component name=final-affine type=AffineComponent input-dim="
+     << hidden_dim << " output-dim=8\n"
+     << "component-node name=final-affine component=final-affine input="
+     << prev << "\n"
+     << "output-node name=output input=final-affine objective=quadratic\n";
+  Nnet nnet;
+  {
+    std::istringstream is(os.str());
+    nnet.ReadConfig(is);
+  }
+
+  ComputationRequest request;
+  std::vector<Index> input_indexes, output_indexes;
+  for (int32 n = 0; n < 4; n++) {
+    for (int32 t = -num_layers; t < 20 + num_layers; t++)
+      input_indexes.push_back(Index(n, t, 0));
+    for (int32 t = 0; t < 20; t++)
+      output_indexes.push_back(Index(n, t, 0));
+  }
+  request.inputs.push_back(IoSpecification("input", input_indexes));
+  request.inputs.back().has_deriv = true;
+  request.outputs.push_back(IoSpecification("output", output_indexes));
+  request.outputs.back().has_deriv = true;
+  request.need_model_derivative = true;
+  Matrix<BaseFloat> input(input_indexes.size(), 10);
+  input.SetRandn();
+
+  NnetComputation computation;
+  Compiler compiler(request, nnet);
+  CompilerOptions compiler_opts;
+  compiler.CreateComputation(compiler_opts, &computation);
+  NnetOptimizeOptions opt_config;
+  Optimize(opt_config, nnet, MaxOutputTimeInRequest(request), &computation);
+  NnetComputation computation_recompute(computation);
+  int32 num_matrices = OptimizeRecomputation(nnet, "*",
+                                             &computation_recompute);
+  int64 bytes_used = GetMaxMemoryUse(computation),
+      bytes_used_recompute = GetMaxMemoryUse(computation_recompute);
+  KALDI_LOG << "Recomputing " << num_matrices << " matrices changed the max "
+            << "memory use from " << bytes_used << " to "
+            << bytes_used_recompute << " bytes.";
+  KALDI_ASSERT(num_matrices > 0 && bytes_used_recompute < bytes_used);
+  CheckComputation(nnet, computation_recompute, false);
+  computation.ComputeCudaIndexes();
+  computation_recompute.ComputeCudaIndexes();
+
+  NnetComputeOptions compute_opts;
+  Nnet nnet_to_update(nnet), nnet_to_update_recompute(nnet);
+  ScaleNnet(0.0, &nnet_to_update);
+  SetNnetAsGradient(&nnet_to_update);
+  ScaleNnet(0.0, &nnet_to_update_recompute);
+  SetNnetAsGradient(&nnet_to_update_recompute);
+  NnetComputer computer(compute_opts, computation, nnet, &nnet_to_update),
+      computer_recompute(compute_opts, computation_recompute, nnet,
+                         &nnet_to_update_recompute);
+  CuMatrix<BaseFloat> temp(input), temp2(input);
+  computer.AcceptInput("input", &temp);
+  computer_recompute.AcceptInput("input", &temp2);
+  computer.Run();
+  computer_recompute.Run();
+  AssertEqual(computer.GetOutput("output"),
+              computer_recompute.GetOutput("output"), 0.0f);
+
+  CuMatrix<BaseFloat> output_deriv(computer.GetOutput("output").NumRows(),
+                                   computer.GetOutput("output").NumCols());
+  output_deriv.SetRandn();
+  CuMatrix<BaseFloat> output_deriv_recompute(output_deriv);
+  computer.AcceptInput("output", &output_deriv);
+  computer_recompute.AcceptInput("output", &output_deriv_recompute);
+  computer.Run();
+  computer_recompute.Run();
+  AssertEqual(computer.GetOutput("input"),
+              computer_recompute.GetOutput("input"), 0.0f);
+  KALDI_ASSERT(NnetParametersAreIdentical(nnet_to_update,
+                                          nnet_to_update_recompute, 0.0));
+}
+
+// Level-3 memory compression stores the matrices needed in the backward pass
+// in bfloat16 when not using a GPU.  This checks that the computation passes
+// the checks, and that the derivatives stay close to the uncompressed ones
+// (they are not identical, so this is not part of the test above).
+static void UnitTestNnetOptimizeCompressionLevel3(int32 srand_seed) {
+  srand(srand_seed);
+  struct NnetGenerationOptions gen_config;
+  std::vector<std::string> configs;
+  GenerateConfigSequence(gen_config, &configs);
+  Nnet nnet;
+  for (size_t j = 0; j < configs.size(); j++) {
+    std::istringstream is(configs[j]);
+    nnet.ReadConfig(is);
+  }
+
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+  if (!request.outputs[0].has_deriv)
+    return;
+
+  NnetOptimizeOptions opt_config, opt_config_level3;
+  opt_config.memory_compression_level = 0;
+  opt_config_level3.memory_compression_level = 3;
+  CachingOptimizingCompilerOptions compiler_config;
+  CachingOptimizingCompiler compiler(nnet, opt_config, compiler_config),
+      compiler_level3(nnet, opt_config_level3, compiler_config);
+  const NnetComputation &computation = *compiler.Compile(request),
+      &computation_level3 = *compiler_level3.Compile(request);
+  {
+    CheckComputationOptions check_config;
+    ComputationChecker checker(check_config, nnet, computation_level3);
+    checker.Check();
+  }
+  bool gpu_in_use = false;
+#if HAVE_CUDA == 1
+  gpu_in_use = CuDevice::Instantiate().Enabled();
+#endif
+  for (size_t i = 0; i < computation_level3.commands.size(); i++) {
+    const NnetComputation::Command &c = computation_level3.commands[i];
+    if (c.command_type == kCompressMatrix)
+      KALDI_ASSERT(gpu_in_use == (c.arg2 != kCompressedMatrixBf16));
+  }
+
+  NnetComputeOptions compute_opts;
+  Nnet nnet_to_update(nnet), nnet_to_update_level3(nnet);
+  ScaleNnet(0.0, &nnet_to_update);
+  SetNnetAsGradient(&nnet_to_update);
+  ScaleNnet(0.0, &nnet_to_update_level3);
+  SetNnetAsGradient(&nnet_to_update_level3);
+  Nnet nnet_level3(nnet);
+  NnetComputer computer(compute_opts, computation, nnet, &nnet_to_update),
+      computer_level3(compute_opts, computation_level3, nnet_level3,
+                      &nnet_to_update_level3);
+  for (size_t i = 0; i < request.inputs.size(); i++) {
+    CuMatrix<BaseFloat> temp(inputs[i]), temp2(inputs[i]);
+    computer.AcceptInput(request.inputs[i].name, &temp);
+    computer_level3.AcceptInput(request.inputs[i].name, &temp2);
+  }
+  srand(srand_seed);
+  ResetGenerators(&nnet);
+  computer.Run();
+  srand(srand_seed);
+  ResetGenerators(&nnet_level3);
+  computer_level3.Run();
+  // the forward pass is not affected by the compression,
+  KALDI_ASSERT(ApproxEqual(computer.GetOutput("output"),
+                           computer_level3.GetOutput("output")));
+
+  CuMatrix<BaseFloat> output_deriv(computer.GetOutput("output").NumRows(),
+                                   computer.GetOutput("output").NumCols());
+  output_deriv.SetRandn();
+  CuMatrix<BaseFloat> output_deriv_level3(output_deriv);
+  computer.AcceptInput("output", &output_deriv);
+  computer_level3.AcceptInput("output", &output_deriv_level3);
+  computer.Run();
+  computer_level3.Run();
+  for (size_t i = 0; i < request.inputs.size(); i++) {
+    if (request.inputs[i].has_deriv) {
+      const CuMatrixBase<BaseFloat>
+          &in_deriv = computer.GetOutput(request.inputs[i].name),
+          &in_deriv_level3 = computer_level3.GetOutput(request.inputs[i].name);
+      KALDI_LOG << "Input-deriv sum for input '" << request.inputs[i].name
+                << "' is " << in_deriv.Sum() << " (level 3: "
+                << in_deriv_level3.Sum() << ")";
+      KALDI_ASSERT(ApproxEqual(in_deriv, in_deriv_level3, 0.05f));
+    }
+  }
+}
+
 static void UnitTestNnetOptimize() {
+  UnitTestNnetOptimizeRecomputation();
   for (int32 srand_seed = 0; srand_seed < 40; srand_seed++) {
     KALDI_LOG << "About to run UnitTestNnetOptimizeInternal with srand_seed = "
               << srand_seed;
     UnitTestNnetOptimizeInternal(srand_seed);
+    UnitTestNnetOptimizeCompressionLevel3(srand_seed);
   }
 }
 
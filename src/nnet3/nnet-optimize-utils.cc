@@ -20,6 +20,7 @@
 #include <map>
 #include "nnet3/nnet-optimize-utils.h"
 #include "nnet3/nnet-optimize.h"
+#include "cudamatrix/cu-device.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -4695,7 +4696,8 @@ class MemoryCompressionOptimizer {
          0 = no compression (the constructor should not be called with this value).
          1 = compression that doesn't affect the results (but still takes time).
          2 = compression that affects the results only very slightly
-         3 = compression that affects the results a little more.
+         3 = compression that affects the results a little more (bfloat16,
+             only used without a GPU; with a GPU the same as 2).
       @param [in] middle_command  Must be the command-index of the
           command of type kNoOperationMarker in 'computation'.
       @param [in,out] computation  The computation we're optimizing.
@@ -4705,7 +4707,12 @@ class MemoryCompressionOptimizer {
                              int32 middle_command,
                              NnetComputation *computation):
       nnet_(nnet), memory_compression_level_(memory_compression_level),
-      middle_command_(middle_command), computation_(computation) { }
+      middle_command_(middle_command), computation_(computation),
+      gpu_in_use_(false) {
+#if HAVE_CUDA == 1
+    gpu_in_use_ = CuDevice::Instantiate().Enabled();
+#endif
+  }
 
   void Optimize();
  private:
@@ -4762,6 +4769,9 @@ class MemoryCompressionOptimizer {
   int32 memory_compression_level_;
   int32 middle_command_;
   NnetComputation *computation_;
+  // true if the computation will run on a GPU (decides the level-3
+  // compression type),
+  bool gpu_in_use_;
   Analyzer analyzer_;
 };
 
@@ -4857,6 +4867,22 @@ void MemoryCompressionOptimizer::ProcessMatrix(int32 m) {
   NnetComputation::Command
       &backward_command = computation_->commands[backward_command_index];
 
+  // If memory_compression_level >= 3 and we are not using a GPU, everything
+  // that's needed in the backward pass is stored in bfloat16 (half the memory,
+  // ~3 significant digits).  The integer compression below does nothing
+  // without a GPU, so this includes the ReLU outputs (the sign and zero are
+  // exact in bfloat16).  With a GPU, level 3 is the same as level 2: the
+  // integer types are compressed on the device, while bfloat16 would go
+  // through host memory.
+  if (memory_compression_level_ >= 3 && !gpu_in_use_) {
+    compress_info_.push_back(
+        MatrixCompressInfo(m, forward_command_index,
+                           backward_command_index,
+                           kCompressedMatrixBf16, 0.0,
+                           false));
+    return;
+  }
+
   if (memory_compression_level_ >= 1 &&
       backward_access_is_last_access &&
       backward_access.access_type == kReadAccess &&
@@ -4889,13 +4915,32 @@ void MemoryCompressionOptimizer::ProcessMatrix(int32 m) {
                            true));
     return;
   }
-
-  // TODO: later maybe implement something for memory compression level = 3.
 }
 
 
 
 
+// Returns the index of the command of type 'kNoOperationMarker' that
+// separates the forward and backward passes of a non-looped computation, or -1
+// if it doesn't exist (i.e. the computation doesn't include backprop) or there
+// is more than one.
+static int32 FindMiddleCommand(const NnetComputation &computation) {
+  int32 middle_command = -1;
+  for (size_t i = 0; i < computation.commands.size(); i++) {
+    if (computation.commands[i].command_type == kNoOperationMarker) {
+      if (middle_command < 0) {
+        middle_command = static_cast<int32>(i);
+      } else {
+        KALDI_WARN << "Found more than one command of type kNoOperationMarker "
+            "in non-looped computation.";
+        // there are more than one command of this type... this wasn't expected.
+        return -1;
+      }
+    }
+  }
+  return middle_command;
+}
+
 void OptimizeMemoryCompression(const Nnet &nnet,
                                int32 memory_compression_level,
                                NnetComputation *computation) {
@@ -4907,22 +4952,8 @@ void OptimizeMemoryCompression(const Nnet &nnet,
 
   // 'middle_command' will be the index of the command of type
   // 'kNoOperationMarker' that separates the forward and backward
-  // passes.  If it doesn't exist, it means this computation doesn't
-  // include
-  int32 middle_command = -1;
-  for (size_t i = 0; i < computation->commands.size(); i++) {
-    if (computation->commands[i].command_type == kNoOperationMarker) {
-      if (middle_command < 0) {
-        middle_command = static_cast<int32>(i);
-      } else {
-        KALDI_WARN << "Found more than one command of type kNoOperationMarker "
-            "in non-looped computation.";
-        // there are more than one command of this type... this wasn't expected.
-        // return (i.e. do nothing).
-        return;
-      }
-    }
-  }
+  // passes.
+  int32 middle_command = FindMiddleCommand(*computation);
   if (middle_command == -1) {
     return;  // This computation doesn't have a backprop pass.
   }
@@ -4948,6 +4979,385 @@ void OptimizeMemoryCompression(const Nnet &nnet,
 }
 
 
+/**
+   This class is used in the function OptimizeRecomputation().  It finds the
+   matrices written in the forward pass by the Propagate() of the components
+   selected by the user, that are needed again in the backward pass.  Each
+   such matrix is freed after its last access in the forward pass; just before
+   its first access in the backward pass, a new matrix is allocated and the
+   commands that wrote the old one are run again to write the new one, which
+   replaces the old matrix in the rest of the computation.  (Having two
+   matrices means each is still allocated and deallocated just once).
+
+   This is only done if the commands can be run again with the same result:
+   they must write nothing but the matrix, not be random and save no memo, and
+   the other matrices they read must be still allocated and unchanged at that
+   point.  Those matrices are not themselves recomputed.
+ */
+class RecomputationOptimizer {
+ public:
+  /** @param [in] nnet         The neural net the computation is for.
+      @param [in] recompute_components  Comma-separated list of patterns
+          (c.f. NameMatchesPattern()) of the names of the components whose
+          outputs we want to recompute.
+      @param [in] middle_command  Must be the command-index of the
+          command of type kNoOperationMarker in 'computation'.
+      @param [in,out] computation  The computation we're optimizing.
+  */
+  RecomputationOptimizer(const Nnet &nnet,
+                         const std::string &recompute_components,
+                         int32 middle_command,
+                         NnetComputation *computation);
+
+  void Optimize();
+
+  /// The number of matrices recomputed,
+  int32 NumMatrices() const { return recompute_info_.size(); }
+  /// The number of Propagate() commands run again, and their total
+  /// output size (rows times columns),
+  int32 NumPropagates() const { return num_propagates_; }
+  int64 NumPropagateElements() const { return num_propagate_elements_; }
+ private:
+
+  // This function, called from Optimize(), figures out whether we can
+  // recompute matrix m, and if so, adds an entry to recompute_info_.
+  void ProcessMatrix(int32 m);
+
+  // This function modifies the commands in '*computation_', taking
+  // as input the entries in recompute_info_.
+  void ModifyComputation();
+
+  struct MatrixRecomputeInfo {
+    // m is the matrix-index of the matrix we're going to recompute.
+    int32 m;
+    // the command-index of the last command accessing m in the forward pass;
+    // m is freed after this command.
+    int32 forward_command_index;
+    // the command-index of the first command accessing m in the backward
+    // pass; the recomputation goes before this command, which, like the
+    // rest of the computation, will use the new matrix.
+    int32 backward_command_index;
+    // the command-indexes of the forward-pass commands that write m, in
+    // order; these are the commands that we run again.
+    std::vector<int32> commands;
+  };
+  std::vector<MatrixRecomputeInfo> recompute_info_;
+
+  // component_selected_[c] is true if the outputs of component c are to be
+  // recomputed.
+  std::vector<bool> component_selected_;
+  // matrix_recomputed_[m] is true if matrix m is recomputed, and
+  // matrix_read_[m] is true if m is read by the commands of the
+  // recomputation of another matrix.
+  std::vector<bool> matrix_recomputed_;
+  std::vector<bool> matrix_read_;
+  // matrix_in_indexes_multi_[m] is true if a submatrix of m appears in
+  // 'indexes_multi' (we don't recompute those matrices, to avoid having to
+  // duplicate the indexes).
+  std::vector<bool> matrix_in_indexes_multi_;
+
+  int32 num_propagates_;
+  int64 num_propagate_elements_;
+
+  const Nnet &nnet_;
+  int32 middle_command_;
+  NnetComputation *computation_;
+  Analyzer analyzer_;
+};
+
+
+RecomputationOptimizer::RecomputationOptimizer(
+    const Nnet &nnet,
+    const std::string &recompute_components,
+    int32 middle_command,
+    NnetComputation *computation):
+    num_propagates_(0), num_propagate_elements_(0),
+    nnet_(nnet), middle_command_(middle_command), computation_(computation) {
+  std::vector<std::string> patterns;
+  SplitStringToVector(recompute_components, ",", true, &patterns);
+  int32 num_components = nnet_.NumComponents();
+  component_selected_.resize(num_components, false);
+  for (int32 c = 0; c < num_components; c++) {
+    const std::string &name = nnet_.GetComponentName(c);
+    for (size_t p = 0; p < patterns.size(); p++) {
+      if (NameMatchesPattern(name.c_str(), patterns[p].c_str())) {
+        component_selected_[c] = true;
+        break;
+      }
+    }
+  }
+}
+
+
+void RecomputationOptimizer::Optimize() {
+  analyzer_.Init(nnet_, *computation_);
+  int32 num_matrices = computation_->matrices.size();
+  matrix_recomputed_.resize(num_matrices, false);
+  matrix_read_.resize(num_matrices, false);
+  matrix_in_indexes_multi_.resize(num_matrices, false);
+  for (size_t i = 0; i < computation_->indexes_multi.size(); i++) {
+    const std::vector<std::pair<int32, int32> > &indexes =
+        computation_->indexes_multi[i];
+    for (size_t j = 0; j < indexes.size(); j++) {
+      int32 s = indexes[j].first;
+      if (s > 0)
+        matrix_in_indexes_multi_[computation_->submatrices[s].matrix_index] =
+            true;
+    }
+  }
+  // note: matrix zero is not really a matrix.
+  for (int32 m = 1; m < num_matrices; m++)
+    ProcessMatrix(m);
+  if (!recompute_info_.empty())
+    ModifyComputation();
+}
+
+
+void RecomputationOptimizer::ProcessMatrix(int32 m) {
+  const MatrixAccesses &matrix_accesses = analyzer_.matrix_accesses[m];
+  if (matrix_accesses.is_input || matrix_accesses.is_output ||
+      matrix_read_[m] || matrix_in_indexes_multi_[m])
+    return;
+
+  // 'accesses' list the commands that access this matrix; as in
+  // MemoryCompressionOptimizer::ProcessMatrix(), we find the last access in
+  // the forward pass and the first one in the backward pass.
+  const std::vector<Access> &accesses = matrix_accesses.accesses;
+  Access middle_access(middle_command_, kReadAccess);
+  std::vector<Access>::const_iterator iter = std::lower_bound(accesses.begin(),
+                                                              accesses.end(),
+                                                              middle_access);
+  if (iter == accesses.end() || iter == accesses.begin())
+    return;  // not accessed in both the forward and the backward pass.
+  const Access &backward_access = iter[0],
+      &forward_access = iter[-1];
+  if (backward_access.access_type == kWriteAccess)
+    return;  // The values from the forward pass are not needed.
+  int32 backward_command_index = backward_access.command_index;
+
+  // the forward-pass commands that write the matrix,
+  std::vector<int32> commands;
+  bool selected = false;
+  for (std::vector<Access>::const_iterator a = accesses.begin();
+       a != iter; ++a) {
+    if (a->access_type == kReadAccess)
+      continue;
+    const NnetComputation::Command &command =
+        computation_->commands[a->command_index];
+    switch (command.command_type) {
+      case kPropagate: {
+        const Component *component = nnet_.GetComponent(command.arg1);
+        if (command.arg5 != 0 ||
+            (component->Properties() & kRandomComponent) != 0)
+          return;  // It saves a memo or would not give the same output.
+        if (component_selected_[command.arg1])
+          selected = true;
+        break;
+      }
+      case kSetConst: case kMatrixCopy: case kMatrixAdd:
+      case kCopyRows: case kAddRows: case kCopyRowsMulti:
+      case kAddRowsMulti: case kAddRowRanges:
+        break;
+      default:
+        return;
+    }
+    if (analyzer_.command_attributes[a->command_index].matrices_written.size()
+        != 1)
+      return;  // It writes other matrices too.
+    commands.push_back(a->command_index);
+  }
+  if (!selected)
+    return;
+
+  // the other matrices read by the commands must be allocated and unchanged
+  // until 'backward_command_index',
+  std::vector<int32> matrices_read;
+  for (size_t i = 0; i < commands.size(); i++) {
+    const std::vector<int32> &read =
+        analyzer_.command_attributes[commands[i]].matrices_read;
+    for (size_t j = 0; j < read.size(); j++) {
+      int32 r = read[j];
+      if (r == m)
+        continue;
+      if (matrix_recomputed_[r])
+        return;
+      const MatrixAccesses &r_accesses = analyzer_.matrix_accesses[r];
+      if (r_accesses.deallocate_command != -1 &&
+          r_accesses.deallocate_command < backward_command_index)
+        return;
+      for (size_t k = 0; k < r_accesses.accesses.size(); k++) {
+        const Access &access = r_accesses.accesses[k];
+        if (access.command_index > commands[i] &&
+            access.command_index < backward_command_index &&
+            access.access_type != kReadAccess)
+          return;
+      }
+      matrices_read.push_back(r);
+    }
+  }
+
+  matrix_recomputed_[m] = true;
+  for (size_t j = 0; j < matrices_read.size(); j++)
+    matrix_read_[matrices_read[j]] = true;
+  MatrixRecomputeInfo info;
+  info.m = m;
+  info.forward_command_index = forward_access.command_index;
+  info.backward_command_index = backward_command_index;
+  info.commands.swap(commands);
+  recompute_info_.push_back(info);
+}
+
+
+void RecomputationOptimizer::ModifyComputation() {
+  // whole_submatrices[m] is the submatrix-index of the submatrix that
+  // represents the whole of matrix m.
+  std::vector<int32> whole_submatrices;
+  computation_->GetWholeSubmatrices(&whole_submatrices);
+  std::vector<std::vector<int32> > mat_to_submat;
+  ComputeMatrixToSubmatrix(*computation_, &mat_to_submat);
+
+  // 'pairs_to_insert' will be a list of pairs (command-index, command),
+  // meaning: (command-index just before which to insert this command; command
+  // to insert).
+  std::vector<std::pair<int32, NnetComputation::Command> >
+      pairs_to_insert;
+  std::vector<int32*> submatrix_args;
+  for (size_t i = 0; i < recompute_info_.size(); i++) {
+    const MatrixRecomputeInfo &info = recompute_info_[i];
+    int32 m = info.m, s = whole_submatrices[m];
+    NnetComputation::MatrixInfo matrix_info = computation_->matrices[m];
+    int32 new_s = computation_->NewMatrix(matrix_info.num_rows,
+                                          matrix_info.num_cols,
+                                          matrix_info.stride_type),
+        new_m = computation_->submatrices[new_s].matrix_index;
+    if (!computation_->matrix_debug_info.empty())
+      computation_->matrix_debug_info[new_m] =
+          computation_->matrix_debug_info[m];
+    // 'submatrix_map' maps the submatrices of m to those of the new matrix.
+    std::map<int32, int32> submatrix_map;
+    for (size_t j = 0; j < mat_to_submat[m].size(); j++) {
+      int32 old_s = mat_to_submat[m][j];
+      if (old_s == s) {
+        submatrix_map[old_s] = new_s;
+      } else {
+        NnetComputation::SubMatrixInfo submat_info =
+            computation_->submatrices[old_s];
+        submatrix_map[old_s] = computation_->NewSubMatrix(
+            new_s, submat_info.row_offset, submat_info.num_rows,
+            submat_info.col_offset, submat_info.num_cols);
+      }
+    }
+
+    // free the matrix after the forward pass,
+    pairs_to_insert.push_back(std::pair<int32, NnetComputation::Command>(
+        info.forward_command_index + 1,
+        NnetComputation::Command(kDeallocMatrix, s)));
+    // allocate the new matrix, and run the commands again,
+    pairs_to_insert.push_back(std::pair<int32, NnetComputation::Command>(
+        info.backward_command_index,
+        NnetComputation::Command(kAllocMatrix, new_s)));
+    for (size_t j = 0; j < info.commands.size(); j++) {
+      NnetComputation::Command command = computation_->commands[info.commands[j]];
+      IdentifySubmatrixArgs(&command, &submatrix_args);
+      for (size_t k = 0; k < submatrix_args.size(); k++) {
+        std::map<int32, int32>::const_iterator iter =
+            submatrix_map.find(*(submatrix_args[k]));
+        if (iter != submatrix_map.end())
+          *(submatrix_args[k]) = iter->second;
+      }
+      if (command.command_type == kPropagate) {
+        command.arg6 = 0;  // the stats were stored in the forward pass.
+        num_propagates_++;
+        const NnetComputation::SubMatrixInfo &output =
+            computation_->submatrices[command.arg4];
+        num_propagate_elements_ +=
+            static_cast<int64>(output.num_rows) * output.num_cols;
+      }
+      pairs_to_insert.push_back(std::pair<int32, NnetComputation::Command>(
+          info.backward_command_index, command));
+    }
+
+    // the rest of the computation uses the new matrix.
+    std::vector<int32> later_commands;
+    const MatrixAccesses &accesses = analyzer_.matrix_accesses[m];
+    for (size_t j = 0; j < accesses.accesses.size(); j++)
+      if (accesses.accesses[j].command_index >= info.backward_command_index)
+        later_commands.push_back(accesses.accesses[j].command_index);
+    KALDI_ASSERT(accesses.deallocate_command > info.backward_command_index);
+    later_commands.push_back(accesses.deallocate_command);
+    for (size_t j = 0; j < later_commands.size(); j++) {
+      IdentifySubmatrixArgs(&(computation_->commands[later_commands[j]]),
+                            &submatrix_args);
+      for (size_t k = 0; k < submatrix_args.size(); k++) {
+        std::map<int32, int32>::const_iterator iter =
+            submatrix_map.find(*(submatrix_args[k]));
+        if (iter != submatrix_map.end())
+          *(submatrix_args[k]) = iter->second;
+      }
+    }
+  }
+  InsertCommands(&pairs_to_insert,
+                 computation_);
+}
+
+
+int32 OptimizeRecomputation(const Nnet &nnet,
+                            const std::string &recompute_components,
+                            NnetComputation *computation) {
+  if (recompute_components.empty() || computation->commands.empty())
+    return 0;
+  // don't apply this optimization to looped computations.
+  if (computation->commands.back().command_type == kGotoLabel)
+    return 0;
+  int32 middle_command = FindMiddleCommand(*computation);
+  if (middle_command == -1) {
+    return 0;  // This computation doesn't have a backprop pass.
+  }
+
+  int64 bytes_used_initial = GetMaxMemoryUse(*computation);
+  bool verbose_ge_2 = GetVerboseLevel() >= 2;
+  // the total size of the outputs of the forward pass,
+  int32 num_propagates = 0;
+  int64 num_propagate_elements = 0;
+  for (int32 c = 0; verbose_ge_2 && c < middle_command; c++) {
+    const NnetComputation::Command &command = computation->commands[c];
+    if (command.command_type == kPropagate) {
+      const NnetComputation::SubMatrixInfo &output =
+          computation->submatrices[command.arg4];
+      num_propagates++;
+      num_propagate_elements +=
+          static_cast<int64>(output.num_rows) * output.num_cols;
+    }
+  }
+
+  RecomputationOptimizer opt(nnet, recompute_components,
+                             middle_command, computation);
+  opt.Optimize();
+  if (opt.NumMatrices() == 0) {
+    // e.g. no component matches, or none of the matching ones qualifies.
+    KALDI_VLOG(2) << "No matrices of the components matching '"
+                  << recompute_components << "' can be recomputed.";
+    return 0;
+  }
+  int64 bytes_used_final = GetMaxMemoryUse(*computation);
+  if (bytes_used_final >= bytes_used_initial) {
+    KALDI_WARN << "Recomputing " << opt.NumMatrices() << " matrices of the "
+               << "components matching '" << recompute_components
+               << "' did not reduce the max memory use.";
+  } else if (verbose_ge_2) {
+    KALDI_VLOG(2) << "Recomputing " << opt.NumMatrices() << " matrices in the "
+                  << "backward pass reduced the max memory use from "
+                  << bytes_used_initial << " to " << bytes_used_final
+                  << " bytes, at the cost of running " << opt.NumPropagates()
+                  << " of the " << num_propagates << " forward Propagate() "
+                  << "commands again (" << (100.0 * opt.NumPropagateElements() /
+                                std::max<int64>(num_propagate_elements, 1))
+                  << "% of their output).";
+  }
+  return opt.NumMatrices();
+}
+
+
 std::shared_ptr<const NnetComputation> ComputationCache::Find(
     const ComputationRequest &in_request) {
   std::lock_guard<std::mutex> lock(mutex_);
@@ -588,12 +588,34 @@ void InsertCommands(
 ///           compression of the output of NormalizeComponent and the like),
 ///           but this is not implemented yet, so equivalent to 1.
 ///       3 = compression that may affect the results more than just
-///           slightly.  Not implemented yet, so equivalent to 1.
+///           slightly: without a GPU, everything needed in the backward
+///           pass is stored in bfloat16 (CuBf16Matrix), the only
+///           compression that is done on the CPU.  With a GPU, equivalent
+///           to 2.
 void OptimizeMemoryCompression(const Nnet &nnet,
                                int32 memory_compression_level,
                                NnetComputation *computation);
 
 
+/// Performs "activation checkpointing" to reduce memory usage, for the
+/// components whose names match one of the comma-separated patterns in
+/// 'recompute_components' (c.f. NameMatchesPattern(), e.g. "tdnn*.affine,
+/// tdnn*.relu"): a matrix written by the Propagate() of such a component, and
+/// needed in the backward pass, is freed after the forward pass and computed
+/// again just before it is needed, by re-running the commands that wrote it.
+/// This trades extra compute for memory; it's only done where the result is
+/// the same (e.g. not for random components, components saving a memo, or
+/// when the input of the Propagate() would not be kept anyway).  It prints the
+/// memory saved and the extra forward computation (at verbose level 2), and
+/// warns if matrices were recomputed but the max memory use did not go down.
+/// Like OptimizeMemoryCompression(), this should be done after the other
+/// optimizations and does nothing for looped computations.  Returns the
+/// number of matrices that are recomputed.
+int32 OptimizeRecomputation(const Nnet &nnet,
+                            const std::string &recompute_components,
+                            NnetComputation *computation);
+
+
 /// This function tries to optimize computation 'computation' for an 'looped'
 /// computation.  It expects as input a computation with no backprop but with
 /// multiple 'segments' separated by command kNoOperationLabel, where each
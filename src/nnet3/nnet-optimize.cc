@@ -79,6 +79,12 @@ void NnetOptimizeOptions::Read(std::istream &is, bool binary) {
     ExpectToken(is, binary, "<MemoryCompressionLevel>");
     ReadBasicType(is, binary, &memory_compression_level);
   }
+  if (PeekToken(is, binary) == 'R') {
+    ExpectToken(is, binary, "<RecomputeComponents>");
+    ReadToken(is, binary, &recompute_components);
+  } else {
+    recompute_components.clear();
+  }
   ExpectToken(is, binary, "</NnetOptimizeOptions>");
 }
 
@@ -122,6 +128,10 @@ void NnetOptimizeOptions::Write(std::ostream &os, bool binary) const {
   WriteBasicType(os, binary, snip_row_ops);
   WriteToken(os, binary, "<MemoryCompressionLevel>");
   WriteBasicType(os, binary, memory_compression_level);
+  if (!recompute_components.empty()) {
+    WriteToken(os, binary, "<RecomputeComponents>");
+    WriteToken(os, binary, recompute_components);
+  }
   WriteToken(os, binary, "</NnetOptimizeOptions>");
 }
 
@@ -143,7 +153,8 @@ bool NnetOptimizeOptions::operator == (const NnetOptimizeOptions &other) const {
           other.max_deriv_time == max_deriv_time &&
           other.max_deriv_time_relative == max_deriv_time_relative &&
           other.snip_row_ops == snip_row_ops &&
-          other.memory_compression_level == memory_compression_level);
+          other.memory_compression_level == memory_compression_level &&
+          other.recompute_components == recompute_components);
 }
 
 // move commands that resize and zero matrices to as late/early as possible.
@@ -616,6 +627,15 @@ void Optimize(const NnetOptimizeOptions &config,
     FixGotoLabel(computation);
 
 
+  // This goes before the memory compression, which then leaves alone the
+  // recomputed matrices (they are not accessed in the forward pass).
+  if (!config.recompute_components.empty() &&
+      !config.optimize_looped_computation) {
+    OptimizeRecomputation(nnet, config.recompute_components, computation);
+    if (GetVerboseLevel() >= 3)
+      CheckComputation(nnet, *computation, false);
+  }
+
   if (config.memory_compression_level > 0 &&
       !config.optimize_looped_computation) {
     OptimizeMemoryCompression(nnet, config.memory_compression_level,
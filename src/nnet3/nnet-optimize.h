@@ -54,6 +54,7 @@ struct NnetOptimizeOptions {
   int32 max_deriv_time_relative;
   bool snip_row_ops;
   int32 memory_compression_level;
+  std::string recompute_components;
   // optimize_looped_computation is a 'hidden config' not available from
   // the command line; it's set to true to enable the optimization for
   // looped computation that turns a linear computation into a loop.
@@ -140,11 +141,22 @@ struct NnetOptimizeOptions {
                    "per-row operations");
     opts->Register("memory-compression-level", &memory_compression_level,
                    "This is only relevant to training, not decoding.  Set this "
-                   "to 0,1,2; higher levels are more aggressive at reducing "
+                   "to 0,1,2,3; higher levels are more aggressive at reducing "
                    "memory by compressing quantities needed for backprop, "
                    "potentially at the expense of speed and the accuracy "
                    "of derivatives.  0 means no compression at all; 1 means "
-                   "compression that shouldn't affect results at all.");
+                   "compression that shouldn't affect results at all.  "
+                   "Levels 1 and 2 only have effect with a GPU; without a "
+                   "GPU, 3 stores the quantities in bfloat16 (activation "
+                   "storage only, the computation stays in float), with a "
+                   "GPU it is the same as 2.");
+    opts->Register("recompute-components", &recompute_components,
+                   "This is only relevant to training, not decoding.  "
+                   "Comma-separated list of patterns of component names, with "
+                   "'*' as wildcard, e.g. 'tdnn*.affine,tdnn*.relu': the "
+                   "outputs of these components are freed after the forward "
+                   "pass and recomputed in the backward pass where possible "
+                   "(activation checkpointing: less memory, more compute).");
 
   }
   void Read(std::istream &is, bool binary);
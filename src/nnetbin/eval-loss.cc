@@ -24,8 +24,69 @@
 //#include "nnet/nnet-pdf-prior.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "base/timer.h"
 
+namespace kaldi {
+namespace nnet1 {
+
+// Evaluates the loss of one utterance in operator () (with its own copy
+// of the transforms and its own loss object), the output and the
+// accumulation happen in the destructor (called in the input order),
+class EvalLossTask {
+ public:
+  EvalLossTask(const std::string &objective_function,
+               const LossOptions &loss_opts,
+               const Nnet &nnet_transf, const Nnet &nnet_transt,
+               const std::string &utt, const Matrix<BaseFloat> &feats,
+               const Matrix<BaseFloat> &targets, BaseFloatWriter *writer,
+               double *tot_loss):
+      objective_function_(objective_function), loss_opts_(loss_opts),
+      nnet_transf_(nnet_transf), nnet_transt_(nnet_transt), utt_(utt),
+      feats_(feats), targets_(targets), writer_(writer), tot_loss_(tot_loss),
+      avg_loss_(0.0) { }
+
+  void operator () () {
+    CuMatrix<BaseFloat> feats_transf, targets_transf, obj_diff;
+    nnet_transf_.Feedforward(CuMatrix<BaseFloat>(feats_), &feats_transf);
+    if (!KALDI_ISFINITE(feats_transf.Sum())) {  // check there's no nan/inf,
+      KALDI_ERR << "NaN or inf found in transformed-features for " << utt_;
+    }
+    nnet_transt_.Feedforward(CuMatrix<BaseFloat>(targets_), &targets_transf);
+    if (!KALDI_ISFINITE(targets_transf.Sum())) {  // check there's no nan/inf,
+      KALDI_ERR << "NaN or inf found in transformed-targets for " << utt_;
+    }
+    // use unit weights,
+    Vector<BaseFloat> weights(feats_.NumRows());
+    weights.Set(1.0);
+    LossItf *loss = NewLoss(objective_function_, loss_opts_);
+    loss->Eval(weights, feats_transf, targets_transf, &obj_diff);
+    if (writer_->IsOpen()) {
+      KALDI_ASSERT(KALDI_ISFINITE(obj_diff.Sum()));
+    }
+    avg_loss_ = loss->AvgLoss();
+    delete loss;
+  }
+
+  ~EvalLossTask() {
+    *tot_loss_ += avg_loss_ * feats_.NumRows();
+    if (writer_->IsOpen()) writer_->Write(utt_, avg_loss_);
+  }
+
+ private:
+  std::string objective_function_;
+  LossOptions loss_opts_;
+  Nnet nnet_transf_, nnet_transt_;
+  std::string utt_;
+  Matrix<BaseFloat> feats_, targets_;
+  BaseFloatWriter *writer_;
+  double *tot_loss_;
+  BaseFloat avg_loss_;
+};
+
+}  // namespace nnet1
+}  // namespace kaldi
+
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -38,7 +99,9 @@ int main(int argc, char *argv[]) {
 			"average loss over all utterances provided.\n"
       "Usage: eval-loss [options] <feature-rspecifier> <targets-rspecifier> <loss-wspecifier>|<loss-wxfilename>)\n"
       "e.g.: eval-loss ark:output.ark ark:target.ark -\n"
-      "e.g.: eval-loss ark:output.ark ark:target.ark ark,t:loss.txt\n";
+      "e.g.: eval-loss ark:output.ark ark:target.ark ark,t:loss.txt\n"
+      "With --num-threads > 1, the utterances are evaluated in parallel\n"
+      "on the CPU, and only the average loss is reported.\n";
 
     ParseOptions po(usage);
 
@@ -61,6 +124,9 @@ int main(int argc, char *argv[]) {
     LossOptions loss_opts;
     loss_opts.Register(&po);
 
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.Register(&po);
+
     using namespace kaldi;
     using namespace kaldi::nnet1;
     typedef kaldi::int32 int32;
@@ -113,6 +179,55 @@ int main(int argc, char *argv[]) {
 			average_loss_writer.Open(wspecifier_or_wxfilename);
 			write_ark = true;
 		}
+    if (sequencer_config.num_threads > 1) {
+#if HAVE_CUDA == 1
+      if (CuDevice::Instantiate().Enabled()) {
+        KALDI_ERR << "--num-threads > 1 is for the CPU, use --use-gpu=no.";
+      }
+#endif
+      double tot_loss = 0.0;
+      {
+        TaskSequencer<EvalLossTask> sequencer(sequencer_config);
+        for (; !feature_reader.Done() && !targets_reader.Done();
+             feature_reader.Next(), targets_reader.Next()) {
+          if (feature_reader.Key() != targets_reader.Key()) {
+            KALDI_ERR << "Mismatched utterance for feature "
+                      << feature_reader.Key() << " and targets "
+                      << targets_reader.Key();
+          }
+          const std::string utt = feature_reader.Key();
+          const Matrix<BaseFloat> &mat = feature_reader.Value(),
+            &targets = targets_reader.Value();
+          KALDI_ASSERT(mat.NumRows() == targets.NumRows());
+          KALDI_ASSERT(mat.NumCols() == targets.NumCols());
+          if (!KALDI_ISFINITE(mat.Sum())) {  // check there's no nan/inf,
+            KALDI_ERR << "NaN or inf found in features for " << utt;
+          }
+          if (!KALDI_ISFINITE(targets.Sum())) {  // check there's no nan/inf,
+            KALDI_ERR << "NaN or inf found in targetss for " << utt;
+          }
+          sequencer.Run(new EvalLossTask(objective_function, loss_opts,
+                                         nnet_transf, nnet_transt, utt, mat,
+                                         targets, &average_loss_writer,
+                                         &tot_loss));
+          num_done++;
+          tot_t += mat.NumRows();
+        }
+      }  // waits for the remaining tasks,
+      if (!write_ark) {
+        BaseFloat average_loss = tot_loss / tot_t;
+        KALDI_LOG << "AvgLoss: " << average_loss << " (" << objective_function
+                  << "), [frames " << tot_t << "]";
+        Output ko(wspecifier_or_wxfilename, false); // text mode.
+        ko.Stream() << "AvgLoss of " << num_done << " files: "
+                    <<  average_loss << "\n";
+      }
+      KALDI_LOG << "Done " << num_done << " files"
+                << " in " << time.Elapsed()/60 << "min,"
+                << " (fps " << tot_t/time.Elapsed() << ")";
+      return (num_done == 0 ? -1 : 0);
+    }
+
     // main loop,
     for (; !feature_reader.Done() && !targets_reader.Done(); feature_reader.Next(),targets_reader.Next()) {
 			if(feature_reader.Key() != targets_reader.Key()){
@@ -22,6 +22,7 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-pdf-prior.h"
+#include "nnet/nnet-online-forward.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/timer.h"
@@ -58,6 +59,12 @@ int main(int argc, char *argv[]) {
     po.Register("use-gpu", &use_gpu,
         "yes|no|optional, only has effect if compiled with CUDA");
 
+    int32 chunk_size = 0;
+    po.Register("chunk-size", &chunk_size,
+        "If > 0, the forward pass is done chunk-by-chunk with this many "
+        "input frames per chunk, as in the low-latency streaming inference "
+        "(the output is the same, 0 = whole utterance)");
+
     using namespace kaldi;
     using namespace kaldi::nnet1;
     typedef kaldi::int32 int32;
@@ -112,12 +119,23 @@ int main(int argc, char *argv[]) {
     nnet_transf.SetDropoutRate(0.0);
     nnet.SetDropoutRate(0.0);
 
+    // the streaming forward pass goes through both networks,
+    Nnet nnet_online;
+    OnlineNnetForward *online = NULL;
+    if (chunk_size > 0) {
+      nnet_online = nnet_transf;
+      nnet_online.AppendNnet(nnet);
+      online = new OnlineNnetForward(&nnet_online);
+      KALDI_LOG << "Chunk-by-chunk forward pass, --chunk-size=" << chunk_size
+                << ", latency " << online->Latency() << " frames.";
+    }
+
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     BaseFloatMatrixWriter feature_writer(feature_wspecifier);
 
-    CuMatrix<BaseFloat> feats, feats_transf, nnet_out;
+    CuMatrix<BaseFloat> feats, feats_transf, nnet_out, chunk_out;
     Matrix<BaseFloat> nnet_out_host;
 
     Timer time;
@@ -141,14 +159,35 @@ int main(int argc, char *argv[]) {
       // push it to gpu,
       feats = mat;
 
-      // fwd-pass, feature transform,
-      nnet_transf.Feedforward(feats, &feats_transf);
-      if (!KALDI_ISFINITE(feats_transf.Sum())) {  // check there's no nan/inf,
-        KALDI_ERR << "NaN or inf found in transformed-features for " << utt;
-      }
+      if (online != NULL) {
+        // fwd-pass, chunk-by-chunk,
+        online->Reset();
+        nnet_out.Resize(feats.NumRows(), nnet_online.OutputDim(), kUndefined);
+        int32 num_out = 0;
+        for (int32 t = 0; num_out < feats.NumRows(); t += chunk_size) {
+          if (t < feats.NumRows()) {
+            online->AcceptFrames(feats.RowRange(
+                t, std::min(chunk_size, feats.NumRows() - t)));
+          } else {
+            online->InputFinished();
+          }
+          online->GetFrames(&chunk_out);
+          if (chunk_out.NumRows() > 0) {
+            nnet_out.RowRange(num_out, chunk_out.NumRows())
+                .CopyFromMat(chunk_out);
+            num_out += chunk_out.NumRows();
+          }
+        }
+      } else {
+        // fwd-pass, feature transform,
+        nnet_transf.Feedforward(feats, &feats_transf);
+        if (!KALDI_ISFINITE(feats_transf.Sum())) {  // check there's no nan/inf,
+          KALDI_ERR << "NaN or inf found in transformed-features for " << utt;
+        }
 
-      // fwd-pass, nnet,
-      nnet.Feedforward(feats_transf, &nnet_out);
+        // fwd-pass, nnet,
+        nnet.Feedforward(feats_transf, &nnet_out);
+      }
       if (!KALDI_ISFINITE(nnet_out.Sum())) {  // check there's no nan/inf,
         KALDI_ERR << "NaN or inf found in nn-output for " << utt;
       }
@@ -199,6 +238,7 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    delete online;
     if (num_done == 0) return -1;
     return 0;
   } catch(const std::exception &e) {
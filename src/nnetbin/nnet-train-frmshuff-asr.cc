@@ -9,6 +9,7 @@
 #include "nnet/nnet-various.h"
 #include "nnet/nnet-linear-transform.h"
 #include "nnet/nnet-randomizer.h"
+#include "nnet/nnet-data-loader.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/timer.h"
@@ -96,6 +97,8 @@ int main(int argc, char *argv[]) {
     //Select the GPU
 #if HAVE_CUDA==1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
+    // the randomizer buffers are filled in a background thread,
+    CuDevice::Instantiate().AllowMultithreading();
 #endif
 
     Nnet nnet_transf;
@@ -165,9 +168,6 @@ int main(int argc, char *argv[]) {
     }
 
     RandomizerMask randomizer_mask(rnd_opts);
-    MatrixRandomizer feature_randomizer(rnd_opts);
-    MatrixRandomizer targets_randomizer(rnd_opts);
-    VectorRandomizer weights_randomizer(rnd_opts);
 
     Xent xent(loss_opts);
     Mse mse(loss_opts),mse_asr(loss_opts);
@@ -184,14 +184,14 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << (crossvalidate?"CROSS-VALIDATION":"TRAINING") << " STARTED";
 
     int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
-    while (!feature_reader.Done() && !targets_reader.Done()) {
-#if HAVE_CUDA==1
-      // check the GPU is not overheated
-      CuDevice::Instantiate().CheckGpuHealth();
-#endif
-      // fill the randomizer
+    kaldi::int64 num_frames_loaded = 0;
+
+    // fill the randomizers, this runs in a background thread
+    // while we train on the previous buffer,
+    DoubleBufferedLoader<RandomizerBundle>::FillFunction fill =
+        [&](RandomizerBundle *buf) -> bool {
       for ( ; !feature_reader.Done() && !targets_reader.Done(); feature_reader.Next(), targets_reader.Next()) {
-        if (feature_randomizer.IsFull()) break; // suspend, keep utt for next loop
+        if (buf->IsFull()) break; // suspend, keep utt for next loop
         std::string utt = feature_reader.Key();
         KALDI_VLOG(3) << "Reading " << utt;
         // check that we have targets
@@ -245,36 +245,44 @@ int main(int argc, char *argv[]) {
 
         // pass data to randomizers
         KALDI_ASSERT(feats_transf.NumRows() == tgt_transf.NumRows());
-        feature_randomizer.AddData(feats_transf);
-        targets_randomizer.AddData(tgt_transf);
-        weights_randomizer.AddData(weights);
+        buf->Mat(0).AddData(feats_transf);
+        buf->Mat(1).AddData(tgt_transf);
+        buf->Vec(0).AddData(weights);
         num_done++;
+        num_frames_loaded += feats_transf.NumRows();
       
         // report the speed
         if (num_done % 5000 == 0) {
           double time_now = time.Elapsed();
           KALDI_VLOG(1) << "After " << num_done << " utterances: time elapsed = "
-                        << time_now/60 << " min; processed " << total_frames/time_now
+                        << time_now/60 << " min; loaded " << num_frames_loaded/time_now
                         << " frames per second.";
         }
       }
 
       // randomize
       if (!crossvalidate && randomize) {
-        const std::vector<int32>& mask = randomizer_mask.Generate(feature_randomizer.NumFrames());
-        feature_randomizer.Randomize(mask);
-        targets_randomizer.Randomize(mask);
-        weights_randomizer.Randomize(mask);
+        buf->Randomize(&randomizer_mask);
       }
+      return !feature_reader.Done() && !targets_reader.Done();
+    };
+
+    DoubleBufferedLoader<RandomizerBundle> loader(
+        RandomizerBundle(rnd_opts, 2, 0, 1), fill);
+
+    RandomizerBundle *buf;
+    while ((buf = loader.Next()) != NULL) {
+#if HAVE_CUDA==1
+      // check the GPU is not overheated
+      CuDevice::Instantiate().CheckGpuHealth();
+#endif
 
       // train with data from randomizers (using mini-batches)
-      for ( ; !feature_randomizer.Done(); feature_randomizer.Next(),
-                                          targets_randomizer.Next(),
-                                          weights_randomizer.Next()) {
+      for ( ; !buf->Done(); buf->Next()) {
         // get block of feature/target pairs
-        const CuMatrixBase<BaseFloat>& nnet_in = feature_randomizer.Value();
-        const CuMatrixBase<BaseFloat>& nnet_tgt = targets_randomizer.Value();
-        const Vector<BaseFloat>& frm_weights = weights_randomizer.Value();
+        const CuMatrixBase<BaseFloat>& nnet_in = buf->Mat(0).Value();
+        const CuMatrixBase<BaseFloat>& nnet_tgt = buf->Mat(1).Value();
+        const Vector<BaseFloat>& frm_weights = buf->Vec(0).Value();
 
         nnet.Propagate(nnet_in, &nnet_out);
 //        nnet_out_enh.CopyFromMat(nnet_out.ColRange(0,enh_feats_dim));
@@ -19,23 +19,23 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-randomizer.h"
+#include "nnet/nnet-frmshuff-trainer.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
-#include "base/timer.h"
 #include "cudamatrix/cu-device.h"
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   using namespace kaldi::nnet1;
-  typedef kaldi::int32 int32;  
-  
+
   try {
     const char *usage =
-        "Perform one iteration of Neural Network training by mini-batch Stochastic Gradient Descent.\n"
-        "This version use pdf-posterior as targets, prepared typically by ali-to-post.\n"
-        "Usage:  nnet-train-frmshuff [options] <feature-rspecifier> <targets-rspecifier> <model-in> [<model-out>]\n"
-        "e.g.: \n"
-        " nnet-train-frmshuff scp:feature.scp ark:posterior.ark nnet.init nnet.iter1\n";
+      "Perform one iteration (epoch) of Neural Network training with\n"
+      "mini-batch Stochastic Gradient Descent. The training targets\n"
+      "are feature-like matrices (regression). Each mini-batch is used once\n"
+      "more, perturbed by the fast gradient sign method (adversarial training).\n"
+      "Usage:  nnet-train-frmshuff-reg-fgsm [options] <feature-rspecifier> <targets-rspecifier> <model-in> [<model-out>]\n"
+      "e.g.: nnet-train-frmshuff-reg-fgsm scp:feats.scp scp:targets.scp nnet.init nnet.iter1\n";
 
     ParseOptions po(usage);
 
@@ -45,36 +45,27 @@ int main(int argc, char *argv[]) {
     rnd_opts.Register(&po);
     LossOptions loss_opts;
     loss_opts.Register(&po);
+    FrmshuffTrainOptions frmshuff_opts;
+    frmshuff_opts.Register(&po);
 
-    bool binary = true, 
-         crossvalidate = false,
-         randomize = true;
+    bool binary = true;
     po.Register("binary", &binary, "Write output in binary mode");
-    po.Register("cross-validate", &crossvalidate, "Perform cross-validation (don't backpropagate)");
-    po.Register("randomize", &randomize, "Perform the frame-level shuffling within the Cache::");
 
-    std::string feature_transform;
-    po.Register("feature-transform", &feature_transform, "Feature transform in Nnet format");
-    std::string targets_transform;
-    po.Register("targets-transform", &targets_transform, "Targets transform in Nnet format");
     std::string objective_function = "mse";
-    po.Register("objective-function", &objective_function, "Objective function : xent|mse");
+    po.Register("objective-function", &objective_function,
+        "Objective function : xent|mse|quartic|multitask");
+
+    BaseFloat gstep = 0.01;
+    po.Register("gstep", &gstep, "Adversarial step size");
 
-    int32 length_tolerance = 5;
-    po.Register("length-tolerance", &length_tolerance, "Allowed length difference of features/targets (frames)");
-    
-    std::string frame_weights;
-    po.Register("frame-weights", &frame_weights, "Per-frame weights to scale gradients (frame selection/weighting).");
-//    std::string tgt_weighting;
-//    po.Register("tgt-weight", &tgt_weighting, "Weight for different dimensions of the output.");
-    float gstep = 0.01;
-    po.Register("gstep", &gstep, "adversarial step size");
     std::string use_gpu="yes";
-    po.Register("use-gpu", &use_gpu, "yes|no|optional, only has effect if compiled with CUDA");
-    
+    po.Register("use-gpu", &use_gpu,
+        "yes|no|optional, only has effect if compiled with CUDA");
+
     po.Read(argc, argv);
 
-    if (po.NumArgs() != 4-(crossvalidate?1:0)) {
+    bool crossvalidate = frmshuff_opts.crossvalidate;
+    if (po.NumArgs() != 3 + (crossvalidate ? 0 : 1)) {
       po.PrintUsage();
       exit(1);
     }
@@ -82,264 +73,41 @@ int main(int argc, char *argv[]) {
     std::string feature_rspecifier = po.GetArg(1),
       targets_rspecifier = po.GetArg(2),
       model_filename = po.GetArg(3);
-        
+
     std::string target_model_filename;
     if (!crossvalidate) {
       target_model_filename = po.GetArg(4);
     }
 
-    using namespace kaldi;
-    using namespace kaldi::nnet1;
-    typedef kaldi::int32 int32;
-
-    //Select the GPU
-#if HAVE_CUDA==1
+#if HAVE_CUDA == 1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
+    // the randomizer buffers are filled in a background thread,
+    CuDevice::Instantiate().AllowMultithreading();
 #endif
 
-    Nnet nnet_transf;
-    if (feature_transform != "") {
-      nnet_transf.Read(feature_transform);
-    }
-    Nnet nnet_transt;
-    if (targets_transform != "") {
-      nnet_transt.Read(targets_transform);
-    }
-
     Nnet nnet;
     nnet.Read(model_filename);
     nnet.SetTrainOptions(trn_opts);
-
     if (crossvalidate) {
-      nnet_transf.SetDropoutRate(0.0);
       nnet.SetDropoutRate(0.0);
     }
 
-    kaldi::int64 total_frames = 0;
+    LossItf *loss = NewLoss(objective_function, loss_opts);
+    Mse adv_loss(loss_opts);
+    FgsmObjective objective(&nnet, loss, &adv_loss, gstep);
 
-    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
-    SequentialBaseFloatMatrixReader targets_reader(targets_rspecifier);
-    RandomAccessBaseFloatVectorReader weights_reader;
-    if (frame_weights != "") {
-      weights_reader.Open(frame_weights);
-    }
-
-    RandomizerMask randomizer_mask(rnd_opts);
-    MatrixRandomizer feature_randomizer(rnd_opts);
-    MatrixRandomizer targets_randomizer(rnd_opts);
-    VectorRandomizer weights_randomizer(rnd_opts);
+    FrmshuffTrainer trainer(frmshuff_opts, rnd_opts);
+    trainer.Train(feature_rspecifier, targets_rspecifier, "", &objective);
 
-/*    Vector<BaseFloat> tgt_weight;
-    if (tgt_weighting != "") {
-      ReadKaldiObject(tgt_weighting, &tgt_weight);
-    }else{
-	  tgt_weight = Vector<BaseFloat>(nnet.OutputDim());
-	  tgt_weight.Set(1);
-	}*/
-    Xent xent(loss_opts);
-    Mse mse(loss_opts);
-    Mse mse_adv(loss_opts);
-    MultiTaskLoss multitask(loss_opts); 
-    if (0 == objective_function.compare(0, 9, "multitask")) {
-      // objective_function contains something like :
-      // 'multitask,xent,2456,1.0,mse,440,0.001'
-      //
-      // the meaning is following:
-      // 'multitask,<type1>,<dim1>,<weight1>,...,<typeN>,<dimN>,<weightN>'
-      multitask.InitFromString(objective_function);
-    }
-    CuMatrix<BaseFloat> feats_transf, nnet_out, tgt_transf, obj_diff,nnet_in_copy, in_diff;
-    int32 batch_counter = 0;
-
-    Timer time;
-    KALDI_LOG << (crossvalidate?"CROSS-VALIDATION":"TRAINING") << " STARTED";
-
-    int32 num_done = 0, num_no_tgt_mat = 0, num_other_error = 0;
-    while (!feature_reader.Done() && !targets_reader.Done()) {
-#if HAVE_CUDA==1
-      // check the GPU is not overheated
-      CuDevice::Instantiate().CheckGpuHealth();
-#endif
-      // fill the randomizer
-      for ( ; !feature_reader.Done() && !targets_reader.Done(); feature_reader.Next(), targets_reader.Next()) {
-        if (feature_randomizer.IsFull()) break; // suspend, keep utt for next loop
-        std::string utt = feature_reader.Key();
-        KALDI_VLOG(3) << "Reading " << utt;
-        // check that we have targets
-        if (targets_reader.Key() != utt) {
-          KALDI_WARN << utt << ", missing targets";
-          num_no_tgt_mat++;
-          break;
-        }
-        // check we have per-frame weights
-        if (frame_weights != "" && !weights_reader.HasKey(utt)) {
-          KALDI_WARN << utt << ", missing per-frame weights";
-          num_other_error++;
-          continue;
-        }
-        // get feature / target pair
-        Matrix<BaseFloat> mat = feature_reader.Value();
-        Matrix<BaseFloat> targets = targets_reader.Value();
-        // get per-frame weights
-        Vector<BaseFloat> weights;
-        if (frame_weights != "") {
-          weights = weights_reader.Value(utt);
-        } else { // all per-frame weights are 1.0
-          weights.Resize(mat.NumRows());
-          weights.Set(1.0);
-        }
-        // correct small length mismatch ... or drop sentence
-        {
-          // add lengths to vector
-          std::vector<int32> lenght;
-          lenght.push_back(mat.NumRows());
-          lenght.push_back(targets.NumRows());
-          lenght.push_back(weights.Dim());
-          // find min, max
-          int32 min = *std::min_element(lenght.begin(),lenght.end());
-          int32 max = *std::max_element(lenght.begin(),lenght.end());
-          // fix or drop ?
-          if (max - min < length_tolerance) {
-            if(mat.NumRows() != min) mat.Resize(min, mat.NumCols(), kCopyData);
-            if(targets.NumRows() != min) targets.Resize(min, targets.NumCols(), kCopyData);
-            if(weights.Dim() != min) weights.Resize(min, kCopyData);
-          } else {
-            KALDI_WARN << utt << ", length mismatch of targets " << targets.NumRows()
-                       << " and features " << mat.NumRows();
-            num_other_error++;
-            continue;
-          }
-        }
-        // apply optional feature transform
-        nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
-        nnet_transt.Feedforward(CuMatrix<BaseFloat>(targets), &tgt_transf);
-
-        // pass data to randomizers
-        KALDI_ASSERT(feats_transf.NumRows() == tgt_transf.NumRows());
-        feature_randomizer.AddData(feats_transf);
-        targets_randomizer.AddData(tgt_transf);
-        weights_randomizer.AddData(weights);
-        num_done++;
-      
-        // report the speed
-        if (num_done % 5000 == 0) {
-          double time_now = time.Elapsed();
-          KALDI_VLOG(1) << "After " << num_done << " utterances: time elapsed = "
-                        << time_now/60 << " min; processed " << total_frames/time_now
-                        << " frames per second.";
-        }
-      }
-
-      // randomize
-      if (!crossvalidate && randomize) {
-        const std::vector<int32>& mask = randomizer_mask.Generate(feature_randomizer.NumFrames());
-        feature_randomizer.Randomize(mask);
-        targets_randomizer.Randomize(mask);
-        weights_randomizer.Randomize(mask);
-      }
-
-      // train with data from randomizers (using mini-batches)
-      for ( ; !feature_randomizer.Done(); feature_randomizer.Next(),
-                                          targets_randomizer.Next(),
-                                          weights_randomizer.Next()) {
-        // get block of feature/target pairs
-        const CuMatrixBase<BaseFloat>& nnet_in = feature_randomizer.Value();
-        const CuMatrixBase<BaseFloat>& nnet_tgt = targets_randomizer.Value();
-        const Vector<BaseFloat>& frm_weights = weights_randomizer.Value();
-
-        // forward pass
-        nnet.Propagate(nnet_in, &nnet_out);
-        // evaluate objective function we've chosen
-        if (objective_function == "xent") {
-          // gradients re-scaled by weights in Eval,
-          xent.Eval(frm_weights, nnet_out, nnet_tgt, &obj_diff); 
-        } else if (objective_function == "mse") {
-          // gradients re-scaled by weights in Eval,
-          mse.Eval(frm_weights, nnet_out, nnet_tgt, &obj_diff);
-        } else if (0 == objective_function.compare(0, 9, "multitask")) {
-          multitask.Eval(frm_weights, nnet_out, nnet_tgt, &obj_diff);
-        } else {
-          KALDI_ERR << "Unknown objective function code : " << objective_function;
-        }
-        // backward pass
-        if (!crossvalidate) {
-          // backpropagate
-          nnet.Backpropagate(obj_diff, &in_diff);
-          nnet_in_copy = nnet_in;
-          //Take sign of input gradient
-          {
-          in_diff.ApplyHeaviside();
-          in_diff.Scale(2.0);
-          in_diff.Add(-1.0);
-          }
-          nnet_in_copy.AddMat(gstep,in_diff);
-          nnet.Propagate(nnet_in_copy,&nnet_out);
-          mse_adv.Eval(frm_weights, nnet_out, nnet_tgt, &obj_diff);
-          nnet.Backpropagate(obj_diff, NULL);
-          KALDI_LOG << "Batch " << batch_counter << ":"
-                    << "prev loss " << mse.BatchLoss() << ","
-                    << "post loss " << mse_adv.BatchLoss() << ".";
-        }
-        batch_counter++;
-/*
-        // 1st minibatch : show what happens in network 
-        if (kaldi::g_kaldi_verbose_level >= 1 && total_frames == 0) { // vlog-1
-          KALDI_VLOG(1) << "### After " << total_frames << " frames,";
-          KALDI_VLOG(1) << nnet.InfoPropagate();
-          if (!crossvalidate) {
-            KALDI_VLOG(1) << nnet.InfoBackPropagate();
-            KALDI_VLOG(1) << nnet.InfoGradient();
-          }
-        }
-        
-        // monitor the NN training
-        if (kaldi::g_kaldi_verbose_level >= 2) { // vlog-2
-          if ((total_frames/25000) != ((total_frames+nnet_in.NumRows())/25000)) { // print every 25k frames
-            KALDI_VLOG(2) << "### After " << total_frames << " frames,";
-            KALDI_VLOG(2) << nnet.InfoPropagate();
-            if (!crossvalidate) {
-              KALDI_VLOG(2) << nnet.InfoGradient();
-            }
-          }
-        }
-*/        
-        total_frames += nnet_in.NumRows();
-      }
-    }
-/*    
-    // after last minibatch : show what happens in network 
-    if (kaldi::g_kaldi_verbose_level >= 1) { // vlog-1
-      KALDI_VLOG(1) << "### After " << total_frames << " frames,";
-      KALDI_VLOG(1) << nnet.InfoPropagate();
-      if (!crossvalidate) {
-        KALDI_VLOG(1) << nnet.InfoBackPropagate();
-        KALDI_VLOG(1) << nnet.InfoGradient();
-      }
-    }
-*/
     if (!crossvalidate) {
       nnet.Write(target_model_filename, binary);
     }
 
-    KALDI_LOG << "Done " << num_done << " files, " << num_no_tgt_mat
-              << " with no tgt_mats, " << num_other_error
-              << " with other errors. "
-              << "[" << (crossvalidate?"CROSS-VALIDATION":"TRAINING")
-              << ", " << (randomize?"RANDOMIZED":"NOT-RANDOMIZED") 
-              << ", " << time.Elapsed()/60 << " min, fps" << total_frames/time.Elapsed()
-              << "]";  
-
-    if (objective_function == "xent") {
-      KALDI_LOG << xent.Report();
-    } else if (objective_function == "mse") {
-      KALDI_LOG << mse.Report();
-    } else if (0 == objective_function.compare(0, 9, "multitask")) {
-      KALDI_LOG << multitask.Report();
-    } else {
-      KALDI_ERR << "Unknown objective function code : " << objective_function;
-    }
+    KALDI_LOG << trainer.Report();
+    KALDI_LOG << objective.Report();
+    delete loss;
 
-#if HAVE_CUDA==1
+#if HAVE_CUDA == 1
     CuDevice::Instantiate().PrintProfile();
 #endif
 
@@ -52,6 +52,8 @@ int main(int argc, char *argv[]) {
     trn_opts.Register(&po);
     LossOptions loss_opts;
     loss_opts.Register(&po);
+    MatrixBufferOptions buffer_opts;
+    buffer_opts.Register(&po);
 
     bool binary = true;
     po.Register("binary", &binary, "Write model in binary mode");
@@ -125,7 +127,8 @@ int main(int argc, char *argv[]) {
       nnet.SetDropoutRate(0.0);
     }
 
-    kaldi::int64 total_frames = 0;
+    kaldi::int64 total_frames = 0,
+      total_frames_padded = 0;
 
     // Initialize feature and target readers,
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -146,7 +149,7 @@ int main(int argc, char *argv[]) {
 
     // Buffer for input features, used for choosing utt's with similar length,
     MatrixBuffer matrix_buffer;
-    matrix_buffer.Init(&feature_reader);
+    matrix_buffer.Init(&feature_reader, buffer_opts);
 
     int32 num_done = 0,
           num_no_tgt_mat = 0,
@@ -214,6 +217,12 @@ int main(int argc, char *argv[]) {
             }
           }
 
+          // utterances with all the frame weights zero give no gradient,
+          if (weights.Max() == 0.0) {
+            KALDI_VLOG(2) << utt << ", all frame weights are zero, skipping";
+            continue;
+          }
+
           // input transform may contain splicing,
           nnet_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
 
@@ -233,6 +242,29 @@ int main(int argc, char *argv[]) {
       // Having no data? Skip the cycle...
       if (frame_num_utt.size() == 0) continue;
 
+      // Sort the streams by decreasing length, so the LSTMs process
+      // only the streams which did not finish yet (packed batch),
+      {
+        std::vector<std::pair<int32, int32> > order;  // (-length, index),
+        for (int32 s = 0; s < frame_num_utt.size(); s++) {
+          order.push_back(std::make_pair(-frame_num_utt[s], s));
+        }
+        std::stable_sort(order.begin(), order.end());
+        std::vector<Matrix<BaseFloat> > feats_sorted(order.size());
+        std::vector<Posterior> labels_sorted(order.size());
+        std::vector<Vector<BaseFloat> > weights_sorted(order.size());
+        for (int32 s = 0; s < order.size(); s++) {
+          int32 i = order[s].second;
+          feats_sorted[s].Swap(&feats_utt[i]);
+          labels_sorted[s].swap(labels_utt[i]);
+          weights_sorted[s].Swap(&weights_utt[i]);
+          frame_num_utt[s] = -order[s].first;
+        }
+        feats_utt.swap(feats_sorted);
+        labels_utt.swap(labels_sorted);
+        weights_utt.swap(weights_sorted);
+      }
+
       // Pack the parallel data,
       Matrix<BaseFloat> feat_mat_host;
       Posterior target_host;
@@ -313,6 +345,7 @@ int main(int argc, char *argv[]) {
 
       num_done += frame_num_utt.size();
       total_frames += std::accumulate(frame_num_utt.begin(), frame_num_utt.end(), 0);
+      total_frames_padded += nnet_out.NumRows();
 
       // monitor the NN training (--verbose=2),
       int32 F = 25000;
@@ -349,7 +382,10 @@ int main(int argc, char *argv[]) {
               << " with other errors. "
               << "[" << (crossvalidate ? "CROSS-VALIDATION" : "TRAINING")
               << ", " << time.Elapsed() / 60 << " min, "
-              << "fps" << total_frames / time.Elapsed() << "]";
+              << "fps" << total_frames / time.Elapsed() << ", "
+              << 100.0 * (total_frames_padded - total_frames) /
+                 std::max<int64>(total_frames_padded, 1)
+              << "% padding]";
     KALDI_LOG << xent.Report();
 
 #if HAVE_CUDA == 1
@@ -93,6 +93,12 @@ bool ReadData(SequentialBaseFloatMatrixReader& feature_reader,
       }
     }
 
+    // utterances with all the frame weights zero give no gradient,
+    if (weights->Max() == 0.0) {
+      KALDI_VLOG(2) << utt << ", all frame weights are zero, skipping";
+      continue;
+    }
+
     // By getting here we got a valid utterance,
     feature_reader.Next();
     return true;
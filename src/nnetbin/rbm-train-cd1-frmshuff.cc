@@ -22,6 +22,7 @@
 #include "nnet/nnet-nnet.h"
 #include "nnet/nnet-loss.h"
 #include "nnet/nnet-randomizer.h"
+#include "nnet/nnet-data-loader.h"
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "base/timer.h"
@@ -99,6 +100,8 @@ int main(int argc, char *argv[]) {
 
 #if HAVE_CUDA == 1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
+    // the randomizer buffer is filled in a background thread,
+    CuDevice::Instantiate().AllowMultithreading();
 #endif
 
     Nnet rbm_transf;
@@ -132,7 +135,6 @@ int main(int argc, char *argv[]) {
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomizerMask randomizer_mask(rnd_opts);
-    MatrixRandomizer feature_randomizer(rnd_opts);
 
     CuRand<BaseFloat> cu_rand;  // parallel random number generator,
     Mse mse(loss_opts);
@@ -149,14 +151,14 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Iteration " << iter << "/" << num_iters;
 
     int32 num_done = 0, num_other_error = 0;
-    while (!feature_reader.Done()) {
-#if HAVE_CUDA == 1
-      // check that GPU is computing accurately,
-      CuDevice::Instantiate().CheckGpuHealth();
-#endif
-      // fill the randomizer,
+    kaldi::int64 num_frames_loaded = 0;
+
+    // fill the randomizer, this runs in a background thread
+    // while we train on the previous buffer,
+    DoubleBufferedLoader<RandomizerBundle>::FillFunction fill =
+        [&](RandomizerBundle *buf) -> bool {
       for ( ; !feature_reader.Done(); feature_reader.Next()) {
-        if (feature_randomizer.IsFull()) {
+        if (buf->IsFull()) {
           // break the loop without calling Next(),
           // we keep the 'utt' for next round,
           break;
@@ -176,27 +178,45 @@ int main(int argc, char *argv[]) {
         // apply feature transform,
         rbm_transf.Feedforward(CuMatrix<BaseFloat>(mat), &feats_transf);
         // add to randomizer,
-        feature_randomizer.AddData(feats_transf);
+        buf->Mat(0).AddData(feats_transf);
         num_done++;
+        num_frames_loaded += feats_transf.NumRows();
 
         // report the speed
         if (num_done % 5000 == 0) {
           double time_now = time.Elapsed();
           KALDI_VLOG(1) << "After " << num_done << " utterances: "
             << "time elapsed = " << time_now / 60 << " min; "
-            << "processed " << total_frames / time_now << " frames per sec.";
+            << "loaded " << num_frames_loaded / time_now << " frames per sec.";
         }
       }
 
       // randomize,
-      feature_randomizer.Randomize(
-        randomizer_mask.Generate(feature_randomizer.NumFrames())
-      );
+      buf->Randomize(&randomizer_mask);
+
+      // reopen the feature stream if we will run another iteration
+      if (feature_reader.Done() && (iter < num_iters)) {
+        iter++;
+        KALDI_LOG << "Iteration " << iter << "/" << num_iters;
+        feature_reader.Close();
+        feature_reader.Open(feature_rspecifier);
+      }
+      return !feature_reader.Done();
+    };
 
+    DoubleBufferedLoader<RandomizerBundle> loader(
+        RandomizerBundle(rnd_opts, 1, 0, 0), fill);
+
+    RandomizerBundle *buf;
+    while ((buf = loader.Next()) != NULL) {
+#if HAVE_CUDA == 1
+      // check that GPU is computing accurately,
+      CuDevice::Instantiate().CheckGpuHealth();
+#endif
       // train with data from randomizer (using mini-batches)
-      for ( ; !feature_randomizer.Done(); feature_randomizer.Next()) {
+      for ( ; !buf->Done(); buf->Next()) {
         // get the mini-batch,
-        const CuMatrixBase<BaseFloat>& pos_vis = feature_randomizer.Value();
+        const CuMatrixBase<BaseFloat>& pos_vis = buf->Mat(0).Value();
         // get the dims,
         int32 num_frames = pos_vis.NumRows(),
               dim_hid = rbm.OutputDim();
@@ -256,14 +276,6 @@ int main(int argc, char *argv[]) {
           }
         }
       }
-
-      // reopen the feature stream if we will run another iteration
-      if (feature_reader.Done() && (iter < num_iters)) {
-        iter++;
-        KALDI_LOG << "Iteration " << iter << "/" << num_iters;
-        feature_reader.Close();
-        feature_reader.Open(feature_rspecifier);
-      }
     }
 
     nnet.Write(target_model_filename, binary);
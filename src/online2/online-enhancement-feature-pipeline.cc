@@ -0,0 +1,76 @@
+// online2/online-enhancement-feature-pipeline.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online2/online-enhancement-feature-pipeline.h"
+
+namespace kaldi {
+
+OnlineEnhancementFeaturePipelineInfo::OnlineEnhancementFeaturePipelineInfo(
+    const OnlineEnhancementFeaturePipelineConfig &config) {
+  if (config.lps_config != "")
+    ReadConfigFromFile(config.lps_config, &lps_opts);
+  // else use the defaults.
+}
+
+OverlapAddOptions OnlineEnhancementFeaturePipelineInfo::SynthesisOptions()
+    const {
+  const FrameExtractionOptions &frame_opts = lps_opts.frame_opts;
+  OverlapAddOptions ans;
+  ans.frame_shift = frame_opts.WindowShift();
+  ans.fft_size = frame_opts.PaddedWindowSize();
+  ans.window_type = frame_opts.window_type;
+  if (ans.window_type != "hamming" && ans.window_type != "hanning" &&
+      ans.window_type != "rectangular")
+    KALDI_ERR << "Window type " << ans.window_type << " is not supported for "
+              << "resynthesis; use hamming, hanning or rectangular.";
+  if (frame_opts.PaddedWindowSize() != frame_opts.WindowSize() ||
+      frame_opts.preemph_coeff != 0.0 || frame_opts.remove_dc_offset ||
+      !frame_opts.snip_edges)
+    KALDI_WARN << "Resynthesis will not invert the analysis exactly; use a "
+               << "power-of-two frame length, --preemphasis-coefficient=0, "
+               << "--remove-dc-offset=false and --snip-edges=true.";
+  return ans;
+}
+
+OnlineEnhancementFeaturePipeline::OnlineEnhancementFeaturePipeline(
+    const OnlineEnhancementFeaturePipelineInfo &info):
+    info_(info) {
+  base_feature_ = new OnlineLpsPhs(info_.lps_opts);
+  int32 dim = base_feature_->Dim() / 2;
+  lps_feature_ = new OnlineColumnRangeFeature(base_feature_, 0, dim);
+  phase_feature_ = new OnlineColumnRangeFeature(base_feature_, dim, dim);
+}
+
+void OnlineEnhancementFeaturePipeline::AcceptWaveform(
+    BaseFloat sampling_rate,
+    const VectorBase<BaseFloat> &waveform) {
+  base_feature_->AcceptWaveform(sampling_rate, waveform);
+}
+
+void OnlineEnhancementFeaturePipeline::InputFinished() {
+  base_feature_->InputFinished();
+}
+
+OnlineEnhancementFeaturePipeline::~OnlineEnhancementFeaturePipeline() {
+  // Note: the delete command only deletes pointers that are non-NULL.  Delete
+  // things in reverse order of how they were created.
+  delete phase_feature_;
+  delete lps_feature_;
+  delete base_feature_;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,141 @@
+// online2/online-enhancement-feature-pipeline.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_ONLINE2_ONLINE_ENHANCEMENT_FEATURE_PIPELINE_H_
+#define KALDI_ONLINE2_ONLINE_ENHANCEMENT_FEATURE_PIPELINE_H_
+
+#include <string>
+
+#include "matrix/matrix-lib.h"
+#include "util/common-utils.h"
+#include "base/kaldi-error.h"
+#include "feat/online-feature.h"
+#include "feat/overlap-add.h"
+
+namespace kaldi {
+/// @addtogroup  onlinefeat OnlineFeatureExtraction
+/// @{
+
+/// @file
+/// This file contains the online feature pipeline for speech enhancement: the
+/// log-power spectrum (LPS) of the input is given to a mask-estimation or
+/// regression network, and the phase of the same frames is kept so that the
+/// enhanced LPS can be turned back into a waveform, e.g. with
+/// OverlapAddSynthesizer.  Both come from a single FFT per frame
+/// (LpsPhsComputer).
+
+
+/// This configuration class is to set up OnlineEnhancementFeaturePipelineInfo,
+/// which in turn is the configuration class for
+/// OnlineEnhancementFeaturePipeline.
+struct OnlineEnhancementFeaturePipelineConfig {
+  std::string lps_config;
+
+  OnlineEnhancementFeaturePipelineConfig() { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("lps-config", &lps_config, "Configuration file for "
+                   "log-power spectrum features (e.g. conf/lps.conf); the same "
+                   "frame options are used for the phase.");
+  }
+};
+
+
+/// This class holds the options for OnlineEnhancementFeaturePipeline; it is
+/// initialized from OnlineEnhancementFeaturePipelineConfig, which reads them
+/// from the command line, or it can be set up directly from code.
+struct OnlineEnhancementFeaturePipelineInfo {
+  OnlineEnhancementFeaturePipelineInfo() { }
+
+  explicit OnlineEnhancementFeaturePipelineInfo(
+      const OnlineEnhancementFeaturePipelineConfig &config);
+
+  BaseFloat FrameShiftInSeconds() const {
+    return lps_opts.frame_opts.frame_shift_ms / 1000.0f;
+  }
+
+  /// Returns options for OverlapAddSynthesizer that match the framing of
+  /// the features, for resynthesis of the enhanced signal.  For exact
+  /// resynthesis the frame length should be a power of two and there should
+  /// be no pre-emphasis or DC removal.
+  OverlapAddOptions SynthesisOptions() const;
+
+  LpsOptions lps_opts;
+};
+
+
+/// OnlineEnhancementFeaturePipeline computes, in an online setting, the
+/// log-power spectrum and phase of the incoming waveform.  As an
+/// OnlineFeatureInterface its output is the log-power spectrum, which is what
+/// the network sees; the phase of the same frames is available from
+/// PhaseFeature().
+class OnlineEnhancementFeaturePipeline: public OnlineFeatureInterface {
+ public:
+  explicit OnlineEnhancementFeaturePipeline(
+      const OnlineEnhancementFeaturePipelineInfo &info);
+
+  /// Member functions from OnlineFeatureInterface; they refer to the
+  /// log-power spectrum.
+  virtual int32 Dim() const { return lps_feature_->Dim(); }
+  virtual bool IsLastFrame(int32 frame) const {
+    return lps_feature_->IsLastFrame(frame);
+  }
+  virtual int32 NumFramesReady() const {
+    return lps_feature_->NumFramesReady();
+  }
+  virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
+    lps_feature_->GetFrame(frame, feat);
+  }
+  virtual BaseFloat FrameShiftInSeconds() const {
+    return info_.FrameShiftInSeconds();
+  }
+
+  /// Accept more data to process; sampling_rate is necessary just to assert
+  /// it equals what's in the config.
+  void AcceptWaveform(BaseFloat sampling_rate,
+                      const VectorBase<BaseFloat> &waveform);
+
+  /// Tells the pipeline there will be no more waveform; this flushes out the
+  /// last frames if snip-edges is false.
+  void InputFinished();
+
+  /// Returns the log-power spectrum, to be given to the network; the pointer
+  /// is owned by this object.
+  OnlineFeatureInterface *InputFeature() { return lps_feature_; }
+
+  /// Returns the phase of the same frames; the pointer is owned by this
+  /// object.
+  OnlineFeatureInterface *PhaseFeature() { return phase_feature_; }
+
+  virtual ~OnlineEnhancementFeaturePipeline();
+
+ private:
+  const OnlineEnhancementFeaturePipelineInfo &info_;
+
+  OnlineLpsPhs *base_feature_;  // log-power spectrum and phase.
+  OnlineColumnRangeFeature *lps_feature_;
+  OnlineColumnRangeFeature *phase_feature_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineEnhancementFeaturePipeline);
+};
+
+
+/// @} End of "addtogroup onlinefeat"
+}  // namespace kaldi
+
+#endif  // KALDI_ONLINE2_ONLINE_ENHANCEMENT_FEATURE_PIPELINE_H_
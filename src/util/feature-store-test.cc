@@ -0,0 +1,197 @@
+// util/feature-store-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//  http://www.apache.org/licenses/LICENSE-2.0
+
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/feature-store.h"
+#include "util/kaldi-table.h"
+#include "util/table-types.h"
+
+namespace kaldi {
+
+void UnitTestFeatureStoreRanges(bool compress) {
+  FeatureStoreWriterOptions opts;
+  opts.chunk_size = RandInt(1, 20);
+  opts.compress = compress;
+  int32 num_utts = RandInt(1, 10), dim = RandInt(1, 15);
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > feats(num_utts);
+  {
+    FeatureStoreWriter writer(opts);
+    KALDI_ASSERT(writer.Open("tmpf.fstore", "tmpf.fsidx"));
+    for (int32 i = 0; i < num_utts; i++) {
+      std::ostringstream os;
+      os << "utt" << i;
+      keys.push_back(os.str());
+      feats[i].Resize(RandInt(1, 100), dim);
+      feats[i].SetRandn();
+      KALDI_ASSERT(writer.Write(keys[i], feats[i]));
+    }
+    KALDI_ASSERT(writer.Close());
+  }
+  FeatureStoreReader reader;
+  KALDI_ASSERT(reader.Open("tmpf.fsidx"));
+  KALDI_ASSERT(reader.Keys() == keys && !reader.HasKey("foo"));
+  BaseFloat tol = (compress ? 0.1 : 1.0e-05);
+  for (int32 n = 0; n < 20; n++) {
+    int32 i = RandInt(0, num_utts - 1), num_frames = feats[i].NumRows();
+    KALDI_ASSERT(reader.NumFrames(keys[i]) == num_frames &&
+                 reader.Dim(keys[i]) == dim);
+    int32 t0 = RandInt(0, num_frames), t1 = RandInt(t0, num_frames);
+    Matrix<BaseFloat> frames;
+    reader.ReadFrames(keys[i], t0, t1, &frames);
+    KALDI_ASSERT(frames.NumRows() == t1 - t0);
+    if (t1 > t0) {
+      KALDI_ASSERT(frames.NumCols() == dim);
+      Matrix<BaseFloat> ref(feats[i].RowRange(t0, t1 - t0));
+      KALDI_ASSERT(frames.ApproxEqual(ref, tol));
+    }
+  }
+  unlink("tmpf.fstore");
+  unlink("tmpf.fsidx");
+}
+
+void UnitTestFeatureStoreTable() {
+  int32 num_utts = RandInt(1, 10), dim = RandInt(1, 15);
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > feats(num_utts);
+  {
+    BaseFloatMatrixWriter writer("fstore:tmpf.fstore,tmpf.fsidx");
+    for (int32 i = 0; i < num_utts; i++) {
+      std::ostringstream os;
+      os << "utt" << i;
+      keys.push_back(os.str());
+      feats[i].Resize(RandInt(1, 300), dim);
+      feats[i].SetRandn();
+      writer.Write(keys[i], feats[i]);
+    }
+    KALDI_ASSERT(writer.Close());
+  }
+  {
+    SequentialBaseFloatMatrixReader reader("fstore:tmpf.fsidx");
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++) {
+      KALDI_ASSERT(reader.Key() == keys[i] &&
+                   reader.Value().ApproxEqual(feats[i], 1.0e-05));
+    }
+    KALDI_ASSERT(i == num_utts && reader.Close());
+  }
+  {
+    RandomAccessDoubleMatrixReader reader("fstore:tmpf.fsidx");
+    for (int32 n = 0; n < 10; n++) {
+      int32 i = RandInt(0, num_utts - 1);
+      KALDI_ASSERT(reader.HasKey(keys[i]));
+      Matrix<BaseFloat> value(reader.Value(keys[i]));
+      KALDI_ASSERT(value.ApproxEqual(feats[i], 1.0e-05));
+    }
+    KALDI_ASSERT(!reader.HasKey("foo"));
+  }
+  {
+    // Frame ranges, as in scp files (inclusive).
+    RandomAccessBaseFloatMatrixReader reader("fstore:tmpf.fsidx");
+    for (int32 n = 0; n < 10; n++) {
+      int32 i = RandInt(0, num_utts - 1), num_frames = feats[i].NumRows(),
+          t0 = RandInt(0, num_frames - 1), t1 = RandInt(t0, num_frames - 1);
+      std::ostringstream os;
+      os << keys[i] << '[' << t0 << ':' << t1 << ']';
+      KALDI_ASSERT(reader.HasKey(os.str()));
+      Matrix<BaseFloat> ref(feats[i].RowRange(t0, t1 - t0 + 1));
+      KALDI_ASSERT(reader.Value(os.str()).ApproxEqual(ref, 1.0e-05));
+      std::ostringstream bad;
+      bad << keys[i] << "[0:" << num_frames << ']';
+      KALDI_ASSERT(!reader.HasKey(bad.str()));
+    }
+    KALDI_ASSERT(!reader.HasKey(keys[0] + "[2:1]") &&
+                 !reader.HasKey("foo[0:0]"));
+    // Other matrix types are filled directly.
+    RandomAccessGeneralMatrixReader general_reader("fstore:tmpf.fsidx");
+    Matrix<BaseFloat> value;
+    general_reader.Value(keys[0]).GetMatrix(&value);
+    KALDI_ASSERT(value.ApproxEqual(feats[0], 1.0e-05));
+  }
+  {
+    // Chunk size and compression given in the wspecifier.
+    std::vector<int64> data_size;
+    for (int32 compress = 0; compress < 2; compress++) {
+      BaseFloatMatrixWriter writer(compress ?
+                                   "fstore,chunk=7,compress:tmpf.fstore,"
+                                   "tmpf.fsidx" :
+                                   "fstore,chunk=7:tmpf.fstore,tmpf.fsidx");
+      for (int32 i = 0; i < num_utts; i++)
+        writer.Write(keys[i], feats[i]);
+      KALDI_ASSERT(writer.Close());
+      std::ifstream data("tmpf.fstore", std::ios::binary | std::ios::ate);
+      data_size.push_back(data.tellg());
+    }
+    KALDI_ASSERT(data_size[1] < data_size[0]);
+    std::ifstream is("tmpf.fsidx");
+    std::string key, data_filename;
+    int32 num_rows, num_cols, chunk_size;
+    is >> key >> data_filename >> num_rows >> num_cols >> chunk_size;
+    KALDI_ASSERT(key == keys[0] && chunk_size == 7);
+    SequentialBaseFloatMatrixReader reader("fstore:tmpf.fsidx");
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++) {
+      KALDI_ASSERT(reader.Key() == keys[i] &&
+                   reader.Value().ApproxEqual(feats[i], 0.1));
+    }
+    KALDI_ASSERT(i == num_utts);
+  }
+  {
+    // Writing compressed matrices gives compressed chunks.
+    CompressedMatrixWriter writer("fstore:tmpf.fstore,tmpf.fsidx");
+    for (int32 i = 0; i < num_utts; i++)
+      writer.Write(keys[i], CompressedMatrix(feats[i]));
+    KALDI_ASSERT(writer.Close());
+    SequentialBaseFloatMatrixReader reader("fstore:tmpf.fsidx");
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++) {
+      Matrix<BaseFloat> ref(CompressedMatrix(feats[i]));
+      KALDI_ASSERT(reader.Key() == keys[i] &&
+                   reader.Value().ApproxEqual(ref, 0.1));
+    }
+    KALDI_ASSERT(i == num_utts);
+  }
+  unlink("tmpf.fstore");
+  unlink("tmpf.fsidx");
+}
+
+}  // end namespace kaldi.
+
+int main() {
+  using namespace kaldi;
+  KALDI_ASSERT(ClassifyRspecifier("fstore:foo.fsidx", NULL, NULL) ==
+               kFeatureStoreRspecifier);
+  std::string data, index;
+  KALDI_ASSERT(ClassifyWspecifier("fstore:a.fstore,b.fsidx", &data, &index,
+                                  NULL) == kFeatureStoreWspecifier &&
+               data == "a.fstore" && index == "b.fsidx");
+  KALDI_ASSERT(ClassifyWspecifier("ark,fstore:a,b", NULL, NULL, NULL) ==
+               kNoWspecifier);
+  WspecifierOptions opts;
+  KALDI_ASSERT(ClassifyWspecifier("fstore,chunk=50,compress:a,b", NULL, NULL,
+                                  &opts) == kFeatureStoreWspecifier &&
+               opts.chunk_size == 50 && opts.compress);
+  KALDI_ASSERT(ClassifyWspecifier("ark,compress:a", NULL, NULL, NULL) ==
+               kNoWspecifier &&
+               ClassifyWspecifier("fstore,chunk=0:a,b", NULL, NULL, NULL) ==
+               kNoWspecifier);
+  for (int32 i = 0; i < 10; i++) {
+    UnitTestFeatureStoreRanges(i % 2 == 0);
+    UnitTestFeatureStoreTable();
+  }
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,317 @@
+// util/feature-store.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/feature-store.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+bool FeatureStoreWriter::Open(const std::string &data_filename,
+                              const std::string &index_wxfilename) {
+  if (IsOpen() && !Close())
+    KALDI_ERR << "Error closing previously open feature store "
+              << data_filename_;
+  KALDI_ASSERT(opts_.chunk_size > 0);
+  if (ClassifyWxfilename(data_filename) != kFileOutput) {
+    KALDI_WARN << "The data file of a feature store must be an actual "
+               << "filename, got " << PrintableWxfilename(data_filename);
+    return false;
+  }
+  if (!IsToken(data_filename)) {
+    KALDI_WARN << "The data file of a feature store may not contain "
+               << "whitespace: '" << data_filename << "'";
+    return false;
+  }
+  data_filename_ = data_filename;
+  // true, true means binary mode, write the binary-mode header.
+  if (!data_output_.Open(data_filename, true, true))
+    return false;
+  // Index files are always text mode.
+  if (!index_output_.Open(index_wxfilename, false, false)) {
+    data_output_.Close();
+    return false;
+  }
+  return true;
+}
+
+bool FeatureStoreWriter::WriteIndexLine(const std::string &key,
+                                        int32 num_rows, int32 num_cols,
+                                        const std::vector<int64> &offsets) {
+  std::ostream &os = index_output_.Stream();
+  os << key << ' ' << data_filename_ << ' ' << num_rows << ' ' << num_cols
+     << ' ' << opts_.chunk_size;
+  for (size_t i = 0; i < offsets.size(); i++)
+    os << ' ' << offsets[i];
+  os << '\n';
+  if (!os.good()) {
+    KALDI_WARN << "Error writing index of feature store, key is " << key;
+    return false;
+  }
+  return true;
+}
+
+bool FeatureStoreWriter::Write(const std::string &key,
+                               const MatrixBase<BaseFloat> &feats) {
+  if (!IsToken(key))
+    KALDI_ERR << "Invalid key '" << key << "' (feature store)";
+  std::ostream &os = data_output_.Stream();
+  int32 num_rows = feats.NumRows(), num_cols = feats.NumCols(),
+      chunk_size = opts_.chunk_size;
+  std::vector<int64> offsets;
+  for (int32 row = 0; row < num_rows; row += chunk_size) {
+    SubMatrix<BaseFloat> chunk(feats, row,
+                               std::min(chunk_size, num_rows - row),
+                               0, num_cols);
+    offsets.push_back(os.tellp());
+    if (opts_.compress) {
+      CompressedMatrix cmat(chunk, opts_.compression_method);
+      cmat.Write(os, true);
+    } else {
+      chunk.Write(os, true);
+    }
+  }
+  if (!os.good()) {
+    KALDI_WARN << "Error writing data to feature store "
+               << data_filename_ << ", key is " << key;
+    return false;
+  }
+  return WriteIndexLine(key, num_rows, num_cols, offsets);
+}
+
+bool FeatureStoreWriter::Write(const std::string &key,
+                               const CompressedMatrix &feats) {
+  if (!IsToken(key))
+    KALDI_ERR << "Invalid key '" << key << "' (feature store)";
+  std::ostream &os = data_output_.Stream();
+  int32 num_rows = feats.NumRows(), num_cols = feats.NumCols(),
+      chunk_size = opts_.chunk_size;
+  std::vector<int64> offsets;
+  for (int32 row = 0; row < num_rows; row += chunk_size) {
+    CompressedMatrix chunk(feats, row, std::min(chunk_size, num_rows - row),
+                           0, num_cols);
+    offsets.push_back(os.tellp());
+    chunk.Write(os, true);
+  }
+  if (!os.good()) {
+    KALDI_WARN << "Error writing data to feature store "
+               << data_filename_ << ", key is " << key;
+    return false;
+  }
+  return WriteIndexLine(key, num_rows, num_cols, offsets);
+}
+
+bool FeatureStoreWriter::Write(const std::string &key,
+                               const GeneralMatrix &feats) {
+  switch (feats.Type()) {
+    case kCompressedMatrix:
+      return Write(key, feats.GetCompressedMatrix());
+    case kFullMatrix: {
+      bool compress = opts_.compress;
+      opts_.compress = false;
+      bool ans = Write(key, feats.GetFullMatrix());
+      opts_.compress = compress;
+      return ans;
+    }
+    default:
+      KALDI_ERR << "Sparse matrices cannot be written to a feature store.";
+      return false;
+  }
+}
+
+bool FeatureStoreWriter::Close() {
+  if (!IsOpen()) return true;
+  bool ans = data_output_.Close();
+  ans = index_output_.Close() && ans;
+  if (!ans)
+    KALDI_WARN << "Error closing feature store " << data_filename_;
+  return ans;
+}
+
+FeatureStoreWriter::~FeatureStoreWriter() {
+  if (IsOpen() && !Close())
+    KALDI_ERR << "Error closing feature store " << data_filename_
+              << " (call Close() yourself to avoid this exception).";
+}
+
+
+bool FeatureStoreReader::Open(const std::string &index_rxfilename) {
+  Close();
+  bool binary;
+  Input input;
+  if (!input.Open(index_rxfilename, &binary)) {
+    KALDI_WARN << "Error opening feature-store index "
+               << PrintableRxfilename(index_rxfilename);
+    return false;
+  }
+  if (binary) {
+    KALDI_WARN << "Feature-store index appears to be binary: "
+               << PrintableRxfilename(index_rxfilename);
+    return false;
+  }
+  unordered_map<std::string, int32, StringHasher> file_to_index;
+  std::string line;
+  int32 line_number = 0;
+  std::vector<std::string> fields;
+  while (std::getline(input.Stream(), line)) {
+    line_number++;
+    SplitStringToVector(line, " \t", true, &fields);
+    UttInfo info;
+    bool ok = (fields.size() >= 5 &&
+               ConvertStringToInteger(fields[2], &info.num_rows) &&
+               ConvertStringToInteger(fields[3], &info.num_cols) &&
+               ConvertStringToInteger(fields[4], &info.chunk_size) &&
+               info.num_rows >= 0 && info.num_cols >= 0 &&
+               info.chunk_size > 0);
+    if (ok) {
+      int32 num_chunks = (info.num_rows + info.chunk_size - 1) /
+          info.chunk_size;
+      ok = (fields.size() == 5 + static_cast<size_t>(num_chunks));
+      info.offsets.resize(num_chunks);
+      for (int32 c = 0; ok && c < num_chunks; c++)
+        ok = ConvertStringToInteger(fields[5 + c], &(info.offsets[c]));
+    }
+    if (!ok) {
+      KALDI_WARN << "Invalid line " << line_number << " of feature-store "
+                 << "index " << PrintableRxfilename(index_rxfilename)
+                 << ": " << line;
+      Close();
+      return false;
+    }
+    const std::string &key = fields[0], &data_filename = fields[1];
+    unordered_map<std::string, int32, StringHasher>::iterator iter =
+        file_to_index.find(data_filename);
+    if (iter == file_to_index.end()) {
+      info.file_index = data_filenames_.size();
+      file_to_index[data_filename] = info.file_index;
+      data_filenames_.push_back(data_filename);
+      data_streams_.push_back(NULL);
+    } else {
+      info.file_index = iter->second;
+    }
+    if (utt_info_.count(key) != 0) {
+      KALDI_WARN << "Duplicate key " << key << " in feature-store index "
+                 << PrintableRxfilename(index_rxfilename);
+      Close();
+      return false;
+    }
+    keys_.push_back(key);
+    utt_info_[key] = info;
+  }
+  is_open_ = true;
+  return true;
+}
+
+void FeatureStoreReader::Close() {
+  for (size_t i = 0; i < data_streams_.size(); i++)
+    delete data_streams_[i];
+  data_streams_.clear();
+  data_filenames_.clear();
+  utt_info_.clear();
+  keys_.clear();
+  is_open_ = false;
+}
+
+bool FeatureStoreReader::HasKey(const std::string &key) const {
+  return utt_info_.count(key) != 0;
+}
+
+const FeatureStoreReader::UttInfo &FeatureStoreReader::GetInfo(
+    const std::string &key) const {
+  unordered_map<std::string, UttInfo, StringHasher>::const_iterator iter =
+      utt_info_.find(key);
+  if (iter == utt_info_.end())
+    KALDI_ERR << "No such key " << key << " in feature store.";
+  return iter->second;
+}
+
+int32 FeatureStoreReader::NumFrames(const std::string &key) const {
+  return GetInfo(key).num_rows;
+}
+
+int32 FeatureStoreReader::Dim(const std::string &key) const {
+  return GetInfo(key).num_cols;
+}
+
+std::istream &FeatureStoreReader::SeekData(int32 file_index, int64 offset) {
+  std::ifstream *&is = data_streams_[file_index];
+  if (is == NULL) {
+    is = new std::ifstream(data_filenames_[file_index].c_str(),
+                           std::ios_base::in | std::ios_base::binary);
+    if (!is->is_open())
+      KALDI_ERR << "Error opening feature-store data file "
+                << data_filenames_[file_index];
+  }
+  is->clear();
+  is->seekg(offset, std::ios_base::beg);
+  if (!is->good())
+    KALDI_ERR << "Error seeking to offset " << offset << " in feature-store "
+              << "data file " << data_filenames_[file_index];
+  return *is;
+}
+
+void FeatureStoreReader::ReadChunkRows(std::istream &is, int32 row_begin,
+                                       SubMatrix<BaseFloat> *dest) {
+  // Compressed chunks start with a token such as "CM", "CM2" or "CM3";
+  // uncompressed ones with "FM" or "DM".
+  if (is.peek() == 'C') {
+    CompressedMatrix cmat;
+    cmat.Read(is, true);
+    KALDI_ASSERT(row_begin + dest->NumRows() <= cmat.NumRows() &&
+                 dest->NumCols() == cmat.NumCols());
+    // Only decompresses the rows we need.
+    cmat.CopyToMat(row_begin, 0, dest);
+  } else {
+    Matrix<BaseFloat> chunk;
+    chunk.Read(is, true);
+    KALDI_ASSERT(row_begin + dest->NumRows() <= chunk.NumRows() &&
+                 dest->NumCols() == chunk.NumCols());
+    dest->CopyFromMat(chunk.RowRange(row_begin, dest->NumRows()));
+  }
+}
+
+void FeatureStoreReader::ReadFrames(const std::string &key,
+                                    int32 t0, int32 t1,
+                                    Matrix<BaseFloat> *frames) {
+  const UttInfo &info = GetInfo(key);
+  if (!(t0 >= 0 && t0 <= t1 && t1 <= info.num_rows))
+    KALDI_ERR << "Invalid frame range [" << t0 << ", " << t1 << ") for "
+              << "utterance " << key << " with " << info.num_rows
+              << " frames.";
+  if (t1 == t0) {
+    frames->Resize(0, 0);  // Kaldi matrices with no rows have no columns.
+    return;
+  }
+  frames->Resize(t1 - t0, info.num_cols, kUndefined);
+  int32 chunk_size = info.chunk_size;
+  for (int32 t = t0; t < t1; ) {
+    int32 c = t / chunk_size, chunk_begin = c * chunk_size,
+        chunk_end = std::min(chunk_begin + chunk_size, info.num_rows),
+        end = std::min(chunk_end, t1);
+    SubMatrix<BaseFloat> dest(*frames, t - t0, end - t, 0, info.num_cols);
+    std::istream &is = SeekData(info.file_index, info.offsets[c]);
+    try {
+      ReadChunkRows(is, t - chunk_begin, &dest);
+    } catch (const std::exception &e) {
+      KALDI_ERR << "Error reading chunk " << c << " of utterance " << key
+                << " from feature store "
+                << data_filenames_[info.file_index] << ": " << e.what();
+    }
+    t = end;
+  }
+}
+
+}  // end namespace kaldi
@@ -0,0 +1,198 @@
+// util/feature-store.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_FEATURE_STORE_H_
+#define KALDI_UTIL_FEATURE_STORE_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/compressed-matrix.h"
+#include "matrix/sparse-matrix.h"
+#include "util/kaldi-io.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+// A "feature store" is a way of storing per-utterance feature matrices so that
+// an arbitrary range of frames [t0, t1) of any utterance can be read without
+// reading (or decompressing) the whole matrix.  It consists of two files:
+//
+//  - a data file, which must be an actual file on disk (not a pipe) because
+//    we seek in it.  After the binary-mode header it contains a sequence of
+//    "chunks", each of which is the binary Write() output of either a
+//    Matrix<BaseFloat> or a CompressedMatrix, holding a block of at most
+//    'chunk-size' consecutive frames of one utterance.
+//  - an index file, which is a text file with one line per utterance:
+//       key data-filename num-rows num-cols chunk-size offset1 offset2 ...
+//    where offset_i is the byte offset of the i'th chunk in the data file.
+//    Like scp files, index files can simply be concatenated, e.g. to combine
+//    the output of parallel jobs.
+//
+// Feature stores are also accessible through the Table code: the rspecifier
+// "fstore:foo.fsidx" reads the utterances listed in an index file (random
+// access also takes frame ranges, e.g. the key "utt1[100:199]"), and the
+// wspecifier "fstore:foo.fstore,foo.fsidx" writes them.  When writing through
+// a table, the chunk size is set by the "chunk=N" option of the wspecifier and
+// the chunks are compressed if the wspecifier has the "compress" option or
+// the object being written is compressed (e.g. copy-feats --compress=true); in
+// the latter case the compressed data is split into chunks without being
+// re-compressed.
+
+struct FeatureStoreWriterOptions {
+  int32 chunk_size;
+  bool compress;
+  CompressionMethod compression_method;
+  FeatureStoreWriterOptions(): chunk_size(100), compress(false),
+                               compression_method(kAutomaticMethod) { }
+
+  template<class OptionsItf>
+  void Register(OptionsItf *opts) {
+    opts->Register("chunk-size", &chunk_size, "Number of frames per chunk in "
+                   "the feature store; reads of frame ranges are done at this "
+                   "granularity.");
+    opts->Register("compress", &compress, "If true, compress the chunks "
+                   "(lossy).");
+  }
+};
+
+
+/// FeatureStoreWriter writes utterances to the data file of a feature store
+/// and the corresponding lines to its index file.
+class FeatureStoreWriter {
+ public:
+  explicit FeatureStoreWriter(const FeatureStoreWriterOptions &opts):
+      opts_(opts) { }
+
+  /// 'data_filename' must be an actual filename (we need its byte offsets);
+  /// 'index_wxfilename' may be any wxfilename, e.g. a pipe.  Returns false
+  /// on error.
+  bool Open(const std::string &data_filename,
+            const std::string &index_wxfilename);
+
+  bool IsOpen() { return data_output_.IsOpen(); }
+
+  /// Writes a matrix, compressing the chunks if opts_.compress is true.
+  bool Write(const std::string &key, const MatrixBase<BaseFloat> &feats);
+
+  /// Writes a matrix that is already compressed; the chunks are extracted
+  /// from it without re-compression.
+  bool Write(const std::string &key, const CompressedMatrix &feats);
+
+  /// Writes a GeneralMatrix, which must not be sparse: compressed input gives
+  /// compressed chunks, full input gives uncompressed chunks (whatever the
+  /// value of opts_.compress).
+  bool Write(const std::string &key, const GeneralMatrix &feats);
+
+  /// Returns false if there was any write error.
+  bool Close();
+
+  ~FeatureStoreWriter();
+
+ private:
+  // Writes the index line for an utterance whose chunks have just been
+  // written, at the offsets in 'offsets'.
+  bool WriteIndexLine(const std::string &key, int32 num_rows, int32 num_cols,
+                      const std::vector<int64> &offsets);
+
+  FeatureStoreWriterOptions opts_;
+  std::string data_filename_;
+  Output data_output_;
+  Output index_output_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureStoreWriter);
+};
+
+
+/// FeatureStoreReader gives random access, by key and frame range, to the
+/// utterances listed in the index file(s) of a feature store.  It reads the
+/// index fully in Open(), but data is only read on demand.  It is not
+/// thread-safe; use one reader per thread.
+class FeatureStoreReader {
+ public:
+  FeatureStoreReader(): is_open_(false) { }
+
+  /// Reads the index file; returns false on error.
+  bool Open(const std::string &index_rxfilename);
+
+  bool IsOpen() const { return is_open_; }
+
+  void Close();
+
+  /// Returns the keys in the order in which they appeared in the index.
+  const std::vector<std::string> &Keys() const { return keys_; }
+
+  bool HasKey(const std::string &key) const;
+
+  /// Returns the number of frames of this utterance; it is an error if the
+  /// key is not present.
+  int32 NumFrames(const std::string &key) const;
+
+  /// Returns the feature dimension of this utterance.
+  int32 Dim(const std::string &key) const;
+
+  /// Reads frames [t0, t1) of utterance 'key' into 'frames', which is resized.
+  /// Only the chunks that overlap the range are read.  Requires
+  /// 0 <= t0 <= t1 <= NumFrames(key).  Throws on error.
+  void ReadFrames(const std::string &key, int32 t0, int32 t1,
+                  Matrix<BaseFloat> *frames);
+
+  /// Reads the whole matrix for utterance 'key'; throws on error.
+  void Read(const std::string &key, Matrix<BaseFloat> *feats) {
+    ReadFrames(key, 0, NumFrames(key), feats);
+  }
+
+  ~FeatureStoreReader() { Close(); }
+
+ private:
+  struct UttInfo {
+    int32 file_index;  // index into data_filenames_.
+    int32 num_rows;
+    int32 num_cols;
+    int32 chunk_size;
+    std::vector<int64> offsets;  // byte offsets of the chunks.
+  };
+
+  const UttInfo &GetInfo(const std::string &key) const;
+
+  // Returns a stream positioned at byte 'offset' of data file 'file_index',
+  // opening the file if needed.
+  std::istream &SeekData(int32 file_index, int64 offset);
+
+  // Copies rows [row_begin, row_begin + dest->NumRows()) of the chunk that
+  // starts at the current position of 'is' into 'dest'.
+  void ReadChunkRows(std::istream &is, int32 row_begin,
+                     SubMatrix<BaseFloat> *dest);
+
+  bool is_open_;
+  std::vector<std::string> keys_;
+  unordered_map<std::string, UttInfo, StringHasher> utt_info_;
+  std::vector<std::string> data_filenames_;
+  // data_streams_[i] is NULL until data_filenames_[i] is first read.
+  std::vector<std::ifstream*> data_streams_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeatureStoreReader);
+};
+
+/// @} end "addtogroup table_group"
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_FEATURE_STORE_H_
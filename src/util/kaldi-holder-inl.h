@@ -103,6 +103,15 @@ template<class KaldiType> class KaldiObjectHolder {
     std::swap(t_, other->t_);
   }
 
+  // Replaces the held object with a default-constructed one and returns it,
+  // so it can be filled in place (the feature-store readers use this to avoid
+  // going through the binary format).
+  T &New() {
+    delete t_;
+    t_ = new T;
+    return *t_;
+  }
+
   bool ExtractRange(const KaldiObjectHolder<T> &other,
                     const std::string &range) {
     KALDI_ASSERT(other.t_ != NULL);
@@ -277,21 +286,21 @@ template<class BasicType> class BasicVectorHolder {
             (is.eof() ? "[eof]" : "");
         return false;  // probably eof.  fail in any case.
       }
-      std::istringstream line_is(line);
-      try {
-        while (1) {
-          line_is >> std::ws;  // eat up whitespace.
-          if (line_is.eof()) break;
-          BasicType bt;
-          ReadBasicType(line_is, false, &bt);
-          t_.push_back(bt);
+      // We parse the line in memory rather than via an istringstream, as
+      // this is much faster.
+      const char *c = line.c_str();
+      while (1) {
+        while (isspace(static_cast<unsigned char>(*c))) c++;
+        if (*c == '\0') break;
+        BasicType bt;
+        if (!ParseBasicTypeFromText(&c, &bt)) {
+          KALDI_WARN << "BasicVectorHolder::Read, could not interpret line: "
+                     << "'" << line << "'";
+          return false;
         }
-        return true;
-      } catch(const std::exception &e) {
-        KALDI_WARN << "BasicVectorHolder::Read, could not interpret line: "
-                   << "'" << line << "'" << "\n" << e.what();
-        return false;
+        t_.push_back(bt);
       }
+      return true;
     } else {  // binary mode.
       size_t filepos = is.tellg();
       try {
@@ -404,37 +413,38 @@ template<class BasicType> class BasicVectorVectorHolder {
       return false;
     }
     if (!is_binary) {
-      // In text mode, we terminate with newline.
-      try {  // catching errors from ReadBasicType..
-        std::vector<BasicType> v;  // temporary vector
-        while (1) {
-          int i = is.peek();
-          if (i == -1) {
-            KALDI_WARN << "Unexpected EOF";
+      // In text mode, we terminate with newline.  We read the line and then
+      // parse it in memory, which is much faster than reading from the stream
+      // one token at a time.
+      std::string line;
+      getline(is, line);  // this will discard the \n, if present.
+      if (is.fail() || is.eof()) {
+        KALDI_WARN << "Unexpected EOF";
+        return false;
+      }
+      std::vector<BasicType> v;  // temporary vector
+      const char *c = line.c_str();
+      while (1) {
+        while (isspace(static_cast<unsigned char>(*c))) c++;
+        if (*c == '\0') {
+          if (!v.empty()) {
+            KALDI_WARN << "No semicolon before newline (wrong format)";
+            return false;
+          }
+          return true;
+        } else if (*c == ';') {
+          t_.push_back(v);
+          v.clear();
+          c++;
+        } else {  // some object we want to read...
+          BasicType b;
+          if (!ParseBasicTypeFromText(&c, &b)) {
+            KALDI_WARN << "BasicVectorVectorHolder::Read, could not interpret "
+                       << "line: '" << line << "'";
             return false;
-          } else if (static_cast<char>(i) == '\n') {
-            if (!v.empty()) {
-              KALDI_WARN << "No semicolon before newline (wrong format)";
-              return false;
-            } else {
-              is.get();
-              return true;
-            }
-          } else if (std::isspace(i)) {
-            is.get();
-          } else if (static_cast<char>(i) == ';') {
-            t_.push_back(v);
-            v.clear();
-            is.get();
-          } else {  // some object we want to read...
-            BasicType b;
-            ReadBasicType(is, false, &b);  // throws on error.
-            v.push_back(b);
           }
+          v.push_back(b);
         }
-      } catch(const std::exception &e) {
-        KALDI_WARN << "BasicVectorVectorHolder::Read, read error. " << e.what();
-        return false;
       }
     } else {  // binary mode.
       size_t filepos = is.tellg();
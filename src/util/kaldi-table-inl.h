@@ -24,6 +24,9 @@
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <utility>
@@ -34,6 +37,7 @@
 #include "util/text-utils.h"
 #include "util/stl-utils.h"  // for StringHasher.
 #include "util/kaldi-semaphore.h"
+#include "util/feature-store.h"
 
 
 namespace kaldi {
@@ -41,6 +45,126 @@ namespace kaldi {
 /// \addtogroup table_impl_types
 /// @{
 
+// The feature-store implementations below (fstore: rspecifiers and
+// wspecifiers) deal in matrices, while the Holder may hold any matrix type
+// (Matrix<float>, Matrix<double>, CompressedMatrix, GeneralMatrix...).  The
+// functions below convert between the two: the matrix types are copied (or
+// swapped) directly, any other type goes by way of the Kaldi binary format,
+// which all the matrix types can read (and which fails for other types).
+
+// Moves the frames in 'mat' into 'holder'; 'mat' is left in an undefined
+// state.
+template<class Holder>
+bool FeatureStoreMatrixToHolder(Matrix<BaseFloat> *mat, Holder *holder) {
+  std::ostringstream os;
+  InitKaldiOutputStream(os, true);
+  mat->Write(os, true);
+  std::istringstream is(os.str());
+  return holder->Read(is);
+}
+
+inline bool FeatureStoreMatrixToHolder(
+    Matrix<BaseFloat> *mat, KaldiObjectHolder<Matrix<BaseFloat> > *holder) {
+  holder->New().Swap(mat);
+  return true;
+}
+
+template<class Real>
+bool FeatureStoreMatrixToHolder(Matrix<BaseFloat> *mat,
+                                KaldiObjectHolder<Matrix<Real> > *holder) {
+  Matrix<Real> &value = holder->New();
+  value.Resize(mat->NumRows(), mat->NumCols(), kUndefined);
+  value.CopyFromMat(*mat);
+  return true;
+}
+
+inline bool FeatureStoreMatrixToHolder(
+    Matrix<BaseFloat> *mat, KaldiObjectHolder<CompressedMatrix> *holder) {
+  holder->New().CopyFromMat(*mat);
+  return true;
+}
+
+inline bool FeatureStoreMatrixToHolder(
+    Matrix<BaseFloat> *mat, KaldiObjectHolder<GeneralMatrix> *holder) {
+  holder->New().SwapFullMatrix(mat);
+  return true;
+}
+
+
+inline bool FeatureStoreWriteMatrix(FeatureStoreWriter *writer,
+                                    const std::string &key,
+                                    const MatrixBase<BaseFloat> &value) {
+  return writer->Write(key, value);
+}
+
+template<class Real>
+bool FeatureStoreWriteMatrix(FeatureStoreWriter *writer,
+                             const std::string &key,
+                             const MatrixBase<Real> &value) {
+  Matrix<BaseFloat> mat(value);
+  return writer->Write(key, mat);
+}
+
+// Writes 'value' to the feature store; full matrices are compressed iff the
+// writer was opened with the 'compress' option, compressed ones are split
+// into chunks without re-compression.
+template<class Holder>
+bool FeatureStoreWrite(FeatureStoreWriter *writer, const std::string &key,
+                       const typename Holder::T &value) {
+  std::ostringstream os;
+  if (!Holder::Write(os, true, value))
+    return false;
+  std::istringstream is(os.str());
+  bool binary;
+  if (!InitKaldiInputStream(is, &binary))
+    return false;
+  GeneralMatrix mat;
+  try {
+    mat.Read(is, binary);
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Object cannot be written to a feature store (only "
+               << "matrices can): " << e.what();
+    return false;
+  }
+  return writer->Write(key, mat);
+}
+
+template<>
+inline bool FeatureStoreWrite<KaldiObjectHolder<Matrix<float> > >(
+    FeatureStoreWriter *writer, const std::string &key,
+    const Matrix<float> &value) {
+  return FeatureStoreWriteMatrix(writer, key, value);
+}
+
+template<>
+inline bool FeatureStoreWrite<KaldiObjectHolder<Matrix<double> > >(
+    FeatureStoreWriter *writer, const std::string &key,
+    const Matrix<double> &value) {
+  return FeatureStoreWriteMatrix(writer, key, value);
+}
+
+template<>
+inline bool FeatureStoreWrite<KaldiObjectHolder<CompressedMatrix> >(
+    FeatureStoreWriter *writer, const std::string &key,
+    const CompressedMatrix &value) {
+  return writer->Write(key, value);
+}
+
+template<>
+inline bool FeatureStoreWrite<KaldiObjectHolder<GeneralMatrix> >(
+    FeatureStoreWriter *writer, const std::string &key,
+    const GeneralMatrix &value) {
+  switch (value.Type()) {
+    case kCompressedMatrix:
+      return writer->Write(key, value.GetCompressedMatrix());
+    case kFullMatrix:
+      return writer->Write(key, value.GetFullMatrix());
+    default:
+      KALDI_WARN << "Sparse matrices cannot be written to a feature store.";
+      return false;
+  }
+}
+
 template<class Holder> class SequentialTableReaderImplBase {
  public:
   typedef typename Holder::T T;
@@ -696,6 +820,114 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
   } state_;
 };
 
+// This is the implementation for SequentialTableReader when it's a feature
+// store (fstore:), see feature-store.h.  The utterances are read in the order
+// of the index file.
+template<class Holder>  class SequentialTableReaderFeatureStoreImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  SequentialTableReaderFeatureStoreImpl(): key_index_(0), have_object_(false),
+                                           error_(false) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    rspecifier_ = rspecifier;
+    std::string index_rxfilename;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &index_rxfilename,
+                                           &opts_);
+    KALDI_ASSERT(rs == kFeatureStoreRspecifier);
+    if (!reader_.Open(index_rxfilename))
+      return false;
+    key_index_ = 0;
+    have_object_ = false;
+    error_ = false;
+    if (opts_.permissive)
+      SkipUnreadable();
+    return true;
+  }
+
+  virtual bool Done() const {
+    return key_index_ >= reader_.Keys().size();
+  }
+
+  virtual bool IsOpen() const { return reader_.IsOpen(); }
+
+  virtual std::string Key() {
+    if (Done())
+      KALDI_ERR << "Key() called at the wrong time.";
+    return reader_.Keys()[key_index_];
+  }
+
+  virtual T &Value() {
+    if (Done())
+      KALDI_ERR << "Value() called at the wrong time.";
+    if (!have_object_ && !LoadObject()) {
+      error_ = true;
+      KALDI_ERR << "Failed to load object for key " << Key()
+                << " from feature store: rspecifier is " << rspecifier_;
+    }
+    return holder_.Value();
+  }
+
+  virtual void FreeCurrent() {
+    holder_.Clear();
+    have_object_ = false;
+  }
+
+  virtual void SwapHolder(Holder *other_holder) {
+    Value();  // make sure the object is loaded.
+    holder_.Swap(other_holder);
+    have_object_ = false;
+  }
+
+  virtual void Next() {
+    if (Done())
+      KALDI_ERR << "Next() called at the wrong time.";
+    FreeCurrent();
+    key_index_++;
+    if (opts_.permissive)
+      SkipUnreadable();
+  }
+
+  virtual bool Close() {
+    FreeCurrent();
+    reader_.Close();
+    return !error_;
+  }
+
+  virtual ~SequentialTableReaderFeatureStoreImpl() { }
+
+ private:
+  // Loads the current object into holder_; returns false on failure.
+  bool LoadObject() {
+    try {
+      reader_.Read(reader_.Keys()[key_index_], &mat_);
+    } catch (const std::exception &e) {
+      if (!opts_.permissive)
+        KALDI_WARN << e.what();
+      return false;
+    }
+    have_object_ = FeatureStoreMatrixToHolder(&mat_, &holder_);
+    return have_object_;
+  }
+
+  // In permissive mode, skips over keys whose data cannot be read.
+  void SkipUnreadable() {
+    while (!Done() && !LoadObject())
+      key_index_++;
+  }
+
+  FeatureStoreReader reader_;
+  size_t key_index_;
+  Matrix<BaseFloat> mat_;
+  Holder holder_;
+  bool have_object_;
+  bool error_;
+  std::string rspecifier_;
+  RspecifierOptions opts_;
+};
+
 // this is for when someone adds the 'th' modifier; it wraps around the basic
 // implementation and allows it to do the reading in a background thread.
 template<class Holder>
@@ -853,6 +1085,255 @@ class SequentialTableReaderBackgroundImpl:
 
 };
 
+// This is the implementation for SequentialTableReader when it's a sharded
+// rspecifier ("shards:"), e.g. "shards:scp:feats.{1..64}.scp".  Each shard is
+// read by an ordinary sequential-reader implementation in its own background
+// thread, which reads ahead up to kMaxQueueSize objects.  Without the "det"
+// modifier we return whichever object is ready first (visiting the shards in
+// round-robin order when several are ready); with it, we return all of shard
+// 1, then all of shard 2, and so on.
+template<class Holder>
+class SequentialTableReaderShardedImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  SequentialTableReaderShardedImpl(): current_shard_(0), num_queued_(0),
+                                      num_finished_(0), closing_(false),
+                                      done_(true) {
+    current_.holder = NULL;
+  }
+
+  virtual bool Open(const std::string &rspecifier) {
+    std::string pattern;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &pattern, &opts_);
+    KALDI_ASSERT(rs == kShardedRspecifier);
+    std::vector<std::string> shard_rspecifiers;
+    if (!ExpandShardedRspecifier(pattern, &shard_rspecifiers)) {
+      KALDI_WARN << "Invalid sharded rspecifier " << rspecifier
+                 << " (expected exactly one range like {1..10})";
+      return false;
+    }
+    for (size_t i = 0; i < shard_rspecifiers.size(); i++) {
+      const std::string &shard_rspecifier = shard_rspecifiers[i];
+      SequentialTableReaderImplBase<Holder> *reader = NULL;
+      switch (ClassifyRspecifier(shard_rspecifier, NULL, NULL)) {
+        case kArchiveRspecifier:
+          reader = new SequentialTableReaderArchiveImpl<Holder>();
+          break;
+        case kScriptRspecifier:
+          reader = new SequentialTableReaderScriptImpl<Holder>();
+          break;
+        case kFeatureStoreRspecifier:
+          reader = new SequentialTableReaderFeatureStoreImpl<Holder>();
+          break;
+        default:
+          KALDI_WARN << "Invalid rspecifier " << shard_rspecifier
+                     << " in sharded rspecifier " << rspecifier;
+      }
+      if (reader != NULL && !reader->Open(shard_rspecifier)) {
+        delete reader;
+        reader = NULL;
+      }
+      if (reader == NULL) {
+        Close();
+        return false;
+      }
+      shards_.push_back(new Shard(reader));
+    }
+    for (size_t i = 0; i < shards_.size(); i++)
+      shards_[i]->thread = std::thread(
+          SequentialTableReaderShardedImpl<Holder>::run, this, shards_[i]);
+    done_ = false;
+    Next();
+    return true;
+  }
+
+  virtual bool IsOpen() const { return !shards_.empty(); }
+
+  virtual bool Done() const { return done_; }
+
+  virtual std::string Key() {
+    if (done_)
+      KALDI_ERR << "Key() called at the wrong time.";
+    return current_.key;
+  }
+
+  virtual T &Value() {
+    if (done_)
+      KALDI_ERR << "Value() called at the wrong time.";
+    if (current_.holder == NULL)
+      KALDI_ERR << "Error reading object for key " << current_.key
+                << " in sharded reader: " << current_.error;
+    return current_.holder->Value();
+  }
+
+  virtual void FreeCurrent() {
+    if (done_)
+      KALDI_ERR << "FreeCurrent() called at the wrong time.";
+    if (current_.holder != NULL)
+      current_.holder->Clear();
+  }
+
+  virtual void SwapHolder(Holder *other_holder) {
+    Value();  // dies if the object could not be read.
+    current_.holder->Swap(other_holder);
+  }
+
+  virtual void Next() {
+    if (done_)
+      KALDI_ERR << "Next() called at the wrong time.";
+    delete current_.holder;
+    current_.holder = NULL;
+    std::unique_lock<std::mutex> lock(mutex_);
+    Shard *shard = NULL;
+    if (opts_.deterministic) {
+      for (; current_shard_ < shards_.size(); current_shard_++) {
+        Shard *s = shards_[current_shard_];
+        item_ready_.wait(lock, [s] { return !s->queue.empty() ||
+                                            s->finished; });
+        if (!s->queue.empty()) {
+          shard = s;
+          break;
+        }
+      }
+    } else {
+      item_ready_.wait(lock, [this] {
+          return num_queued_ > 0 || num_finished_ == shards_.size(); });
+      for (size_t i = 0; num_queued_ > 0 && i < shards_.size(); i++) {
+        size_t s = (current_shard_ + i) % shards_.size();
+        if (!shards_[s]->queue.empty()) {
+          shard = shards_[s];
+          current_shard_ = (s + 1) % shards_.size();
+          break;
+        }
+      }
+    }
+    if (shard == NULL) {
+      done_ = true;
+      return;
+    }
+    current_ = shard->queue.front();
+    shard->queue.pop_front();
+    num_queued_--;
+    shard->not_full.notify_one();
+  }
+
+  virtual bool Close() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      closing_ = true;
+      for (size_t i = 0; i < shards_.size(); i++)
+        shards_[i]->not_full.notify_one();
+    }
+    bool ans = true;
+    for (size_t i = 0; i < shards_.size(); i++) {
+      Shard *shard = shards_[i];
+      if (shard->thread.joinable())
+        shard->thread.join();
+      for (size_t j = 0; j < shard->queue.size(); j++)
+        delete shard->queue[j].holder;
+      ans = !shard->error && ans;
+      try {
+        ans = shard->reader->Close() && ans;
+      } catch (...) {
+        ans = false;
+      }
+      delete shard->reader;
+      delete shard;
+    }
+    shards_.clear();
+    delete current_.holder;
+    current_.holder = NULL;
+    done_ = true;
+    return ans;
+  }
+
+  virtual ~SequentialTableReaderShardedImpl() {
+    if (IsOpen() && !Close())
+      KALDI_ERR << "Error detected closing sharded reader (shards: "
+                << "rspecifier)";
+  }
+
+ private:
+  struct Item {
+    std::string key;
+    Holder *holder;  // NULL if the object could not be read.
+    std::string error;  // the error message, if holder is NULL.
+  };
+  struct Shard {
+    explicit Shard(SequentialTableReaderImplBase<Holder> *r):
+        reader(r), finished(false), error(false) { }
+    // Only accessed by this shard's thread until the thread is joined.
+    SequentialTableReaderImplBase<Holder> *reader;
+    std::thread thread;
+    // The members below are protected by mutex_.
+    std::deque<Item> queue;
+    std::condition_variable not_full;
+    bool finished;  // set when the thread has queued its last object.
+    bool error;  // true if we failed to read an object.
+  };
+
+  void RunShard(Shard *shard) {
+    SequentialTableReaderImplBase<Holder> *reader = shard->reader;
+    bool error = false;
+    while (!error) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        shard->not_full.wait(lock, [this, shard] {
+            return closing_ || shard->queue.size() < kMaxQueueSize; });
+        if (closing_)
+          break;
+      }
+      if (reader->Done())
+        break;
+      Item item;
+      item.key = reader->Key();
+      item.holder = new Holder;
+      try {
+        reader->SwapHolder(item.holder);
+        reader->Next();
+      } catch (const std::exception &e) {
+        // We don't know what state the reader is in, so we stop reading this
+        // shard; the error is reported when the user asks for this object.
+        delete item.holder;
+        item.holder = NULL;
+        item.error = e.what();
+        error = true;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      shard->queue.push_back(item);
+      shard->error = error;
+      num_queued_++;
+      item_ready_.notify_one();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    shard->finished = true;
+    num_finished_++;
+    item_ready_.notify_one();
+  }
+  static void run(SequentialTableReaderShardedImpl<Holder> *object,
+                  Shard *shard) {
+    object->RunShard(shard);
+  }
+
+  // The maximum number of objects each shard reads ahead.
+  static const size_t kMaxQueueSize = 4;
+
+  RspecifierOptions opts_;
+  std::vector<Shard*> shards_;
+  // In deterministic mode, the shard we are reading from; otherwise the shard
+  // we look at first in Next().
+  size_t current_shard_;
+  Item current_;
+  std::mutex mutex_;  // protects the variables below and the queues.
+  std::condition_variable item_ready_;
+  size_t num_queued_;  // total number of objects in the queues.
+  size_t num_finished_;  // number of shards whose threads have finished.
+  bool closing_;
+  bool done_;
+};
+
 template<class Holder>
 SequentialTableReader<Holder>::SequentialTableReader(const std::string
                                                      &rspecifier): impl_(NULL) {
@@ -876,6 +1357,12 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
     case kScriptRspecifier:
       impl_ = new SequentialTableReaderScriptImpl<Holder>();
       break;
+    case kFeatureStoreRspecifier:
+      impl_ = new SequentialTableReaderFeatureStoreImpl<Holder>();
+      break;
+    case kShardedRspecifier:
+      impl_ = new SequentialTableReaderShardedImpl<Holder>();
+      break;
     case kNoRspecifier: default:
       KALDI_WARN << "Invalid rspecifier " << rspecifier;
       return false;
@@ -1463,6 +1950,220 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
 };
 
 
+// This is for when someone adds the 'bg' modifier to a wspecifier; it wraps
+// around one of the basic implementations and does the writing (including the
+// serialization of the objects) in a background thread, so the calling thread
+// does not wait for the disk.  Write() makes a deep copy of the object (the
+// caller may modify or free it as soon as Write() returns), so each write
+// costs one copy of the object in time and memory, and up to kMaxQueueSize
+// copies may be waiting; it only blocks if the queue is full.  Errors from the
+// background thread are reported by the next call to Write() (including one
+// that was waiting for room in the queue) or by Close().
+template<class Holder>
+class TableWriterBackgroundImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  TableWriterBackgroundImpl(TableWriterImplBase<Holder> *base_writer):
+      base_writer_(base_writer), closing_(false), writing_(false),
+      error_(false) { }
+
+  // This function ignores the wspecifier argument; base_writer_ must already
+  // be open.  We use the same function signature as the regular Open(), for
+  // convenience.
+  virtual bool Open(const std::string &wspecifier) {
+    KALDI_ASSERT(base_writer_ != NULL && base_writer_->IsOpen());
+    thread_ = std::thread(TableWriterBackgroundImpl<Holder>::run, this);
+    return true;
+  }
+
+  virtual bool IsOpen() const { return base_writer_ != NULL; }
+
+  virtual bool Write(const std::string &key, const T &value) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (error_)
+        return false;  // the background thread will have printed a warning.
+    }
+    // The copy is made without holding the lock, so the background thread
+    // can keep writing meanwhile.
+    T *copy = new T(value);
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_not_full_.wait(lock, [this] {
+        return queue_.size() < kMaxQueueSize || error_; });
+    if (error_) {
+      // the background thread failed while we were waiting; the object would
+      // never be written.
+      delete copy;
+      return false;
+    }
+    queue_.push_back(std::pair<std::string, T*>(key, copy));
+    queue_not_empty_.notify_one();
+    return true;
+  }
+
+  // Waits until everything queued so far has been written, then flushes.
+  virtual void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_idle_.wait(lock, [this] { return queue_.empty() && !writing_; });
+    base_writer_->Flush();
+  }
+
+  virtual bool Close() {
+    KALDI_ASSERT(base_writer_ != NULL && thread_.joinable());
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      closing_ = true;
+      queue_not_empty_.notify_one();
+    }
+    thread_.join();
+    bool ans = !error_;
+    try {
+      ans = base_writer_->Close() && ans;
+    } catch (...) {
+      ans = false;
+    }
+    delete base_writer_;
+    base_writer_ = NULL;
+    return ans;
+  }
+
+  virtual ~TableWriterBackgroundImpl() {
+    if (base_writer_ != NULL && !Close())
+      KALDI_ERR << "Error detected closing background writer "
+                << "(relates to ',bg' modifier)";
+  }
+
+ private:
+  void RunInBackground() {
+    while (true) {
+      std::pair<std::string, T*> item;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_not_empty_.wait(lock, [this] {
+            return !queue_.empty() || closing_; });
+        if (queue_.empty())
+          return;  // closing_ is true and there is nothing left to write.
+        item = queue_.front();
+        queue_.pop_front();
+        writing_ = true;
+        queue_not_full_.notify_one();
+      }
+      bool ok;
+      try {
+        ok = base_writer_->Write(item.first, *item.second);
+      } catch (const std::exception &e) {
+        KALDI_WARN << "Exception writing key " << item.first
+                   << " in background writer: " << e.what();
+        ok = false;
+      }
+      delete item.second;
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!ok) {
+        error_ = true;
+        // Discard anything still queued; it will never be written.
+        for (size_t i = 0; i < queue_.size(); i++)
+          delete queue_[i].second;
+        queue_.clear();
+        queue_not_full_.notify_all();
+      }
+      writing_ = false;
+      if (queue_.empty())
+        queue_idle_.notify_all();
+    }
+  }
+  static void run(TableWriterBackgroundImpl<Holder> *object) {
+    object->RunInBackground();
+  }
+
+  // The maximum number of objects that can be waiting to be written; this
+  // bounds the extra memory used.
+  static const size_t kMaxQueueSize = 16;
+
+  TableWriterImplBase<Holder> *base_writer_;
+  std::deque<std::pair<std::string, T*> > queue_;
+  std::mutex mutex_;  // protects all the variables below, and queue_.
+  std::condition_variable queue_not_full_;
+  std::condition_variable queue_not_empty_;
+  std::condition_variable queue_idle_;
+  bool closing_;  // set by Close(); the thread exits when the queue is empty.
+  bool writing_;  // true while the background thread is writing an object.
+  bool error_;
+  std::thread thread_;
+};
+
+
+// The implementation of TableWriter we use when writing to a feature store
+// (fstore:), see feature-store.h.  Only matrix types can be written.  The
+// chunk size and compression come from the wspecifier, e.g.
+// "fstore,chunk=50,compress:foo.fstore,foo.fsidx".
+template<class Holder>
+class TableWriterFeatureStoreImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  TableWriterFeatureStoreImpl(): writer_(NULL), write_error_(false) { }
+
+  virtual bool Open(const std::string &wspecifier) {
+    wspecifier_ = wspecifier;
+    std::string data_filename, index_wxfilename;
+    WspecifierOptions opts;
+    WspecifierType ws = ClassifyWspecifier(wspecifier, &data_filename,
+                                           &index_wxfilename, &opts);
+    KALDI_ASSERT(ws == kFeatureStoreWspecifier);  // or wrongly called.
+    FeatureStoreWriterOptions store_opts;
+    if (opts.chunk_size > 0)
+      store_opts.chunk_size = opts.chunk_size;
+    store_opts.compress = opts.compress;
+    delete writer_;
+    writer_ = new FeatureStoreWriter(store_opts);
+    if (!writer_->Open(data_filename, index_wxfilename)) {
+      delete writer_;
+      writer_ = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  virtual bool IsOpen() const { return writer_ != NULL; }
+
+  virtual bool Write(const std::string &key, const T &value) {
+    if (!IsToken(key))
+      KALDI_ERR << "Using invalid key " << key;
+    if (!FeatureStoreWrite<Holder>(writer_, key, value)) {
+      KALDI_WARN << "Write failure to feature store: wspecifier is "
+                 << wspecifier_;
+      write_error_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  // The index is flushed when it is closed, so there is nothing to do here.
+  virtual void Flush() { }
+
+  virtual bool Close() {
+    if (writer_ == NULL)
+      return !write_error_;
+    bool ans = writer_->Close();
+    delete writer_;
+    writer_ = NULL;
+    return ans && !write_error_;
+  }
+
+  virtual ~TableWriterFeatureStoreImpl() {
+    if (IsOpen() && !Close())
+      KALDI_ERR << "Error closing feature store: wspecifier is "
+                << wspecifier_;
+  }
+
+ private:
+  FeatureStoreWriter *writer_;
+  std::string wspecifier_;
+  bool write_error_;
+};
+
+
 template<class Holder>
 TableWriter<Holder>::TableWriter(const std::string &wspecifier): impl_(NULL) {
   if (wspecifier != "" && !Open(wspecifier))
@@ -1483,7 +2184,8 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDI_ERR << "Failed to close previously open writer.";
   }
   KALDI_ASSERT(impl_ == NULL);
-  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, NULL);
+  WspecifierOptions opts;
+  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, &opts);
   switch (wtype) {
     case kBothWspecifier:
       impl_ = new TableWriterBothImpl<Holder>();
@@ -1494,17 +2196,26 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
     case kScriptWspecifier:
       impl_ = new TableWriterScriptImpl<Holder>();
       break;
+    case kFeatureStoreWspecifier:
+      impl_ = new TableWriterFeatureStoreImpl<Holder>();
+      break;
     case kNoWspecifier: default:
       KALDI_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
       return false;
   }
-  if (impl_->Open(wspecifier)) {
-    return true;
-  } else {  // The class will have printed a more specific warning.
+  if (!impl_->Open(wspecifier)) {
+    // The class will have printed a more specific warning.
     delete impl_;
     impl_ = NULL;
     return false;
   }
+  if (opts.background) {
+    impl_ = new TableWriterBackgroundImpl<Holder>(impl_);
+    // the wspecifier is ignored in that Open() call.
+    if (!impl_->Open(""))
+      return false;
+  }
+  return true;
 }
 
 template<class Holder>
@@ -2504,6 +3215,115 @@ class RandomAccessTableReaderUnsortedArchiveImpl:
 
 
 
+// The implementation of RandomAccessTableReader for a feature store
+// (fstore:), see feature-store.h.  The index is read in Open(); each Value()
+// reads just the chunks it needs, so there are no constraints on the order of
+// the calls.  Besides the keys of the index, it accepts keys with a range of
+// frames, as in scp files: "utt1[100:199]" gives frames 100 to 199 inclusive
+// of utt1, and only the chunks overlapping that range are read.
+template<class Holder>
+class RandomAccessTableReaderFeatureStoreImpl:
+    public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  virtual bool Open(const std::string &rspecifier) {
+    rspecifier_ = rspecifier;
+    std::string index_rxfilename;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &index_rxfilename,
+                                           &opts_);
+    KALDI_ASSERT(rs == kFeatureStoreRspecifier);
+    return reader_.Open(index_rxfilename);
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    std::string utt;
+    int32 t0, t1;
+    if (!ParseKey(key, &utt, &t0, &t1))
+      return false;
+    // In permissive mode, keys whose data cannot be read are treated as
+    // absent, which means we have to load the data here.
+    return !opts_.permissive || LoadObject(key);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (!LoadObject(key))
+      KALDI_ERR << "Failed to load object for key " << key
+                << " from feature store: rspecifier is " << rspecifier_;
+    return holder_.Value();
+  }
+
+  virtual bool Close() {
+    holder_.Clear();
+    current_key_ = "";
+    reader_.Close();
+    return true;
+  }
+
+  virtual ~RandomAccessTableReaderFeatureStoreImpl() { }
+
+ private:
+  // Splits a key such as "utt1" or "utt1[100:199]" into the utterance and the
+  // range [t0, t1) of frames; returns false if the utterance is not in the
+  // store or the range is not valid for it.
+  bool ParseKey(const std::string &key, std::string *utt,
+                int32 *t0, int32 *t1) const {
+    size_t pos = key.find('[');
+    if (pos == std::string::npos || key[key.size() - 1] != ']') {
+      if (!reader_.HasKey(key))
+        return false;
+      *utt = key;
+      *t0 = 0;
+      *t1 = reader_.NumFrames(key);
+      return true;
+    }
+    *utt = std::string(key, 0, pos);
+    if (!reader_.HasKey(*utt))
+      return false;
+    std::vector<int32> range;
+    std::string range_str(key, pos + 1, key.size() - pos - 2);
+    if (!SplitStringToIntegers(range_str, ":", false, &range) ||
+        range.size() != 2 || range[0] < 0 || range[1] < range[0] ||
+        range[1] >= reader_.NumFrames(*utt))
+      return false;
+    *t0 = range[0];
+    *t1 = range[1] + 1;
+    return true;
+  }
+
+  // Makes sure holder_ contains the object for 'key'; returns false on
+  // failure.
+  bool LoadObject(const std::string &key) {
+    if (key == current_key_)
+      return true;
+    holder_.Clear();
+    current_key_ = "";
+    std::string utt;
+    int32 t0, t1;
+    if (!ParseKey(key, &utt, &t0, &t1))
+      return false;
+    try {
+      reader_.ReadFrames(utt, t0, t1, &mat_);
+    } catch (const std::exception &e) {
+      if (!opts_.permissive)
+        KALDI_WARN << e.what();
+      return false;
+    }
+    if (!FeatureStoreMatrixToHolder(&mat_, &holder_))
+      return false;
+    current_key_ = key;
+    return true;
+  }
+
+  FeatureStoreReader reader_;
+  Matrix<BaseFloat> mat_;
+  Holder holder_;
+  std::string current_key_;  // key of the object in holder_, if any.
+  std::string rspecifier_;
+  RspecifierOptions opts_;
+};
+
+
 template<class Holder>
 RandomAccessTableReader<Holder>::RandomAccessTableReader(const
                                                        std::string &rspecifier):
@@ -2533,6 +3353,13 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
         impl_ = new RandomAccessTableReaderUnsortedArchiveImpl<Holder>();
       }
       break;
+    case kFeatureStoreRspecifier:
+      impl_ = new RandomAccessTableReaderFeatureStoreImpl<Holder>();
+      break;
+    case kShardedRspecifier:
+      KALDI_WARN << "Sharded rspecifiers cannot be used for random access: "
+                 << rspecifier;
+      return false;
     case kNoRspecifier: default:
       KALDI_WARN << "Invalid rspecifier: "
                  << rspecifier;
@@ -2662,6 +3489,113 @@ const typename Holder::T& RandomAccessTableReaderMapped<Holder>::Value(
 }
 
 
+template<class Holder>
+SequentialTableJoinReader<Holder>::SequentialTableJoinReader(
+    const std::vector<std::string> &rspecifiers) {
+  if (!Open(rspecifiers))
+    KALDI_ERR << "Error constructing SequentialTableJoinReader.";
+}
+
+template<class Holder>
+bool SequentialTableJoinReader<Holder>::Open(
+    const std::vector<std::string> &rspecifiers) {
+  if (IsOpen() && !Close())
+    KALDI_ERR << "Could not close previously open object.";
+  KALDI_ASSERT(!rspecifiers.empty());
+  for (size_t i = 0; i < rspecifiers.size(); i++) {
+    SequentialTableReader<Holder> *reader = new SequentialTableReader<Holder>;
+    readers_.push_back(reader);
+    if (!reader->Open(rspecifiers[i])) {
+      Close();
+      return false;  // the reader will have printed a warning.
+    }
+  }
+  rspecifiers_ = rspecifiers;
+  if (!readers_[0]->Done())
+    for (size_t i = 1; i < readers_.size(); i++)
+      Advance(i);
+  return true;
+}
+
+template<class Holder>
+bool SequentialTableJoinReader<Holder>::Done() {
+  KALDI_ASSERT(IsOpen());
+  return readers_[0]->Done();
+}
+
+template<class Holder>
+std::string SequentialTableJoinReader<Holder>::Key() {
+  KALDI_ASSERT(IsOpen());
+  return readers_[0]->Key();
+}
+
+template<class Holder>
+bool SequentialTableJoinReader<Holder>::HasKey(int32 i) {
+  KALDI_ASSERT(static_cast<size_t>(i) < readers_.size());
+  if (i == 0)
+    return !readers_[0]->Done();
+  return !readers_[i]->Done() && readers_[i]->Key() == readers_[0]->Key();
+}
+
+template<class Holder>
+typename Holder::T &SequentialTableJoinReader<Holder>::Value(int32 i) {
+  if (!HasKey(i))
+    KALDI_ERR << "Value() called for input " << i << " which does not have "
+              << "the current key (or at the wrong time).";
+  return readers_[i]->Value();
+}
+
+template<class Holder>
+void SequentialTableJoinReader<Holder>::Next() {
+  KALDI_ASSERT(IsOpen());
+  std::string prev_key = readers_[0]->Key();
+  readers_[0]->Next();
+  if (readers_[0]->Done())
+    return;
+  if (!(prev_key < readers_[0]->Key()))
+    KALDI_ERR << "Input " << rspecifiers_[0] << " is not sorted, or has "
+              << "duplicate keys: " << readers_[0]->Key() << " follows "
+              << prev_key << " (SequentialTableJoinReader requires sorted "
+              << "inputs).";
+  for (size_t i = 1; i < readers_.size(); i++)
+    Advance(i);
+}
+
+template<class Holder>
+void SequentialTableJoinReader<Holder>::Advance(int32 i) {
+  SequentialTableReader<Holder> *reader = readers_[i];
+  std::string key = readers_[0]->Key();
+  while (!reader->Done() && reader->Key() < key) {
+    std::string prev_key = reader->Key();
+    reader->Next();
+    if (!reader->Done() && !(prev_key < reader->Key()))
+      KALDI_ERR << "Input " << rspecifiers_[i] << " is not sorted, or has "
+                << "duplicate keys: " << reader->Key() << " follows "
+                << prev_key << " (SequentialTableJoinReader requires sorted "
+                << "inputs).";
+  }
+}
+
+template<class Holder>
+bool SequentialTableJoinReader<Holder>::Close() {
+  bool ans = true;
+  for (size_t i = 0; i < readers_.size(); i++) {
+    if (readers_[i]->IsOpen())
+      ans = readers_[i]->Close() && ans;
+    delete readers_[i];
+  }
+  readers_.clear();
+  rspecifiers_.clear();
+  return ans;
+}
+
+template<class Holder>
+SequentialTableJoinReader<Holder>::~SequentialTableJoinReader() {
+  if (IsOpen() && !Close())
+    KALDI_ERR << "Error closing SequentialTableJoinReader (call Close() "
+              << "yourself to avoid this exception).";
+}
+
 
 /// @}
 
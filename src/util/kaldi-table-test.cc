@@ -89,6 +89,15 @@ void UnitTestReadScriptFile() {
 
 
 void UnitTestClassifyWspecifier() {
+  {
+    std::string a = "ark,scp,bg:foo.ark,foo.scp";
+    std::string ark = "x", scp = "y";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kBothWspecifier && ark == "foo.ark" &&
+                 scp == "foo.scp" && opts.background == true);
+  }
+
   {
     std::string a = "b,ark:foo|";
     std::string ark = "x", scp = "y";
@@ -324,6 +333,36 @@ void UnitTestClassifyRspecifier() {
     RspecifierType ans = ClassifyRspecifier(a, &b, NULL);
     KALDI_ASSERT(ans == kArchiveRspecifier && b == "a");
   }
+  {
+    std::string a = "shards,det:scp,p:foo.{1..4}.scp", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kShardedRspecifier && b == "scp,p:foo.{1..4}.scp" &&
+                 opts.deterministic && !opts.permissive);
+  }
+  {
+    std::string a = "shards,ark:foo";
+    RspecifierType ans = ClassifyRspecifier(a, NULL, NULL);
+    KALDI_ASSERT(ans == kNoRspecifier);
+  }
+}
+
+void UnitTestExpandShardedRspecifier() {
+  std::vector<std::string> v;
+  KALDI_ASSERT(ExpandShardedRspecifier("scp:foo.{1..3}.scp", &v) &&
+               v.size() == 3 && v[0] == "scp:foo.1.scp" &&
+               v[2] == "scp:foo.3.scp");
+  KALDI_ASSERT(ExpandShardedRspecifier("ark:{08..10}/a.ark", &v) &&
+               v.size() == 3 && v[0] == "ark:08/a.ark" &&
+               v[1] == "ark:09/a.ark" && v[2] == "ark:10/a.ark");
+  KALDI_ASSERT(ExpandShardedRspecifier("ark:{5..5}", &v) &&
+               v.size() == 1 && v[0] == "ark:5");
+  KALDI_ASSERT(!ExpandShardedRspecifier("scp:foo.scp", &v));
+  KALDI_ASSERT(!ExpandShardedRspecifier("scp:foo.{3..1}", &v));
+  KALDI_ASSERT(!ExpandShardedRspecifier("scp:foo.{1..3", &v));
+  KALDI_ASSERT(!ExpandShardedRspecifier("scp:foo.{1,2}", &v));
+  KALDI_ASSERT(!ExpandShardedRspecifier("scp:{1..2}/{1..2}", &v));
+  KALDI_ASSERT(!ExpandShardedRspecifier("scp:foo.{-1..2}", &v));
 }
 
 void UnitTestTableSequentialInt32(bool binary) {
@@ -654,6 +693,190 @@ void UnitTestTableSequentialInt32Script(bool binary) {
   KALDI_ASSERT(v2 == v);
 }
 
+// Writing as both with the background writer, and reading as archive or
+// script.
+void UnitTestTableBackgroundWriter(bool binary, bool read_scp) {
+  // Write enough objects that the queue of the background writer fills up.
+  int32 sz = Rand() % 100;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    v[i].Resize(1 + Rand() % 50, 1 + Rand() % 10);
+    v[i].SetRandn();
+  }
+  {
+    BaseFloatMatrixWriter bw(binary ? "b,bg,ark,scp:tmpf,tmpf.scp" :
+                             "t,bg,ark,scp:tmpf,tmpf.scp");
+    for (int32 i = 0; i < sz; i++) {
+      bw.Write(k[i], v[i]);
+      // the writer made a copy, so changing the object must not matter.
+      Matrix<BaseFloat> tmp(v[i]);
+      v[i].SetZero();
+      v[i].Swap(&tmp);
+      if (i == sz / 2)
+        bw.Flush();
+    }
+    KALDI_ASSERT(bw.Close());
+  }
+  SequentialBaseFloatMatrixReader sbr(read_scp ? "scp:tmpf.scp" : "ark:tmpf");
+  int32 i = 0;
+  for (; !sbr.Done(); sbr.Next(), i++) {
+    KALDI_ASSERT(i < sz && sbr.Key() == k[i] &&
+                 sbr.Value().ApproxEqual(v[i], 1.0e-04));
+  }
+  KALDI_ASSERT(i == sz && sbr.Close());
+  unlink("tmpf");
+  unlink("tmpf.scp");
+
+  // A write error in the background thread makes a later Write() fail
+  // (also one waiting for room in the queue), and Close() too.
+  {
+    std::ofstream scp("tmpf.scp");
+    scp << "foo tmpf\n";  // the keys we write are not in the scp file.
+  }
+  BaseFloatMatrixWriter bw("bg,scp:tmpf.scp");
+  bool write_failed = false;
+  for (int32 n = 0; n < 100 && !write_failed; n++) {
+    try {
+      bw.Write("bar", Matrix<BaseFloat>(10, 10));
+    } catch (const std::exception &e) {
+      write_failed = true;
+    }
+  }
+  KALDI_ASSERT(write_failed && !bw.Close());
+  unlink("tmpf.scp");
+}
+
+void UnitTestTableSharded(bool binary, bool read_scp, bool deterministic) {
+  int32 num_shards = 1 + Rand() % 5;
+  std::vector<std::string> k;
+  std::vector<Vector<BaseFloat> > v;
+  for (int32 s = 1; s <= num_shards; s++) {
+    std::ostringstream wspecifier;
+    wspecifier << (binary ? "b" : "t") << ",ark,scp:tmpf." << s
+               << ",tmpf." << s << ".scp";
+    BaseFloatVectorWriter bw(wspecifier.str());
+    int32 sz = Rand() % 10;
+    for (int32 i = 0; i < sz; i++) {
+      std::ostringstream os;
+      os << "key" << s << "_" << i;
+      k.push_back(os.str());
+      v.push_back(Vector<BaseFloat>(1 + Rand() % 10));
+      v.back().SetRandn();
+      bw.Write(k.back(), v.back());
+    }
+  }
+  std::ostringstream rspecifier;
+  rspecifier << "shards" << (deterministic ? ",det" : "")
+             << (read_scp ? ":scp:tmpf.{1.." : ":ark:tmpf.{1..")
+             << num_shards << (read_scp ? "}.scp" : "}");
+  SequentialBaseFloatVectorReader sbr(rspecifier.str());
+  std::vector<bool> seen(k.size(), false);
+  size_t i = 0;
+  for (; !sbr.Done(); sbr.Next(), i++) {
+    size_t j = std::find(k.begin(), k.end(), sbr.Key()) - k.begin();
+    // In deterministic mode the order is that of the concatenated shards.
+    KALDI_ASSERT(j < k.size() && !seen[j] && (!deterministic || j == i) &&
+                 sbr.Value().ApproxEqual(v[j], 1.0e-04));
+    seen[j] = true;
+  }
+  KALDI_ASSERT(i == k.size() && sbr.Close());
+
+  // Check that we can close the reader before reading everything.
+  KALDI_ASSERT(sbr.Open(rspecifier.str()) && sbr.Close());
+
+  // A shard whose scp file points to a missing file: we get an error when
+  // reading that object.
+  if (read_scp && deterministic) {
+    {
+      Output ko("tmpf.1.scp", false);
+      ko.Stream() << "badkey tmpf.nonexistent\n";
+    }
+    KALDI_ASSERT(sbr.Open(rspecifier.str()) && !sbr.Done() &&
+                 sbr.Key() == "badkey");
+    bool threw = false;
+    try {
+      sbr.Value();
+    } catch (const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw && !sbr.Close());
+  }
+  KALDI_ASSERT(!sbr.Open("shards:scp:tmpf.nonexistent.{1..2}.scp"));
+  for (int32 s = 1; s <= num_shards; s++) {
+    std::ostringstream os;
+    os << "tmpf." << s;
+    unlink(os.str().c_str());
+    unlink((os.str() + ".scp").c_str());
+  }
+}
+
+void UnitTestTableJoinReader(bool binary) {
+  // Each of three inputs has a random subset of the (sorted) keys.
+  int32 num_keys = Rand() % 20, num_inputs = 3;
+  std::vector<std::vector<int32> > present(num_inputs,
+                                           std::vector<int32>(num_keys));
+  std::vector<std::string> rspecifiers;
+  for (int32 n = 0; n < num_inputs; n++) {
+    std::ostringstream os;
+    os << "tmpf." << n;
+    BaseFloatMatrixWriter bw((binary ? "b,ark:" : "t,ark:") + os.str());
+    for (int32 i = 0; i < num_keys; i++) {
+      present[n][i] = (Rand() % 3 != 0);
+      if (present[n][i]) {
+        std::ostringstream key;
+        key << "key" << (100 + i);
+        Matrix<BaseFloat> m(1, 1);
+        m(0, 0) = 10 * n + i;
+        bw.Write(key.str(), m);
+      }
+    }
+    rspecifiers.push_back("ark:" + os.str());
+  }
+  SequentialBaseFloatMatrixJoinReader reader(rspecifiers);
+  KALDI_ASSERT(reader.NumInputs() == num_inputs);
+  int32 i = 0;
+  for (; !reader.Done(); reader.Next(), i++) {
+    while (!present[0][i]) i++;
+    std::ostringstream key;
+    key << "key" << (100 + i);
+    KALDI_ASSERT(reader.Key() == key.str());
+    for (int32 n = 0; n < num_inputs; n++) {
+      KALDI_ASSERT(reader.HasKey(n) == static_cast<bool>(present[n][i]));
+      if (present[n][i])
+        KALDI_ASSERT(reader.Value(n)(0, 0) == 10 * n + i);
+    }
+  }
+  while (i < num_keys && !present[0][i]) i++;
+  KALDI_ASSERT(i == num_keys && reader.Close());
+
+  // Unsorted input: we should die when we detect it.
+  {
+    BaseFloatMatrixWriter bw("ark:tmpf.1");
+    Matrix<BaseFloat> m(1, 1);
+    bw.Write("b", m);
+    bw.Write("a", m);
+  }
+  std::vector<std::string> rspecifiers2(2);
+  rspecifiers2[0] = "ark:echo c [ 0 ] |";
+  rspecifiers2[1] = "ark:tmpf.1";
+  bool threw = false;
+  try {
+    SequentialBaseFloatMatrixJoinReader reader2(rspecifiers2);
+  } catch (const std::exception &e) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw);
+  for (int32 n = 0; n < num_inputs; n++) {
+    std::ostringstream os;
+    os << "tmpf." << n;
+    unlink(os.str().c_str());
+  }
+}
+
 // Writing as both and reading as archive.
 void UnitTestTableSequentialDoubleMatrixBoth(bool binary, bool read_scp) {
   int32 sz = Rand() % 10;
@@ -1059,6 +1282,7 @@ int main() {
   UnitTestReadScriptFile();
   UnitTestClassifyWspecifier();
   UnitTestClassifyRspecifier();
+  UnitTestExpandShardedRspecifier();
   for (int i = 0; i < 10; i++) {
     bool b = (i == 0);
     UnitTestTableSequentialBool(b);
@@ -1066,10 +1290,14 @@ int main() {
     UnitTestTableSequentialInt32Script(b);
     UnitTestTableSequentialDouble(b);
     UnitTestRangesMatrix(b);
+    UnitTestTableJoinReader(b);
     for (int j = 0; j < 2; j++) {
       bool c = (j == 0);
       UnitTestTableSequentialDoubleBoth(b, c);
       UnitTestTableSequentialDoubleMatrixBoth(b, c);
+      UnitTestTableBackgroundWriter(b, c);
+      UnitTestTableSharded(b, c, true);
+      UnitTestTableSharded(b, c, false);
       UnitTestTableSequentialInt32VectorBoth(b, c);
       UnitTestTableSequentialInt32PairVectorBoth(b, c);
       UnitTestTableSequentialInt32VectorVectorBoth(b, c);
@@ -148,6 +148,9 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   //  ark,scp,f:filename, wxfilename ->  kBothWspecifier
   // or:
   //  scp,t,nf:rxfilename -> kScriptWspecifier
+  //  ark,bg:wxfilename -> kArchiveWspecifier [written in background thread]
+  //  fstore:filename,wxfilename -> kFeatureStoreWspecifier
+  //  fstore,chunk=50,compress:filename,wxfilename -> kFeatureStoreWspecifier
 
   if (archive_wxfilename) archive_wxfilename->clear();
   if (script_wxfilename) script_wxfilename->clear();
@@ -164,6 +167,7 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   // don't omit empty strings between commas.
 
   WspecifierType ws = kNoWspecifier;
+  bool store_options = false;  // "chunk=N" or "compress", fstore only.
 
   if (opts != NULL)
     *opts = WspecifierOptions();  // Make sure all the defaults are as in the
@@ -183,6 +187,17 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strncmp(c, "chunk=", 6)) {
+      int32 chunk_size;
+      if (!ConvertStringToInteger(c + 6, &chunk_size) || chunk_size <= 0)
+        return kNoWspecifier;
+      if (opts) opts->chunk_size = chunk_size;
+      store_options = true;
+    } else if (!strcmp(c, "compress")) {
+      if (opts) opts->compress = true;
+      store_options = true;
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier) ws = kArchiveWspecifier;
       else
@@ -193,11 +208,18 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       else if (ws == kArchiveWspecifier) ws = kBothWspecifier;
       else
         return kNoWspecifier;  // repeated "scp" option: invalid.
+    } else if (!strcmp(c, "fstore")) {
+      if (ws == kNoWspecifier) ws = kFeatureStoreWspecifier;
+      else
+        return kNoWspecifier;  // cannot be combined with "ark" or "scp".
     } else {
       return kNoWspecifier;  // Could not interpret this option.
     }
   }
 
+  if (store_options && ws != kFeatureStoreWspecifier)
+    return kNoWspecifier;
+
   switch (ws) {
     case kArchiveWspecifier:
       if (archive_wxfilename)
@@ -207,7 +229,7 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (script_wxfilename)
         *script_wxfilename = after_colon;
       break;
-    case kBothWspecifier:
+    case kBothWspecifier: case kFeatureStoreWspecifier:
       pos = after_colon.find(',');  // first comma.
       if (pos == std::string::npos) return kNoWspecifier;
       if (archive_wxfilename)
@@ -228,6 +250,9 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
   // Examples
   // ark:rxfilename  ->  kArchiveRspecifier
   // scp:rxfilename  -> kScriptRspecifier
+  // fstore:rxfilename  -> kFeatureStoreRspecifier
+  // shards:scp:foo.{1..10}.scp  -> kShardedRspecifier [rxfilename is the
+  //                                 pattern "scp:foo.{1..10}.scp"]
   //
   // We also allow the meaningless prefixes b, and t,
   // plus the options o (once), no (not-once),
@@ -293,6 +318,8 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = false;
     } else if (!strcmp(c, "bg")) {
       if (opts) opts->background = true;
+    } else if (!strcmp(c, "det")) {
+      if (opts) opts->deterministic = true;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else
@@ -303,17 +330,57 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       else
         return kNoRspecifier;  // Repeated or combined ark and scp options
       // invalid.
+    } else if (!strcmp(c, "fstore")) {
+      if (rs == kNoRspecifier) rs = kFeatureStoreRspecifier;
+      else
+        return kNoRspecifier;
+    } else if (!strcmp(c, "shards")) {
+      if (rs == kNoRspecifier) rs = kShardedRspecifier;
+      else
+        return kNoRspecifier;
     } else {
       return kNoRspecifier;  // Could not interpret this option.
     }
   }
-  if ((rs == kArchiveRspecifier || rs == kScriptRspecifier)
-     && wxfilename != NULL)
+  if (rs != kNoRspecifier && wxfilename != NULL)
     *wxfilename = after_colon;
   return rs;
 }
 
 
+bool ExpandShardedRspecifier(const std::string &pattern,
+                             std::vector<std::string> *rspecifiers) {
+  rspecifiers->clear();
+  size_t open = pattern.find('{');
+  if (open == std::string::npos) return false;
+  size_t close = pattern.find('}', open);
+  if (close == std::string::npos ||
+      pattern.find_first_of("{}", close + 1) != std::string::npos)
+    return false;  // Unterminated, or more than one range.
+  std::string range(pattern, open + 1, close - open - 1);
+  size_t dots = range.find("..");
+  if (dots == std::string::npos) return false;
+  std::string first_str(range, 0, dots), last_str(range, dots + 2);
+  int32 first, last;
+  if (first_str.empty() || last_str.empty() ||
+      first_str.find_first_not_of("0123456789") != std::string::npos ||
+      last_str.find_first_not_of("0123456789") != std::string::npos ||
+      !ConvertStringToInteger(first_str, &first) ||
+      !ConvertStringToInteger(last_str, &last) || first > last)
+    return false;
+  // As in bash, a leading zero means we zero-pad to the width of 'first'.
+  size_t width = (first_str.size() > 1 && first_str[0] == '0' ?
+                  first_str.size() : 0);
+  std::string prefix(pattern, 0, open), suffix(pattern, close + 1);
+  for (int32 n = first; n <= last; n++) {
+    std::string num = std::to_string(n);
+    if (num.size() < width) num.insert(0, width - num.size(), '0');
+    rspecifiers->push_back(prefix + num + suffix);
+  }
+  return true;
+}
+
+
 
 
 
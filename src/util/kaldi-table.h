@@ -71,12 +71,17 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  bg means "background": the objects are queued (Write() copies them) and
+//     serialized and written in a background thread, so the program does
+//     not wait for slow disks.  Write errors are reported by a later Write()
+//     or by Close().
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
 //  ark,b:-
+//  ark,scp,bg:foo.ark,foo.scp
 //
 //  The meanings of rxfilename and wxfilename are as described in
 //  kaldi-stream.h (they are filenames but include pipes, stdin/stdout
@@ -102,19 +107,33 @@ typedef std::vector<std::string> KeyList;
 //  In this case we restrict the archive-filename to be an actual filename,
 //  as we can't see a situtation where an extended filename would make sense
 //  for this (we can't fseek() in pipes).
+//
+//  The type fstore:filename,wxfilename writes a "feature store" (see
+//  feature-store.h): matrices split into chunks of frames, in the data file
+//  'filename', plus an index 'wxfilename' that allows ranges of frames to be
+//  read without reading the whole matrix.  It only works for matrix types.
+//  It takes two extra options: chunk=N sets the number of frames per chunk
+//  (default 100), and compress compresses the chunks (compressed matrices are
+//  always stored compressed), e.g.
+//    fstore,chunk=50,compress:foo.fstore,foo.fsidx
 
 enum WspecifierType  {
   kNoWspecifier,
   kArchiveWspecifier,
   kScriptWspecifier,
-  kBothWspecifier
+  kBothWspecifier,
+  kFeatureStoreWspecifier
 };
 
 struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive;  // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool background;  // write in a background thread.
+  int32 chunk_size;  // fstore only: frames per chunk, 0 for the default.
+  bool compress;  // fstore only: compress the chunks.
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       background(false), chunk_size(0), compress(false) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -167,6 +186,26 @@ bool WriteScriptFile(std::ostream &os,
 //
 // ark:rxfilename
 // scp:rxfilename
+// fstore:rxfilename
+// shards:rspecifier-pattern
+//
+// where in the fstore case, rxfilename is the index of a "feature store" (see
+// feature-store.h); this only works for matrix types.  Random-access readers
+// of a feature store also accept keys with a range of frames, as in scp
+// files: "utt1[100:199]" gives frames 100 to 199 (inclusive) of utt1, reading
+// only the chunks that overlap them.
+//
+// The shards case reads several tables, e.g. the split scp files of a data
+// directory, as if they were one: "shards:scp:data/split64/{1..64}/feats.scp"
+// opens 64 sequential readers, each reading ahead in its own background
+// thread, so a single program can keep several disks or network mounts busy.
+// The pattern must contain exactly one range "{m..n}" (if m is written with
+// leading zeros, e.g. {01..64}, the numbers are zero-padded to that width);
+// each expansion must be an ark, scp or fstore rspecifier.  By default the
+// objects are returned in whatever order the shards deliver them; with the
+// "det" (deterministic) modifier, e.g. "shards,det:scp:...", they are returned
+// in the order of the shards, i.e. as if the shards were concatenated.
+// Sharded rspecifiers only work for sequential reading.
 //
 // We also allow various modifiers:
 //   o   means the program will only ask for each key once, which enables
@@ -190,6 +229,9 @@ bool WriteScriptFile(std::ostream &os,
 //       such as neural-net training examples, especially when you want to
 //       maximize GPU usage.
 //
+//   det only affects "shards:" rspecifiers (see above): return objects in the
+//       order of the shards rather than as soon as any shard has one ready.
+//
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
 //
@@ -211,21 +253,32 @@ struct  RspecifierOptions {
   bool background;  // For sequential readers, if the background option ("bg")
                     // is provided, it will read ahead to the next object in a
                     // background thread.
+  bool deterministic;  // For "shards:" rspecifiers, if "det" is provided, the
+                       // objects are returned in the order of the shards.
   RspecifierOptions(): once(false), sorted(false),
                        called_sorted(false), permissive(false),
-                       background(false) { }
+                       background(false), deterministic(false) { }
 };
 
 enum RspecifierType  {
   kNoRspecifier,
   kArchiveRspecifier,
-  kScriptRspecifier
+  kScriptRspecifier,
+  kFeatureStoreRspecifier,
+  kShardedRspecifier
 };
 
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
                                   std::string *rxfilename,
                                   RspecifierOptions *opts);
 
+// Expands the pattern of a sharded rspecifier (the part after "shards:"),
+// e.g. "scp:feats.{1..3}.scp" -> "scp:feats.1.scp", "scp:feats.2.scp",
+// "scp:feats.3.scp".  Returns false if the pattern does not contain exactly
+// one well-formed range {m..n} with 0 <= m <= n.
+bool ExpandShardedRspecifier(const std::string &pattern,
+                             std::vector<std::string> *rspecifiers);
+
 
 /// Allows random access to a collection
 /// of objects in an archive or script file; see \ref io_sec_tables.
@@ -463,6 +516,68 @@ class RandomAccessTableReaderMapped {
 };
 
 
+/// SequentialTableJoinReader reads several tables of the same type in a single
+/// sequential pass, matching up their keys with a sorted-merge join; it is
+/// for programs like paste-feats that need the object with the same key from
+/// each of several inputs.  Unlike looking the keys up with a
+/// RandomAccessTableReader, it never holds more than one object per input in
+/// memory and never seeks, so the inputs may be pipes or archives of any size.
+/// The keys of every input must be sorted (in the order of std::string's
+/// operator <, which is what "LC_ALL=C sort" gives); it dies with an error if
+/// they are not.  We iterate over the keys of the first input; the other
+/// inputs may lack some of those keys, and may have extra keys, which are
+/// skipped.
+template<class Holder>
+class SequentialTableJoinReader {
+ public:
+  typedef typename Holder::T T;
+
+  SequentialTableJoinReader() { }
+
+  /// This constructor is equivalent to default constructor + Open(), but
+  /// throws on error.
+  explicit SequentialTableJoinReader(
+      const std::vector<std::string> &rspecifiers);
+
+  /// Opens one SequentialTableReader per rspecifier; returns false on error.
+  bool Open(const std::vector<std::string> &rspecifiers);
+
+  bool IsOpen() const { return !readers_.empty(); }
+
+  int32 NumInputs() const { return readers_.size(); }
+
+  /// Returns true when the first input is exhausted.
+  bool Done();
+
+  /// The current key, which is the current key of the first input.
+  std::string Key();
+
+  /// Returns true if input i has the current key; always true for i == 0.
+  bool HasKey(int32 i);
+
+  /// Returns the object for the current key from input i; requires
+  /// HasKey(i).  Like SequentialTableReader::Value(), it is valid until
+  /// the next call to Next().
+  T &Value(int32 i);
+
+  /// Moves to the next key of the first input.
+  void Next();
+
+  /// Closes all the inputs; returns false if any of them had an error.
+  bool Close();
+
+  ~SequentialTableJoinReader();
+
+ private:
+  // Advances input i (i > 0) until its key is not less than Key(), checking
+  // that its keys are sorted.
+  void Advance(int32 i);
+
+  std::vector<SequentialTableReader<Holder>*> readers_;
+  std::vector<std::string> rspecifiers_;  // for error messages.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SequentialTableJoinReader);
+};
+
 /// @} end "addtogroup table_group"
 }  // end namespace kaldi
 
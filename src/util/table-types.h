@@ -41,6 +41,8 @@ typedef RandomAccessTableReader<KaldiObjectHolder<Matrix<BaseFloat> > >
                                 RandomAccessBaseFloatMatrixReader;
 typedef RandomAccessTableReaderMapped<KaldiObjectHolder<Matrix<BaseFloat> > >
                                       RandomAccessBaseFloatMatrixReaderMapped;
+typedef SequentialTableJoinReader<KaldiObjectHolder<Matrix<BaseFloat> > >
+                                  SequentialBaseFloatMatrixJoinReader;
 
 typedef TableWriter<KaldiObjectHolder<Matrix<double> > >
                                       DoubleMatrixWriter;
@@ -161,6 +161,39 @@ void TestConvertStringToInteger() {
                                                         // cannot convert.
 }
 
+void TestParseBasicTypeFromText() {
+  const char *str = " 12 -3\t[7]; 2147483648 1.5e2 F", *p = str;
+  int32 i;
+  KALDI_ASSERT(ParseBasicTypeFromText(&p, &i) && i == 12);
+  KALDI_ASSERT(ParseBasicTypeFromText(&p, &i) && i == -3);
+  KALDI_ASSERT(!ParseBasicTypeFromText(&p, &i) && *p == '\t');  // '['
+  p += 2;
+  KALDI_ASSERT(ParseBasicTypeFromText(&p, &i) && i == 7 && *p == ']');
+  p += 2;
+  const char *q = p;
+  KALDI_ASSERT(!ParseBasicTypeFromText(&p, &i) && p == q);  // overflow.
+  int64 j;
+  KALDI_ASSERT(ParseBasicTypeFromText(&p, &j) && j == 2147483648LL);
+  KALDI_ASSERT(!ParseBasicTypeFromText(&p, &i));  // not an integer.
+  float f;
+  KALDI_ASSERT(ParseBasicTypeFromText(&p, &f) && f == 150.0);
+  bool b = true;
+  KALDI_ASSERT(ParseBasicTypeFromText(&p, &b) && !b && *p == '\0');
+  KALDI_ASSERT(!ParseBasicTypeFromText(&p, &i));
+
+  const char *min_str = "-2147483648", *r = min_str;
+  KALDI_ASSERT(ParseBasicTypeFromText(&r, &i) && i == -2147483647 - 1);
+  uint32 u;
+  r = "-1";
+  KALDI_ASSERT(!ParseBasicTypeFromText(&r, &u));  // unsigned.
+  r = "12a";
+  KALDI_ASSERT(!ParseBasicTypeFromText(&r, &u));  // junk after number.
+  r = "12\xe9 \xe9" "3";  // non-ASCII bytes (negative as char).
+  KALDI_ASSERT(!ParseBasicTypeFromText(&r, &u));
+  r += 4;
+  KALDI_ASSERT(!ParseBasicTypeFromText(&r, &u));
+}
+
 template<class Real>
 void TestConvertStringToReal() {
   Real d;
@@ -521,6 +554,7 @@ int main() {
   TestSplitStringToIntegers();
   TestSplitStringToFloats();
   TestConvertStringToInteger();
+  TestParseBasicTypeFromText();
   TestConvertStringToReal<float>();
   TestConvertStringToReal<double>();
   TestTrim();
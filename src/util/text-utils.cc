@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include "util/text-utils.h"
+#include <cstdlib>
 #include <limits>
 #include <map>
 #include <algorithm>
@@ -234,6 +235,36 @@ class NumberIstream{
 };
 
 
+bool ParseBasicTypeFromText(const char **ptr, float *out) {
+  char *end;
+  float f = strtof(*ptr, &end);  // skips leading whitespace.
+  if (end == *ptr || !IsNumberTerminator(*end))
+    return false;
+  *out = f;
+  *ptr = end;
+  return true;
+}
+
+bool ParseBasicTypeFromText(const char **ptr, double *out) {
+  char *end;
+  double d = strtod(*ptr, &end);
+  if (end == *ptr || !IsNumberTerminator(*end))
+    return false;
+  *out = d;
+  *ptr = end;
+  return true;
+}
+
+bool ParseBasicTypeFromText(const char **ptr, bool *out) {
+  const char *c = *ptr;
+  while (isspace(static_cast<unsigned char>(*c))) c++;
+  if ((*c != 'T' && *c != 'F') || !IsNumberTerminator(c[1]))
+    return false;
+  *out = (*c == 'T');
+  *ptr = c + 1;
+  return true;
+}
+
 template <typename T>
 bool ConvertStringToReal(const std::string &str,
                          T *out) {
@@ -109,6 +109,12 @@ bool SplitStringToFloats(const std::string &full,
                          std::vector<F> *out);
 
 
+/// Returns true if c may follow a number in the text formats read by
+/// ParseBasicTypeFromText(): whitespace, '\0', or one of ";[]".
+inline bool IsNumberTerminator(char c) {
+  return c == '\0' || isspace(static_cast<unsigned char>(c)) || c == ';' || c == '[' || c == ']';
+}
+
 /// Converts a string into an integer via strtoll and returns false if there was
 /// any kind of problem (i.e. the string was not an integer or contained extra
 /// non-whitespace junk, or the integer was too large to fit into the type it is
@@ -123,7 +129,7 @@ bool ConvertStringToInteger(const std::string &str,
   errno = 0;
   int64 i = KALDI_STRTOLL(this_str, &end);
   if (end != this_str)
-    while (isspace(*end)) end++;
+    while (isspace(static_cast<unsigned char>(*end))) end++;
   if (end == this_str || *end != '\0' || errno != 0)
     return false;
   Int iInt = static_cast<Int>(i);
@@ -136,6 +142,51 @@ bool ConvertStringToInteger(const std::string &str,
 }
 
 
+/// ParseBasicTypeFromText is a fast way of reading numbers from text in memory,
+/// used when reading text-mode archives (e.g. of alignments or posteriors),
+/// where going through an istream one token at a time is much slower.  It
+/// skips leading whitespace in the null-terminated string *ptr, parses one
+/// number, and advances *ptr past it.  Returns false (without changing
+/// *ptr or *out) if there was no valid number, or the integer would overflow
+/// the type, or the number is not followed by whitespace, '\0' or one of the
+/// delimiters ";[]".  This template covers integer types; see the overloads
+/// below for float, double and bool (bool is written as T or F).
+template<class Int>
+bool ParseBasicTypeFromText(const char **ptr, Int *out) {
+  KALDI_ASSERT_IS_INTEGER_TYPE(Int);
+  const char *c = *ptr;
+  while (isspace(static_cast<unsigned char>(*c))) c++;
+  bool negative = (*c == '-');
+  if (negative && !std::numeric_limits<Int>::is_signed)
+    return false;
+  if (*c == '-' || *c == '+') c++;
+  if (!isdigit(static_cast<unsigned char>(*c)))
+    return false;
+  // 'limit' is the largest magnitude we can represent with this sign.
+  const uint64 limit = negative ?
+      static_cast<uint64>(-(std::numeric_limits<Int>::min() + 1)) + 1 :
+      static_cast<uint64>(std::numeric_limits<Int>::max());
+  uint64 value = 0;
+  for (; isdigit(static_cast<unsigned char>(*c)); c++) {
+    uint64 digit = *c - '0';
+    if (value > (limit - digit) / 10)
+      return false;  // overflow.
+    value = value * 10 + digit;
+  }
+  if (!IsNumberTerminator(*c))
+    return false;
+  if (negative)  // written this way to handle the most negative value.
+    *out = -static_cast<Int>(value - 1) - 1;
+  else
+    *out = static_cast<Int>(value);
+  *ptr = c;
+  return true;
+}
+
+bool ParseBasicTypeFromText(const char **ptr, float *out);
+bool ParseBasicTypeFromText(const char **ptr, double *out);
+bool ParseBasicTypeFromText(const char **ptr, bool *out);
+
 /// ConvertStringToReal converts a string into either float or double
 /// and returns false if there was any kind of problem (i.e. the string
 /// was not a floating point number or contained extra non-whitespace junk).